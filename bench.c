@@ -0,0 +1,500 @@
+/*************************************************************************
+    > File Name: bench.c
+    > Author: xlzh
+    > Mail: xiaolongzhang2015@163.com
+    > Created Time: 2025年12月22 14时20分37秒
+ ************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include <getopt.h>
+#include <omp.h>
+
+#include "utils.h"
+#include "md5.h"
+#include "database.h"
+#include "stream_reader.h"
+#include "xml_compare.h"
+#include "xml_validate.h"
+#include "cpu_dispatch.h"
+
+/* the maximum number of kernels and runs of one benchmark */
+#define BENCH_MAX_KERNEL 32
+#define BENCH_MAX_RUN 1024
+
+/* the bytes hashed by each md5 benchmark */
+#define BENCH_MD5_BYTES (64 << 20)
+
+
+/*! @typedef result_t
+  @abstract the timing of one kernel
+  @field  name              the kernel name (e.g. md5_calculate_block/1024)
+  @field  n_record          the number of records processed by one run
+  @field  n_byte            the number of bytes processed by one run
+  @field  elapsed           the seconds of each run
+  @field  mean              the mean seconds of the runs
+  @field  cv                the coefficient of variation of the runs (%)
+ */
+typedef struct {
+    char name[48];
+    uint64_t n_record;
+    uint64_t n_byte;
+    double elapsed[BENCH_MAX_RUN];
+    double mean;
+    double cv;
+} result_t;
+
+
+/*! @typedef bench_t
+  @abstract the benchmark options and results
+  @field  n_run             the number of timed runs of each kernel (after one warm-up run)
+  @field  n_record          the number of synthetic records
+  @field  table_size        the capacity of the database used by the lookup and sweep kernels
+  @field  filter            only run the kernels whose name contains it
+  @field  baseline          the baseline file to compare with
+  @field  save              the file to save the results as the new baseline
+  @field  n_result          the number of results
+  @field  results           the results of the kernels
+ */
+typedef struct {
+    int n_run;
+    uint32_t n_record;
+    uint32_t table_size;
+    char *filter;
+    char *baseline;
+    char *save;
+    int n_result;
+    result_t results[BENCH_MAX_KERNEL];
+} bench_t;
+
+
+/*! @typedef context_t
+  @abstract the data shared by the kernels
+ */
+typedef struct {
+    cache_t *cache;             // the cache with the synthetic records
+    uint64_t xml_size;          // the size of the synthetic xml
+    uint64_t id_bytes;          // the bytes scanned by stream_id_parse over all records
+    uint8_t *block;             // the random data hashed by md5
+    uint32_t block_size;        // the size of each md5 block
+    database_t *database;       // the table for the lookup and sweep kernels
+    uint32_t *ids;              // the ids looked up (random or ascending)
+    uint8_t *hashes;            // the current hashes compared with the table
+    uint32_t n_lookup;          // the number of lookups
+} context_t;
+
+
+typedef void (*kernel_f)(context_t *ctx);
+
+
+/* the sink of the kernel results, so that the compiler keeps the work */
+static volatile uint64_t bench_sink;
+
+
+static double bench_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+
+static uint64_t bench_rand(uint64_t *state)
+{
+    uint64_t x = *state;  /* xorshift64 */
+    x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+    return *state = x;
+}
+
+
+/* func: generate the BioSample-like records, with ascending ids and 512~4096 bytes for each */
+static void context_xml_init(context_t *ctx, uint32_t n_record)
+{
+    static const char *words[] = {"<Attribute attribute_name=\"strain\">", "</Attribute>", "<Title>",
+                                  "Homo sapiens", "</Title>", "<Organism taxonomy_id=\"9606\">", "</Organism>",
+                                  "<Description>", "collection_date", "geo_loc_name", "\n  "};
+    uint64_t state = 0x9E3779B97F4A7C15ULL;
+    kstring_t xml = {0, 0, NULL};
+    char head[128];
+
+    for (uint32_t i=0; i < n_record; i++) {
+        const uint32_t id = i * 5 / 4 + 1;
+        const int l_head = snprintf(head, sizeof(head), "<BioSample submission_date=\"2025-12-01\" "
+                                    "id=\"%u\" accession=\"SAMN%08u\">", id, id);
+        const uint32_t size = 512 + (uint32_t)(bench_rand(&state) % 3584);
+
+        err_realloc(xml.s, xml.l + size + 256, char);
+        memcpy(xml.s + xml.l, head, l_head);
+        xml.l += l_head;
+
+        for (uint32_t l=l_head; l < size; ) {
+            const char *word = words[bench_rand(&state) % (sizeof(words) / sizeof(words[0]))];
+            const size_t l_word = strlen(word);
+            memcpy(xml.s + xml.l, word, l_word);
+            xml.l += l_word; l += l_word;
+        }
+        memcpy(xml.s + xml.l, "</BioSample>\n", 13);
+        xml.l += 13;
+    }
+
+    /* the cache is assembled by hand since the records are already in the memory */
+    cache_t *cache;
+    err_calloc(cache, 1, cache_t);
+    k_strcpy(&cache->buffer.start_tag, SAMPLE_START_TAG);
+    k_strcpy(&cache->buffer.end_tag, SAMPLE_END_TAG);
+
+    err_realloc(xml.s, xml.l + 8, char);
+    xml.s[xml.l] = '\0';
+    cache->buffer.base = xml.s;
+    cache->buffer.data = xml.s;
+    cache->buffer.capacity = (uint32_t)xml.l;
+    cache->file_hd = -1;
+
+    ctx->cache = cache;
+    ctx->xml_size = xml.l;
+}
+
+
+static void kernel_cache_parse(context_t *ctx)
+{
+    buffer_t *buffer = &ctx->cache->buffer;
+
+    ctx->cache->size = 0;
+    buffer->front = buffer->data;
+    buffer->size = buffer->capacity;
+    stream_cache_parse(ctx->cache);
+    bench_sink += ctx->cache->size;
+}
+
+
+static void kernel_id_parse(context_t *ctx)
+{
+    uint64_t sum = 0;
+
+    for (uint32_t i=0; i < ctx->cache->size; i++)
+        sum += stream_id_parse(ctx->cache->item_list[i].start, ctx->cache->item_list[i].size);
+    bench_sink += sum;
+}
+
+
+static void kernel_validate(context_t *ctx)
+{
+    const char *message;
+    uint64_t n_error = 0;
+
+    for (uint32_t i=0; i < ctx->cache->size; i++)
+        n_error += validate_body(ctx->cache->item_list[i].start, ctx->cache->item_list[i].size, &message) != NULL;
+    bench_sink += n_error;
+}
+
+
+static void kernel_md5(context_t *ctx)
+{
+    uint8_t md5_value[16];
+    const uint32_t n_block = BENCH_MD5_BYTES / ctx->block_size;
+
+    for (uint32_t i=0; i < n_block; i++) {
+        md5_calculate_block(ctx->block + (size_t)i * ctx->block_size, ctx->block_size, md5_value);
+        bench_sink += md5_value[0];
+    }
+}
+
+
+/* the lookup pattern of xml_compare_core: check the flag, then compare and copy the hash */
+static void kernel_query(context_t *ctx)
+{
+    database_t *database = ctx->database;
+    const size_t width = database->hash_width;
+    uint64_t n_changed = 0;
+
+    for (uint32_t i=0; i < ctx->n_lookup; i++) {
+        const uint32_t id = ctx->ids[i];
+        uint8_t *raw_md5 = database_query(database, id);
+        const uint8_t *cur_md5 = ctx->hashes + i * width;
+
+        if (database_flag(database, id) == 0) {
+            database_flag(database, id) = 3;
+            database_copy(database, raw_md5, cur_md5);
+            continue;
+        }
+
+        if (!database_equal(database, raw_md5, cur_md5)) {
+            database_flag(database, id) = 4;
+            n_changed++;
+            continue;
+        }
+        database_flag(database, id) = 2;
+    }
+    bench_sink += n_changed;
+}
+
+
+/* func: set the flags as after comparing: 2% deleted, 1% added, 3% changed, the others unchanged */
+static void prepare_flags(context_t *ctx)
+{
+    database_t *database = ctx->database;
+    const uint32_t capacity = database->capacity;
+
+    #pragma omp parallel for schedule(static)
+    for (uint32_t id=0; id < capacity; id++) {
+        const uint32_t r = (id * 2654435761U) >> 25;  /* 0~127 */
+        database_flag(database, id) = r < 3 ? 1 : r < 4 ? 3 : r < 8 ? 4 : r < 112 ? 2 : 0;
+    }
+}
+
+
+static void kernel_flags_reset(context_t *ctx)
+{
+    database_flags_reset(ctx->database);
+}
+
+
+static void kernel_list_write(context_t *ctx)
+{
+    diff_list_write(ctx->database, "/dev/null", 1, NULL);
+}
+
+
+/* func: time the kernel with one warm-up run, then report it (the prepare function is not timed) */
+static void bench_time(bench_t *bench, context_t *ctx, const char *name, uint64_t n_record, uint64_t n_byte,
+                       kernel_f kernel, kernel_f prepare)
+{
+    if (bench->filter != NULL && strstr(name, bench->filter) == NULL)
+        return;
+
+    if (bench->n_result == BENCH_MAX_KERNEL) {
+        fprintf(stderr, "[Error:%s] too many kernels (%d)!\n", __func__, BENCH_MAX_KERNEL);
+        exit(-1);
+    }
+
+    result_t *result = &bench->results[bench->n_result++];
+    snprintf(result->name, sizeof(result->name), "%s", name);
+    result->n_record = n_record;
+    result->n_byte = n_byte;
+
+    for (int k=-1; k < bench->n_run; k++) {
+        if (prepare != NULL) prepare(ctx);
+
+        const double start = bench_now();
+        kernel(ctx);
+        if (k >= 0) result->elapsed[k] = bench_now() - start;
+    }
+
+    double sum = 0, sum_sq = 0;
+    for (int k=0; k < bench->n_run; k++)
+        sum += result->elapsed[k];
+    result->mean = sum / bench->n_run;
+
+    for (int k=0; k < bench->n_run; k++)
+        sum_sq += (result->elapsed[k] - result->mean) * (result->elapsed[k] - result->mean);
+    result->cv = bench->n_run > 1 ? sqrt(sum_sq / (bench->n_run - 1)) / result->mean * 100 : 0;
+
+    fprintf(stderr, "[*] %s done\n", name);
+}
+
+
+/* func: find the ns/record of the kernel in the baseline file (-1: not found) */
+static double baseline_find(FILE *file_hd, const char *name)
+{
+    char line[256], base_name[64];
+    double ns_record;
+
+    rewind(file_hd);
+    while (fgets(line, sizeof(line), file_hd) != NULL) {
+        if (line[0] == '#') continue;
+        if (sscanf(line, "%63s %*u %lf", base_name, &ns_record) == 2 && strcmp(base_name, name) == 0)
+            return ns_record;
+    }
+    return -1;
+}
+
+
+/* func: print the results (with the change to the baseline) and save them if necessary
+ *
+ *   the saved file has the same columns as the report, so that it could be used as the baseline
+ */
+static void bench_report(const bench_t *bench)
+{
+    FILE *base_hd = NULL, *save_hd = NULL;
+
+    if (bench->baseline != NULL && (base_hd = fopen(bench->baseline, "r")) == NULL) {
+        fprintf(stderr, "[Error:%s]: failed to open (%s)!\n", __func__, bench->baseline);
+        exit(-1);
+    }
+    if (bench->save != NULL && (save_hd = fopen(bench->save, "w")) == NULL) {
+        fprintf(stderr, "[Error:%s]: failed to open (%s)!\n", __func__, bench->save);
+        exit(-1);
+    }
+
+    const char *header = "#kernel                         records    ns/record       GB/s    cv(%)";
+    fprintf(stdout, "%s%s\n", header, base_hd ? "  baseline(%)" : "");
+    if (save_hd) fprintf(save_hd, "%s\n", header);
+
+    for (int i=0; i < bench->n_result; i++) {
+        const result_t *r = &bench->results[i];
+        const double ns_record = r->mean / (double)r->n_record * 1e9;
+        const double gbps = (double)r->n_byte / r->mean * 1e-9;
+        char row[256];
+
+        snprintf(row, sizeof(row), "%-30s %9lu %12.2f %10.3f %8.2f", r->name, (unsigned long)r->n_record,
+                 ns_record, gbps, r->cv);
+        fprintf(stdout, "%s", row);
+        if (save_hd) fprintf(save_hd, "%s\n", row);
+
+        /* positive: slower than the baseline, '~': the change is within twice the variation */
+        double base_ns = base_hd ? baseline_find(base_hd, r->name) : -1;
+        if (base_ns > 0) {
+            const double change = (ns_record - base_ns) / base_ns * 100;
+            fprintf(stdout, " %+11.2f%s", change, fabs(change) < 2 * r->cv ? " ~" : "");
+        }
+        fprintf(stdout, "\n");
+    }
+
+    if (base_hd) fclose(base_hd);
+    if (save_hd) fclose(save_hd);
+}
+
+
+static void bench_show_usage(void)
+{
+    fprintf(stderr,
+        "\nUsage: xml_bench [options]\n"
+        "\n"
+        "Options:\n"
+        "    -n|--runs          INT       the number of timed runs of each kernel (default: 10)\n"
+        "    -r|--records       INT       the number of synthetic records (default: 200000)\n"
+        "    -t|--table_size    INT       the capacity of the table for lookups and sweeps (default: %d)\n"
+        "    -k|--kernel        STRING    only run the kernels whose name contains STRING\n"
+        "    -b|--baseline      FILE      compare ns/record with the saved baseline\n"
+        "    -s|--save          FILE      save the results as the new baseline\n"
+        "\n\n", SAMPLE_TABLE_SIZE);
+    exit(-1);
+}
+
+
+static const struct option bench_options[] =
+{
+    {"help",  no_argument,  NULL, 'h'},
+    {"runs",  required_argument,  NULL, 'n'},
+    {"records",  required_argument,  NULL, 'r'},
+    {"table_size",  required_argument,  NULL, 't'},
+    {"kernel",  required_argument,  NULL, 'k'},
+    {"baseline",  required_argument,  NULL, 'b'},
+    {"save",  required_argument,  NULL, 's'},
+    {NULL,  0,  NULL,  0}
+};
+
+
+int main(int argc, char **argv)
+{
+    int opt;
+    bench_t *bench;
+
+    err_calloc(bench, 1, bench_t);
+    bench->n_run = 10;
+    bench->n_record = 200000;
+    bench->table_size = SAMPLE_TABLE_SIZE;
+
+    while ( (opt = getopt_long(argc, argv, "n:r:t:k:b:s:h", bench_options, NULL)) != -1 ) {
+        switch (opt) {
+        case 'n': bench->n_run = (int)strtol(optarg, NULL, 10); break;
+        case 'r': bench->n_record = (uint32_t)strtoul(optarg, NULL, 10); break;
+        case 't': bench->table_size = (uint32_t)strtoul(optarg, NULL, 10); break;
+        case 'k': bench->filter = optarg; break;
+        case 'b': bench->baseline = optarg; break;
+        case 's': bench->save = optarg; break;
+        default: bench_show_usage();
+        }
+    }
+
+    if (bench->n_run < 1 || bench->n_run > BENCH_MAX_RUN || bench->n_record < 1 || bench->table_size < 1) {
+        fprintf(stderr, "[Error:%s] the runs (1~%d), records or table size is INVALID!\n\n", __func__, BENCH_MAX_RUN);
+        bench_show_usage();
+    }
+
+    char time_buf[32];
+    fprintf(stderr, "[%s] start to prepare the benchmark (%d threads, %s kernels) ...\n", get_current_time(time_buf),
+            omp_get_max_threads(), cpu_kernel.name);
+
+    /* tag scanning and id parsing over the synthetic records */
+    context_t ctx;
+    memset(&ctx, 0, sizeof(context_t));
+    context_xml_init(&ctx, bench->n_record);
+    kernel_cache_parse(&ctx);
+
+    for (uint32_t i=0; i < ctx.cache->size; i++) {
+        const body_t *body = &ctx.cache->item_list[i];
+        ctx.id_bytes += (uint64_t)(strstr(body->start, "id=\"") - body->start) + 12;
+    }
+
+    bench_time(bench, &ctx, "stream_cache_parse", ctx.cache->size, ctx.xml_size, kernel_cache_parse, NULL);
+    bench_time(bench, &ctx, "stream_id_parse", ctx.cache->size, ctx.id_bytes, kernel_id_parse, NULL);
+    bench_time(bench, &ctx, "validate_body", ctx.cache->size, ctx.xml_size, kernel_validate, NULL);
+
+    /* md5 across the record sizes */
+    uint64_t state = 0x2545F4914F6CDD1DULL;
+    err_malloc(ctx.block, BENCH_MD5_BYTES, uint8_t);
+    for (uint32_t i=0; i < BENCH_MD5_BYTES / 8; i++)
+        ((uint64_t *)ctx.block)[i] = bench_rand(&state);
+
+    static const uint32_t block_sizes[] = {256, 1024, 4096, 16384, 65536};
+    for (size_t i=0; i < sizeof(block_sizes) / sizeof(block_sizes[0]); i++) {
+        char name[48];
+        snprintf(name, sizeof(name), "md5_calculate_block/%u", block_sizes[i]);
+        ctx.block_size = block_sizes[i];
+        bench_time(bench, &ctx, name, BENCH_MD5_BYTES / block_sizes[i], BENCH_MD5_BYTES, kernel_md5, NULL);
+    }
+    free(ctx.block);
+
+    /* the lookups of the classification, with random ids (TLB bound) and ascending ids (as the xml file) */
+    ctx.n_lookup = bench->n_record * 16;
+    err_malloc(ctx.ids, ctx.n_lookup, uint32_t);
+    err_malloc(ctx.hashes, (size_t)ctx.n_lookup * DATABASE_HASH_FULL, uint8_t);
+
+    for (size_t i=0; i < (size_t)ctx.n_lookup * DATABASE_HASH_FULL / 8; i++)
+        ((uint64_t *)ctx.hashes)[i] = bench_rand(&state);
+
+    /* each width with the split tables (e.g. database_query/random/16) and the slots (database_query/random/16/slot) */
+    static const uint32_t widths[] = {DATABASE_HASH_FULL, DATABASE_HASH_SHORT};
+    for (size_t w=0; w < 2 * sizeof(widths) / sizeof(widths[0]); w++) {
+        char name[48];
+        const uint32_t width = widths[w >> 1], layout = w & 1 ? DATABASE_LAYOUT_SLOT : DATABASE_LAYOUT_SPLIT;
+        const char *suffix = layout == DATABASE_LAYOUT_SLOT ? "/slot" : "";
+        ctx.database = database_init(bench->table_size, width, layout);
+
+        /* the bytes of the table touched for each ID */
+        const uint64_t n_byte = ctx.database->slot_width + (layout == DATABASE_LAYOUT_SLOT ? 0 : 1);
+
+        for (uint32_t i=0; i < ctx.n_lookup; i++)
+            ctx.ids[i] = (uint32_t)(bench_rand(&state) % bench->table_size);
+        snprintf(name, sizeof(name), "database_query/random/%u%s", width, suffix);
+        bench_time(bench, &ctx, name, ctx.n_lookup, ctx.n_lookup * n_byte, kernel_query, NULL);
+
+        const uint32_t step = bench->table_size / ctx.n_lookup ? bench->table_size / ctx.n_lookup : 1;
+        for (uint32_t i=0; i < ctx.n_lookup; i++)
+            ctx.ids[i] = (uint32_t)(((uint64_t)i * step) % bench->table_size);
+        snprintf(name, sizeof(name), "database_query/ascending/%u%s", width, suffix);
+        bench_time(bench, &ctx, name, ctx.n_lookup, ctx.n_lookup * n_byte, kernel_query, NULL);
+
+        /* the flag sweeps over the whole table */
+        const uint64_t capacity = ctx.database->capacity;
+        snprintf(name, sizeof(name), "database_flags_reset/%u%s", width, suffix);
+        bench_time(bench, &ctx, name, capacity, capacity * n_byte, kernel_flags_reset, prepare_flags);
+
+        if (width == DATABASE_HASH_FULL && layout == DATABASE_LAYOUT_SPLIT)
+            bench_time(bench, &ctx, "diff_list_write", capacity, capacity, kernel_list_write, prepare_flags);
+
+        database_destroy(ctx.database);
+    }
+    free(ctx.ids);
+    free(ctx.hashes);
+    stream_cache_destroy(ctx.cache);
+
+    fprintf(stderr, "[%s] done!\n", get_current_time(time_buf));
+    bench_report(bench);
+    free(bench);
+    return 0;
+}
@@ -0,0 +1,521 @@
+/*************************************************************************
+    > File Name: body_store.c
+    > Author: xlzh
+    > Mail: xiaolongzhang2015@163.com
+    > Created Time: 2025年12月19 10时08分41秒
+ ************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <zlib.h>
+
+#include "utils.h"
+#include "body_store.h"
+#include "checkpoint.h"
+
+
+/*! @typedef line_t
+  @abstract the distinct line of the sampled data bodies, used to train the dictionary
+ */
+typedef struct {
+    const char *start;
+    uint32_t size;
+    uint32_t count;
+    uint64_t hash;
+} line_t;
+
+
+#define body_memory_resize(_store, _n) do {                                        \
+    if ((_store)->capacity < (_n)) {                                               \
+        uint32_t _old = (_store)->capacity;                                        \
+        (_store)->capacity = (_n); kroundup32((_store)->capacity);                 \
+        err_realloc((_store)->offsets, (_store)->capacity, uint64_t);              \
+        err_realloc((_store)->sizes, (_store)->capacity, uint32_t);                \
+        err_realloc((_store)->raw_sizes, (_store)->capacity, uint32_t);            \
+        memset((_store)->offsets + _old, 0, ((_store)->capacity - _old) * sizeof(uint64_t)); \
+        memset((_store)->sizes + _old, 0, ((_store)->capacity - _old) * sizeof(uint32_t));   \
+        memset((_store)->raw_sizes + _old, 0, ((_store)->capacity - _old) * sizeof(uint32_t)); \
+    }                                                                              \
+} while(0)
+
+
+static void body_store_name(const body_store_t *store, const char *suffix, char *name, size_t size)
+{
+    snprintf(name, size, "%s%s", store->db_name, suffix);
+}
+
+
+/* a new stamp for the data file, which differs from the previous one */
+static uint64_t body_data_stamp(uint64_t stamp)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+
+    uint64_t now = (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+    return now > stamp ? now : stamp + 1;
+}
+
+
+/* write the header of the data file (magic, stamp, dictionary), return the size of the header */
+static uint64_t body_data_header(int fd, uint64_t stamp, const kstring_t *dict)
+{
+    char magic[8] = BODY_DATA_MAGIC;
+    uint32_t dict_size = (uint32_t)dict->l;
+
+    if (pwrite(fd, magic, 8, 0) != 8 || pwrite(fd, &stamp, sizeof(uint64_t), 8) != sizeof(uint64_t) ||
+        pwrite(fd, &dict_size, sizeof(uint32_t), 16) != sizeof(uint32_t) ||
+        pwrite(fd, dict->s, dict->l, 20) != (ssize_t)dict->l) {
+        fprintf(stderr, "[Error:%s] failed to write the body store!\n", __func__);
+        exit(-1);
+    }
+
+    return 20 + dict->l;
+}
+
+
+/* the index keeps the present items only: id, offset, size and raw size of each */
+static int body_index_load(body_store_t *store, const char *index_name)
+{
+    FILE *file_hd = fopen(index_name, "rb");
+    if (file_hd == NULL) return -1;
+
+    char magic[8];
+    uint32_t capacity, n_entry, *ids = NULL, *sizes = NULL, *raw_sizes = NULL;
+    uint64_t *offsets = NULL;
+
+    if (fread(magic, sizeof(char), 8, file_hd) != 8 || memcmp(magic, BODY_INDEX_MAGIC, 8) != 0 ||
+        fread(&store->stamp, sizeof(uint64_t), 1, file_hd) != 1 ||
+        fread(&capacity, sizeof(uint32_t), 1, file_hd) != 1 ||
+        fread(&n_entry, sizeof(uint32_t), 1, file_hd) != 1 ||
+        fread(&store->garbage, sizeof(uint64_t), 1, file_hd) != 1 ||
+        fread(&store->data_size, sizeof(uint64_t), 1, file_hd) != 1 || n_entry > capacity)
+        goto _truncated_error;
+
+    err_malloc(ids, n_entry + 1, uint32_t);
+    err_malloc(offsets, n_entry + 1, uint64_t);
+    err_malloc(sizes, n_entry + 1, uint32_t);
+    err_malloc(raw_sizes, n_entry + 1, uint32_t);
+
+    if (fread(ids, sizeof(uint32_t), n_entry, file_hd) != n_entry ||
+        fread(offsets, sizeof(uint64_t), n_entry, file_hd) != n_entry ||
+        fread(sizes, sizeof(uint32_t), n_entry, file_hd) != n_entry ||
+        fread(raw_sizes, sizeof(uint32_t), n_entry, file_hd) != n_entry)
+        goto _truncated_error;
+
+    body_memory_resize(store, capacity);
+    for (uint32_t k=0; k < n_entry; k++) {
+        if (ids[k] >= capacity) goto _truncated_error;
+
+        store->offsets[ids[k]] = offsets[k];
+        store->sizes[ids[k]] = sizes[k];
+        store->raw_sizes[ids[k]] = raw_sizes[k];
+    }
+
+    free(ids); free(offsets); free(sizes); free(raw_sizes);
+    fclose(file_hd);
+    return 0;
+
+    _truncated_error:
+    fprintf(stderr, "[Error:%s] truncated body store index (%s) detected!\n\n", __func__, index_name);
+    exit(-1);
+}
+
+
+body_store_t *body_store_open(const char *db_name, uint32_t capacity, int resume, int truncate)
+{
+    body_store_t *store;
+    char data_name[1024], index_name[1024];
+
+    err_calloc(store, 1, body_store_t);
+    err_malloc(store->db_name, strlen(db_name) + 1, char);
+    strcpy(store->db_name, db_name);
+
+    body_store_name(store, BODY_DATA_SUFFIX, data_name, sizeof(data_name));
+    body_store_name(store, BODY_INDEX_SUFFIX CHECKPOINT_SUFFIX, index_name, sizeof(index_name));
+
+    /* the index of the checkpoint refers to the data appended after the latest saving */
+    int loaded = resume ? body_index_load(store, index_name) : -1;
+    if (loaded != 0 && !truncate) {
+        body_store_name(store, BODY_INDEX_SUFFIX, index_name, sizeof(index_name));
+        loaded = body_index_load(store, index_name);
+    }
+    body_memory_resize(store, capacity);
+    if (loaded != 0) store->stamp = body_data_stamp(0);
+
+    store->data_fd = open(data_name, loaded == 0 ? O_RDWR : O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (store->data_fd < 0) {
+        fprintf(stderr, "[Error:%s] failed to open the body store (%s)!\n", __func__, data_name);
+        exit(-1);
+    }
+
+    /* read the dictionary, and drop the data appended after the index was saved */
+    if (loaded == 0) {
+        char magic[8];
+        uint64_t stamp;
+        uint32_t dict_size;
+
+        if (pread(store->data_fd, magic, 8, 0) != 8 || memcmp(magic, BODY_DATA_MAGIC, 8) != 0 ||
+            pread(store->data_fd, &stamp, sizeof(uint64_t), 8) != sizeof(uint64_t) ||
+            pread(store->data_fd, &dict_size, sizeof(uint32_t), 16) != sizeof(uint32_t)) {
+            fprintf(stderr, "[Error:%s] broken body store (%s) detected!\n", __func__, data_name);
+            exit(-1);
+        }
+
+        /* the saving was interrupted between the data file and the index */
+        if (stamp != store->stamp) {
+            fprintf(stderr, "[Error:%s] the body store index (%s) does not match the data file (%s), "
+                            "rebuild the store with -b|--body_store!\n", __func__, index_name, data_name);
+            exit(-1);
+        }
+
+        err_realloc(store->dict.s, dict_size + 1, char);
+        store->dict.m = dict_size + 1;
+        if (pread(store->data_fd, store->dict.s, dict_size, 20) != (ssize_t)dict_size) {
+            fprintf(stderr, "[Error:%s] broken body store (%s) detected!\n", __func__, data_name);
+            exit(-1);
+        }
+        store->dict.l = dict_size;
+
+        if (ftruncate(store->data_fd, (off_t)store->data_size) != 0) {
+            fprintf(stderr, "[Error:%s] failed to truncate the body store (%s)!\n", __func__, data_name);
+            exit(-1);
+        }
+    }
+
+    return store;
+}
+
+
+static int line_compare(const void *a, const void *b)
+{
+    const line_t *la = (const line_t *)a, *lb = (const line_t *)b;
+    const uint64_t sa = (uint64_t)(la->count - 1) * la->size, sb = (uint64_t)(lb->count - 1) * lb->size;
+
+    return sa < sb ? 1 : (sa > sb ? -1 : 0);
+}
+
+
+/* func: train the dictionary with the most frequent lines of the sampled data bodies
+ *
+ *   score = (count - 1) * length     (the bytes saved if the line is in the dictionary)
+ *
+ * the lines are written from the lowest score to the highest one, since deflate encodes the
+ * nearer distance (the end of the dictionary) with fewer bits.
+ */
+void body_store_train(body_store_t *store, const cache_t *cache)
+{
+    if (store->data_size > 0 || cache->size == 0) return;  /* already trained */
+
+    const uint32_t n_table = 1 << 18, mask = n_table - 1;
+    const uint32_t step = cache->size > BODY_DICT_SAMPLE ? cache->size / BODY_DICT_SAMPLE : 1;
+    line_t *table;
+    uint32_t n_line = 0;
+
+    err_calloc(table, n_table, line_t);
+
+    /* count the distinct lines with open addressing */
+    for (uint32_t i=0; i < cache->size && n_line < (n_table >> 1); i += step) {
+        const body_t *body = &cache->item_list[i];
+        const char *p = body->start, *end = body->start + body->size;
+
+        while (p < end) {
+            const char *eol = memchr(p, '\n', end - p);
+            uint32_t size = (uint32_t)((eol ? eol + 1 : end) - p);
+            uint64_t hash = 14695981039346656037ULL;
+
+            for (uint32_t k=0; k < size; k++)
+                hash = (hash ^ (uint8_t)p[k]) * 1099511628211ULL;
+
+            uint32_t slot = (uint32_t)hash & mask;
+            while (table[slot].count && (table[slot].hash != hash || table[slot].size != size ||
+                   memcmp(table[slot].start, p, size) != 0))
+                slot = (slot + 1) & mask;
+
+            if (table[slot].count++ == 0) {
+                table[slot].start = p;
+                table[slot].size = size;
+                table[slot].hash = hash;
+                n_line++;
+            }
+            p += size;
+        }
+    }
+
+    /* keep the lines with the highest scores */
+    uint32_t n_keep = 0;
+    for (uint32_t slot=0; slot < n_table; slot++) {
+        if (table[slot].count > 1)
+            table[n_keep++] = table[slot];
+    }
+    qsort(table, n_keep, sizeof(line_t), line_compare);
+
+    uint32_t n_dict = 0, dict_size = 0;
+    while (n_dict < n_keep && dict_size + table[n_dict].size <= BODY_DICT_SIZE)
+        dict_size += table[n_dict++].size;
+
+    store->dict.l = 0;
+    err_realloc(store->dict.s, dict_size + 1, char);
+    store->dict.m = dict_size + 1;
+
+    for (uint32_t k=n_dict; k > 0; k--) {
+        memcpy(store->dict.s + store->dict.l, table[k-1].start, table[k-1].size);
+        store->dict.l += table[k-1].size;
+    }
+    store->dict.s[store->dict.l] = '\0';
+    free(table);
+
+    store->data_size = body_data_header(store->data_fd, store->stamp, &store->dict);
+}
+
+
+void *body_stream_init(void)
+{
+    z_stream *stream;
+    err_calloc(stream, 1, z_stream);
+
+    /* raw deflate (no header and checksum), the data body is small */
+    if (deflateInit2(stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        fprintf(stderr, "[Error:%s] failed to initiate the deflate stream!\n", __func__);
+        exit(-1);
+    }
+    return stream;
+}
+
+
+void body_stream_destroy(void *stream)
+{
+    if (stream == NULL) return;
+
+    deflateEnd((z_stream *)stream);
+    free(stream);
+}
+
+
+void body_store_compress(const body_store_t *store, void *stream, const body_t *body, kstring_t *blob)
+{
+    z_stream *zs = stream ? (z_stream *)stream : (z_stream *)body_stream_init();
+
+    deflateReset(zs);
+    deflateSetDictionary(zs, (const Bytef *)store->dict.s, (uInt)store->dict.l);
+
+    size_t bound = deflateBound(zs, body->size) + 16;
+    if (blob->m < bound) {
+        blob->m = bound; kroundup32(blob->m);
+        err_realloc(blob->s, blob->m, char);
+    }
+
+    zs->next_in = (Bytef *)body->start;
+    zs->avail_in = body->size;
+    zs->next_out = (Bytef *)blob->s;
+    zs->avail_out = (uInt)blob->m;
+
+    deflate(zs, Z_FINISH);
+    blob->l = blob->m - zs->avail_out;
+
+    if (stream == NULL) body_stream_destroy(zs);
+}
+
+
+void body_store_put(body_store_t *store, uint32_t id, const kstring_t *blob, uint32_t raw_size)
+{
+    body_memory_resize(store, id + 1);
+
+    if (pwrite(store->data_fd, blob->s, blob->l, (off_t)store->data_size) != (ssize_t)blob->l) {
+        fprintf(stderr, "[Error:%s] failed to write the body store!\n", __func__);
+        exit(-1);
+    }
+
+    if (store->offsets[id] != 0)  /* the previous data body is stale */
+        store->garbage += store->sizes[id];
+
+    store->offsets[id] = store->data_size;
+    store->sizes[id] = (uint32_t)blob->l;
+    store->raw_sizes[id] = raw_size;
+    store->data_size += blob->l;
+}
+
+
+int body_store_get(const body_store_t *store, uint32_t id, kstring_t *body)
+{
+    if (id >= store->capacity || store->offsets[id] == 0)
+        return -1;
+
+    const uint32_t size = store->sizes[id], raw_size = store->raw_sizes[id];
+    uint8_t *blob;
+    err_malloc(blob, size, uint8_t);
+
+    if (body->m < raw_size + 1) {
+        body->m = raw_size + 1; kroundup32(body->m);
+        err_realloc(body->s, body->m, char);
+    }
+
+    int status = -1;
+    if (pread(store->data_fd, blob, size, (off_t)store->offsets[id]) == (ssize_t)size) {
+        z_stream zs;
+        memset(&zs, 0, sizeof(z_stream));
+
+        if (inflateInit2(&zs, -15) == Z_OK) {
+            inflateSetDictionary(&zs, (const Bytef *)store->dict.s, (uInt)store->dict.l);
+            zs.next_in = blob;
+            zs.avail_in = size;
+            zs.next_out = (Bytef *)body->s;
+            zs.avail_out = raw_size;
+
+            if (inflate(&zs, Z_FINISH) == Z_STREAM_END && zs.total_out == raw_size)
+                status = 0;
+            inflateEnd(&zs);
+        }
+    }
+
+    free(blob);
+    body->l = status == 0 ? raw_size : 0;
+    body->s[body->l] = '\0';
+    return status;
+}
+
+
+void body_store_remove(body_store_t *store, uint32_t id)
+{
+    if (id >= store->capacity || store->offsets[id] == 0)
+        return;
+
+    store->garbage += store->sizes[id];
+    store->offsets[id] = 0;
+    store->sizes[id] = store->raw_sizes[id] = 0;
+}
+
+
+/* rewrite the data file with the live data bodies only, the new stamp invalidates the index saved before */
+static void body_store_compact(body_store_t *store)
+{
+    char data_name[1024], tmp_name[sizeof(data_name) + 4];
+    body_store_name(store, BODY_DATA_SUFFIX, data_name, sizeof(data_name));
+    file_tmp_name(tmp_name, sizeof(tmp_name), data_name);
+
+    int fd = open(tmp_name, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        fprintf(stderr, "[Error:%s] failed to open (%s)!\n", __func__, tmp_name);
+        exit(-1);
+    }
+
+    const uint64_t stamp = body_data_stamp(store->stamp);
+    uint64_t data_size = body_data_header(fd, stamp, &store->dict);
+    uint8_t *blob = NULL;
+    uint32_t m_blob = 0;
+
+    for (uint32_t id=0; id < store->capacity; id++) {
+        if (store->offsets[id] == 0) continue;
+
+        const uint32_t size = store->sizes[id];
+        if (m_blob < size) {
+            m_blob = size; kroundup32(m_blob);
+            err_realloc(blob, m_blob, uint8_t);
+        }
+
+        if (pread(store->data_fd, blob, size, (off_t)store->offsets[id]) != (ssize_t)size ||
+            pwrite(fd, blob, size, (off_t)data_size) != (ssize_t)size) {
+            fprintf(stderr, "[Error:%s] failed to compact the body store!\n", __func__);
+            exit(-1);
+        }
+        store->offsets[id] = data_size;
+        data_size += size;
+    }
+    if (blob != NULL) free(blob);
+
+    if (fsync(fd) != 0 || file_publish(tmp_name, data_name) != 0) {
+        fprintf(stderr, "[Error:%s] failed to compact the body store!\n", __func__);
+        exit(-1);
+    }
+
+    close(store->data_fd);
+    store->data_fd = fd;
+    store->stamp = stamp;
+    store->data_size = data_size;
+    store->garbage = 0;
+}
+
+
+void body_store_save(body_store_t *store, int checkpoint)
+{
+    char index_name[1024], tmp_name[sizeof(index_name) + 4];
+    body_store_name(store, checkpoint ? BODY_INDEX_SUFFIX CHECKPOINT_SUFFIX : BODY_INDEX_SUFFIX,
+                    index_name, sizeof(index_name));
+    file_tmp_name(tmp_name, sizeof(tmp_name), index_name);
+
+    if (!checkpoint && store->garbage > (store->data_size >> 1))
+        body_store_compact(store);
+
+    /* the data must be on the disk before the index referring to it */
+    fsync(store->data_fd);
+
+    FILE *file_hd = fopen(tmp_name, "wb");
+    if (file_hd == NULL) {
+        fprintf(stderr, "[Error:%s] failed to open (%s)!\n", __func__, tmp_name);
+        exit(-1);
+    }
+
+    uint32_t n_entry = 0, *ids, *sizes, *raw_sizes;
+    uint64_t *offsets;
+
+    for (uint32_t id=0; id < store->capacity; id++)
+        n_entry += store->offsets[id] != 0;
+
+    err_malloc(ids, n_entry + 1, uint32_t);
+    err_malloc(offsets, n_entry + 1, uint64_t);
+    err_malloc(sizes, n_entry + 1, uint32_t);
+    err_malloc(raw_sizes, n_entry + 1, uint32_t);
+
+    for (uint32_t id=0, k=0; id < store->capacity; id++) {
+        if (store->offsets[id] == 0) continue;
+
+        ids[k] = id;
+        offsets[k] = store->offsets[id];
+        sizes[k] = store->sizes[id];
+        raw_sizes[k++] = store->raw_sizes[id];
+    }
+
+    char magic[8] = BODY_INDEX_MAGIC;
+    size_t n_item = 0;
+
+    n_item += fwrite(magic, sizeof(char), 8, file_hd);
+    n_item += fwrite(&store->stamp, sizeof(uint64_t), 1, file_hd);
+    n_item += fwrite(&store->capacity, sizeof(uint32_t), 1, file_hd);
+    n_item += fwrite(&n_entry, sizeof(uint32_t), 1, file_hd);
+    n_item += fwrite(&store->garbage, sizeof(uint64_t), 1, file_hd);
+    n_item += fwrite(&store->data_size, sizeof(uint64_t), 1, file_hd);
+    n_item += fwrite(ids, sizeof(uint32_t), n_entry, file_hd);
+    n_item += fwrite(offsets, sizeof(uint64_t), n_entry, file_hd);
+    n_item += fwrite(sizes, sizeof(uint32_t), n_entry, file_hd);
+    n_item += fwrite(raw_sizes, sizeof(uint32_t), n_entry, file_hd);
+    free(ids); free(offsets); free(sizes); free(raw_sizes);
+
+    if (file_cache_drop(file_hd) != 0 || fclose(file_hd) != 0 || n_item != 13 + (size_t)n_entry * 4 ||
+        file_publish(tmp_name, index_name) != 0) {
+        fprintf(stderr, "[Error:%s] failed to save the body store index (%s)!\n", __func__, index_name);
+        exit(-1);
+    }
+
+    /* the index of the checkpoint is useless after saving */
+    if (!checkpoint) {
+        body_store_name(store, BODY_INDEX_SUFFIX CHECKPOINT_SUFFIX, index_name, sizeof(index_name));
+        unlink(index_name);
+    }
+}
+
+
+void body_store_close(body_store_t *store)
+{
+    if (store == NULL) return;
+
+    close(store->data_fd);
+    k_strfree(&store->dict);
+    free(store->offsets);
+    free(store->sizes);
+    free(store->raw_sizes);
+    free(store->db_name);
+    free(store);
+}
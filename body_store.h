@@ -0,0 +1,135 @@
+/*************************************************************************
+    > File Name: body_store.h
+    > Author: xlzh
+    > Mail: xiaolongzhang2015@163.com
+    > Created Time: 2025年12月19 10时08分41秒
+ ************************************************************************/
+
+#ifndef INSDCXMLPARSER_BODY_STORE_H
+#define INSDCXMLPARSER_BODY_STORE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "utils.h"
+#include "stream_reader.h"
+
+/* the magic string of the data and index file */
+#define BODY_DATA_MAGIC "INSDCB2"
+#define BODY_INDEX_MAGIC "INSDCI2"
+
+/* the suffix of the data and index file (e.g. biosample.db.bst) */
+#define BODY_DATA_SUFFIX ".bst"
+#define BODY_INDEX_SUFFIX ".bsi"
+
+/* the size of the dictionary (the window size of deflate) */
+#define BODY_DICT_SIZE 32768
+
+/* the number of data bodies sampled to train the dictionary */
+#define BODY_DICT_SAMPLE 2048
+
+
+/*! @typedef body_store_t
+  @abstract the compressed data body of each id (raw deflate with a trained dictionary)
+  @field  capacity          the maximum number of items to store
+  @field  stamp             the stamp of the data file, the index is only valid with the same stamp
+  @field  garbage           the bytes of the stale data bodies in the data file
+  @field  data_size         the size of the data file
+  @field  offsets           the offset of the compressed data body in the data file (0: not existed)
+  @field  sizes             the size of the compressed data body
+  @field  raw_sizes         the size of the data body
+  @field  dict              the dictionary shared by all data bodies
+  @field  data_fd           the file handle of the data file
+  @field  db_name           the database file name, which the store is next to
+ */
+typedef struct {
+    uint32_t capacity;
+    uint64_t stamp;
+    uint64_t garbage;
+    uint64_t data_size;
+    uint64_t *offsets;
+    uint32_t *sizes;
+    uint32_t *raw_sizes;
+    kstring_t dict;
+    int data_fd;
+    char *db_name;
+} body_store_t;
+
+
+/*! @function: open the body store next to the database (created if not existed)
+  @param  db_name            the database file name
+  @param  capacity           the maximum number of items to store
+  @param  resume             [0|1] 1: load the index saved by the latest checkpoint
+  @param  truncate           [0|1] 1: drop the existing store (unless resumed from the checkpoint)
+  @return                    the body store object
+ */
+body_store_t *body_store_open(const char *db_name, uint32_t capacity, int resume, int truncate);
+
+
+/*! @function: train the dictionary with the data bodies of the batch (only if the store is empty)
+  @param  store              the body store object
+  @param  cache              the cache with parsed data bodies
+  @return
+ */
+void body_store_train(body_store_t *store, const cache_t *cache);
+
+
+/*! @function: compress the data body with the dictionary (thread-safe with its own stream)
+  @param  store              the body store object
+  @param  stream             the deflate stream from body_stream_init (NULL: a temporary one)
+  @param  body               the data body
+  @param  blob               the compressed data body
+  @return
+ */
+void body_store_compress(const body_store_t *store, void *stream, const body_t *body, kstring_t *blob);
+
+
+/*! @function: prepare and release a deflate stream for body_store_compress
+  @return                    the deflate stream
+ */
+void *body_stream_init(void);
+void body_stream_destroy(void *stream);
+
+
+/*! @function: append the compressed data body of the id (not thread-safe)
+  @param  store              the body store object
+  @param  id                 the id of the data body
+  @param  blob               the compressed data body
+  @param  raw_size           the size of the data body
+  @return
+ */
+void body_store_put(body_store_t *store, uint32_t id, const kstring_t *blob, uint32_t raw_size);
+
+
+/*! @function: get the data body of the id (thread-safe)
+  @param  store              the body store object
+  @param  id                 the id of the data body
+  @param  body               the data body
+  @return                    status (-1: not existed or broken)
+ */
+int body_store_get(const body_store_t *store, uint32_t id, kstring_t *body);
+
+
+/*! @function: remove the data body of the id
+  @param  store              the body store object
+  @param  id                 the id of the data body
+  @return
+ */
+void body_store_remove(body_store_t *store, uint32_t id);
+
+
+/*! @function: save the index (and compact the data file if more than half is stale)
+  @param  store              the body store object
+  @param  checkpoint         [0|1] 1: save the index for the checkpoint, no compaction
+  @return
+ */
+void body_store_save(body_store_t *store, int checkpoint);
+
+
+/*! @function: close the body store and destroy the memory
+  @param  store              the body store object
+  @return
+ */
+void body_store_close(body_store_t *store);
+
+
+#endif //INSDCXMLPARSER_BODY_STORE_H
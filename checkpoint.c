@@ -0,0 +1,170 @@
+/*************************************************************************
+    > File Name: checkpoint.c
+    > Author: xlzh
+    > Mail: xiaolongzhang2015@163.com
+    > Created Time: 2025年12月16 14时05分37秒
+ ************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "utils.h"
+#include "checkpoint.h"
+#include "trace.h"
+
+
+/* the size of the xml file (0: unknown) */
+static uint64_t checkpoint_xml_size(const char *xml_file)
+{
+    struct stat st;
+
+    if (stat(xml_file, &st) != 0)
+        return 0;
+
+    return (uint64_t)st.st_size;
+}
+
+
+void checkpoint_init(checkpoint_t *ckpt, const args_t *args)
+{
+    memset(ckpt, 0, sizeof(checkpoint_t));
+
+    ckpt->params_mode = args->params_mode;
+    ckpt->xml_date = args->xml_date;
+    ckpt->xml_size = checkpoint_xml_size(args->xml_file);
+    ckpt->range_start = args->range_start;
+    ckpt->range_end = args->range_end;
+    ckpt->last_time = time(NULL);
+
+    if (args->output_shards > 1) {
+        ckpt->n_shard = (uint32_t)args->output_shards;
+        err_calloc(ckpt->shard_size, ckpt->n_shard, uint64_t);
+    }
+}
+
+
+int checkpoint_save(checkpoint_t *ckpt, const args_t *args, const database_t *database)
+{
+    char ckpt_name[1024], tmp_name[sizeof(ckpt_name) + 4];
+    snprintf(ckpt_name, sizeof(ckpt_name), "%s%s", args->database, CHECKPOINT_SUFFIX);
+    file_tmp_name(tmp_name, sizeof(tmp_name), ckpt_name);
+
+    ckpt->last_time = time(NULL);
+
+    FILE *file_hd = fopen(tmp_name, "wb");
+    if (file_hd == NULL) {
+        fprintf(stderr, "\n[Warning:%s] failed to open (%s), the checkpoint is skipped!\n", __func__, tmp_name);
+        return -1;
+    }
+
+    /* save the progress, then the partial table */
+    char magic[8] = CHECKPOINT_MAGIC;
+    size_t n_item = 0;
+
+    n_item += fwrite(magic, sizeof(char), 8, file_hd);
+    n_item += fwrite(&ckpt->params_mode, sizeof(uint32_t), 1, file_hd);
+    n_item += fwrite(&ckpt->xml_date, sizeof(uint32_t), 1, file_hd);
+    n_item += fwrite(&ckpt->xml_size, sizeof(uint64_t), 1, file_hd);
+    n_item += fwrite(&ckpt->offset, sizeof(uint64_t), 1, file_hd);
+    n_item += fwrite(&ckpt->diff_size, sizeof(uint64_t), 1, file_hd);
+    n_item += fwrite(&ckpt->prev_size, sizeof(uint64_t), 1, file_hd);
+    n_item += fwrite(&ckpt->n_item, sizeof(uint64_t), 1, file_hd);
+    n_item += fwrite(&ckpt->range_start, sizeof(uint64_t), 1, file_hd);
+    n_item += fwrite(&ckpt->range_end, sizeof(uint64_t), 1, file_hd);
+    n_item += fwrite(&ckpt->n_shard, sizeof(uint32_t), 1, file_hd);
+    n_item += fwrite(ckpt->shard_size, sizeof(uint64_t), ckpt->n_shard, file_hd);
+
+    int status = n_item == 18 + ckpt->n_shard ? database_write(database, file_hd) : -1;
+
+    /* the checkpoint must be on the disk before replacing the previous one (it is only read to resume) */
+    if (file_cache_drop(file_hd) != 0) status = -1;
+    if (fclose(file_hd) != 0) status = -1;
+
+    if (status != 0 || file_publish(tmp_name, ckpt_name) != 0) {
+        fprintf(stderr, "\n[Warning:%s] failed to save the checkpoint (%s)!\n", __func__, ckpt_name);
+        unlink(tmp_name);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+database_t *checkpoint_load(checkpoint_t *ckpt, const args_t *args)
+{
+    char ckpt_name[1024];
+    snprintf(ckpt_name, sizeof(ckpt_name), "%s%s", args->database, CHECKPOINT_SUFFIX);
+
+    FILE *file_hd = fopen(ckpt_name, "rb");
+    if (file_hd == NULL) {
+        fprintf(stderr, "[*] no checkpoint (%s) is found, start from the beginning\n", ckpt_name);
+        return NULL;
+    }
+
+    char time_buf[32], magic[8];
+    const uint64_t t_load = trace_begin();
+    fprintf(stderr, "[%s] start to load the checkpoint ...\n", get_current_time(time_buf));
+
+    if (fread(magic, sizeof(char), 8, file_hd) != 8 || memcmp(magic, CHECKPOINT_MAGIC, 8) != 0) {
+        fprintf(stderr, "[Error:%s] the file (%s) is not a checkpoint of this version!\n\n", __func__, ckpt_name);
+        exit(-1);
+    }
+
+    size_t n_item = 0;
+    n_item += fread(&ckpt->params_mode, sizeof(uint32_t), 1, file_hd);
+    n_item += fread(&ckpt->xml_date, sizeof(uint32_t), 1, file_hd);
+    n_item += fread(&ckpt->xml_size, sizeof(uint64_t), 1, file_hd);
+    n_item += fread(&ckpt->offset, sizeof(uint64_t), 1, file_hd);
+    n_item += fread(&ckpt->diff_size, sizeof(uint64_t), 1, file_hd);
+    n_item += fread(&ckpt->prev_size, sizeof(uint64_t), 1, file_hd);
+    n_item += fread(&ckpt->n_item, sizeof(uint64_t), 1, file_hd);
+    n_item += fread(&ckpt->range_start, sizeof(uint64_t), 1, file_hd);
+    n_item += fread(&ckpt->range_end, sizeof(uint64_t), 1, file_hd);
+
+    /* the shards must be the same as the current run */
+    uint32_t n_shard = 0;
+    n_item += fread(&n_shard, sizeof(uint32_t), 1, file_hd);
+    if (n_item == 10 && n_shard != ckpt->n_shard) {
+        fprintf(stderr, "[Error:%s] the checkpoint (%s) is saved with %u output shards!\n", __func__, ckpt_name,
+                n_shard ? n_shard : 1);
+        exit(-1);
+    }
+    n_item += fread(ckpt->shard_size, sizeof(uint64_t), ckpt->n_shard, file_hd);
+
+    database_t *database = n_item == 10 + ckpt->n_shard ? database_read(file_hd) : NULL;
+    if (database == NULL) {
+        fprintf(stderr, "[Error:%s] truncated checkpoint file (%s) detected!\n\n", __func__, ckpt_name);
+        exit(-1);
+    }
+    fclose(file_hd);
+
+    /* the checkpoint must come from the same command, the same xml file and the same byte range */
+    if (ckpt->params_mode != (uint32_t)args->params_mode || ckpt->xml_date != (uint32_t)args->xml_date ||
+        ckpt->xml_size != checkpoint_xml_size(args->xml_file) || ckpt->range_start != args->range_start ||
+        ckpt->range_end != args->range_end) {
+        fprintf(stderr, "[Error:%s] the checkpoint (%s) does not match the current run!\n", __func__, ckpt_name);
+        fprintf(stderr, "  (-) checkpoint: mode %u, date %u, xml size %lu, range [%lu, %lu)\n", ckpt->params_mode,
+                ckpt->xml_date, (unsigned long)ckpt->xml_size, (unsigned long)ckpt->range_start,
+                (unsigned long)ckpt->range_end);
+        exit(-1);
+    }
+
+    ckpt->last_time = time(NULL);
+    fprintf(stderr, "[*] resume from offset %lu (%lu items)\n", (unsigned long)ckpt->offset,
+            (unsigned long)ckpt->n_item);
+    fprintf(stderr, "[%s] done!\n", get_current_time(time_buf));
+    trace_end(t_load, "load", database->capacity);
+    return database;
+}
+
+
+void checkpoint_remove(const args_t *args)
+{
+    char ckpt_name[1024];
+    snprintf(ckpt_name, sizeof(ckpt_name), "%s%s", args->database, CHECKPOINT_SUFFIX);
+
+    unlink(ckpt_name);
+}
@@ -0,0 +1,95 @@
+/*************************************************************************
+    > File Name: checkpoint.h
+    > Author: xlzh
+    > Mail: xiaolongzhang2015@163.com
+    > Created Time: 2025年12月16 14时05分37秒
+ ************************************************************************/
+
+#ifndef INSDCXMLPARSER_CHECKPOINT_H
+#define INSDCXMLPARSER_CHECKPOINT_H
+
+#include <stdint.h>
+#include <time.h>
+#include "params.h"
+#include "database.h"
+
+/* the magic string of the checkpoint file */
+#define CHECKPOINT_MAGIC "INSDCK3"
+
+/* the suffix of the checkpoint file (e.g. biosample.db.ckpt) */
+#define CHECKPOINT_SUFFIX ".ckpt"
+
+
+/*! @typedef checkpoint_t
+  @abstract the progress of a build or compare run, saved with the partial table
+  @field  params_mode       the mode of the run (PARAMS_BUILD, PARAMS_SAMPLE or PARAMS_PROJECT)
+  @field  xml_date          the released date of the xml file
+  @field  xml_size          the size of the xml file, used to detect a different input
+  @field  offset            the offset of the xml file to resume from (a record boundary)
+  @field  diff_size         the number of bytes written into the diff xml file
+  @field  prev_size         the number of bytes written into the prev xml file (with body store)
+  @field  n_item            the number of items processed
+  @field  range_start       the start offset of the byte range built (--range)
+  @field  range_end         the end offset of the byte range built (--range)
+  @field  n_shard           the number of the diff xml shards (0: a single diff xml)
+  @field  shard_size        the number of bytes written into each diff xml shard
+  @field  last_time         the time of the latest checkpoint (not saved)
+ */
+typedef struct {
+    uint32_t params_mode;
+    uint32_t xml_date;
+    uint64_t xml_size;
+    uint64_t offset;
+    uint64_t diff_size;
+    uint64_t prev_size;
+    uint64_t n_item;
+    uint64_t range_start;
+    uint64_t range_end;
+    uint32_t n_shard;
+    uint64_t *shard_size;
+    time_t last_time;
+} checkpoint_t;
+
+
+/*! @function: initiation of the checkpoint for a fresh run (shard_size is freed by the caller)
+  @param  ckpt               the checkpoint object
+  @param  args               the command line parameters
+  @return
+ */
+void checkpoint_init(checkpoint_t *ckpt, const args_t *args);
+
+
+/*! @function: save the checkpoint and the partial table (write to a temporary file then rename)
+  @param  ckpt               the checkpoint object
+  @param  args               the command line parameters
+  @param  database           the partial table
+  @return                    status of saving (-1: failed, the run could continue)
+ */
+int checkpoint_save(checkpoint_t *ckpt, const args_t *args, const database_t *database);
+
+
+/*! @function: load the checkpoint and the partial table
+  @param  ckpt               the checkpoint object
+  @param  args               the command line parameters
+  @return                    the partial table (NULL: the checkpoint is not existed)
+ */
+database_t *checkpoint_load(checkpoint_t *ckpt, const args_t *args);
+
+
+/*! @function: remove the checkpoint after the run finished
+  @param  args               the command line parameters
+  @return
+ */
+void checkpoint_remove(const args_t *args);
+
+
+/*! @function: check whether it is time to save a checkpoint
+  @param  _ckpt              the checkpoint object
+  @param  _args              the command line parameters
+  @return                    1: a checkpoint is needed
+ */
+#define checkpoint_due(_ckpt, _args) \
+    ((_args)->checkpoint > 0 && time(NULL) - (_ckpt)->last_time >= (_args)->checkpoint)
+
+
+#endif //INSDCXMLPARSER_CHECKPOINT_H
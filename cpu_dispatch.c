@@ -0,0 +1,467 @@
+/*************************************************************************
+    > File Name: cpu_dispatch.c
+    > Author: xlzh
+    > Mail: xiaolongzhang2015@163.com
+    > Created Time: 2025年12月26 10时12分47秒
+ ************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "cpu_dispatch.h"
+#include "md5.h"
+
+/* the vector variants are compiled for x86-64 with the target attribute, so that one binary runs on any node */
+#if defined(__x86_64__) && defined(__GNUC__)
+#define CPU_DISPATCH_X86 1
+#include <immintrin.h>
+#endif
+
+
+/* func: the scalar search of the tag in the candidates [p, end) */
+static const char *tag_find_tail(const char *p, const char *end, const char *tag, size_t l)
+{
+    for (; p < end && (p = memchr(p, tag[0], end - p)) != NULL; p++)
+        if (memcmp(p, tag, l) == 0) return p;
+
+    return NULL;
+}
+
+
+static const char *tag_find_generic(const char *data, size_t size, const char *tag, size_t l)
+{
+    if (size < l) return NULL;
+    return tag_find_tail(data, data + size - l + 1, tag, l);
+}
+
+
+static size_t text_span_generic(const uint8_t *data, size_t size)
+{
+    size_t i = 0;
+
+    for (; i < size; i++) {
+        const uint8_t c = data[i];
+        if ((c < 0x20 || c >= 0x80) && c != '\t' && c != '\n' && c != '\r') break;
+    }
+
+    return i;
+}
+
+
+/* func: the scalar sweep of the flags [i, n), the bits of the mask are set (the mask is cleared by the caller) */
+static size_t flags_sweep_tail(uint8_t *flags, size_t i, size_t n, uint64_t *mask)
+{
+    static const uint8_t table[8] = {0, 0, 1, 1, 1, 0, 0, 0};
+    size_t n_deleted = 0;
+
+    for (; i < n; i++) {
+        if (flags[i] == 1) {
+            mask[i >> 6] |= 1ULL << (i & 63);
+            n_deleted++;
+        }
+        flags[i] = table[flags[i]];
+    }
+
+    return n_deleted;
+}
+
+
+static size_t flags_sweep_generic(uint8_t *flags, size_t n, uint64_t *mask)
+{
+    memset(mask, 0, ((n + 63) >> 6) * sizeof(uint64_t));
+    return flags_sweep_tail(flags, 0, n, mask);
+}
+
+
+static size_t flags_changed_tail(const uint8_t *flags, size_t i, size_t n, uint64_t *mask)
+{
+    size_t n_changed = 0;
+
+    for (; i < n; i++) {
+        if (flags[i] & 5) {  /* 1:delete, 3:add and 4:change */
+            mask[i >> 6] |= 1ULL << (i & 63);
+            n_changed++;
+        }
+    }
+
+    return n_changed;
+}
+
+
+static size_t flags_changed_generic(const uint8_t *flags, size_t n, uint64_t *mask)
+{
+    memset(mask, 0, ((n + 63) >> 6) * sizeof(uint64_t));
+    return flags_changed_tail(flags, 0, n, mask);
+}
+
+
+#ifdef CPU_DISPATCH_X86
+
+/* func: the positions matching both the first and last bytes of the tag are found 16 at once,
+ *   then the candidates are compared with the whole tag
+ */
+static const char *tag_find_sse2(const char *data, size_t size, const char *tag, size_t l)
+{
+    if (size < l) return NULL;
+
+    const char *p = data, *end = data + size - l + 1;  /* the candidates are in [data, end) */
+    const __m128i first = _mm_set1_epi8(tag[0]), last = _mm_set1_epi8(tag[l-1]);
+
+    for (; l >= 2 && end - p >= 16; p += 16) {
+        const __m128i head = _mm_loadu_si128((const __m128i *)p);
+        const __m128i tail = _mm_loadu_si128((const __m128i *)(p + l - 1));
+        uint32_t mask = (uint32_t)_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(head, first),
+                                                                  _mm_cmpeq_epi8(tail, last)));
+        while (mask != 0) {
+            const int k = __builtin_ctz(mask);
+            if (memcmp(p + k + 1, tag + 1, l - 2) == 0) return p + k;
+            mask &= mask - 1;
+        }
+    }
+
+    return tag_find_tail(p, end, tag, l);
+}
+
+
+__attribute__((target("avx2,bmi,bmi2")))
+static const char *tag_find_avx2(const char *data, size_t size, const char *tag, size_t l)
+{
+    if (size < l) return NULL;
+
+    const char *p = data, *end = data + size - l + 1;
+    const __m256i first = _mm256_set1_epi8(tag[0]), last = _mm256_set1_epi8(tag[l-1]);
+
+    for (; l >= 2 && end - p >= 32; p += 32) {
+        const __m256i head = _mm256_loadu_si256((const __m256i *)p);
+        const __m256i tail = _mm256_loadu_si256((const __m256i *)(p + l - 1));
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(head, first),
+                                                                        _mm256_cmpeq_epi8(tail, last)));
+        while (mask != 0) {
+            const int k = __builtin_ctz(mask);
+            if (memcmp(p + k + 1, tag + 1, l - 2) == 0) return p + k;
+            mask &= mask - 1;
+        }
+    }
+
+    return tag_find_tail(p, end, tag, l);
+}
+
+
+__attribute__((target("avx512f,avx512bw,avx2,bmi,bmi2")))
+static const char *tag_find_avx512(const char *data, size_t size, const char *tag, size_t l)
+{
+    if (size < l) return NULL;
+
+    const char *p = data, *end = data + size - l + 1;
+    const __m512i first = _mm512_set1_epi8(tag[0]), last = _mm512_set1_epi8(tag[l-1]);
+
+    for (; l >= 2 && end - p >= 64; p += 64) {
+        const __m512i head = _mm512_loadu_si512((const void *)p);
+        const __m512i tail = _mm512_loadu_si512((const void *)(p + l - 1));
+        uint64_t mask = _mm512_cmpeq_epi8_mask(head, first) & _mm512_cmpeq_epi8_mask(tail, last);
+
+        while (mask != 0) {
+            const int k = __builtin_ctzll(mask);
+            if (memcmp(p + k + 1, tag + 1, l - 2) == 0) return p + k;
+            mask &= mask - 1;
+        }
+    }
+
+    return tag_find_tail(p, end, tag, l);
+}
+
+
+/* func: the chunks of printable ASCII, tab, LF and CR are skipped, the chunk with other bytes is checked byte-wise */
+static size_t text_span_sse2(const uint8_t *data, size_t size)
+{
+    const __m128i space = _mm_set1_epi8(0x20), lf = _mm_set1_epi8('\n');
+    const __m128i tab = _mm_set1_epi8('\t'), cr = _mm_set1_epi8('\r');
+    size_t i = 0;
+
+    for (; size - i >= 16; i += 16) {
+        const __m128i v = _mm_loadu_si128((const __m128i *)(data + i));
+        const __m128i special = _mm_cmplt_epi8(v, space);  /* control characters and non-ASCII (signed) */
+        const __m128i blank = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, lf), _mm_cmpeq_epi8(v, tab)),
+                                           _mm_cmpeq_epi8(v, cr));
+
+        if (_mm_movemask_epi8(_mm_andnot_si128(blank, special)) != 0) break;
+    }
+
+    return i + text_span_generic(data + i, size - i);
+}
+
+
+__attribute__((target("avx2,bmi,bmi2")))
+static size_t text_span_avx2(const uint8_t *data, size_t size)
+{
+    const __m256i space = _mm256_set1_epi8(0x20), lf = _mm256_set1_epi8('\n');
+    const __m256i tab = _mm256_set1_epi8('\t'), cr = _mm256_set1_epi8('\r');
+    size_t i = 0;
+
+    for (; size - i >= 32; i += 32) {
+        const __m256i v = _mm256_loadu_si256((const __m256i *)(data + i));
+        const __m256i special = _mm256_cmpgt_epi8(space, v);
+        const __m256i blank = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, lf), _mm256_cmpeq_epi8(v, tab)),
+                                              _mm256_cmpeq_epi8(v, cr));
+
+        if (_mm256_movemask_epi8(_mm256_andnot_si256(blank, special)) != 0) break;
+    }
+
+    return i + text_span_generic(data + i, size - i);
+}
+
+
+__attribute__((target("avx512f,avx512bw,avx2,bmi,bmi2")))
+static size_t text_span_avx512(const uint8_t *data, size_t size)
+{
+    const __m512i space = _mm512_set1_epi8(0x20), lf = _mm512_set1_epi8('\n');
+    const __m512i tab = _mm512_set1_epi8('\t'), cr = _mm512_set1_epi8('\r');
+    size_t i = 0;
+
+    for (; size - i >= 64; i += 64) {
+        const __m512i v = _mm512_loadu_si512((const void *)(data + i));
+        const uint64_t special = _mm512_cmplt_epi8_mask(v, space);
+        const uint64_t blank = _mm512_cmpeq_epi8_mask(v, lf) | _mm512_cmpeq_epi8_mask(v, tab) |
+                               _mm512_cmpeq_epi8_mask(v, cr);
+
+        if ((special & ~blank) != 0) break;
+    }
+
+    return i + text_span_generic(data + i, size - i);
+}
+
+
+/* func: each 64 flags are reset with min(flag, 1) except the deleted ones (0), the remainder is swept byte-wise */
+static size_t flags_sweep_sse2(uint8_t *flags, size_t n, uint64_t *mask)
+{
+    const __m128i one = _mm_set1_epi8(1);
+    size_t i = 0, n_deleted = 0;
+
+    memset(mask, 0, ((n + 63) >> 6) * sizeof(uint64_t));
+    for (; n - i >= 64; i += 64) {
+        uint64_t bits = 0;
+
+        for (int k=0; k < 4; k++) {
+            const __m128i v = _mm_loadu_si128((const __m128i *)(flags + i + (k << 4)));
+            const __m128i deleted = _mm_cmpeq_epi8(v, one);
+            _mm_storeu_si128((__m128i *)(flags + i + (k << 4)), _mm_andnot_si128(deleted, _mm_min_epu8(v, one)));
+            bits |= (uint64_t)(uint32_t)_mm_movemask_epi8(deleted) << (k << 4);
+        }
+        mask[i >> 6] = bits;
+        n_deleted += __builtin_popcountll(bits);
+    }
+
+    return n_deleted + flags_sweep_tail(flags, i, n, mask);
+}
+
+
+__attribute__((target("avx2,bmi,bmi2,popcnt")))
+static size_t flags_sweep_avx2(uint8_t *flags, size_t n, uint64_t *mask)
+{
+    const __m256i one = _mm256_set1_epi8(1);
+    size_t i = 0, n_deleted = 0;
+
+    memset(mask, 0, ((n + 63) >> 6) * sizeof(uint64_t));
+    for (; n - i >= 64; i += 64) {
+        const __m256i lo = _mm256_loadu_si256((const __m256i *)(flags + i));
+        const __m256i hi = _mm256_loadu_si256((const __m256i *)(flags + i + 32));
+        const __m256i del_lo = _mm256_cmpeq_epi8(lo, one), del_hi = _mm256_cmpeq_epi8(hi, one);
+
+        _mm256_storeu_si256((__m256i *)(flags + i), _mm256_andnot_si256(del_lo, _mm256_min_epu8(lo, one)));
+        _mm256_storeu_si256((__m256i *)(flags + i + 32), _mm256_andnot_si256(del_hi, _mm256_min_epu8(hi, one)));
+
+        const uint64_t bits = (uint64_t)(uint32_t)_mm256_movemask_epi8(del_lo) |
+                              (uint64_t)(uint32_t)_mm256_movemask_epi8(del_hi) << 32;
+        mask[i >> 6] = bits;
+        n_deleted += __builtin_popcountll(bits);
+    }
+
+    return n_deleted + flags_sweep_tail(flags, i, n, mask);
+}
+
+
+__attribute__((target("avx512f,avx512bw,avx2,bmi,bmi2,popcnt")))
+static size_t flags_sweep_avx512(uint8_t *flags, size_t n, uint64_t *mask)
+{
+    const __m512i one = _mm512_set1_epi8(1), zero = _mm512_setzero_si512();
+    size_t i = 0, n_deleted = 0;
+
+    memset(mask, 0, ((n + 63) >> 6) * sizeof(uint64_t));
+    for (; n - i >= 64; i += 64) {
+        const __m512i v = _mm512_loadu_si512((const void *)(flags + i));
+        const uint64_t bits = _mm512_cmpeq_epi8_mask(v, one);
+
+        /* the deleted flags are reset to 0, the others to min(flag, 1) */
+        _mm512_storeu_si512((void *)(flags + i), _mm512_mask_blend_epi8(bits, _mm512_min_epu8(v, one), zero));
+        mask[i >> 6] = bits;
+        n_deleted += __builtin_popcountll(bits);
+    }
+
+    return n_deleted + flags_sweep_tail(flags, i, n, mask);
+}
+
+
+static size_t flags_changed_sse2(const uint8_t *flags, size_t n, uint64_t *mask)
+{
+    const __m128i five = _mm_set1_epi8(5), zero = _mm_setzero_si128();
+    size_t i = 0, n_changed = 0;
+
+    memset(mask, 0, ((n + 63) >> 6) * sizeof(uint64_t));
+    for (; n - i >= 64; i += 64) {
+        uint64_t bits = 0;
+
+        for (int k=0; k < 4; k++) {
+            const __m128i v = _mm_and_si128(_mm_loadu_si128((const __m128i *)(flags + i + (k << 4))), five);
+            bits |= (uint64_t)((uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, zero)) ^ 0xFFFF) << (k << 4);
+        }
+        mask[i >> 6] = bits;
+        n_changed += __builtin_popcountll(bits);
+    }
+
+    return n_changed + flags_changed_tail(flags, i, n, mask);
+}
+
+
+__attribute__((target("avx2,bmi,bmi2,popcnt")))
+static size_t flags_changed_avx2(const uint8_t *flags, size_t n, uint64_t *mask)
+{
+    const __m256i five = _mm256_set1_epi8(5), zero = _mm256_setzero_si256();
+    size_t i = 0, n_changed = 0;
+
+    memset(mask, 0, ((n + 63) >> 6) * sizeof(uint64_t));
+    for (; n - i >= 64; i += 64) {
+        const __m256i lo = _mm256_and_si256(_mm256_loadu_si256((const __m256i *)(flags + i)), five);
+        const __m256i hi = _mm256_and_si256(_mm256_loadu_si256((const __m256i *)(flags + i + 32)), five);
+        const uint64_t bits = ~((uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, zero)) |
+                                (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, zero)) << 32);
+        mask[i >> 6] = bits;
+        n_changed += __builtin_popcountll(bits);
+    }
+
+    return n_changed + flags_changed_tail(flags, i, n, mask);
+}
+
+
+__attribute__((target("avx512f,avx512bw,avx2,bmi,bmi2,popcnt")))
+static size_t flags_changed_avx512(const uint8_t *flags, size_t n, uint64_t *mask)
+{
+    const __m512i five = _mm512_set1_epi8(5);
+    size_t i = 0, n_changed = 0;
+
+    memset(mask, 0, ((n + 63) >> 6) * sizeof(uint64_t));
+    for (; n - i >= 64; i += 64) {
+        const uint64_t bits = _mm512_test_epi8_mask(_mm512_loadu_si512((const void *)(flags + i)), five);
+        mask[i >> 6] = bits;
+        n_changed += __builtin_popcountll(bits);
+    }
+
+    return n_changed + flags_changed_tail(flags, i, n, mask);
+}
+
+#endif
+
+
+/* the kernels of each level, and the variant name of each kernel */
+static const cpu_kernel_t cpu_levels[] = {
+    {CPU_LEVEL_GENERIC, "generic", tag_find_generic, text_span_generic, flags_sweep_generic, flags_changed_generic,
+     MD5Transform},
+#ifdef CPU_DISPATCH_X86
+    {CPU_LEVEL_SSE2, "sse2", tag_find_sse2, text_span_sse2, flags_sweep_sse2, flags_changed_sse2, MD5Transform},
+    {CPU_LEVEL_AVX2, "avx2", tag_find_avx2, text_span_avx2, flags_sweep_avx2, flags_changed_avx2, MD5Transform_bmi2},
+    {CPU_LEVEL_AVX512, "avx512", tag_find_avx512, text_span_avx512, flags_sweep_avx512, flags_changed_avx512,
+     MD5Transform_bmi2},
+#endif
+};
+
+static const char *vector_names[] = {"scalar", "sse2", "avx2", "avx512bw"};
+static const char *md5_names[] = {"scalar", "scalar", "bmi2", "bmi2"};
+
+cpu_kernel_t cpu_kernel = {CPU_LEVEL_GENERIC, "generic", tag_find_generic, text_span_generic, flags_sweep_generic,
+                           flags_changed_generic, MD5Transform};
+
+
+/* func: the highest level supported by the cpu (and the operating system) */
+static int cpu_level_detect(void)
+{
+    int level = CPU_LEVEL_GENERIC;
+
+#ifdef CPU_DISPATCH_X86
+    __builtin_cpu_init();
+    level = CPU_LEVEL_SSE2;  /* the baseline of x86-64 */
+
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("bmi") && __builtin_cpu_supports("bmi2"))
+        level = CPU_LEVEL_AVX2;
+
+    if (level == CPU_LEVEL_AVX2 && __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw"))
+        level = CPU_LEVEL_AVX512;
+#endif
+
+    return level;
+}
+
+
+int cpu_dispatch_init(void)
+{
+    int level = cpu_level_detect(), status = 0;
+    const char *env = getenv(CPU_DISPATCH_ENV);
+
+    /* the process (or the one loading the library) keeps running with the detected level */
+    if (env != NULL && *env != '\0') {
+        int k = 0;
+        while (k <= level && strcmp(env, cpu_levels[k].name) != 0) k++;
+
+        if (k > level) {
+            fprintf(stderr, "[Warning:%s] the level (%s=%s) is unknown or not supported by the cpu, use %s!\n",
+                    __func__, CPU_DISPATCH_ENV, env, cpu_levels[level].name);
+            status = -1;
+        }
+        else level = k;
+    }
+
+    cpu_kernel = cpu_levels[level];
+    return status;
+}
+
+
+/* select the kernels before main, so that every entry (xml_parser, xml_bench) runs the best variants */
+__attribute__((constructor))
+static void cpu_dispatch_startup(void)
+{
+    cpu_dispatch_init();
+}
+
+
+void cpu_dispatch_print(FILE *file_hd)
+{
+    const char *env = getenv(CPU_DISPATCH_ENV);
+    const int level = cpu_kernel.level, forced = env != NULL && strcmp(env, cpu_kernel.name) == 0;
+
+    fprintf(file_hd, "cpu features:");
+#ifdef CPU_DISPATCH_X86
+    static const char *features[] = {"sse2", "sse4.2", "avx", "avx2", "bmi", "bmi2", "avx512f", "avx512bw"};
+    __builtin_cpu_init();
+
+    /* __builtin_cpu_supports only accepts string literals */
+    const int supported[] = {__builtin_cpu_supports("sse2"), __builtin_cpu_supports("sse4.2"),
+                             __builtin_cpu_supports("avx"), __builtin_cpu_supports("avx2"),
+                             __builtin_cpu_supports("bmi"), __builtin_cpu_supports("bmi2"),
+                             __builtin_cpu_supports("avx512f"), __builtin_cpu_supports("avx512bw")};
+
+    for (size_t k=0; k < sizeof(features) / sizeof(features[0]); k++)
+        if (supported[k]) fprintf(file_hd, " %s", features[k]);
+#else
+    fprintf(file_hd, " (not x86-64)");
+#endif
+
+    fprintf(file_hd, "\nsupported level: %s\n", cpu_levels[cpu_level_detect()].name);
+    fprintf(file_hd, "selected level: %s%s\n", cpu_kernel.name, forced ? " (set by " CPU_DISPATCH_ENV ")" : "");
+
+    fprintf(file_hd, "\n#kernel          variant\n");
+    fprintf(file_hd, "tag_find         %s\n", vector_names[level]);
+    fprintf(file_hd, "id_parse         %s (tag_find)\n", vector_names[level]);
+    fprintf(file_hd, "text_span        %s\n", vector_names[level]);
+    fprintf(file_hd, "flags_sweep      %s\n", vector_names[level]);
+    fprintf(file_hd, "flags_changed    %s\n", vector_names[level]);
+    fprintf(file_hd, "md5_transform    %s\n", md5_names[level]);
+}
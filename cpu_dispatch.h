@@ -0,0 +1,66 @@
+/*************************************************************************
+    > File Name: cpu_dispatch.h
+    > Author: xlzh
+    > Mail: xiaolongzhang2015@163.com
+    > Created Time: 2025年12月26 10时12分47秒
+ ************************************************************************/
+
+#ifndef INSDCXMLPARSER_CPU_DISPATCH_H
+#define INSDCXMLPARSER_CPU_DISPATCH_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+/* the environment variable to select a lower level than the cpu supports (e.g. INSDC_CPU_DISPATCH=sse2) */
+#define CPU_DISPATCH_ENV "INSDC_CPU_DISPATCH"
+
+/* the instruction set levels of the kernel variants */
+enum {
+    CPU_LEVEL_GENERIC = 0,
+    CPU_LEVEL_SSE2 = 1,
+    CPU_LEVEL_AVX2 = 2,
+    CPU_LEVEL_AVX512 = 3
+};
+
+
+/*! @typedef cpu_kernel_t
+  @abstract the hot kernels of the selected instruction set level
+  @field  level             the instruction set level [CPU_LEVEL_GENERIC|SSE2|AVX2|AVX512]
+  @field  name              the name of the level
+  @field  tag_find          find the first tag (l bytes) in the data, NULL if not found
+  @field  text_span         the number of leading bytes that are printable ASCII, tab, LF or CR
+  @field  flags_sweep       reset the flags {0,1,2,3,4} to {0,0,1,1,1}, and set the bit of each deleted flag (1)
+                            in the mask (n bits), return the number of deleted flags
+  @field  flags_changed     set the bit of each changed flag {1,3,4} in the mask (n bits), return the number of them
+  @field  md5_transform     the md5 compression of one 64-byte block
+ */
+typedef struct {
+    int level;
+    const char *name;
+    const char *(*tag_find)(const char *data, size_t size, const char *tag, size_t l);
+    size_t (*text_span)(const uint8_t *data, size_t size);
+    size_t (*flags_sweep)(uint8_t *flags, size_t n, uint64_t *mask);
+    size_t (*flags_changed)(const uint8_t *flags, size_t n, uint64_t *mask);
+    void (*md5_transform)(unsigned int state[4], unsigned char block[64]);
+} cpu_kernel_t;
+
+
+/* the kernels selected at startup (the generic ones before the selection) */
+extern cpu_kernel_t cpu_kernel;
+
+
+/*! @function: detect the cpu features and select the best kernels (called at startup)
+  @return                    status (-1: the level of INSDC_CPU_DISPATCH is ignored, the detected level is used)
+ */
+int cpu_dispatch_init(void);
+
+
+/*! @function: print the cpu features and the selected variant of each kernel
+  @param  file_hd            the output file handle
+  @return
+ */
+void cpu_dispatch_print(FILE *file_hd);
+
+
+#endif //INSDCXMLPARSER_CPU_DISPATCH_H
@@ -5,26 +5,248 @@
     > Created Time: 2025年12月08 10时18分26秒
  ************************************************************************/
 
+#include <omp.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
 #include "md5.h"
 #include "stream_reader.h"
 #include "database.h"
+#include "checkpoint.h"
+#include "body_store.h"
+#include "record_index.h"
+#include "fingerprint.h"
+#include "field_extract.h"
+#include "update_stamp.h"
+#include "cpu_dispatch.h"
+#include "trace.h"
+
+
+/* the mapped length of a table: whole pages, and whole huge pages once the table is large enough */
+static size_t table_length(size_t size)
+{
+    const size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t length = size ? (size + page - 1) / page * page : page;
+
+    if (length >= DATABASE_HUGE_PAGE)
+        length = (length + DATABASE_HUGE_PAGE - 1) / DATABASE_HUGE_PAGE * DATABASE_HUGE_PAGE;
+
+    return length;
+}
+
+
+/* func: fault the pages in [start, end) of the table with the worker threads
+ *
+ *   the static schedule is the same as the loops walking the table, so that each page is placed
+ *   on the NUMA node of the thread using it (first-touch), and the page faults are spread
+ */
+static void table_prefault(uint8_t *table, size_t start, size_t end)
+{
+    const size_t step = end - start >= DATABASE_HUGE_PAGE ? DATABASE_HUGE_PAGE : (size_t)sysconf(_SC_PAGESIZE);
+    const int64_t n_step = (int64_t)((end - start + step - 1) / step);
+
+    #pragma omp parallel for schedule(static) if(n_step > 1)
+    for (int64_t i=0; i < n_step; i++)
+        table[start + (size_t)i * step] = 0;
+}
 
 
-database_t *database_init(uint32_t max_size)
+/* func: map the zeroed table aligned to the huge page, and ask for transparent huge pages */
+static uint8_t *table_alloc(size_t size)
+{
+    const size_t length = table_length(size);
+    const size_t align = length >= DATABASE_HUGE_PAGE ? DATABASE_HUGE_PAGE : 0;
+
+    uint8_t *map = mmap(NULL, length + align, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "[Error:%s] failed to map the table (%lu bytes)!\n", __func__, (unsigned long)length);
+        exit(-1);
+    }
+
+    /* trim the head and tail to keep the huge page aligned part */
+    uint8_t *table = map;
+    if (align) {
+        table = (uint8_t *)(((uintptr_t)map + align - 1) & ~(uintptr_t)(align - 1));
+        if (table > map) munmap(map, (size_t)(table - map));
+        if (map + align > table) munmap(table + length, (size_t)(map + align - table));
+        madvise(table, length, MADV_HUGEPAGE);  /* ignored if THP is disabled */
+    }
+
+    table_prefault(table, 0, length);
+    return table;
+}
+
+
+/* func: expand the table, the pages added are zeroed by the kernel */
+static uint8_t *table_realloc(uint8_t *table, size_t old_size, size_t new_size)
+{
+    const size_t old_length = table_length(old_size), new_length = table_length(new_size);
+    if (new_length <= old_length)
+        return table;
+
+    table = mremap(table, old_length, new_length, MREMAP_MAYMOVE);
+    if (table == MAP_FAILED) {
+        fprintf(stderr, "[Error:%s] failed to expand the table (%lu bytes)!\n", __func__, (unsigned long)new_length);
+        exit(-1);
+    }
+
+    if (new_length >= DATABASE_HUGE_PAGE)
+        madvise(table, new_length, MADV_HUGEPAGE);
+
+    table_prefault(table, old_length, new_length);
+    return table;
+}
+
+
+uint32_t database_tree_shape(uint32_t n_leaf, uint32_t *start, uint32_t *count)
+{
+    uint32_t n_level = 1, size[DATABASE_TREE_LEVEL] = {n_leaf};
+
+    /* the levels from the leaves to the root */
+    while (size[n_level-1] > 1 && n_level < DATABASE_TREE_LEVEL) {
+        size[n_level] = (size[n_level-1] + DATABASE_TREE_FANOUT - 1) / DATABASE_TREE_FANOUT;
+        n_level++;
+    }
+
+    for (uint32_t l=0, offset=0; l < n_level; l++) {
+        count[l] = size[n_level-1-l];
+        start[l] = offset;
+        offset += count[l];
+    }
+
+    return n_level;
+}
+
+
+/* func: expand the leaves to cover the capacity, the new leaves are empty (no item) */
+static void database_tree_resize(database_t *database)
+{
+    const uint32_t old_leaf = database->n_leaf;
+    const uint32_t n_leaf = (uint32_t)(((uint64_t)database->capacity + (1U << DATABASE_LEAF_SHIFT) - 1)
+                                       >> DATABASE_LEAF_SHIFT);
+    if (n_leaf <= old_leaf && database->leaves != NULL)
+        return;
+
+    err_realloc(database->leaves, n_leaf ? n_leaf : 1, uint64_t);
+    err_realloc(database->dirty, n_leaf ? n_leaf : 1, uint8_t);
+    for (uint32_t k=old_leaf; k < n_leaf; k++)
+        database->leaves[k] = DATABASE_TREE_SEED;
+    memset(database->dirty + old_leaf, 0, n_leaf - old_leaf);
+
+    /* the nodes above the leaves are rebuilt by database_tree_update */
+    uint32_t start[DATABASE_TREE_LEVEL], count[DATABASE_TREE_LEVEL];
+    const uint32_t n_level = database_tree_shape(n_leaf, start, count);
+
+    database->n_leaf = n_leaf;
+    database->n_node = start[n_level-1];
+    err_realloc(database->nodes, database->n_node + 1, uint64_t);
+}
+
+
+static inline uint64_t tree_mix(uint64_t h, uint64_t v)
+{
+    h ^= v * 0x9E3779B97F4A7C15ULL;
+    h = (h << 31) | (h >> 33);
+    return h * 0xC2B2AE3D27D4EB4FULL;
+}
+
+
+/* func: the hash of the present IDs and their values in the leaf, independent of the capacity */
+static uint64_t tree_leaf_hash(const database_t *database, uint32_t leaf)
+{
+    const uint32_t lo = leaf << DATABASE_LEAF_SHIFT;
+    const uint32_t hi = database->capacity - lo > (1U << DATABASE_LEAF_SHIFT) ?
+                        lo + (1U << DATABASE_LEAF_SHIFT) : database->capacity;
+    const uint32_t n_word = database->hash_width >> 3;
+    uint64_t h = DATABASE_TREE_SEED, flag_word, value_word;
+
+    for (uint32_t id=lo; id < hi; id++) {
+        if (database->flag_stride == 1 && (id & 7) == 0 && hi - id >= 8) {  /* skip 8 empty IDs at once */
+            memcpy(&flag_word, database->flags + id, 8);
+            if (flag_word == 0) {
+                id += 7;
+                continue;
+            }
+        }
+        if (database_flag(database, id) == 0) continue;
+
+        h = tree_mix(h, id);
+        for (uint32_t w=0; w < n_word; w++) {
+            memcpy(&value_word, database_query(database, id) + (w << 3), 8);
+            h = tree_mix(h, value_word);
+        }
+    }
+
+    return h;
+}
+
+
+uint64_t database_tree_update(const database_t *database)
+{
+    const uint64_t t_tree = trace_begin();
+
+    #pragma omp parallel for schedule(dynamic, 64)
+    for (uint32_t leaf=0; leaf < database->n_leaf; leaf++) {
+        if (!database->dirty[leaf]) continue;
+
+        database->leaves[leaf] = tree_leaf_hash(database, leaf);
+        database->dirty[leaf] = 0;
+    }
+
+    /* the nodes above the leaves, from the last level to the root */
+    uint32_t start[DATABASE_TREE_LEVEL], count[DATABASE_TREE_LEVEL];
+    const uint32_t n_level = database_tree_shape(database->n_leaf, start, count);
+
+    for (int l=(int)n_level-2; l >= 0; l--) {
+        const uint64_t *child = l == (int)n_level-2 ? database->leaves : database->nodes + start[l+1];
+
+        for (uint32_t k=0; k < count[l]; k++) {
+            uint64_t h = DATABASE_TREE_SEED;
+            for (uint32_t c=k*DATABASE_TREE_FANOUT; c < count[l+1] && c < (k+1)*DATABASE_TREE_FANOUT; c++)
+                h = tree_mix(h, child[c]);
+            database->nodes[start[l] + k] = h;
+        }
+    }
+
+    trace_end(t_tree, "tree", database->n_leaf);
+    if (database->n_leaf == 0) return DATABASE_TREE_SEED;
+    return n_level > 1 ? database->nodes[0] : database->leaves[0];
+}
+
+
+/* func: create the database, the tables are allocated unless they are mapped from the file (alloc: 0) */
+static database_t *database_create(uint32_t max_size, uint32_t hash_width, uint32_t layout, int alloc)
 {
     database_t *database;
 
     err_calloc(database, 1, database_t);
     database->capacity = max_size;
+    database->hash_width = hash_width;
+    database->layout = layout;
+
+    /* the slot is aligned to its size, so the hash and the flag of an ID are in the same cache line */
+    database->slot_width = layout == DATABASE_LAYOUT_SLOT ? hash_width << 1 : hash_width;
+    database->flag_stride = layout == DATABASE_LAYOUT_SLOT ? database->slot_width : 1;
 
-    /* allocate memory for md5 values and flags */
-    err_calloc(database->flags, database->capacity, uint8_t);
-    err_calloc(database->values, database->capacity<<4, uint8_t);  /* 16 uint8_t for one MD5 */
+    /* allocate memory for hash values and flags */
+    if (alloc) {
+        database->values = table_alloc((size_t)database->capacity * database->slot_width);
+        database->flags = layout == DATABASE_LAYOUT_SLOT ? database->values + hash_width :
+                          table_alloc(database->capacity);
+    }
+    database_tree_resize(database);
 
     return database;
 }
 
 
+database_t *database_init(uint32_t max_size, uint32_t hash_width, uint32_t layout)
+{
+    return database_create(max_size, hash_width, layout, 1);
+}
+
+
 database_t *database_resize(database_t *database, uint32_t new_size)
 {
     if (database->capacity >= new_size)
@@ -34,90 +256,620 @@ database_t *database_resize(database_t *database, uint32_t new_size)
     uint32_t old_capacity = database->capacity;
     database->capacity = new_size; kroundup32(database->capacity);
 
-    /* expand the flags space and memset the new allocated space to 0 */
-    err_realloc(database->flags, database->capacity, uint8_t);
-    memset(database->flags+old_capacity, 0, database->capacity-old_capacity);
-
-    /* expand the md5 values and memset the new allocated space to 0 */
-    err_realloc(database->values, database->capacity<<4, uint8_t);
-    memset(database->values+(old_capacity<<4), 0, (database->capacity-old_capacity)<<4);
+    /* expand the flags and hash values, the new allocated space is zeroed */
+    const size_t width = database->slot_width;
+    database->values = table_realloc(database->values, old_capacity * width, database->capacity * width);
+    if (database->layout == DATABASE_LAYOUT_SLOT)
+        database->flags = database->values + database->hash_width;
+    else
+        database->flags = table_realloc(database->flags, old_capacity, database->capacity);
+    database_tree_resize(database);
 
     return database;
 }
 
 
-static void database_build_core(database_t *database, const char *xml_file, const char *start_tag, const char *end_tag)
+/* func: sum the huge pages of the mappings overlapping [start, start+size) from /proc/self/smaps */
+static size_t table_huge_size(const uint8_t *start, size_t size, size_t *page_size)
+{
+    FILE *file_hd = fopen("/proc/self/smaps", "r");
+    if (file_hd == NULL) return 0;
+
+    char line[512];
+    int overlap = 0;
+    unsigned long lo, hi, kb, huge_kb = 0;
+    const unsigned long begin = (uintptr_t)start, end = (uintptr_t)start + size;
+
+    while (fgets(line, sizeof(line), file_hd) != NULL) {
+        if (sscanf(line, "%lx-%lx ", &lo, &hi) == 2)  /* the header line of a mapping */
+            overlap = lo < end && hi > begin;
+
+        else if (overlap && sscanf(line, "AnonHugePages: %lu kB", &kb) == 1)
+            huge_kb += kb;
+
+        else if (overlap && sscanf(line, "KernelPageSize: %lu kB", &kb) == 1)
+            *page_size = kb << 10;
+    }
+
+    fclose(file_hd);
+    return (size_t)huge_kb << 10;
+}
+
+
+void database_page_report(const database_t *database)
+{
+    size_t flag_page = (size_t)sysconf(_SC_PAGESIZE), value_page = flag_page;
+    const size_t flag_size = database->layout == DATABASE_LAYOUT_SLOT ? 0 : table_length(database->capacity);
+    const size_t value_size = table_length((size_t)database->capacity * database->slot_width);
+    const size_t huge_size = (flag_size ? table_huge_size(database->flags, flag_size, &flag_page) : 0) +
+                             table_huge_size(database->values, value_size, &value_page);
+
+    /* the anonymous huge pages are reported as the base page size by the kernel */
+    const size_t page_size = huge_size ? DATABASE_HUGE_PAGE : (flag_page > value_page ? flag_page : value_page);
+
+    fprintf(stderr, "[*] table memory: %lu MB (%s), page size: %lu kB, huge pages: %lu MB\n",
+            (unsigned long)((flag_size + value_size) >> 20),
+            database->layout == DATABASE_LAYOUT_SLOT ? "slot" : "split", (unsigned long)(page_size >> 10),
+            (unsigned long)(huge_size >> 20));
+}
+
+
+static uint64_t database_build_core(database_t *database, const args_t *args, checkpoint_t *ckpt,
+                                fingerprint_t *fingerprint, stamp_table_t *stamps, const char *start_tag,
+                                const char *end_tag)
 {
     /* cache and table object initiation */
-    uint32_t n_total_item = 0;
+    uint64_t n_total_item = ckpt->n_item;
     char time_buf[32];
-    cache_t *cache = stream_cache_init(xml_file, start_tag, end_tag);
+    cache_t *cache = stream_cache_init(args->xml_file, start_tag, end_tag);
+    if (args->validate) stream_cache_validate(cache);
+    if (fingerprint != NULL) stream_cache_fingerprint(cache, fingerprint);
+    stream_cache_throttle(cache, (uint64_t)args->io_rate_limit << 20);
+
+    /* continue from the record boundary of the checkpoint, or resync from the start of the range */
+    uint64_t offset = ckpt->offset ? ckpt->offset : args->range_start;
+    if (offset && stream_cache_seek(cache, offset) != 0) {
+        fprintf(stderr, "[Error:%s] failed to seek the xml file to %lu!\n", __func__, (unsigned long)offset);
+        exit(-1);
+    }
+
+    /* the compressed data bodies are stored next to the database */
+    body_store_t *store = NULL;
+    kstring_t *blobs = NULL;
+    uint32_t m_blob = 0;
+    if (args->body_store)
+        store = body_store_open(args->database, database->capacity, args->resume, 1);
+
+    /* the offset and size of each data body are saved next to the database */
+    record_index_t *index = NULL;
+    if (args->record_index)
+        index = record_index_open(args->database, args->xml_file, args->xml_date, args->resume);
+
+    /* the fields of each data body are extracted into the columns next to the database */
+    field_table_t *fields = NULL;
+    if (args->fields)
+        fields = field_table_open(args->database, args->fields, args->xml_date, ckpt->n_item);
 
     fprintf(stderr, "[%s] start to build the database ...\n", get_current_time(time_buf));
+    uint64_t n_batch = 0, t_batch = trace_begin(), t_span;
+
     while (stream_cache_data(cache) >= 0) {
+        int range_end = 0;
+
+        /* drop the records start from the end of the range (the items are in the order of offset) */
+        if (args->range_end != UINT64_MAX) {
+            uint32_t n_item = cache->size;
+            while (n_item > 0 && stream_cache_offset(cache, cache->item_list[n_item-1].start) >= args->range_end)
+                n_item--;
 
-        #pragma omp parallel for shared(cache, database)
-        for (int i=0; i < cache->size; i++) {
-            uint8_t md5_str[16];
-            body_t *body = &cache->item_list[i];
+            range_end = n_item < cache->size || stream_cache_offset(cache, cache->buffer.front) >= args->range_end;
+            cache->size = n_item;
+        }
 
-            md5_calculate_block((uint8_t *)body->start, body->size, md5_str);
-            database_add(database, body->id, md5_str);
+        if (store != NULL) {
+            body_store_train(store, cache);
+            if (m_blob < cache->size) {
+                err_realloc(blobs, cache->size, kstring_t);
+                memset(blobs + m_blob, 0, (cache->size - m_blob) * sizeof(kstring_t));
+                m_blob = cache->size;
+            }
         }
+        if (fields != NULL) field_table_reserve(fields, cache->size);
+        if (stamps != NULL) stamp_table_reserve(stamps, cache->size);
+
+        #pragma omp parallel shared(cache, database, store, blobs, fields, stamps)
+        {
+            void *stream = store ? body_stream_init() : NULL;
+            const uint64_t t_hash = trace_begin();
+            uint64_t n_hash = 0;
+
+            /* the span of each thread ends before the barrier, so the idle time is visible in the trace */
+            #pragma omp for nowait
+            for (int i=0; i < cache->size; i++) {
+                uint8_t md5_str[16];
+                body_t *body = &cache->item_list[i];
+
+                md5_calculate_block((uint8_t *)body->start, body->size, md5_str);
+                database_add(database, body->id, md5_str);
+
+                /* compress the data body while it is still in the cache */
+                if (store != NULL)
+                    body_store_compress(store, stream, body, &blobs[i]);
+                if (fields != NULL)
+                    field_extract(fields, i, body);
+                if (stamps != NULL)
+                    stamp_check(stamps, i, body, NULL);
+                n_hash++;
+            }
+            trace_end(t_hash, "hash", n_hash);
+            body_stream_destroy(stream);
+        }
+
+        t_span = trace_begin();
+        for (uint32_t i=0; store != NULL && i < cache->size; i++)
+            body_store_put(store, cache->item_list[i].id, &blobs[i], cache->item_list[i].size);
+        if (store != NULL) trace_end(t_span, "write", cache->size);
+
+        if (index != NULL) record_index_batch(index, cache);
+        if (fields != NULL) field_table_batch(fields, cache);
+        if (stamps != NULL) stamp_table_batch(stamps, cache);
+
         n_total_item += cache->size;
-        fprintf(stderr, "\r[*] parse number of items: %d", n_total_item);
+        fprintf(stderr, "\r[*] parse number of items: %lu", (unsigned long)n_total_item);
+
+        /* all items before the front have been added into the table */
+        if (checkpoint_due(ckpt, args)) {
+            t_span = trace_begin();
+            ckpt->offset = stream_cache_offset(cache, cache->buffer.front);
+            ckpt->n_item = n_total_item;
+            if (store != NULL) body_store_save(store, 1);
+            if (index != NULL) record_index_save(index, 1);
+            if (fields != NULL) field_table_save(fields, 1);
+            if (stamps != NULL) stamp_table_save(stamps, database, 1);
+            checkpoint_save(ckpt, args, database);
+            trace_end(t_span, "save", ckpt->n_item);
+        }
+
+        trace_end(t_batch, "batch", n_batch++);
+        t_batch = trace_begin();
+        if (range_end) break;  /* all records in the range are built */
+    }
+
+    /* destroy the memory of cache, nothing is saved if the xml file is invalid */
+    const uint64_t n_invalid = stream_cache_destroy(cache);
+
+    if (store != NULL) {
+        if (n_invalid == 0) body_store_save(store, 0);
+        body_store_close(store);
+        for (uint32_t i=0; i < m_blob; i++) k_strfree(&blobs[i]);
+        free(blobs);
+    }
+
+    if (index != NULL) {
+        if (n_invalid == 0) record_index_save(index, 0);
+        record_index_close(index);
+    }
+
+    if (fields != NULL) {
+        if (n_invalid == 0) field_table_save(fields, 0);
+        fprintf(stderr, "\n[*] extract the fields: %u rows, %u columns", fields->n_row, fields->n_field);
+        field_table_close(fields);
     }
 
-    stream_cache_destroy(cache);  /* destroy the memory of cache */
+    if (n_invalid > 0) return n_invalid;
+
     fprintf(stderr, "\n[*] database version: %s (%d)\n", database->db_type, database->db_date);
     fprintf(stderr, "[%s] done!\n", get_current_time(time_buf));
+    return 0;
 }
 
 
-static void database_save(const database_t *database, const char *file_name)
+/* func: write the flags, then the hashes of the slots as the same tables of DATABASE_LAYOUT_SPLIT
+ *
+ *   return the number of bytes written
+ */
+static size_t table_slot_write(const database_t *database, FILE *file_hd)
 {
-    FILE *file_hd = fopen(file_name, "wb");
+    const uint32_t n_chunk = 1U << DATABASE_LEAF_SHIFT, width = database->hash_width;
+    size_t n_byte = 0;
+    uint8_t *buf;
+    err_malloc(buf, (size_t)n_chunk * width, uint8_t);
 
-    if (file_hd == NULL) {
-        fprintf(stderr, "[Error:%s]: failed to open (%s)!\n", __func__, file_name);
-        exit(-1);
+    for (uint32_t start=0; start < database->capacity; start += n_chunk) {
+        const uint32_t n = database->capacity - start < n_chunk ? database->capacity - start : n_chunk;
+        for (uint32_t i=0; i < n; i++) buf[i] = database_flag(database, start + i);
+        n_byte += fwrite(buf, sizeof(uint8_t), n, file_hd);
+    }
+
+    for (uint32_t start=0; start < database->capacity; start += n_chunk) {
+        const uint32_t n = database->capacity - start < n_chunk ? database->capacity - start : n_chunk;
+        for (uint32_t i=0; i < n; i++) memcpy(buf + (size_t)i * width, database_query(database, start + i), width);
+        n_byte += fwrite(buf, sizeof(uint8_t), (size_t)n * width, file_hd);
     }
 
+    free(buf);
+    return n_byte;
+}
+
+
+/* func: read the tables of the file into the slots (the reverse of table_slot_write)
+ *
+ *   return the number of bytes read
+ */
+static size_t table_slot_read(database_t *database, FILE *file_hd)
+{
+    const uint32_t n_chunk = 1U << DATABASE_LEAF_SHIFT, width = database->hash_width;
+    size_t n_byte = 0, n_read;
+    uint8_t *buf;
+    err_malloc(buf, (size_t)n_chunk * width, uint8_t);
+
+    for (uint32_t start=0; start < database->capacity; start += n_chunk) {
+        const uint32_t n = database->capacity - start < n_chunk ? database->capacity - start : n_chunk;
+        n_byte += n_read = fread(buf, sizeof(uint8_t), n, file_hd);
+        for (uint32_t i=0; i < n_read; i++) database_flag(database, start + i) = buf[i];
+    }
+
+    for (uint32_t start=0; start < database->capacity; start += n_chunk) {
+        const uint32_t n = database->capacity - start < n_chunk ? database->capacity - start : n_chunk;
+        n_byte += n_read = fread(buf, sizeof(uint8_t), (size_t)n * width, file_hd);
+        for (uint32_t i=0; i < n_read / width; i++)
+            memcpy(database_query(database, start + i), buf + (size_t)i * width, width);
+    }
+
+    free(buf);
+    return n_byte;
+}
+
+
+int database_write(const database_t *database, FILE *file_hd)
+{
+    size_t n_item = 0;
+    const char magic[8] = DATABASE_MAGIC;
+    const uint32_t version = DATABASE_VERSION;
+    const size_t n_value = (size_t)database->capacity * database->hash_width;
+
+    /* save the format version, the hash width and the layout loaded next time */
+    n_item += fwrite(magic, sizeof(char), 8, file_hd);
+    n_item += fwrite(&version, sizeof(uint32_t), 1, file_hd);
+    n_item += fwrite(&database->hash_width, sizeof(uint32_t), 1, file_hd);
+    n_item += fwrite(&database->layout, sizeof(uint32_t), 1, file_hd);
+
     /* save the database type and date */
-    fwrite(database->db_type, sizeof(char), 8, file_hd);
-    fwrite(&database->db_date, sizeof(uint32_t), 1, file_hd);
-    fwrite(&database->capacity, sizeof(uint32_t), 1, file_hd);
+    n_item += fwrite(database->db_type, sizeof(char), 8, file_hd);
+    n_item += fwrite(&database->db_date, sizeof(uint32_t), 1, file_hd);
+    n_item += fwrite(&database->capacity, sizeof(uint32_t), 1, file_hd);
+    n_item += fwrite(&database->generation, sizeof(uint64_t), 1, file_hd);
+
+    /* save the hash tree from the root, so that two databases could be compared by reading a few nodes */
+    const uint32_t tree_header[2] = {1U << DATABASE_LEAF_SHIFT, DATABASE_TREE_FANOUT};
+    database_tree_update(database);
+
+    n_item += fwrite(tree_header, sizeof(uint32_t), 2, file_hd);
+    n_item += fwrite(database->nodes, sizeof(uint64_t), database->n_node, file_hd);
+    n_item += fwrite(database->leaves, sizeof(uint64_t), database->n_leaf, file_hd);
 
     /* save the flags of the database */
-    fwrite(database->flags, sizeof(uint8_t), database->capacity, file_hd);
-    fwrite(database->values, sizeof(uint8_t), database->capacity<<4, file_hd);
+    if (database->layout == DATABASE_LAYOUT_SLOT)
+        n_item += table_slot_write(database, file_hd);
+    else {
+        n_item += fwrite(database->flags, sizeof(uint8_t), database->capacity, file_hd);
+        n_item += fwrite(database->values, sizeof(uint8_t), n_value, file_hd);
+    }
+
+    const size_t n_tree = 2 + (size_t)database->n_node + database->n_leaf;
+    return n_item == 22 + n_tree + (size_t)database->capacity + n_value ? 0 : -1;
+}
+
+
+/* func: read the database from an opened file
+ *
+ *   version 1:  db_type[8], db_date, capacity, flags, values (16 bytes)
+ *   version 2:  magic[8], version, hash_width, db_type[8], db_date, capacity, flags, values (hash_width bytes)
+ *   version 3:  the same as version 2, with leaf_ids, fanout and the hash tree (uint64_t) before the flags
+ *   version 4:  the same as version 3, with the layout loaded (uint32_t) after the hash width
+ *   version 5:  the same as version 4, with the generation (uint64_t) after the capacity
+ *
+ *   the tables after the hash tree are read by the caller (alloc: 1) or mapped (alloc: 0, the split layout)
+ */
+static database_t *database_read_head(FILE *file_hd, int alloc)
+{
+    char db_type[8];
+    uint32_t data[2];  // [db_date, capacity]
+    uint32_t header[3] = {1, DATABASE_HASH_FULL, DATABASE_LAYOUT_SPLIT};  // [version, hash_width, layout]
+
+    if (fread(db_type, sizeof(char), 8, file_hd) != 8) return NULL;
+
+    if (memcmp(db_type, DATABASE_MAGIC, 8) == 0) {
+        if (fread(header, sizeof(uint32_t), 2, file_hd) != 2) return NULL;
+        if (header[0] >= 4 && fread(header + 2, sizeof(uint32_t), 1, file_hd) != 1) return NULL;
+        if (fread(db_type, sizeof(char), 8, file_hd) != 8) return NULL;
+    }
 
-    /* close the file handle */
+    if (header[0] > DATABASE_VERSION || (header[1] != DATABASE_HASH_SHORT && header[1] != DATABASE_HASH_FULL) ||
+        header[2] > DATABASE_LAYOUT_SLOT) {
+        fprintf(stderr, "[Error:%s] unsupported database version (%u), hash width (%u) or layout (%u)!\n", __func__,
+                header[0], header[1], header[2]);
+        return NULL;
+    }
+
+    uint64_t generation = 0;
+    if (fread(data, sizeof(uint32_t), 2, file_hd) != 2) return NULL;
+    if (header[0] >= 5 && fread(&generation, sizeof(uint64_t), 1, file_hd) != 1) return NULL;
+
+    /* the table is not allocated for a truncated file (or a file that is not a database) */
+    struct stat st;
+    const off_t pos = ftello(file_hd);
+    if (fstat(fileno(file_hd), &st) == 0 && S_ISREG(st.st_mode) && pos >= 0 &&
+        (uint64_t)(st.st_size - pos) < (uint64_t)data[1] * (1 + header[1]))
+        return NULL;
+
+    /* initiate the database */
+    database_t *database = database_create(data[1], header[1], alloc ? header[2] : DATABASE_LAYOUT_SPLIT, alloc);
+    database->db_date = data[0];
+    database->generation = generation;
+    strcpy(database->db_type, db_type);
+
+    /* read the hash tree, which is rebuilt if it is not existed (version 1 and 2) */
+    uint32_t tree_header[2] = {0, 0};
+    if (header[0] >= 3) {
+        if (fread(tree_header, sizeof(uint32_t), 2, file_hd) != 2 ||
+            tree_header[0] != 1U << DATABASE_LEAF_SHIFT || tree_header[1] != DATABASE_TREE_FANOUT ||
+            fread(database->nodes, sizeof(uint64_t), database->n_node, file_hd) != database->n_node ||
+            fread(database->leaves, sizeof(uint64_t), database->n_leaf, file_hd) != database->n_leaf) {
+            database_destroy(database);
+            return NULL;
+        }
+    }
+
+    if (header[0] < 3)
+        memset(database->dirty, 1, database->n_leaf);
+
+    return database;
+}
+
+
+database_t *database_read(FILE *file_hd)
+{
+    database_t *database = database_read_head(file_hd, 1);
+    if (database == NULL) return NULL;
+
+    /* read the flags and hash value list */
+    const size_t n_value = (size_t)database->capacity * database->hash_width;
+    size_t n_read;
+
+    if (database->layout == DATABASE_LAYOUT_SLOT)
+        n_read = table_slot_read(database, file_hd);
+    else {
+        n_read = fread(database->flags, sizeof(uint8_t), database->capacity, file_hd);
+        n_read += fread(database->values, sizeof(uint8_t), n_value, file_hd);
+    }
+
+    if (n_read != database->capacity + n_value) {
+        database_destroy(database);
+        return NULL;
+    }
+
+    return database;
+}
+
+
+database_t *database_map(const char *file_name)
+{
+    FILE *file_hd = fopen(file_name, "rb");
+    if (file_hd == NULL) return NULL;
+
+    /* the file is never modified after it is published, a new generation is renamed over it */
+    struct stat st;
+    database_t *database = database_read_head(file_hd, 0);
+    const off_t offset = database != NULL ? ftello(file_hd) : -1;
+    const size_t n_table = database != NULL ? (size_t)database->capacity * (1 + database->hash_width) : 0;
+
+    if (offset < 0 || fstat(fileno(file_hd), &st) != 0 || (uint64_t)st.st_size < (uint64_t)offset + n_table) {
+        database_destroy(database);
+        fclose(file_hd);
+        return NULL;
+    }
+
+    uint8_t *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fileno(file_hd), 0);
+    fclose(file_hd);
+    if (map == MAP_FAILED) {
+        database_destroy(database);
+        return NULL;
+    }
+
+    database->mapped = map;
+    database->mapped_size = (size_t)st.st_size;
+    database->flags = map + offset;
+    database->values = database->flags + database->capacity;
+    return database;
+}
+
+
+uint64_t database_generation(const char *file_name)
+{
+    FILE *file_hd = fopen(file_name, "rb");
+    if (file_hd == NULL) return 0;
+
+    database_t *database = database_read_head(file_hd, 0);
+    const uint64_t generation = database != NULL ? database->generation : 0;
+
+    database_destroy(database);
     fclose(file_hd);
+    return generation;
+}
+
+
+void database_destroy(database_t *database)
+{
+    if (database == NULL) return;
+
+    if (database->mapped != NULL)
+        munmap(database->mapped, database->mapped_size);
+    else if (database->flags != NULL && database->layout != DATABASE_LAYOUT_SLOT)
+        munmap(database->flags, table_length(database->capacity));
+    if (database->values != NULL && database->mapped == NULL)
+        munmap(database->values, table_length((size_t)database->capacity * database->slot_width));
+
+    free(database->leaves);
+    free(database->nodes);
+    free(database->dirty);
+
+    free(database);
+}
+
+
+int database_publish(database_t *database, const char *file_name)
+{
+    char tmp_name[1024];
+    if (file_tmp_name(tmp_name, sizeof(tmp_name), file_name) != 0) return -1;
+
+    /* the generation continues from the published file (e.g. rebuilt from the xml file) */
+    const uint64_t published = database_generation(file_name);
+    database->generation = (published > database->generation ? published : database->generation) + 1;
+
+    FILE *file_hd = fopen(tmp_name, "wb");
+    if (file_hd == NULL) return -2;
+
+    /* the file must be on the disk before it replaces the published one (the readers map it from the disk) */
+    int status = database_write(database, file_hd);
+    if (file_cache_drop(file_hd) != 0) status = -1;
+    if (fclose(file_hd) != 0) status = -1;
+
+    if (status != 0 || file_publish(tmp_name, file_name) != 0) {
+        unlink(tmp_name);
+        return -3;
+    }
+    return 0;
+}
+
+
+/* func: publish the next generation of the database file, or exit if it is failed */
+static void database_save(database_t *database, const char *file_name)
+{
+    const uint64_t t_save = trace_begin();
+    const int status = database_publish(database, file_name);
+
+    if (status == -1)
+        fprintf(stderr, "[Error:%s]: the file name (%s) is too long!\n", __func__, file_name);
+    else if (status == -2)
+        fprintf(stderr, "[Error:%s]: failed to open the temporary file of (%s)!\n", __func__, file_name);
+    else if (status != 0)
+        fprintf(stderr, "[Error:%s]: failed to write the database (%s)!\n", __func__, file_name);
+    if (status != 0) exit(-1);
+
+    trace_end(t_save, "save", database->capacity);
 }
 
 
 int database_build(const args_t *args)
 {
-    uint32_t table_size = strcmp(args->xml_type, "SAMPLE") ? PROJECT_TABLE_SIZE : SAMPLE_TABLE_SIZE;
-    database_t *database = database_init(table_size);
+    checkpoint_t ckpt;
+    database_t *database = NULL;
+
+    /* restore the partial table from the checkpoint */
+    checkpoint_init(&ckpt, args);
+    if (args->resume)
+        database = checkpoint_load(&ckpt, args);
+
+    if (database != NULL && strcmp(database->db_type, args->xml_type) != 0) {
+        fprintf(stderr, "[Error:%s] conflict database type in the checkpoint: %s!\n", __func__, database->db_type);
+        exit(-1);
+    }
+
+    if (database == NULL) {
+        uint32_t table_size = strcmp(args->xml_type, "SAMPLE") ? PROJECT_TABLE_SIZE : SAMPLE_TABLE_SIZE;
+        database = database_init(table_size, args->hash_width, args->layout);
+
+        /* set the database type and database date */
+        strcpy(database->db_type, args->xml_type);
+        database->db_date = args->xml_date;
+    }
+    database_page_report(database);
 
-    /* set the database type and database date */
-    strcpy(database->db_type, args->xml_type);
-    database->db_date = args->xml_date;
+    /* the chunks of the whole xml file are fingerprinted for the next compare */
+    fingerprint_t *fingerprint = NULL;
+    if (!args->no_fingerprint && !args->checkpoint && !args->resume && args->range_start == 0 &&
+        args->range_end == UINT64_MAX)
+        fingerprint = fingerprint_open(args->database, database, 0);
 
+    /* the last_update and size of each record are saved for the pre-check of the next compare */
+    stamp_table_t *stamps = NULL;
+    if (args->precheck) {
+        stamps = stamp_table_open(args->database, args->xml_date, 0);
+        if (ckpt.offset) stamp_table_load(stamps, database, 1);
+    }
+
+    uint64_t n_invalid;
     if (strcmp(args->xml_type, "SAMPLE") == 0)
-        database_build_core(database, args->xml_file, SAMPLE_START_TAG, SAMPLE_END_TAG);
+        n_invalid = database_build_core(database, args, &ckpt, fingerprint, stamps, SAMPLE_START_TAG, SAMPLE_END_TAG);
 
     else  // PROJECT
-        database_build_core(database, args->xml_file, PROJECT_START_TAG, PROJECT_END_TAG);
+        n_invalid = database_build_core(database, args, &ckpt, fingerprint, stamps, PROJECT_START_TAG, PROJECT_END_TAG);
+
+    /* the database of the invalid xml file is not saved */
+    if (n_invalid > 0) {
+        stamp_table_close(stamps);
+        fingerprint_close(fingerprint);
+        database_destroy(database);
+        return -1;
+    }
 
     /* save the database file */
     database_save(database, args->database);
+    checkpoint_remove(args);
+
+    if (stamps != NULL) {
+        stamp_table_save(stamps, database, 0);
+        stamp_table_close(stamps);
+    }
+
+    if (fingerprint != NULL) {
+        fingerprint_save(fingerprint, args->database, database);
+        fingerprint_close(fingerprint);
+    }
     return 0;
 }
 
 
+/* func: the scalar sweep of the flags in the slots, the same as cpu_kernel.flags_sweep */
+static size_t slot_flags_sweep(const database_t *database, uint32_t start, uint32_t n, uint64_t *mask)
+{
+    static const uint8_t table[8] = {0, 0, 1, 1, 1, 0, 0, 0};
+    size_t n_deleted = 0;
+
+    memset(mask, 0, ((n + 63) >> 6) * sizeof(uint64_t));
+    for (uint32_t i=0; i < n; i++) {
+        uint8_t *flag = &database_flag(database, start + i);
+        if (*flag == 1) {
+            mask[i >> 6] |= 1ULL << (i & 63);
+            n_deleted++;
+        }
+        *flag = table[*flag];
+    }
+
+    return n_deleted;
+}
+
+
+size_t database_flags_changed(const database_t *database, uint32_t start, uint32_t n, uint64_t *mask)
+{
+    if (database->flag_stride == 1)
+        return cpu_kernel.flags_changed(database->flags + start, n, mask);
+
+    size_t n_changed = 0;
+    memset(mask, 0, ((n + 63) >> 6) * sizeof(uint64_t));
+
+    for (uint32_t i=0; i < n; i++) {
+        if (database_flag(database, start + i) & 5) {  /* 1:delete, 3:add and 4:change */
+            mask[i >> 6] |= 1ULL << (i & 63);
+            n_changed++;
+        }
+    }
+
+    return n_changed;
+}
+
+
 /* func: reset the flags after comparing with new xml file
  *
  *               unchange  add  modify  delete  unused
@@ -125,18 +877,38 @@ int database_build(const args_t *args)
  *    cur_flag      2       3     4       1       0       // after compare with new xml file
  * update_flag      1       1     1       0       0       // after update the database
  */
-void database_update(const database_t *database, const char *file_name)
+void database_flags_reset(const database_t *database)
 {
     uint8_t *flags = database->flags;
-    static const uint8_t table[8] = {0, 0, 1, 1, 1, 0, 0, 0};
+    const uint64_t t_reset = trace_begin();
+    const uint32_t n_leaf = (uint32_t)(((uint64_t)database->capacity + (1U << DATABASE_LEAF_SHIFT) - 1) >> DATABASE_LEAF_SHIFT);
 
-    /* update the flag before save the database */
-    for (uint32_t id=0; id < database->capacity; id++) {
-        if (flags[id] == 1)   /* the item is deleted from database */
-            memset(&database->values[id<<4], 0, 16);
+    /* the flags of each leaf are swept by the vector kernel, then the hashes of the deleted items are cleared */
+    #pragma omp parallel for schedule(static)
+    for (uint32_t k=0; k < n_leaf; k++) {
+        uint64_t deleted[(1U << DATABASE_LEAF_SHIFT) >> 6];
+        const uint32_t start = k << DATABASE_LEAF_SHIFT;
+        const uint32_t n = database->capacity - start < (1U << DATABASE_LEAF_SHIFT) ?
+                           database->capacity - start : (1U << DATABASE_LEAF_SHIFT);
+
+        const size_t n_deleted = database->flag_stride == 1 ? cpu_kernel.flags_sweep(flags + start, n, deleted) :
+                                 slot_flags_sweep(database, start, n, deleted);
+        if (n_deleted == 0) continue;
 
-        flags[id] = table[flags[id]];
+        for (uint32_t w=0; w < (n + 63) >> 6; w++) {
+            for (uint64_t mask=deleted[w]; mask != 0; mask &= mask - 1)
+                memset(database_query(database, start + (w << 6) + __builtin_ctzll(mask)), 0, database->hash_width);
+        }
+        database_touch(database, start);
     }
+    trace_end(t_reset, "reset", database->capacity);
+}
+
+
+void database_update(database_t *database, const char *file_name)
+{
+    /* update the flag before save the database */
+    database_flags_reset(database);
 
     /* save the database */
     database_save(database, file_name);
@@ -145,6 +917,7 @@ void database_update(const database_t *database, const char *file_name)
 
 database_t *database_load(char *file_name)
 {
+    const uint64_t t_load = trace_begin();
     FILE *file_hd = fopen(file_name, "rb");
 
     if (file_hd == NULL) {
@@ -156,34 +929,164 @@ database_t *database_load(char *file_name)
     fprintf(stderr, "[%s] start to load the database ...\n", get_current_time(time_buf));
 
     /* read the database data from file */
-    char db_type[8];
-    uint32_t data[2];  // [db_date, capacity]
-    size_t n_item;
+    database_t *database = database_read(file_hd);
+    if (database == NULL) {
+        fprintf(stderr, "[Error:%s] truncated database file (%s) detected!\n\n", __func__, file_name);
+        exit(-1);
+    }
 
-    n_item = fread(db_type, sizeof(char), 8, file_hd);
-    if (n_item != 8) goto _truncated_error;
+    fprintf(stderr, "[*] database version: %s (%d), hash width: %u\n", database->db_type, database->db_date,
+            database->hash_width);
+    database_page_report(database);
+    fprintf(stderr, "[%s] done!\n", get_current_time(time_buf));
+    fclose(file_hd);
+    trace_end(t_load, "load", database->capacity);
+    return database;
+}
 
-    n_item = fread(data, sizeof(uint32_t), 2, file_hd);
-    if (n_item != 2) goto _truncated_error;
 
-    /* initiate the database */
-    database_t *database = database_init(data[1]);
-    database->db_date = data[0];
-    strcpy(database->db_type, db_type);
+/* func: merge the record indexes of the partial databases (only if all of them are built with --index) */
+static void database_index_merge(const args_t *args)
+{
+    record_index_t *index = NULL;
 
-    /* read the flags and md5 value list */
-    n_item = fread(database->flags, sizeof(uint8_t), database->capacity, file_hd);
-    if (n_item != database->capacity) goto _truncated_error;
+    for (int k=0; k < args->n_input; k++) {
+        record_index_t *partial = record_index_load(args->inputs[k]);
 
-    n_item = fread(database->values, sizeof(uint8_t), database->capacity<<4, file_hd);
-    if (n_item != database->capacity<<4) goto _truncated_error;
+        if (partial == NULL) {
+            if (k > 0) fprintf(stderr, "[Warning:%s] no record index of %s, the index is skipped!\n", __func__,
+                               args->inputs[k]);
+            record_index_close(index);
+            return;
+        }
 
-    fprintf(stderr, "[*] database version: %s (%d)\n", db_type, data[0]);
-    fprintf(stderr, "[%s] done!\n", get_current_time(time_buf));
-    fclose(file_hd);
-    return database;
+        if (index == NULL)
+            index = record_index_open(args->database, "-", partial->xml_date, 0);
+
+        if (k > 0 && (partial->xml_date != index->xml_date || partial->xml_size != index->xml_size)) {
+            fprintf(stderr, "[Error:%s] the record index of %s is built from another xml file!\n", __func__,
+                    args->inputs[k]);
+            exit(-1);
+        }
+
+        index->xml_size = partial->xml_size;
+        if (record_index_merge(index, partial) > 0) {
+            fprintf(stderr, "[Error:%s] duplicate IDs found in the record index of %s!\n", __func__, args->inputs[k]);
+            exit(-1);
+        }
+        record_index_close(partial);
+    }
+
+    record_index_save(index, 0);
+    fprintf(stderr, "[*] merge the record index: %u items\n", index->n_record);
+    record_index_close(index);
+}
+
+
+/* func: merge the field files of the partial databases in the order of the inputs (only if all of them have) */
+static void database_fields_merge(const args_t *args)
+{
+    field_table_t *fields = NULL;
+
+    for (int k=0; k < args->n_input; k++) {
+        field_table_t *partial = field_table_load(args->inputs[k]);
+
+        if (partial == NULL) {
+            if (k > 0) fprintf(stderr, "[Warning:%s] no field file of %s, the fields are skipped!\n", __func__,
+                               args->inputs[k]);
+            field_table_close(fields);
+            return;
+        }
+
+        if (fields == NULL)
+            fields = field_table_open(args->database, partial->spec, partial->xml_date, 0);
+
+        if (partial->xml_date != fields->xml_date || field_table_merge(fields, partial, partial->n_row) != 0) {
+            fprintf(stderr, "[Error:%s] the fields of %s are extracted with other fields or xml file!\n", __func__,
+                    args->inputs[k]);
+            exit(-1);
+        }
+        field_table_close(partial);
+    }
+
+    field_table_save(fields, 0);
+    fprintf(stderr, "[*] merge the fields: %u rows, %u columns\n", fields->n_row, fields->n_field);
+    field_table_close(fields);
+}
+
+
+int database_merge(const args_t *args)
+{
+    char time_buf[32];
+    database_t *database = NULL;
+    uint64_t n_total_item = 0;
+
+    /* the stamps are merged only if all of the partial databases are built with --precheck */
+    stamp_table_t *stamps = stamp_table_open(args->database, 0, 0);
+    int n_stamp = 0;
+
+    for (int k=0; k < args->n_input; k++) {
+        database_t *partial = database_load(args->inputs[k]);
+        n_stamp += stamp_table_merge(stamps, args->inputs[k], partial) == 0;
 
-    _truncated_error:
-    fprintf(stderr, "[Error:%s] truncated database file (%s) detected!\n\n", __func__, file_name);
-    exit(-1);
+        if (database == NULL) {  /* the first partial database is the base */
+            database = partial;
+            for (uint32_t id=0; id < database->capacity; id++)
+                n_total_item += database_flag(database, id) != 0;
+            continue;
+        }
+
+        if (strcmp(partial->db_type, database->db_type) != 0 || partial->db_date != database->db_date ||
+            partial->hash_width != database->hash_width) {
+            fprintf(stderr, "[Error:%s] conflict database version: %s (%d, %u bytes) vs %s (%d, %u bytes)!\n",
+                    __func__, partial->db_type, partial->db_date, partial->hash_width, database->db_type,
+                    database->db_date, database->hash_width);
+            exit(-1);
+        }
+
+        fprintf(stderr, "[%s] start to merge the database ...\n", get_current_time(time_buf));
+        database_resize(database, partial->capacity);
+
+        /* the ranges of the partial databases must not overlap */
+        uint64_t n_item = 0, n_dup = 0;
+        uint32_t dup_id = 0;
+
+        #pragma omp parallel for reduction(+:n_item, n_dup) reduction(max:dup_id)
+        for (uint32_t id=0; id < partial->capacity; id++) {
+            if (database_flag(partial, id) == 0) continue;
+
+            if (database_flag(database, id) != 0) {
+                n_dup++; dup_id = id;
+                continue;
+            }
+            database_add(database, id, database_query(partial, id));
+            n_item++;
+        }
+
+        if (n_dup > 0) {
+            fprintf(stderr, "[Error:%s] %lu duplicate IDs (e.g. %u) found in %s, the ranges are overlapped!\n",
+                    __func__, (unsigned long)n_dup, dup_id, args->inputs[k]);
+            exit(-1);
+        }
+
+        n_total_item += n_item;
+        database_destroy(partial);
+        fprintf(stderr, "[*] merge number of items: %lu\n", (unsigned long)n_total_item);
+        fprintf(stderr, "[%s] done!\n", get_current_time(time_buf));
+    }
+
+    /* save the database file */
+    database_save(database, args->database);
+    fprintf(stderr, "[*] database version: %s (%d)\n", database->db_type, database->db_date);
+
+    if (n_stamp == args->n_input)
+        stamp_table_save(stamps, database, 0);
+    else if (n_stamp > 0)
+        fprintf(stderr, "[Warning:%s] %d of %d partial databases have no stamps, the stamps are skipped!\n", __func__,
+                args->n_input - n_stamp, args->n_input);
+    stamp_table_close(stamps);
+
+    database_index_merge(args);
+    database_fields_merge(args);
+    return 0;
 }
@@ -8,7 +8,9 @@
 #ifndef INSDCXMLPARSER_DATABASE_H
 #define INSDCXMLPARSER_DATABASE_H
 
+#include <stdio.h>
 #include <stdint.h>
+#include <string.h>
 #include "params.h"
 
 /* the maximum ID (usually more bigger) for the sample table */
@@ -25,29 +27,80 @@
 #define PROJECT_START_TAG "<Package>"
 #define PROJECT_END_TAG "</Package>"
 
+/* the magic string and the format version of the database file */
+#define DATABASE_MAGIC "INSDCDB"
+#define DATABASE_VERSION 5
+
+/* the width (bytes) of the hash stored for each ID: the 64-bit fingerprint or the full MD5 */
+#define DATABASE_HASH_SHORT 8
+#define DATABASE_HASH_FULL 16
+
+/* the layout of the table in memory: the flags and the hashes in two tables, or the hash and the flag of each ID
+ * in one slot of 2 * hash_width bytes (one cache line for each lookup), the file is the same for both layouts */
+#define DATABASE_LAYOUT_SPLIT 0
+#define DATABASE_LAYOUT_SLOT 1
+
+/* the tables larger than the huge page are aligned to it and advised to use transparent huge pages */
+#define DATABASE_HUGE_PAGE (2UL << 20)
+
+/* the hash tree: 2^DATABASE_LEAF_SHIFT IDs for each leaf, DATABASE_TREE_FANOUT children for each node */
+#define DATABASE_LEAF_SHIFT 12
+#define DATABASE_TREE_FANOUT 16
+#define DATABASE_TREE_LEVEL 8
+
+/* the hash of the leaf without any item */
+#define DATABASE_TREE_SEED 0x494E534443444254ULL
+
 
 /*! @typedef database_t
   @abstract the database used to store the MD5 value for given ID
   @field  db_type           the database type, could be SAMPLE or PROJECT
   @field  db_date           the date of the current database
   @field  capacity          the maximum number of items to store
-  @field  flags             the status after compare (0:empty, 1:delete, 2:constant, 3:add, 4:modify)
-  @field  values            the value list used to store the MD5 (16 uint8_t for one MD5)
+  @field  hash_width        the bytes of the hash for each ID (8: the first 8 bytes of MD5, 16: MD5)
+  @field  layout            the layout of the table [DATABASE_LAYOUT_SPLIT|DATABASE_LAYOUT_SLOT]
+  @field  slot_width        the bytes of the values for each ID (hash_width, or 2 * hash_width for the slots)
+  @field  flag_stride       the bytes between the flags of two IDs (1, or slot_width for the slots)
+  @field  flags             the status after compare (0:empty, 1:delete, 2:constant, 3:add, 4:modify),
+                            right after the hash in each slot for DATABASE_LAYOUT_SLOT
+  @field  values            the value list used to store the hash (slot_width uint8_t for one ID)
+  @field  generation        the number of times the database file is published (increased by each save)
+  @field  mapped            the read-only mapping of the database file with the tables (NULL: the tables in memory)
+  @field  mapped_size       the size of the mapping
+  @field  n_leaf            the number of leaves of the hash tree (2^DATABASE_LEAF_SHIFT IDs for each leaf)
+  @field  n_node            the number of the nodes above the leaves
+  @field  leaves            the hash of the present IDs and their values in each leaf
+  @field  nodes             the hash of the children, the levels are stored from the root
+  @field  dirty             [0|1] 1: the leaf is changed after the latest database_tree_update
  */
 typedef struct {
     char db_type[8];
     uint32_t db_date;
     uint32_t capacity;
+    uint32_t hash_width;
+    uint32_t layout;
+    uint32_t slot_width;
+    uint32_t flag_stride;
     uint8_t *flags;
     uint8_t *values;
+    uint64_t generation;
+    uint8_t *mapped;
+    size_t mapped_size;
+    uint32_t n_leaf;
+    uint32_t n_node;
+    uint64_t *leaves;
+    uint64_t *nodes;
+    uint8_t *dirty;
 } database_t;
 
 
 /*! @function: initiation of database
   @param  max_size           the maximum number of items for the table to store
+  @param  hash_width         the bytes of the hash for each ID (DATABASE_HASH_SHORT or DATABASE_HASH_FULL)
+  @param  layout             the layout of the table (DATABASE_LAYOUT_SPLIT or DATABASE_LAYOUT_SLOT)
   @return                    database object
  */
-database_t *database_init(uint32_t max_size);
+database_t *database_init(uint32_t max_size, uint32_t hash_width, uint32_t layout);
 
 
 /*! @function: resize the database memory
@@ -58,19 +111,111 @@ database_t *database_init(uint32_t max_size);
 database_t *database_resize(database_t *database, uint32_t new_size);
 
 
+/*! @function: report the memory and the effective page size of the tables
+  @param  database           the pointer to the database object
+  @return
+ */
+void database_page_report(const database_t *database);
+
+
+/*! @function: destroy the memory allocated to database
+  @param  database           the pointer to the database object
+  @return
+ */
+void database_destroy(database_t *database);
+
+
+/*! @function: write the database to an opened file
+  @param  database           the pointer to the database object
+  @param  file_hd            the file handle opened with "wb"
+  @return                    status of writing (-1: failed)
+ */
+int database_write(const database_t *database, FILE *file_hd);
+
+
+/*! @function: read the database from an opened file
+  @param  file_hd            the file handle opened with "rb"
+  @return                    the database object (NULL: truncated file)
+ */
+database_t *database_read(FILE *file_hd);
+
+
+/*! @function: map the published database file read-only, the tables are shared with the page cache
+  @param  file_name          the database file name
+  @return                    the database object (NULL: missing or truncated), never resized or modified
+ */
+database_t *database_map(const char *file_name);
+
+
+/*! @function: the generation in the header of the published database file
+  @param  file_name          the database file name
+  @return                    the generation (0: missing or saved before version 5)
+ */
+uint64_t database_generation(const char *file_name);
+
+
+/*! @function: publish the next generation of the database file
+               (written aside and renamed over the published one, the readers never see a half written table)
+  @param  database           the pointer to the database object (the generation is increased)
+  @param  file_name          the database file name
+  @return                    status (-1: the file name is too long, -2: failed to open, -3: failed to write)
+ */
+int database_publish(database_t *database, const char *file_name);
+
+
 /*! @function: database build
   @param   args              the args necessary for build the database
-  @return                    the database object
+  @return                    status (-1: the xml file is invalid, nothing is saved)
  */
 int database_build(const args_t *args);
 
 
-/*! @function: database update and save
+/*! @function: merge the partial databases (built with --range) into one database
+  @param   args              the args with the partial databases and the output database
+  @return
+ */
+int database_merge(const args_t *args);
+
+
+/*! @function: reset the flags after comparing (deleted items are cleared, the others become 1)
+  @param   database          the pointer to the database object
+  @return
+ */
+void database_flags_reset(const database_t *database);
+
+
+/*! @function: set the bit of each changed flag {1,3,4} of the IDs [start, start+n) in the mask (n bits)
+  @param   database          the pointer to the database object
+  @param   start             the first ID
+  @param   n                 the number of IDs (at most 2^DATABASE_LEAF_SHIFT)
+  @param   mask              the bits of the changed flags
+  @return                    the number of the changed flags
+ */
+size_t database_flags_changed(const database_t *database, uint32_t start, uint32_t n, uint64_t *mask);
+
+
+/*! @function: get the levels of the hash tree, the root is level 0 and the leaves are the last level
+  @param   n_leaf            the number of leaves
+  @param   start             the index of the first node of each level (in the order from the root)
+  @param   count             the number of nodes of each level
+  @return                    the number of levels
+ */
+uint32_t database_tree_shape(uint32_t n_leaf, uint32_t *start, uint32_t *count);
+
+
+/*! @function: rehash the dirty leaves (in parallel) and all nodes above the leaves
+  @param   database          the pointer to the database object
+  @return                    the hash of the root
+ */
+uint64_t database_tree_update(const database_t *database);
+
+
+/*! @function: database update and save (the next generation is published by renaming, see database_save)
   @param   database          the pointer to the database object
   @param   file_name         the database file name
   @return
  */
-void database_update(const database_t *database, const char *file_name);
+void database_update(database_t *database, const char *file_name);
 
 
 /*! @function: database load
@@ -80,26 +225,76 @@ void database_update(const database_t *database, const char *file_name);
 database_t *database_load(char *file_name);
 
 
-/*! @function: get the address of the MD5 value for given index
+/*! @function: get the address of the hash value for given index
+  @param  _database          the pointer to the database object
+  @param  _index             the index of the hash value
+  @return                    the address of the hash value (hash_width bytes)
+ */
+#define database_query(_database, _index) ((_database)->values + (size_t)(_index) * (_database)->slot_width)
+
+
+/*! @function: get the flag for given index (could be assigned)
   @param  _database          the pointer to the database object
-  @param  _index             the index to store the MD5 value (only 16 bytes could be use)
+  @param  _index             the index of the flag
+  @return                    the flag
+ */
+#define database_flag(_database, _index) ((_database)->flags[(size_t)(_index) * (_database)->flag_stride])
+
+
+/*! @function: store the hash value (the leading hash_width bytes of MD5) for given index
+  @param  _database          the pointer to the database object
+  @param  _index             the index to store the hash value
   @param  _value             the MD5 value to store
   @return
  */
-#define database_add(_database, _index, _value) do {     \
-    uint8_t *dest = (_database)->values + (_index<<4);   \
-    memcpy(dest, _value, 16 * sizeof(unsigned char));    \
-    (_database)->flags[_index] = 1;                      \
+#define database_add(_database, _index, _value) do {         \
+    database_copy(_database, database_query(_database, _index), _value); \
+    database_flag(_database, _index) = 1;                    \
+    database_touch(_database, _index);                       \
 } while(0)
 
 
-/*! @function: get the address of the MD5 value for given index
+/*! @function: mark the leaf of the hash tree covering the index as changed
   @param  _database          the pointer to the database object
-  @param  _index             the index to store the MD5 value (only 16 bytes could be use)
-  @param  _value             the MD5 value to store
+  @param  _index             the index changed
+  @return
+ */
+#define database_touch(_database, _index) ((_database)->dirty[(uint32_t)(_index) >> DATABASE_LEAF_SHIFT] = 1)
+
+
+/*! @function: copy the hash value, specialized for each width
+  @param  database           the pointer to the database object
+  @param  dest               the address to store the hash value
+  @param  value              the hash value (at least hash_width bytes)
   @return
  */
-#define database_query(_database, _index) ((_database)->values + (_index<<4))
+static inline void database_copy(const database_t *database, uint8_t *dest, const uint8_t *value)
+{
+    if (database->hash_width == DATABASE_HASH_SHORT)
+        memcpy(dest, value, DATABASE_HASH_SHORT);
+    else
+        memcpy(dest, value, DATABASE_HASH_FULL);
+}
+
+
+/*! @function: compare the hash value with 64-bit words, specialized for each width
+  @param  database           the pointer to the database object
+  @param  raw                the address of the stored hash value
+  @param  value              the hash value to compare (at least hash_width bytes)
+  @return                    1: equal, 0: different
+ */
+static inline int database_equal(const database_t *database, const uint8_t *raw, const uint8_t *value)
+{
+    uint64_t a[2], b[2];
+
+    if (database->hash_width == DATABASE_HASH_SHORT) {
+        memcpy(a, raw, 8); memcpy(b, value, 8);
+        return a[0] == b[0];
+    }
+
+    memcpy(a, raw, 16); memcpy(b, value, 16);
+    return ((a[0] ^ b[0]) | (a[1] ^ b[1])) == 0;
+}
 
 
 #endif //INSDCXMLPARSER_DATABASE_H
\ No newline at end of file
@@ -0,0 +1,463 @@
+/*************************************************************************
+    > File Name: db_compare.c
+    > Author: xlzh
+    > Mail: xiaolongzhang2015@163.com
+    > Created Time: 2025年12月25 09时42分17秒
+ ************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <omp.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "utils.h"
+#include "database.h"
+#include "db_compare.h"
+
+
+/* the size of the header: magic[8], version, hash_width, layout, db_type[8], db_date, capacity, generation[8],
+ * leaf_ids, fanout (the layout is added in version 4, the generation in version 5) */
+#define DB_HEADER_SIZE 52
+
+
+/*! @typedef db_file_t
+  @abstract the database file read with pread (only the nodes and leaves needed)
+  @field  fd                the file descriptor
+  @field  name              the file name
+  @field  hash_width        the bytes of the hash for each ID
+  @field  capacity          the number of IDs in the table
+  @field  n_level           the number of levels of the hash tree
+  @field  start             the index of the first node of each level
+  @field  count             the number of nodes of each level
+  @field  tree_offset       the offset of the hash tree in the file
+  @field  flag_offset       the offset of the flags in the file
+  @field  value_offset      the offset of the values in the file
+  @field  n_read            the number of bytes read
+ */
+typedef struct {
+    int fd;
+    const char *name;
+    uint32_t hash_width;
+    uint32_t capacity;
+    uint32_t n_level;
+    uint32_t start[DATABASE_TREE_LEVEL];
+    uint32_t count[DATABASE_TREE_LEVEL];
+    uint64_t tree_offset;
+    uint64_t flag_offset;
+    uint64_t value_offset;
+    uint64_t n_read;
+} db_file_t;
+
+
+/* func: read the whole range, the short reads are continued (thread-safe) */
+static void db_pread(const db_file_t *file, void *buf, size_t size, uint64_t offset)
+{
+    char *p = (char *)buf;
+
+    while (size > 0) {
+        ssize_t n_bytes = pread(file->fd, p, size, (off_t)offset);
+        if (n_bytes <= 0) {
+            fprintf(stderr, "[Error:%s] truncated database file (%s) detected!\n", __func__, file->name);
+            exit(-1);
+        }
+        p += n_bytes; size -= (size_t)n_bytes; offset += (uint64_t)n_bytes;
+    }
+}
+
+
+static void db_file_read(db_file_t *file, void *buf, size_t size, uint64_t offset)
+{
+    file->n_read += size;
+    db_pread(file, buf, size, offset);
+}
+
+
+/* func: open the database file and locate the tables (and the hash tree of version 3)
+ *
+ *   version 1:  db_type[8], db_date, capacity, flags, values (16 bytes)
+ *   version 2:  magic[8], version, hash_width, db_type[8], db_date, capacity, flags, values
+ *   version 3:  magic[8], version, hash_width, db_type[8], db_date, capacity, leaf_ids, fanout, tree, flags, values
+ *   version 4:  the same as version 3, with the layout (uint32_t) after the hash width (the tables are the same)
+ *   version 5:  the same as version 4, with the generation (uint64_t) after the capacity
+ */
+static void db_file_open(db_file_t *file, const char *name, int need_tree)
+{
+    memset(file, 0, sizeof(db_file_t));
+    file->name = name;
+
+    file->fd = open(name, O_RDONLY);
+    if (file->fd < 0) {
+        fprintf(stderr, "[Error:%s]: failed to open (%s)!\n", __func__, name);
+        exit(-1);
+    }
+
+    char header[DB_HEADER_SIZE];
+    uint32_t version = 1, tree_header[2] = {0, 0};
+    db_file_read(file, header, 8 + sizeof(uint32_t), 0);
+    if (memcmp(header, DATABASE_MAGIC, 8) == 0) memcpy(&version, header + 8, sizeof(uint32_t));
+
+    if (version > DATABASE_VERSION || (need_tree && version < 3)) {
+        fprintf(stderr, "[Error:%s] the database (%s) is saved %s, update it with the current version first!\n",
+                __func__, name, version > DATABASE_VERSION ? "by a newer version" : "without the hash tree");
+        exit(-1);
+    }
+
+    /* the layout of version 4 is only for the memory, the generation of version 5 is not compared */
+    const uint32_t extra = version >= 4 ? sizeof(uint32_t) : 0, generation = version >= 5 ? sizeof(uint64_t) : 0;
+
+    if (version == 1) {  /* no magic, the hash is always the full MD5 */
+        db_file_read(file, header, 16, 0);
+        file->hash_width = DATABASE_HASH_FULL;
+        memcpy(&file->capacity, header + 12, sizeof(uint32_t));
+        file->flag_offset = 16;
+    }
+    else {
+        db_file_read(file, header, version == 2 ? 32 : DB_HEADER_SIZE - 12 + extra + generation, 0);
+        memcpy(&file->hash_width, header + 12, sizeof(uint32_t));
+        memcpy(&file->capacity, header + 28 + extra, sizeof(uint32_t));
+        file->flag_offset = 32;
+    }
+
+    if (version >= 3) {
+        memcpy(tree_header, header + 32 + extra + generation, sizeof(uint32_t) * 2);
+        if (tree_header[0] != 1U << DATABASE_LEAF_SHIFT || tree_header[1] != DATABASE_TREE_FANOUT) {
+            fprintf(stderr, "[Error:%s] unsupported hash tree (%u IDs, %u children) of (%s)!\n", __func__,
+                    tree_header[0], tree_header[1], name);
+            exit(-1);
+        }
+
+        const uint32_t n_leaf = (uint32_t)(((uint64_t)file->capacity + (1U << DATABASE_LEAF_SHIFT) - 1)
+                                           >> DATABASE_LEAF_SHIFT);
+        file->n_level = database_tree_shape(n_leaf, file->start, file->count);
+
+        const uint64_t n_node = (uint64_t)file->start[file->n_level-1] + n_leaf;
+        file->tree_offset = DB_HEADER_SIZE - 12 + extra + generation;
+        file->flag_offset = file->tree_offset + n_node * sizeof(uint64_t);
+    }
+
+    file->value_offset = file->flag_offset + file->capacity;
+}
+
+
+/* func: read the hashes of the nodes [first, first+n) of the level */
+static void db_tree_read(db_file_t *file, uint32_t level, uint32_t first, uint32_t n, uint64_t *hash)
+{
+    db_file_read(file, hash, (size_t)n * sizeof(uint64_t),
+                 file->tree_offset + ((uint64_t)file->start[level] + first) * sizeof(uint64_t));
+}
+
+
+/* func: find the divergent leaves from the root, only the children of the divergent nodes are read */
+static uint32_t *db_tree_descend(db_file_t *a, db_file_t *b, uint32_t *n_diff)
+{
+    uint32_t *diff, *next, n_next;
+    uint64_t hash_a[DATABASE_TREE_FANOUT], hash_b[DATABASE_TREE_FANOUT];
+    const uint32_t n_leaf = a->count[a->n_level-1];
+
+    err_malloc(diff, n_leaf + 1, uint32_t);
+    err_malloc(next, n_leaf + 1, uint32_t);
+
+    db_tree_read(a, 0, 0, 1, hash_a);
+    db_tree_read(b, 0, 0, 1, hash_b);
+    *n_diff = n_leaf > 0 && hash_a[0] != hash_b[0];
+    diff[0] = 0;
+
+    for (uint32_t l=1; l < a->n_level && *n_diff > 0; l++) {
+        n_next = 0;
+
+        for (uint32_t k=0; k < *n_diff; k++) {
+            const uint32_t first = diff[k] * DATABASE_TREE_FANOUT;
+            const uint32_t n = a->count[l] - first < DATABASE_TREE_FANOUT ? a->count[l] - first : DATABASE_TREE_FANOUT;
+
+            db_tree_read(a, l, first, n, hash_a);
+            db_tree_read(b, l, first, n, hash_b);
+            for (uint32_t c=0; c < n; c++)
+                if (hash_a[c] != hash_b[c]) next[n_next++] = first + c;
+        }
+
+        uint32_t *swap = diff; diff = next; next = swap;
+        *n_diff = n_next;
+    }
+
+    free(next);
+    return diff;
+}
+
+
+/* func: compare all leaves when the capacities are different, the missing leaves are empty */
+static uint32_t *db_leaf_scan(db_file_t *a, db_file_t *b, uint32_t *n_diff)
+{
+    const uint32_t n_a = a->count[a->n_level-1], n_b = b->count[b->n_level-1];
+    const uint32_t n_leaf = n_a > n_b ? n_a : n_b;
+    uint64_t *leaf_a, *leaf_b;
+    uint32_t *diff;
+
+    err_malloc(leaf_a, n_leaf + 1, uint64_t);
+    err_malloc(leaf_b, n_leaf + 1, uint64_t);
+    err_malloc(diff, n_leaf + 1, uint32_t);
+
+    for (uint32_t k=0; k < n_leaf; k++)
+        leaf_a[k] = leaf_b[k] = DATABASE_TREE_SEED;
+    db_tree_read(a, a->n_level-1, 0, n_a, leaf_a);
+    db_tree_read(b, b->n_level-1, 0, n_b, leaf_b);
+
+    *n_diff = 0;
+    for (uint32_t k=0; k < n_leaf; k++)
+        if (leaf_a[k] != leaf_b[k]) diff[(*n_diff)++] = k;
+
+    free(leaf_a);
+    free(leaf_b);
+    return diff;
+}
+
+
+/* func: read the flags and values of the leaf, the IDs beyond the capacity are empty */
+static void db_leaf_read(db_file_t *file, uint32_t leaf, uint8_t *flags, uint8_t *values)
+{
+    const uint32_t lo = leaf << DATABASE_LEAF_SHIFT;
+    uint32_t n = lo < file->capacity ? file->capacity - lo : 0;
+    n = n > (1U << DATABASE_LEAF_SHIFT) ? 1U << DATABASE_LEAF_SHIFT : n;
+
+    memset(flags, 0, 1U << DATABASE_LEAF_SHIFT);
+    db_file_read(file, flags, n, file->flag_offset + lo);
+    db_file_read(file, values, (size_t)n * file->hash_width, file->value_offset + (uint64_t)lo * file->hash_width);
+}
+
+
+/* func: write the exact IDs different in the leaf (the first database is the previous one) */
+static uint64_t db_leaf_compare(db_file_t *a, db_file_t *b, uint32_t leaf, uint8_t *buf, FILE *file_hd)
+{
+    const size_t n_id = 1U << DATABASE_LEAF_SHIFT, width = a->hash_width;
+    uint8_t *flag_a = buf, *flag_b = buf + n_id, *value_a = buf + 2 * n_id, *value_b = value_a + n_id * width;
+    uint64_t n_write = 0;
+
+    db_leaf_read(a, leaf, flag_a, value_a);
+    db_leaf_read(b, leaf, flag_b, value_b);
+
+    for (uint32_t k=0; k < n_id; k++) {
+        const char *status = NULL;
+
+        if (flag_a[k] == 0 && flag_b[k] != 0)
+            status = "ADD";
+        else if (flag_a[k] != 0 && flag_b[k] == 0)
+            status = "DELETE";
+        else if (flag_a[k] != 0 && memcmp(value_a + k * width, value_b + k * width, width) != 0)
+            status = "CHANGE";
+
+        if (status == NULL) continue;
+        fprintf(file_hd, "%s\t%u\n", status, (leaf << DATABASE_LEAF_SHIFT) + k);
+        n_write++;
+    }
+
+    return n_write;
+}
+
+
+int db_compare_run(const args_t *args)
+{
+    char time_buf[32];
+    db_file_t a, b;
+
+    fprintf(stderr, "[%s] start to compare the hash trees ...\n", get_current_time(time_buf));
+    db_file_open(&a, args->inputs[0], 1);
+    db_file_open(&b, args->inputs[1], 1);
+
+    if (a.hash_width != b.hash_width) {
+        fprintf(stderr, "[Error:%s] the hash widths (%u vs %u bytes) are different!\n", __func__, a.hash_width,
+                b.hash_width);
+        exit(-1);
+    }
+
+    /* the trees in the same shape are compared from the root, otherwise the leaves are compared */
+    uint32_t n_diff, *diff;
+    if (a.capacity == b.capacity)
+        diff = db_tree_descend(&a, &b, &n_diff);
+    else
+        diff = db_leaf_scan(&a, &b, &n_diff);
+
+    fprintf(stderr, "[*] hash tree: %lu bytes read, %u divergent ranges of %u IDs\n",
+            (unsigned long)(a.n_read + b.n_read), n_diff, 1U << DATABASE_LEAF_SHIFT);
+
+    /* the adjacent divergent leaves are reported as one range */
+    for (uint32_t k=0, n_range=0; k < n_diff; k++) {
+        if (k > 0 && diff[k] == diff[k-1] + 1) continue;
+
+        uint32_t end = k;
+        while (end + 1 < n_diff && diff[end+1] == diff[end] + 1) end++;
+
+        if (n_range++ < DB_COMPARE_MAX_RANGE)
+            fprintf(stderr, "  (-) IDs [%lu, %lu)\n", (unsigned long)diff[k] << DATABASE_LEAF_SHIFT,
+                    (unsigned long)(diff[end] + 1) << DATABASE_LEAF_SHIFT);
+    }
+
+    /* drill down to the exact IDs */
+    FILE *file_hd = args->output_file ? fopen(args->output_file, "wb") : stdout;
+    if (file_hd == NULL) {
+        fprintf(stderr, "[Error:%s]: failed to open the output (%s)!\n", __func__, args->output_file);
+        exit(-1);
+    }
+
+    uint8_t *buf;
+    uint64_t n_id = 0;
+    err_malloc(buf, (size_t)(2 + 2 * a.hash_width) << DATABASE_LEAF_SHIFT, uint8_t);
+
+    for (uint32_t k=0; k < n_diff; k++)
+        n_id += db_leaf_compare(&a, &b, diff[k], buf, file_hd);
+
+    if (file_hd != stdout) fclose(file_hd);
+    fprintf(stderr, "[*] %s: %lu IDs are different, %lu bytes read in total\n", n_diff ? "DIVERGENT" : "IDENTICAL",
+            (unsigned long)n_id, (unsigned long)(a.n_read + b.n_read));
+    fprintf(stderr, "[%s] done!\n", get_current_time(time_buf));
+
+    free(buf);
+    free(diff);
+    close(a.fd);
+    close(b.fd);
+    return n_diff > 0;
+}
+
+
+/* func: the bit mask of the present IDs among 64 flags */
+static inline uint64_t db_present_mask(const uint8_t *flags)
+{
+    uint64_t mask = 0;
+
+#ifdef __SSE2__
+    const __m128i zero = _mm_setzero_si128();
+    for (int k=0; k < 4; k++) {
+        const __m128i v = _mm_loadu_si128((const __m128i *)(flags + (k << 4)));
+        mask |= (uint64_t)(uint16_t)~_mm_movemask_epi8(_mm_cmpeq_epi8(v, zero)) << (k << 4);
+    }
+#else
+    for (int k=0; k < 64; k++)
+        mask |= (uint64_t)(flags[k] != 0) << k;
+#endif
+
+    return mask;
+}
+
+
+/* func: read the flags and values of the IDs [lo, lo+n), the IDs beyond the capacity are empty */
+static void db_block_read(const db_file_t *file, uint32_t lo, uint32_t n, uint8_t *flags, uint8_t *values)
+{
+    const uint32_t n_read = lo < file->capacity ? (file->capacity - lo < n ? file->capacity - lo : n) : 0;
+    const size_t width = file->hash_width;
+
+    db_pread(file, flags, n_read, file->flag_offset + lo);
+    db_pread(file, values, n_read * width, file->value_offset + (uint64_t)lo * width);
+
+    memset(flags + n_read, 0, DB_DIFF_BLOCK - n_read);
+    memset(values + n_read * width, 0, (DB_DIFF_BLOCK - n_read) * width);
+}
+
+
+/* func: compare the block of IDs [lo, lo+n) 64 IDs at once, the different IDs are appended to the output */
+static void db_block_diff(const db_file_t *a, const db_file_t *b, uint32_t lo, uint32_t n, uint8_t *buf,
+                          kstring_t *out, uint64_t *n_status)
+{
+    static const char *table[] = {NULL, "DELETE", NULL, "ADD", "CHANGE"};
+    const size_t width = a->hash_width;
+    uint8_t *flag_a = buf, *flag_b = buf + DB_DIFF_BLOCK;
+    uint8_t *value_a = buf + 2 * DB_DIFF_BLOCK, *value_b = value_a + DB_DIFF_BLOCK * width;
+
+    db_block_read(a, lo, n, flag_a, value_a);
+    db_block_read(b, lo, n, flag_b, value_b);
+
+    out->l = 0;
+    for (uint32_t g=0; g < n; g += 64) {
+        const uint64_t mask_a = db_present_mask(flag_a + g), mask_b = db_present_mask(flag_b + g);
+
+        /* the same IDs with the same hashes (the absent IDs are zeroed) */
+        if (mask_a == mask_b && (mask_a == 0 || memcmp(value_a + g * width, value_b + g * width, 64 * width) == 0))
+            continue;
+
+        for (uint64_t rest = mask_a | mask_b; rest != 0; rest &= rest - 1) {
+            const uint32_t k = g + (uint32_t)__builtin_ctzll(rest);
+            int status;
+
+            if (!(mask_a >> (k - g) & 1))
+                status = 3;  /* ADD */
+            else if (!(mask_b >> (k - g) & 1))
+                status = 1;  /* DELETE */
+            else if (memcmp(value_a + k * width, value_b + k * width, width) != 0)
+                status = 4;  /* CHANGE */
+            else
+                continue;
+
+            /* "CHANGE\t4294967295\n" is at most 18 bytes */
+            if (out->l + 32 > out->m) {
+                out->m = out->m ? out->m << 1 : 1U << 16;
+                err_realloc(out->s, out->m, char);
+            }
+            out->l += (size_t)sprintf(out->s + out->l, "%s\t%u\n", table[status], lo + k);
+            n_status[status]++;
+        }
+    }
+}
+
+
+void db_diff_run(const args_t *args)
+{
+    char time_buf[32];
+    db_file_t a, b;
+
+    fprintf(stderr, "[%s] start to compare the databases ...\n", get_current_time(time_buf));
+    db_file_open(&a, args->inputs[0], 0);
+    db_file_open(&b, args->inputs[1], 0);
+
+    if (a.hash_width != b.hash_width) {
+        fprintf(stderr, "[Error:%s] the hash widths (%u vs %u bytes) are different!\n", __func__, a.hash_width,
+                b.hash_width);
+        exit(-1);
+    }
+
+    FILE *file_hd = args->output_file ? fopen(args->output_file, "wb") : stdout;
+    if (file_hd == NULL) {
+        fprintf(stderr, "[Error:%s]: failed to open the output (%s)!\n", __func__, args->output_file);
+        exit(-1);
+    }
+
+    /* the tables are read once from the start to the end */
+    posix_fadvise(a.fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    posix_fadvise(b.fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    const uint32_t n_id = a.capacity > b.capacity ? a.capacity : b.capacity;
+    const int64_t n_block = ((int64_t)n_id + DB_DIFF_BLOCK - 1) / DB_DIFF_BLOCK;
+    uint64_t n_add = 0, n_change = 0, n_delete = 0;
+
+    /* each block is read and compared by one thread, the lists are written in the order of ID */
+    #pragma omp parallel reduction(+:n_add, n_change, n_delete)
+    {
+        uint8_t *buf;
+        kstring_t out = {0, 0, NULL};
+        uint64_t n_status[5] = {0};
+        err_malloc(buf, (2 + 2 * (size_t)a.hash_width) * DB_DIFF_BLOCK, uint8_t);
+
+        #pragma omp for schedule(dynamic, 1) ordered
+        for (int64_t k=0; k < n_block; k++) {
+            const uint32_t lo = (uint32_t)k * DB_DIFF_BLOCK;
+            db_block_diff(&a, &b, lo, n_id - lo < DB_DIFF_BLOCK ? n_id - lo : DB_DIFF_BLOCK, buf, &out, n_status);
+
+            #pragma omp ordered
+            fwrite(out.s, sizeof(char), out.l, file_hd);
+        }
+
+        n_add += n_status[3]; n_change += n_status[4]; n_delete += n_status[1];
+        k_strfree(&out);
+        free(buf);
+    }
+
+    if (file_hd != stdout) fclose(file_hd);
+    close(a.fd);
+    close(b.fd);
+
+    const uint64_t n_byte = (uint64_t)a.capacity * (1 + a.hash_width) + (uint64_t)b.capacity * (1 + b.hash_width);
+    fprintf(stderr, "[*] ADD: %lu, CHANGE: %lu, DELETE: %lu (%lu MB read)\n", (unsigned long)n_add,
+            (unsigned long)n_change, (unsigned long)n_delete, (unsigned long)(n_byte >> 20));
+    fprintf(stderr, "[%s] done!\n", get_current_time(time_buf));
+}
@@ -0,0 +1,35 @@
+/*************************************************************************
+    > File Name: db_compare.h
+    > Author: xlzh
+    > Mail: xiaolongzhang2015@163.com
+    > Created Time: 2025年12月25 09时42分17秒
+ ************************************************************************/
+
+#ifndef INSDCXMLPARSER_DB_COMPARE_H
+#define INSDCXMLPARSER_DB_COMPARE_H
+
+#include "params.h"
+
+/* the number of divergent ranges reported */
+#define DB_COMPARE_MAX_RANGE 10
+
+/* the number of IDs read and compared by one thread at once (a multiple of 64) */
+#define DB_DIFF_BLOCK (1U << 20)
+
+
+/*! @function: compare two database files with their hash trees, only the divergent leaves are read
+  @param  args               the command line parameters (inputs: the two databases, output_file)
+  @return                    0: the databases are identical, 1: divergent
+ */
+int db_compare_run(const args_t *args);
+
+
+/*! @function: compare the tables of two database files block by block (in parallel), the list is the same as
+               diff_list_write after comparing the current xml with the previous database
+  @param  args               the command line parameters (inputs: the previous and current databases, output_file)
+  @return
+ */
+void db_diff_run(const args_t *args);
+
+
+#endif //INSDCXMLPARSER_DB_COMPARE_H
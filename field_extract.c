@@ -0,0 +1,706 @@
+/*************************************************************************
+    > File Name: field_extract.c
+    > Author: xlzh
+    > Mail: xiaolongzhang2015@163.com
+    > Created Time: 2025年12月31 10时06分52秒
+ ************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <omp.h>
+
+#include "utils.h"
+#include "field_extract.h"
+#include "checkpoint.h"
+#include "trace.h"
+
+
+/* the layout of the field file (each section is padded to the multiple of 8 bytes):
+ *
+ *   header     magic[8], version, xml_date, n_row, n_field, spec_len, reserved (32 bytes)
+ *   spec       the fields extracted (spec_len bytes, name=tag@attr separated by comma)
+ *   ids        uint32[n_row], the id of each row in the order of the xml file
+ *   column     for each field: n_entry, reserved, uint64 offsets[n_entry + 1], the bytes of the entries
+ *              (offsets[n_entry] bytes), uint32 codes[n_row] (0: missing, k: the entry k-1)
+ */
+#define FIELD_HEADER_SIZE 32
+
+/* the initial size of the lookup table of each dictionary */
+#define FIELD_LOOKUP_SIZE 1024
+
+
+static void field_file_name(const char *db_name, int checkpoint, char *name, size_t size)
+{
+    snprintf(name, size, "%s%s%s", db_name, FIELD_SUFFIX, checkpoint ? CHECKPOINT_SUFFIX : "");
+}
+
+
+/* func: the name of the element or attribute (letters, digits, '_', ':', '.' or '-') */
+static int field_name_valid(const char *name)
+{
+    if (*name == '\0') return 0;
+
+    for (; *name; name++) {
+        if (!isalnum((unsigned char)*name) && strchr("_:.-", *name) == NULL) return 0;
+    }
+    return 1;
+}
+
+
+static char *field_str_dup(const char *str, size_t len)
+{
+    char *dup;
+    err_malloc(dup, len + 1, char);
+    memcpy(dup, str, len);
+    dup[len] = '\0';
+    return dup;
+}
+
+
+/* func: parse the fields ([name=]@attr, [name=]tag or [name=]tag@attr separated by comma) into the columns */
+static void field_spec_parse(field_table_t *table, const char *spec)
+{
+    const size_t spec_size = (strlen(spec) + 1) * 3;  /* the name is added to each field at most */
+    char *buf = field_str_dup(spec, strlen(spec)), *save_ptr = NULL;
+    size_t spec_len = 0;
+
+    err_malloc(table->spec, spec_size, char);
+    table->spec[0] = '\0';
+    err_calloc(table->columns, FIELD_MAX, field_column_t);
+
+    for (char *token=strtok_r(buf, ",", &save_ptr); token != NULL; token=strtok_r(NULL, ",", &save_ptr)) {
+        char *rule = strchr(token, '='), *name = token;
+
+        if (rule != NULL) *rule++ = '\0';
+        else rule = token;
+
+        char *attr = strchr(rule, '@');
+        if (attr != NULL) *attr++ = '\0';
+
+        if (table->n_field == FIELD_MAX || (*rule != '\0' && !field_name_valid(rule)) ||
+            (attr != NULL && !field_name_valid(attr)) || (attr == NULL && *rule == '\0') ||
+            (name != rule && !field_name_valid(name))) {
+            fprintf(stderr, "[Error:%s] the fields (%s) are INVALID (e.g. taxonomy_id=Organism@taxonomy_id, at most "
+                    "%d fields)!\n", __func__, spec, FIELD_MAX);
+            exit(-1);
+        }
+
+        field_column_t *column = &table->columns[table->n_field++];
+        if (*rule != '\0') {
+            column->tag = field_str_dup(rule, strlen(rule));
+            column->tag_len = (uint32_t)strlen(rule);
+        }
+        if (attr != NULL) {
+            column->attr = field_str_dup(attr, strlen(attr));
+            column->attr_len = (uint32_t)strlen(attr);
+        }
+
+        /* the token is split in place, the rule is joined again as the default name */
+        char rule_buf[1024];
+        snprintf(rule_buf, sizeof(rule_buf), "%s%s%s", column->tag ? column->tag : "", attr ? "@" : "",
+                 attr ? attr : "");
+        column->name = name != rule ? field_str_dup(name, strlen(name)) : field_str_dup(rule_buf, strlen(rule_buf));
+
+        for (uint32_t k=0; k + 1 < table->n_field; k++) {
+            if (strcmp(table->columns[k].name, column->name) == 0) {
+                fprintf(stderr, "[Error:%s] the field name (%s) is duplicated!\n", __func__, column->name);
+                exit(-1);
+            }
+        }
+
+        spec_len += snprintf(table->spec + spec_len, spec_size - spec_len, "%s%s=%s", spec_len ? "," : "",
+                             column->name, rule_buf);
+    }
+
+    if (table->n_field == 0) {
+        fprintf(stderr, "[Error:%s] no field is given (e.g. accession=@accession,taxonomy_id=Organism@taxonomy_id)!\n",
+                __func__);
+        exit(-1);
+    }
+
+    free(buf);
+}
+
+
+static field_table_t *field_table_create(const char *db_name, const char *spec, uint32_t xml_date)
+{
+    field_table_t *table;
+    err_calloc(table, 1, field_table_t);
+    table->db_name = field_str_dup(db_name, strlen(db_name));
+    table->xml_date = xml_date;
+
+    /* "default" in the list is replaced by the fields of BioSample */
+    char *expanded, *save_ptr = NULL, *buf = field_str_dup(spec, strlen(spec));
+    size_t len = 0;
+    err_malloc(expanded, strlen(spec) * (sizeof(FIELD_SAMPLE_DEFAULT) + 1) + 1, char);
+    expanded[0] = '\0';
+
+    for (char *token=strtok_r(buf, ",", &save_ptr); token != NULL; token=strtok_r(NULL, ",", &save_ptr))
+        len += sprintf(expanded + len, "%s%s", len ? "," : "", strcmp(token, "default") ? token : FIELD_SAMPLE_DEFAULT);
+
+    field_spec_parse(table, expanded);
+    free(expanded);
+    free(buf);
+
+    for (uint32_t k=0; k < table->n_field; k++) {
+        field_column_t *column = &table->columns[k];
+        column->m_entry = FIELD_LOOKUP_SIZE;
+        err_calloc(column->offsets, column->m_entry + 1, uint64_t);
+        err_malloc(column->tags, column->m_entry, uint32_t);
+        err_calloc(column->lookup, FIELD_LOOKUP_SIZE, uint32_t);
+        column->lookup_mask = FIELD_LOOKUP_SIZE - 1;
+    }
+
+    return table;
+}
+
+
+static void field_rows_resize(field_table_t *table, uint32_t n)
+{
+    if (table->m_row >= n) return;
+
+    table->m_row = n;
+    kroundup32(table->m_row);
+    err_realloc(table->ids, table->m_row, uint32_t);
+
+    for (uint32_t k=0; k < table->n_field; k++)
+        err_realloc(table->columns[k].codes, table->m_row, uint32_t);
+}
+
+
+static inline uint64_t field_hash(const char *s, uint32_t n)
+{
+    uint64_t h = 0x9e3779b97f4a7c15ULL ^ n, v;
+
+    for (; n >= 8; s += 8, n -= 8) {
+        memcpy(&v, s, sizeof(uint64_t));
+        h = (h ^ v) * 0xff51afd7ed558ccdULL;
+        h ^= h >> 32;
+    }
+    if (n > 0) {
+        v = 0;
+        memcpy(&v, s, n);
+        h = (h ^ v) * 0xc4ceb9fe1a85ec53ULL;
+    }
+    return h ^ (h >> 29);
+}
+
+
+/* func: place the codes of all entries into the lookup table of the size (a power of 2) */
+static void field_lookup_rebuild(field_column_t *column, uint32_t size)
+{
+    free(column->lookup);
+    err_calloc(column->lookup, size, uint32_t);
+    column->lookup_mask = size - 1;
+
+    for (uint32_t e=0; e < column->n_entry; e++) {
+        const uint64_t h = field_hash(column->dict.s + column->offsets[e], (uint32_t)(column->offsets[e+1] - column->offsets[e]));
+        uint32_t k = (uint32_t)h & column->lookup_mask;
+
+        while (column->lookup[k]) k = (k + 1) & column->lookup_mask;
+        column->lookup[k] = e + 1;
+        column->tags[e] = (uint32_t)(h >> 32);
+    }
+}
+
+
+/* func: the code of the string in the dictionary, the string is added if it is not existed */
+static uint32_t field_intern(field_column_t *column, const char *s, uint32_t n)
+{
+    const uint64_t h = field_hash(s, n);
+    uint32_t k = (uint32_t)h & column->lookup_mask;
+
+    for (; column->lookup[k]; k = (k + 1) & column->lookup_mask) {
+        const uint32_t e = column->lookup[k] - 1;
+
+        if (column->tags[e] == (uint32_t)(h >> 32) && column->offsets[e+1] - column->offsets[e] == n &&
+            memcmp(column->dict.s + column->offsets[e], s, n) == 0)
+            return e + 1;
+    }
+
+    if (column->n_entry == column->m_entry) {
+        column->m_entry <<= 1;
+        err_realloc(column->offsets, column->m_entry + 1, uint64_t);
+        err_realloc(column->tags, column->m_entry, uint32_t);
+    }
+
+    if (column->dict.s == NULL || column->dict.l + n > column->dict.m) {
+        size_t m = column->dict.m ? column->dict.m : 4096;
+        while (m < column->dict.l + n) m <<= 1;
+        err_realloc(column->dict.s, m, char);
+        column->dict.m = m;
+    }
+
+    memcpy(column->dict.s + column->dict.l, s, n);
+    column->dict.l += n;
+    column->tags[column->n_entry] = (uint32_t)(h >> 32);
+    column->offsets[++column->n_entry] = column->dict.l;
+    column->lookup[k] = column->n_entry;
+
+    if (column->n_entry > (column->lookup_mask >> 1))
+        field_lookup_rebuild(column, (column->lookup_mask + 1) << 1);
+
+    return column->n_entry;
+}
+
+
+/* func: append the code point in UTF-8 */
+static void field_utf8_put(kstring_t *out, uint32_t cp)
+{
+    char *p = out->s + out->l;
+
+    if (cp < 0x80) {
+        p[0] = (char)cp;
+        out->l += 1;
+    }
+    else if (cp < 0x800) {
+        p[0] = (char)(0xC0 | (cp >> 6));
+        p[1] = (char)(0x80 | (cp & 0x3F));
+        out->l += 2;
+    }
+    else if (cp < 0x10000) {
+        p[0] = (char)(0xE0 | (cp >> 12));
+        p[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+        p[2] = (char)(0x80 | (cp & 0x3F));
+        out->l += 3;
+    }
+    else {
+        p[0] = (char)(0xF0 | (cp >> 18));
+        p[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+        p[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+        p[3] = (char)(0x80 | (cp & 0x3F));
+        out->l += 4;
+    }
+}
+
+
+/* func: the code point of the character reference (e.g. &amp; or &#x3B1;), 0 if it is not recognized */
+static uint32_t field_reference(const char *name, size_t n)
+{
+    if (n == 3 && memcmp(name, "amp", 3) == 0) return '&';
+    if (n == 2 && memcmp(name, "lt", 2) == 0) return '<';
+    if (n == 2 && memcmp(name, "gt", 2) == 0) return '>';
+    if (n == 4 && memcmp(name, "quot", 4) == 0) return '"';
+    if (n == 4 && memcmp(name, "apos", 4) == 0) return '\'';
+    if (n < 2 || name[0] != '#') return 0;
+
+    const int hex = name[1] == 'x' || name[1] == 'X';
+    uint32_t cp = 0;
+    if (n == 1 + (size_t)hex) return 0;
+
+    for (size_t i=1 + hex; i < n; i++) {
+        const int c = (unsigned char)name[i];
+        int d;
+
+        if (isdigit(c)) d = c - '0';
+        else if (hex && isxdigit(c)) d = (c | 0x20) - 'a' + 10;
+        else return 0;
+
+        cp = cp * (hex ? 16 : 10) + d;
+        if (cp > 0x10FFFF) return 0;
+    }
+    return cp;
+}
+
+
+/* func: decode the character references of the value (the decoded value is never longer) */
+static void field_decode(const char *s, uint32_t n, kstring_t *out)
+{
+    if (out->m < n) {
+        out->m = n;
+        kroundup32(out->m);
+        err_realloc(out->s, out->m, char);
+    }
+    out->l = 0;
+
+    for (uint32_t i=0; i < n; ) {
+        const char *semi = s[i] == '&' ? memchr(s + i, ';', n - i < 12 ? n - i : 12) : NULL;
+        const uint32_t cp = semi ? field_reference(s + i + 1, semi - s - i - 1) : 0;
+
+        if (cp == 0) {
+            out->s[out->l++] = s[i++];
+            continue;
+        }
+        field_utf8_put(out, cp);
+        i = (uint32_t)(semi - s) + 1;
+    }
+}
+
+
+/* func: the '>' of the tag, the quoted values of the attributes are skipped */
+static const char *field_tag_end(const char *p, const char *end)
+{
+    char quote = 0;
+
+    for (; p < end; p++) {
+        if (quote) {
+            if (*p == quote) quote = 0;
+        }
+        else if (*p == '"' || *p == '\'') quote = *p;
+        else if (*p == '>') return p;
+    }
+    return NULL;
+}
+
+
+/* func: the first start tag of the element in the data body */
+static const char *field_element_find(const field_column_t *column, const char *p, const char *end)
+{
+    const char *s = p + 1;
+
+    while (s < end && (s = memmem(s, end - s, column->tag, column->tag_len)) != NULL) {
+        const char *q = s + column->tag_len;
+
+        if (s[-1] == '<' && q < end && (*q == '>' || *q == '/' || isspace((unsigned char)*q))) return s - 1;
+        s = q;
+    }
+    return NULL;
+}
+
+
+/* func: the value of the attribute in the tag [tag, tag_end) */
+static void field_attr_find(const field_column_t *column, const char *tag, const char *tag_end, field_value_t *value)
+{
+    const char *s = tag + 1;
+
+    while (s < tag_end && (s = memmem(s, tag_end - s, column->attr, column->attr_len)) != NULL) {
+        const char *q = s + column->attr_len;
+
+        if (isspace((unsigned char)s[-1])) {
+            while (q < tag_end && isspace((unsigned char)*q)) q++;
+
+            if (q < tag_end && *q == '=') {
+                for (q++; q < tag_end && isspace((unsigned char)*q); q++);
+
+                const char *close = q < tag_end && (*q == '"' || *q == '\'') ? memchr(q + 1, *q, tag_end - q - 1) : NULL;
+                if (close != NULL) {
+                    value->start = q + 1;
+                    value->size = (uint32_t)(close - q - 1);
+                }
+                return;
+            }
+        }
+        s = q;
+    }
+}
+
+
+/* func: the text of the element before its first child (the leading and trailing spaces are trimmed) */
+static void field_text_find(const char *tag_end, const char *end, field_value_t *value)
+{
+    const char *s = tag_end + 1, *e;
+
+    if (tag_end[-1] == '/') {
+        value->start = s;  /* the empty element */
+        return;
+    }
+
+    if ((e = memchr(s, '<', end - s)) == NULL) return;
+    while (s < e && isspace((unsigned char)*s)) s++;
+    while (e > s && isspace((unsigned char)e[-1])) e--;
+
+    value->start = s;
+    value->size = (uint32_t)(e - s);
+}
+
+
+static field_table_t *field_table_read(const char *db_name, int checkpoint);
+
+
+field_table_t *field_table_open(const char *db_name, const char *spec, uint32_t xml_date, uint64_t n_resume)
+{
+    field_table_t *table = field_table_create(db_name, spec, xml_date);
+    if (n_resume == 0) return table;
+
+    /* the rows saved after the checkpoint (interrupted before the checkpoint is renamed) are dropped */
+    field_table_t *saved = field_table_read(db_name, 1);
+    if (saved == NULL || saved->n_row < n_resume) {
+        fprintf(stderr, "[Error:%s] the fields of the checkpoint are missing or fewer than %lu rows!\n", __func__,
+                (unsigned long)n_resume);
+        exit(-1);
+    }
+
+    if (field_table_merge(table, saved, (uint32_t)n_resume) != 0) {
+        fprintf(stderr, "[Error:%s] the fields of the checkpoint (%s) are different!\n", __func__, saved->spec);
+        exit(-1);
+    }
+    field_table_close(saved);
+
+    return table;
+}
+
+
+void field_table_reserve(field_table_t *table, uint32_t n)
+{
+    if (table->m_value >= n) return;
+
+    table->m_value = n;
+    err_realloc(table->values, (size_t)n * table->n_field, field_value_t);
+}
+
+
+void field_extract(field_table_t *table, uint32_t i, const body_t *body)
+{
+    const char *end = body->start + body->size;
+    field_value_t *values = table->values + (size_t)i * table->n_field;
+
+    for (uint32_t k=0; k < table->n_field; k++) {
+        const field_column_t *column = &table->columns[k];
+        const char *tag = column->tag ? field_element_find(column, body->start, end) : body->start;
+        const char *tag_end = tag ? field_tag_end(tag, end) : NULL;
+
+        values[k].start = NULL;
+        values[k].size = 0;
+        if (tag_end == NULL) continue;
+
+        if (column->attr != NULL)
+            field_attr_find(column, tag, tag_end, &values[k]);
+        else
+            field_text_find(tag_end, end, &values[k]);
+    }
+}
+
+
+void field_table_batch(field_table_t *table, const cache_t *cache)
+{
+    const uint64_t t_encode = trace_begin();
+    field_rows_resize(table, table->n_row + cache->size);
+
+    for (uint32_t i=0; i < cache->size; i++)
+        table->ids[table->n_row + i] = cache->item_list[i].id;
+
+    /* each column is encoded by its own thread, so the dictionaries are not shared */
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (uint32_t k=0; k < table->n_field; k++) {
+        field_column_t *column = &table->columns[k];
+        uint32_t *codes = column->codes + table->n_row;
+
+        for (uint32_t i=0; i < cache->size; i++) {
+            const field_value_t *value = &table->values[(size_t)i * table->n_field + k];
+
+            if (value->start == NULL)
+                codes[i] = 0;
+            else if (memchr(value->start, '&', value->size) == NULL)
+                codes[i] = field_intern(column, value->start, value->size);
+            else {
+                field_decode(value->start, value->size, &column->decoded);
+                codes[i] = field_intern(column, column->decoded.s, (uint32_t)column->decoded.l);
+            }
+        }
+    }
+
+    table->n_row += cache->size;
+    trace_end(t_encode, "encode", cache->size);
+}
+
+
+/* func: write the data and pad it to the multiple of 8 bytes, so that each section is aligned in the file */
+static int field_write(FILE *file_hd, const void *data, size_t size)
+{
+    static const char zero[8] = {0};
+
+    if (size > 0 && fwrite(data, 1, size, file_hd) != size) return -1;
+    if ((size & 7) && fwrite(zero, 1, 8 - (size & 7), file_hd) != 8 - (size & 7)) return -1;
+    return 0;
+}
+
+
+/* func: read the data written by field_write (the padding is skipped) */
+static int field_read(FILE *file_hd, void *data, size_t size)
+{
+    char pad[8];
+
+    if (size > 0 && fread(data, 1, size, file_hd) != size) return -1;
+    if ((size & 7) && fread(pad, 1, 8 - (size & 7), file_hd) != 8 - (size & 7)) return -1;
+    return 0;
+}
+
+
+void field_table_save(field_table_t *table, int checkpoint)
+{
+    char file_name[1024], tmp_name[sizeof(file_name) + 4];
+    field_file_name(table->db_name, checkpoint, file_name, sizeof(file_name));
+    file_tmp_name(tmp_name, sizeof(tmp_name), file_name);
+
+    FILE *file_hd = fopen(tmp_name, "wb");
+    if (file_hd == NULL) {
+        fprintf(stderr, "[Error:%s] failed to open (%s)!\n", __func__, tmp_name);
+        exit(-1);
+    }
+
+    char header[FIELD_HEADER_SIZE] = FIELD_MAGIC;
+    const uint32_t version = FIELD_VERSION, spec_len = (uint32_t)strlen(table->spec);
+    memcpy(header + 8, &version, sizeof(uint32_t));
+    memcpy(header + 12, &table->xml_date, sizeof(uint32_t));
+    memcpy(header + 16, &table->n_row, sizeof(uint32_t));
+    memcpy(header + 20, &table->n_field, sizeof(uint32_t));
+    memcpy(header + 24, &spec_len, sizeof(uint32_t));
+
+    int status = field_write(file_hd, header, FIELD_HEADER_SIZE);
+    status |= field_write(file_hd, table->spec, spec_len);
+    status |= field_write(file_hd, table->ids, (size_t)table->n_row * sizeof(uint32_t));
+
+    for (uint32_t k=0; k < table->n_field; k++) {
+        const field_column_t *column = &table->columns[k];
+        const uint32_t n_entry[2] = {column->n_entry, 0};
+
+        status |= field_write(file_hd, n_entry, sizeof(n_entry));
+        status |= field_write(file_hd, column->offsets, ((size_t)column->n_entry + 1) * sizeof(uint64_t));
+        status |= field_write(file_hd, column->dict.s, column->dict.l);
+        status |= field_write(file_hd, column->codes, (size_t)table->n_row * sizeof(uint32_t));
+    }
+
+    if (file_cache_drop(file_hd) != 0 || fclose(file_hd) != 0 || status != 0 ||
+        file_publish(tmp_name, file_name) != 0) {
+        fprintf(stderr, "[Error:%s] failed to save the field file (%s)!\n", __func__, file_name);
+        exit(-1);
+    }
+
+    /* the rows of the checkpoint are useless after saving */
+    if (!checkpoint) {
+        field_file_name(table->db_name, 1, file_name, sizeof(file_name));
+        unlink(file_name);
+    }
+}
+
+
+/* func: read the field file (or the field file of the checkpoint) next to the database */
+static field_table_t *field_table_read(const char *db_name, int checkpoint)
+{
+    char file_name[1024], header[FIELD_HEADER_SIZE];
+    field_file_name(db_name, checkpoint, file_name, sizeof(file_name));
+
+    FILE *file_hd = fopen(file_name, "rb");
+    if (file_hd == NULL) return NULL;
+
+    if (fread(header, 1, FIELD_HEADER_SIZE, file_hd) != FIELD_HEADER_SIZE || memcmp(header, FIELD_MAGIC, 8) != 0) {
+        fprintf(stderr, "[Error:%s] the file (%s) is not a field file!\n", __func__, file_name);
+        exit(-1);
+    }
+
+    uint32_t version, xml_date, n_row, n_field, spec_len;
+    memcpy(&version, header + 8, sizeof(uint32_t));
+    memcpy(&xml_date, header + 12, sizeof(uint32_t));
+    memcpy(&n_row, header + 16, sizeof(uint32_t));
+    memcpy(&n_field, header + 20, sizeof(uint32_t));
+    memcpy(&spec_len, header + 24, sizeof(uint32_t));
+
+    if (version > FIELD_VERSION) {
+        fprintf(stderr, "[Error:%s] unsupported field file version (%u)!\n", __func__, version);
+        exit(-1);
+    }
+
+    char *spec;
+    err_malloc(spec, spec_len + 1, char);
+    if (spec_len > (1U << 20) || field_read(file_hd, spec, spec_len) != 0) goto _truncated;
+    spec[spec_len] = '\0';
+
+    field_table_t *table = field_table_create(db_name, spec, xml_date);
+    free(spec);
+    if (table->n_field != n_field) goto _truncated;
+
+    field_rows_resize(table, n_row);
+    if (field_read(file_hd, table->ids, (size_t)n_row * sizeof(uint32_t)) != 0) goto _truncated;
+
+    for (uint32_t k=0; k < n_field; k++) {
+        field_column_t *column = &table->columns[k];
+        uint32_t n_entry[2];
+        if (field_read(file_hd, n_entry, sizeof(n_entry)) != 0 || n_entry[0] > n_row) goto _truncated;
+
+        while (column->m_entry < n_entry[0]) column->m_entry <<= 1;
+        err_realloc(column->offsets, column->m_entry + 1, uint64_t);
+        err_realloc(column->tags, column->m_entry, uint32_t);
+        column->n_entry = n_entry[0];
+        if (field_read(file_hd, column->offsets, ((size_t)column->n_entry + 1) * sizeof(uint64_t)) != 0)
+            goto _truncated;
+
+        column->dict.l = column->dict.m = column->offsets[column->n_entry];
+        err_malloc(column->dict.s, column->dict.m + 1, char);
+        if (field_read(file_hd, column->dict.s, column->dict.l) != 0) goto _truncated;
+        if (field_read(file_hd, column->codes, (size_t)n_row * sizeof(uint32_t)) != 0) goto _truncated;
+        for (uint32_t r=0; r < n_row; r++) {
+            if (column->codes[r] > column->n_entry) goto _truncated;
+        }
+
+        uint32_t lookup_size = (column->n_entry << 1) + 1 > FIELD_LOOKUP_SIZE ? (column->n_entry << 1) + 1 : FIELD_LOOKUP_SIZE;
+        kroundup32(lookup_size);
+        field_lookup_rebuild(column, lookup_size);
+    }
+
+    table->n_row = n_row;
+    fclose(file_hd);
+    return table;
+
+    _truncated:
+    fprintf(stderr, "[Error:%s] truncated field file (%s) detected!\n", __func__, file_name);
+    exit(-1);
+}
+
+
+field_table_t *field_table_load(const char *db_name)
+{
+    return field_table_read(db_name, 0);
+}
+
+
+int field_table_merge(field_table_t *table, const field_table_t *other, uint32_t n_row)
+{
+    if (strcmp(table->spec, other->spec) != 0) return -1;
+
+    field_rows_resize(table, table->n_row + n_row);
+    memcpy(table->ids + table->n_row, other->ids, (size_t)n_row * sizeof(uint32_t));
+
+    /* the entries of the other dictionary are encoded again at their first row, so the order is kept */
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (uint32_t k=0; k < table->n_field; k++) {
+        field_column_t *column = &table->columns[k];
+        const field_column_t *from = &other->columns[k];
+        uint32_t *map;
+
+        err_malloc(map, from->n_entry + 1, uint32_t);
+        memset(map, 0xFF, (from->n_entry + 1) * sizeof(uint32_t));
+        map[0] = 0;
+
+        for (uint32_t r=0; r < n_row; r++) {
+            const uint32_t e = from->codes[r];
+
+            if (map[e] == UINT32_MAX)
+                map[e] = field_intern(column, from->dict.s + from->offsets[e-1], (uint32_t)(from->offsets[e] - from->offsets[e-1]));
+            column->codes[table->n_row + r] = map[e];
+        }
+        free(map);
+    }
+
+    table->n_row += n_row;
+    return 0;
+}
+
+
+void field_table_close(field_table_t *table)
+{
+    if (table == NULL) return;
+
+    for (uint32_t k=0; k < table->n_field; k++) {
+        field_column_t *column = &table->columns[k];
+
+        free(column->name);
+        free(column->tag);
+        free(column->attr);
+        free(column->codes);
+        free(column->offsets);
+        free(column->tags);
+        free(column->lookup);
+        k_strfree(&column->dict);
+        k_strfree(&column->decoded);
+    }
+
+    free(table->columns);
+    free(table->ids);
+    free(table->values);
+    free(table->spec);
+    free(table->db_name);
+    free(table);
+}
@@ -0,0 +1,171 @@
+/*************************************************************************
+    > File Name: field_extract.h
+    > Author: xlzh
+    > Mail: xiaolongzhang2015@163.com
+    > Created Time: 2025年12月31 10时06分52秒
+ ************************************************************************/
+
+#ifndef INSDCXMLPARSER_FIELD_EXTRACT_H
+#define INSDCXMLPARSER_FIELD_EXTRACT_H
+
+#include <stdint.h>
+#include "utils.h"
+#include "stream_reader.h"
+
+/* the magic string and the format version of the field file */
+#define FIELD_MAGIC "INSDCFC"
+#define FIELD_VERSION 1
+
+/* the suffix of the field file (e.g. biosample.db.fcol) */
+#define FIELD_SUFFIX ".fcol"
+
+/* the maximum number of the fields extracted */
+#define FIELD_MAX 64
+
+/* the fields of BioSample used by default, e.g. --fields default */
+#define FIELD_SAMPLE_DEFAULT "accession=@accession,taxonomy_id=Organism@taxonomy_id," \
+                             "organism=Organism@taxonomy_name,publication_date=@publication_date," \
+                             "last_update=@last_update"
+
+
+/*! @typedef field_value_t
+  @abstract the value of a field in the data body (not decoded, valid until the next batch)
+  @field  start             the start of the value in the buffer (NULL: missing)
+  @field  size              the size of the value
+ */
+typedef struct {
+    const char *start;
+    uint32_t size;
+} field_value_t;
+
+
+/*! @typedef field_column_t
+  @abstract the column of a field with its dictionary of distinct strings
+  @field  name              the name of the column (e.g. taxonomy_id)
+  @field  tag               the element with the value, e.g. Organism (NULL: the start tag of the record)
+  @field  attr              the attribute with the value, e.g. taxonomy_id (NULL: the text of the element)
+  @field  tag_len           the length of the tag
+  @field  attr_len          the length of the attribute
+  @field  codes             the code of each row (0: missing, k: the entry k-1 of the dictionary)
+  @field  dict              the bytes of the entries of the dictionary (in the order of the first appearance)
+  @field  offsets           the offset of each entry in the dict (n_entry + 1)
+  @field  tags              the high 32 bits of the hash of each entry
+  @field  n_entry           the number of entries in the dictionary
+  @field  m_entry           the capacity of the offsets and tags
+  @field  lookup            the open addressing table of the codes by hash (at most half full)
+  @field  lookup_mask       the size of the lookup table - 1
+  @field  decoded           the value with its character references decoded
+ */
+typedef struct {
+    char *name;
+    char *tag;
+    char *attr;
+    uint32_t tag_len;
+    uint32_t attr_len;
+    uint32_t *codes;
+    kstring_t dict;
+    uint64_t *offsets;
+    uint32_t *tags;
+    uint32_t n_entry;
+    uint32_t m_entry;
+    uint32_t *lookup;
+    uint32_t lookup_mask;
+    kstring_t decoded;
+} field_column_t;
+
+
+/*! @typedef field_table_t
+  @abstract the columns of the fields extracted from each data body (one row per data body)
+  @field  xml_date          the released date of the xml file
+  @field  spec              the fields extracted (name=tag@attr, separated by comma)
+  @field  n_field           the number of the columns
+  @field  columns           the columns of the fields
+  @field  n_row             the number of rows
+  @field  m_row             the capacity of the rows
+  @field  ids               the id of each row (in the order of the xml file)
+  @field  values            the values of the current batch (n_field for each data body)
+  @field  m_value           the capacity of the values
+  @field  db_name           the database file name, which the field file is next to
+ */
+typedef struct {
+    uint32_t xml_date;
+    char *spec;
+    uint32_t n_field;
+    field_column_t *columns;
+    uint32_t n_row;
+    uint32_t m_row;
+    uint32_t *ids;
+    field_value_t *values;
+    uint32_t m_value;
+    char *db_name;
+} field_table_t;
+
+
+/*! @function: create the field table next to the database
+  @param  db_name            the database file name
+  @param  spec               the fields to extract, separated by comma, each is [name=]@attr, [name=]tag or
+                             [name=]tag@attr ("default": FIELD_SAMPLE_DEFAULT)
+  @param  xml_date           the released date of the xml file
+  @param  n_resume           the number of items processed before the latest checkpoint (0: start from the first)
+  @return                    the field table (exit if the spec is invalid)
+ */
+field_table_t *field_table_open(const char *db_name, const char *spec, uint32_t xml_date, uint64_t n_resume);
+
+
+/*! @function: make sure the values of the batch are allocated (called before field_extract)
+  @param  table              the field table
+  @param  n                  the number of data bodies in the batch
+  @return
+ */
+void field_table_reserve(field_table_t *table, uint32_t n);
+
+
+/*! @function: find the values of the fields in the data body (thread safe for different i)
+  @param  table              the field table
+  @param  i                  the index of the data body in the batch
+  @param  body               the data body
+  @return
+ */
+void field_extract(field_table_t *table, uint32_t i, const body_t *body);
+
+
+/*! @function: append the rows of the batch, the values are encoded by the dictionaries in parallel
+  @param  table              the field table
+  @param  cache              the cache with the data bodies extracted
+  @return
+ */
+void field_table_batch(field_table_t *table, const cache_t *cache);
+
+
+/*! @function: save the field table (write to a temporary file then rename)
+  @param  table              the field table
+  @param  checkpoint         [0|1] 1: save the table for the checkpoint (<fields>.ckpt)
+  @return
+ */
+void field_table_save(field_table_t *table, int checkpoint);
+
+
+/*! @function: read the field file next to the database
+  @param  db_name            the database file name
+  @return                    the field table (NULL: the field file is not existed)
+ */
+field_table_t *field_table_load(const char *db_name);
+
+
+/*! @function: append the first rows of another table with the same fields
+  @param  table              the field table
+  @param  other              the table appended
+  @param  n_row              the number of rows appended (at most other->n_row)
+  @return                    0: success, -1: the fields are different
+ */
+int field_table_merge(field_table_t *table, const field_table_t *other, uint32_t n_row);
+
+
+/*! @function: close the field table and release the memory
+  @param  table              the field table
+  @return
+ */
+void field_table_close(field_table_t *table);
+
+
+#endif //INSDCXMLPARSER_FIELD_EXTRACT_H
@@ -0,0 +1,502 @@
+/*************************************************************************
+    > File Name: fingerprint.c
+    > Author: xlzh
+    > Mail: xiaolongzhang2015@163.com
+    > Created Time: 2025年12月28 14时05分33秒
+ ************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <omp.h>
+
+#include "utils.h"
+#include "fingerprint.h"
+#include "trace.h"
+
+
+/* the size of the header: magic[8], version, xml_date, n_chunk, reserved, ids_size, root */
+#define FINGERPRINT_HEADER_SIZE 40
+
+/* the primes of the chunk hash lanes */
+#define CHUNK_PRIME1 0x9E3779B185EBCA87ULL
+#define CHUNK_PRIME2 0xC2B2AE3D27D4EB4FULL
+#define CHUNK_PRIME3 0x165667B19E3779F9ULL
+
+
+/* the random value of each byte rolled into the cut hash (filled by fingerprint_open) */
+static uint64_t gear_table[256];
+
+
+static inline uint64_t rotl64(uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+
+static inline uint64_t chunk_round(uint64_t acc, uint64_t word)
+{
+    acc += word * CHUNK_PRIME2;
+    return rotl64(acc, 31) * CHUNK_PRIME1;
+}
+
+
+static inline uint64_t chunk_avalanche(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= CHUNK_PRIME2;
+    h ^= h >> 29;
+    h *= CHUNK_PRIME3;
+    return h ^ (h >> 32);
+}
+
+
+static void chunk_hash_init(chunk_hash_t *state)
+{
+    state->lane[0] = CHUNK_PRIME1 + CHUNK_PRIME2;
+    state->lane[1] = CHUNK_PRIME2;
+    state->lane[2] = 0;
+    state->lane[3] = 0 - CHUNK_PRIME1;
+    state->length = 0;
+    state->n_tail = 0;
+}
+
+
+static inline void chunk_hash_block(chunk_hash_t *state, const uint8_t *block)
+{
+    uint64_t word[4];
+    memcpy(word, block, 32);
+
+    for (int k=0; k < 4; k++)
+        state->lane[k] = chunk_round(state->lane[k], word[k]);
+}
+
+
+/* func: hash the bytes in 32-byte blocks, the partial block is kept so that the bytes could be fed in any pieces */
+static void chunk_hash_update(chunk_hash_t *state, const uint8_t *data, size_t size)
+{
+    state->length += size;
+
+    if (state->n_tail) {
+        const size_t n = 32 - state->n_tail < size ? 32 - state->n_tail : size;
+        memcpy(state->tail + state->n_tail, data, n);
+        state->n_tail += (uint32_t)n;
+        data += n;
+        size -= n;
+
+        if (state->n_tail < 32) return;
+        chunk_hash_block(state, state->tail);
+        state->n_tail = 0;
+    }
+
+    for (; size >= 32; data += 32, size -= 32)
+        chunk_hash_block(state, data);
+
+    memcpy(state->tail, data, size);
+    state->n_tail = (uint32_t)size;
+}
+
+
+static void chunk_hash_final(const chunk_hash_t *state, uint64_t hash[2])
+{
+    const uint64_t *lane = state->lane;
+    uint64_t h = rotl64(lane[0], 1) + rotl64(lane[1], 7) + rotl64(lane[2], 12) + rotl64(lane[3], 18);
+    uint64_t g = lane[0] ^ rotl64(lane[1], 29) ^ rotl64(lane[2], 41) ^ rotl64(lane[3], 53);
+
+    /* the tail bytes are padded by zero, the length tells the padding apart */
+    uint64_t word[4] = {0, 0, 0, 0};
+    memcpy(word, state->tail, state->n_tail);
+    for (int k=0; k < 4; k++) {
+        h = chunk_round(h, word[k]);
+        g = chunk_round(g ^ CHUNK_PRIME3, word[k]);
+    }
+
+    hash[0] = chunk_avalanche(h ^ state->length);
+    hash[1] = chunk_avalanche(g + state->length * CHUNK_PRIME1);
+}
+
+
+/* func: the hash of the leading bytes of the data body, which decides the chunk boundary before it */
+static inline uint64_t chunk_cut_hash(const char *start, uint32_t size)
+{
+    const uint8_t *data = (const uint8_t *)start;
+    const uint32_t n = size < FINGERPRINT_WINDOW ? size : FINGERPRINT_WINDOW;
+    uint64_t h = 0;
+
+    for (uint32_t i=0; i < n; i++)
+        h = rotl64(h, 1) ^ gear_table[data[i]];
+
+    return h * CHUNK_PRIME1;
+}
+
+
+static void ids_append(kstring_t *ids, const void *data, size_t size)
+{
+    if (ids->l + size > ids->m) {
+        while (ids->l + size > ids->m) ids->m = ids->m ? ids->m << 1 : 65536;
+        err_realloc(ids->s, ids->m, char);
+    }
+
+    memcpy(ids->s + ids->l, data, size);
+    ids->l += size;
+}
+
+
+/* func: append the id as the varint of the zigzag delta to the previous id of the chunk */
+static void ids_put(kstring_t *ids, uint32_t id, uint32_t last_id)
+{
+    const int64_t delta = (int64_t)id - (int64_t)last_id;
+    uint64_t zigzag = ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63);
+    uint8_t buf[10];
+    size_t n = 0;
+
+    while (zigzag >= 0x80) {
+        buf[n++] = (uint8_t)(zigzag | 0x80);
+        zigzag >>= 7;
+    }
+    buf[n++] = (uint8_t)zigzag;
+
+    ids_append(ids, buf, n);
+}
+
+
+static inline const uint8_t *ids_get(const uint8_t *p, uint32_t *id)
+{
+    uint64_t zigzag = 0;
+    int shift = 0;
+
+    for (; *p & 0x80; p++, shift += 7)
+        zigzag |= (uint64_t)(*p & 0x7F) << shift;
+    zigzag |= (uint64_t)*p++ << shift;
+
+    *id += (uint32_t)(int64_t)((zigzag >> 1) ^ (0 - (zigzag & 1)));
+    return p;
+}
+
+
+static void fingerprint_name(const char *db_name, char *name, size_t size)
+{
+    snprintf(name, size, "%s%s", db_name, FINGERPRINT_SUFFIX);
+}
+
+
+/* func: start a new chunk at the offset of the xml file */
+static void fingerprint_chunk_begin(fingerprint_t *fingerprint, uint64_t offset)
+{
+    fingerprint->chunk_start = offset;
+    fingerprint->fed = offset;
+    fingerprint->id_start = fingerprint->ids.l;
+    fingerprint->n_id = 0;
+    fingerprint->last_id = 0;
+    chunk_hash_init(&fingerprint->hash);
+}
+
+
+static chunk_t *fingerprint_chunk_push(fingerprint_t *fingerprint)
+{
+    if (fingerprint->n_chunk == fingerprint->m_chunk) {
+        fingerprint->m_chunk = fingerprint->m_chunk ? fingerprint->m_chunk << 1 : 1024;
+        err_realloc(fingerprint->chunks, fingerprint->m_chunk, chunk_t);
+    }
+
+    return &fingerprint->chunks[fingerprint->n_chunk++];
+}
+
+
+/* func: close the current chunk [chunk_start, fed), return its index in the previous release (-1: not found) */
+static int64_t fingerprint_chunk_close(fingerprint_t *fingerprint)
+{
+    chunk_t *chunk = fingerprint_chunk_push(fingerprint);
+    chunk_hash_final(&fingerprint->hash, chunk->hash);
+    chunk->size = (uint32_t)(fingerprint->fed - fingerprint->chunk_start);
+    chunk->n_id = fingerprint->n_id;
+    chunk->id_offset = fingerprint->id_start;
+
+    if (fingerprint->n_prev == 0) return -1;
+
+    for (uint32_t k=(uint32_t)chunk->hash[0] & fingerprint->lookup_mask; fingerprint->lookup[k];
+         k = (k + 1) & fingerprint->lookup_mask) {
+        const chunk_t *prev = &fingerprint->prev[fingerprint->lookup[k] - 1];
+
+        if (prev->hash[0] == chunk->hash[0] && prev->hash[1] == chunk->hash[1] && prev->size == chunk->size)
+            return fingerprint->lookup[k] - 1;
+    }
+
+    return -1;
+}
+
+
+/* func: load the chunks of the previous release, -1 if they do not belong to the table of the database */
+static int fingerprint_load(fingerprint_t *fingerprint, const char *file_name, const database_t *database)
+{
+    FILE *file_hd = fopen(file_name, "rb");
+    if (file_hd == NULL) return -1;
+
+    char header[FINGERPRINT_HEADER_SIZE];
+    uint32_t version, xml_date, n_chunk;
+    uint64_t ids_size, root;
+
+    if (fread(header, 1, FINGERPRINT_HEADER_SIZE, file_hd) != FINGERPRINT_HEADER_SIZE ||
+        memcmp(header, FINGERPRINT_MAGIC, 8) != 0) {
+        fprintf(stderr, "[Error:%s] the file (%s) is not a fingerprint file!\n", __func__, file_name);
+        exit(-1);
+    }
+
+    memcpy(&version, header + 8, sizeof(uint32_t));
+    memcpy(&xml_date, header + 12, sizeof(uint32_t));
+    memcpy(&n_chunk, header + 16, sizeof(uint32_t));
+    memcpy(&ids_size, header + 24, sizeof(uint64_t));
+    memcpy(&root, header + 32, sizeof(uint64_t));
+
+    /* the fingerprints of another release (e.g. the database is compared without them) are useless */
+    if (version != FINGERPRINT_VERSION || xml_date != database->db_date || n_chunk == 0 ||
+        root != database_tree_update(database)) {
+        fclose(file_hd);
+        return -1;
+    }
+
+    err_malloc(fingerprint->prev, n_chunk, chunk_t);
+    err_malloc(fingerprint->prev_ids, ids_size + 1, uint8_t);
+
+    if (fread(fingerprint->prev, sizeof(chunk_t), n_chunk, file_hd) != n_chunk ||
+        fread(fingerprint->prev_ids, 1, ids_size, file_hd) != ids_size) {
+        fprintf(stderr, "[Error:%s] truncated fingerprint file (%s) detected!\n", __func__, file_name);
+        exit(-1);
+    }
+    fclose(file_hd);
+
+    /* the lookup table of the chunks by hash (at most half full) */
+    uint32_t lookup_size = n_chunk << 1;
+    kroundup32(lookup_size);
+    fingerprint->lookup_mask = lookup_size - 1;
+    err_calloc(fingerprint->lookup, lookup_size, uint32_t);
+
+    for (uint32_t i=0; i < n_chunk; i++) {
+        uint32_t k = (uint32_t)fingerprint->prev[i].hash[0] & fingerprint->lookup_mask;
+        while (fingerprint->lookup[k]) k = (k + 1) & fingerprint->lookup_mask;
+        fingerprint->lookup[k] = i + 1;
+    }
+
+    fingerprint->n_prev = n_chunk;
+    fingerprint->prev_ids_size = ids_size;
+    return 0;
+}
+
+
+fingerprint_t *fingerprint_open(const char *db_name, const database_t *database, int skip)
+{
+    fingerprint_t *fingerprint;
+    err_calloc(fingerprint, 1, fingerprint_t);
+    fingerprint_chunk_begin(fingerprint, 0);
+
+    /* the same gear table for every release (splitmix64 of a fixed seed) */
+    uint64_t seed = 0x494E534443434446ULL;
+    for (int i=0; i < 256; i++) {
+        uint64_t z = (seed += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        gear_table[i] = z ^ (z >> 31);
+    }
+
+    char file_name[1024];
+    fingerprint_name(db_name, file_name, sizeof(file_name));
+
+    if (skip && fingerprint_load(fingerprint, file_name, database) == 0) {
+        fingerprint->aligned = 1;  /* the first chunk starts at the start of the file */
+        fprintf(stderr, "[*] fingerprints of the previous release: %u chunks\n", fingerprint->n_prev);
+    }
+
+    return fingerprint;
+}
+
+
+int64_t fingerprint_match(cache_t *cache)
+{
+    fingerprint_t *fingerprint = cache->fingerprint;
+    buffer_t *buffer = &cache->buffer;
+    const chunk_t *chunk = &fingerprint->prev[fingerprint->next];
+
+    /* wait for the whole chunk, unless the stream ends or the chunk could never fit in the buffer */
+    if (buffer->size < chunk->size) {
+        if (!cache->eof && chunk->size <= (buffer->capacity >> 1)) return -1;
+        fingerprint->aligned = 0;
+        return 0;
+    }
+
+    chunk_hash_t state;
+    uint64_t hash[2];
+    chunk_hash_init(&state);
+    chunk_hash_update(&state, (const uint8_t *)buffer->front, chunk->size);
+    chunk_hash_final(&state, hash);
+
+    if (hash[0] != chunk->hash[0] || hash[1] != chunk->hash[1]) {
+        fingerprint->aligned = 0;  /* scan the records until a chunk of the previous release is closed again */
+        return 0;
+    }
+
+    /* the chunk is kept for the next release as it is */
+    chunk_t *copy = fingerprint_chunk_push(fingerprint);
+    *copy = *chunk;
+    copy->id_offset = fingerprint->ids.l;
+
+    const uint64_t ids_end = fingerprint->next + 1 < fingerprint->n_prev ?
+                             chunk[1].id_offset : fingerprint->prev_ids_size;
+    ids_append(&fingerprint->ids, fingerprint->prev_ids + chunk->id_offset, ids_end - chunk->id_offset);
+
+    if (fingerprint->n_skip == fingerprint->m_skip) {
+        fingerprint->m_skip = fingerprint->m_skip ? fingerprint->m_skip << 1 : 256;
+        err_realloc(fingerprint->skipped, fingerprint->m_skip, uint32_t);
+    }
+    fingerprint->skipped[fingerprint->n_skip++] = fingerprint->next;
+    fingerprint->n_skip_total++;
+    fingerprint->n_skip_byte += chunk->size;
+
+    buffer->front += chunk->size;
+    buffer->size -= chunk->size;
+    fingerprint_chunk_begin(fingerprint, fingerprint->chunk_start + chunk->size);
+
+    if (++fingerprint->next == fingerprint->n_prev) fingerprint->aligned = 0;
+    return chunk->size;
+}
+
+
+void fingerprint_feed(cache_t *cache, const char *end)
+{
+    fingerprint_t *fingerprint = cache->fingerprint;
+    const uint64_t offset = stream_cache_offset(cache, end);
+    if (offset <= fingerprint->fed) return;
+
+    const size_t size = (size_t)(offset - fingerprint->fed);
+    chunk_hash_update(&fingerprint->hash, (const uint8_t *)end - size, size);
+    fingerprint->fed = offset;
+}
+
+
+int fingerprint_boundary(cache_t *cache, const char *start, uint32_t size)
+{
+    fingerprint_t *fingerprint = cache->fingerprint;
+    const uint64_t offset = stream_cache_offset(cache, start);
+    const uint64_t length = offset - fingerprint->chunk_start;
+
+    /* the same records start the chunks in every release, whatever the records before them are */
+    if (length < FINGERPRINT_CHUNK_MIN) return 0;
+    if (length < FINGERPRINT_CHUNK_MAX && (chunk_cut_hash(start, size) >> 44) >= size) return 0;
+
+    fingerprint_feed(cache, start);
+    const int64_t k = fingerprint_chunk_close(fingerprint);
+    fingerprint_chunk_begin(fingerprint, offset);
+
+    /* the previous release continues from here (the chunk after the closed one is matched next) */
+    if (k < 0 || (uint32_t)k + 1 == fingerprint->n_prev) return 0;
+
+    fingerprint->aligned = 1;
+    fingerprint->next = (uint32_t)k + 1;
+    return 1;
+}
+
+
+void fingerprint_body(cache_t *cache, const body_t *body)
+{
+    fingerprint_t *fingerprint = cache->fingerprint;
+
+    fingerprint_feed(cache, body->start + body->size);
+    ids_put(&fingerprint->ids, body->id, fingerprint->last_id);
+    fingerprint->last_id = body->id;
+    fingerprint->n_id++;
+}
+
+
+void fingerprint_finish(cache_t *cache)
+{
+    fingerprint_t *fingerprint = cache->fingerprint;
+    buffer_t *buffer = &cache->buffer;
+
+    /* the last chunk runs to the end of the stream */
+    fingerprint_feed(cache, buffer->front + buffer->size);
+    if (fingerprint->fed > fingerprint->chunk_start || fingerprint->n_id > 0)
+        fingerprint_chunk_close(fingerprint);
+
+    fingerprint_chunk_begin(fingerprint, fingerprint->fed);
+    fingerprint->aligned = 0;
+}
+
+
+uint64_t fingerprint_apply(fingerprint_t *fingerprint, const database_t *database)
+{
+    if (fingerprint->n_skip == 0) return 0;
+
+    const uint64_t t_skip = trace_begin();
+    uint64_t n_item = 0;
+
+    #pragma omp parallel for schedule(dynamic, 1) reduction(+:n_item)
+    for (uint32_t i=0; i < fingerprint->n_skip; i++) {
+        const chunk_t *chunk = &fingerprint->prev[fingerprint->skipped[i]];
+        const uint8_t *p = fingerprint->prev_ids + chunk->id_offset;
+        uint32_t id = 0;
+
+        /* the same data body (with the same hash in the table) as the previous release */
+        for (uint32_t k=0; k < chunk->n_id; k++) {
+            p = ids_get(p, &id);
+            if (id < database->capacity && database_flag(database, id) == 1)
+                database_flag(database, id) = 2;
+        }
+        n_item += chunk->n_id;
+    }
+
+    fingerprint->n_skip_id += n_item;
+    fingerprint->n_skip = 0;
+    trace_end(t_skip, "skip", n_item);
+
+    return n_item;
+}
+
+
+void fingerprint_save(fingerprint_t *fingerprint, const char *db_name, const database_t *database)
+{
+    char file_name[1024], tmp_name[sizeof(file_name) + 4];
+    fingerprint_name(db_name, file_name, sizeof(file_name));
+    file_tmp_name(tmp_name, sizeof(tmp_name), file_name);
+
+    FILE *file_hd = fopen(tmp_name, "wb");
+    if (file_hd == NULL) {
+        fprintf(stderr, "[Error:%s] failed to open (%s)!\n", __func__, tmp_name);
+        exit(-1);
+    }
+
+    /* the chunks are only used with the table saved from the same xml file */
+    char magic[8] = FINGERPRINT_MAGIC;
+    const uint32_t version = FINGERPRINT_VERSION, reserved = 0;
+    const uint64_t ids_size = fingerprint->ids.l, root = database_tree_update(database);
+    size_t n_item = 0;
+
+    n_item += fwrite(magic, sizeof(char), 8, file_hd);
+    n_item += fwrite(&version, sizeof(uint32_t), 1, file_hd);
+    n_item += fwrite(&database->db_date, sizeof(uint32_t), 1, file_hd);
+    n_item += fwrite(&fingerprint->n_chunk, sizeof(uint32_t), 1, file_hd);
+    n_item += fwrite(&reserved, sizeof(uint32_t), 1, file_hd);
+    n_item += fwrite(&ids_size, sizeof(uint64_t), 1, file_hd);
+    n_item += fwrite(&root, sizeof(uint64_t), 1, file_hd);
+    n_item += fwrite(fingerprint->chunks, sizeof(chunk_t), fingerprint->n_chunk, file_hd);
+    n_item += fwrite(fingerprint->ids.s, sizeof(char), ids_size, file_hd);
+
+    if (file_cache_drop(file_hd) != 0 || fclose(file_hd) != 0 ||
+        n_item != 14 + (size_t)fingerprint->n_chunk + ids_size || file_publish(tmp_name, file_name) != 0) {
+        fprintf(stderr, "[Error:%s] failed to save the fingerprints (%s)!\n", __func__, file_name);
+        exit(-1);
+    }
+}
+
+
+void fingerprint_close(fingerprint_t *fingerprint)
+{
+    if (fingerprint == NULL) return;
+
+    free(fingerprint->prev);
+    free(fingerprint->prev_ids);
+    free(fingerprint->lookup);
+    free(fingerprint->chunks);
+    free(fingerprint->skipped);
+    k_strfree(&fingerprint->ids);
+    free(fingerprint);
+}
@@ -0,0 +1,188 @@
+/*************************************************************************
+    > File Name: fingerprint.h
+    > Author: xlzh
+    > Mail: xiaolongzhang2015@163.com
+    > Created Time: 2025年12月28 14时05分33秒
+ ************************************************************************/
+
+#ifndef INSDCXMLPARSER_FINGERPRINT_H
+#define INSDCXMLPARSER_FINGERPRINT_H
+
+#include <stdint.h>
+#include "utils.h"
+#include "stream_reader.h"
+#include "database.h"
+
+/* the magic string and the format version of the fingerprint file */
+#define FINGERPRINT_MAGIC "INSDCCF"
+#define FINGERPRINT_VERSION 1
+
+/* the suffix of the fingerprint file (e.g. biosample.db.cdc) */
+#define FINGERPRINT_SUFFIX ".cdc"
+
+/* the chunks end before a data body, with the probability of its size / FINGERPRINT_CHUNK_AVG (about 1MB each),
+ * the chunk is at least FINGERPRINT_CHUNK_MIN and at most FINGERPRINT_CHUNK_MAX bytes (excluding the last body) */
+#define FINGERPRINT_CHUNK_MIN (256U << 10)
+#define FINGERPRINT_CHUNK_AVG (1U << 20)
+#define FINGERPRINT_CHUNK_MAX (16U << 20)
+
+/* the bytes at the start of the data body rolled into the cut hash */
+#define FINGERPRINT_WINDOW 256
+
+
+/*! @typedef chunk_t
+  @abstract the fingerprint of a chunk of the xml file
+  @field  hash              the 128-bit hash of the bytes of the chunk
+  @field  id_offset         the offset of the ids in the id list (varint of the zigzag delta)
+  @field  size              the bytes of the chunk
+  @field  n_id              the number of data bodies in the chunk
+ */
+typedef struct {
+    uint64_t hash[2];
+    uint64_t id_offset;
+    uint32_t size;
+    uint32_t n_id;
+} chunk_t;
+
+
+/*! @typedef chunk_hash_t
+  @abstract the streaming state of the chunk hash (4 lanes of 8 bytes)
+ */
+typedef struct {
+    uint64_t lane[4];
+    uint64_t length;
+    uint8_t tail[32];
+    uint32_t n_tail;
+} chunk_hash_t;
+
+
+/*! @typedef fingerprint_t
+  @abstract the chunks of the previous release (to skip) and the chunks of the current xml file (to save)
+  @field  n_prev            the number of chunks of the previous release (0: nothing to skip)
+  @field  prev              the chunks of the previous release
+  @field  prev_ids          the id list of the previous chunks
+  @field  prev_ids_size     the bytes of the id list of the previous chunks
+  @field  lookup            the hash table of the previous chunks (index + 1, by hash[0])
+  @field  lookup_mask       the size of the lookup table - 1
+  @field  aligned           [0|1] 1: the front of the buffer is the start of the previous chunk (next)
+  @field  next              the previous chunk expected at the front
+  @field  n_chunk           the number of chunks of the current xml file
+  @field  m_chunk           the capacity of chunks
+  @field  chunks            the chunks of the current xml file
+  @field  ids               the id list of the current chunks
+  @field  chunk_start       the offset of the current chunk in the xml file
+  @field  fed               the offset of the bytes hashed into the current chunk
+  @field  id_start          the offset of the ids of the current chunk in the id list
+  @field  n_id              the number of data bodies in the current chunk
+  @field  last_id           the previous id in the current chunk (for the delta)
+  @field  hash              the hash state of the current chunk
+  @field  n_skip            the number of chunks skipped in the current batch
+  @field  m_skip            the capacity of skipped
+  @field  skipped           the index of the previous chunks skipped in the current batch
+  @field  n_skip_total      the number of chunks skipped in total
+  @field  n_skip_byte       the bytes skipped in total
+  @field  n_skip_id         the number of data bodies skipped in total
+ */
+typedef struct fingerprint_t {
+    uint32_t n_prev;
+    chunk_t *prev;
+    uint8_t *prev_ids;
+    uint64_t prev_ids_size;
+    uint32_t *lookup;
+    uint32_t lookup_mask;
+    int aligned;
+    uint32_t next;
+
+    uint32_t n_chunk;
+    uint32_t m_chunk;
+    chunk_t *chunks;
+    kstring_t ids;
+    uint64_t chunk_start;
+    uint64_t fed;
+    uint64_t id_start;
+    uint32_t n_id;
+    uint32_t last_id;
+    chunk_hash_t hash;
+
+    uint32_t n_skip;
+    uint32_t m_skip;
+    uint32_t *skipped;
+    uint64_t n_skip_total;
+    uint64_t n_skip_byte;
+    uint64_t n_skip_id;
+} fingerprint_t;
+
+
+/*! @function: start to fingerprint the xml file, and load the chunks of the previous release to skip
+  @param  db_name            the database file name, which the fingerprint file is next to
+  @param  database           the database (the chunks are only skipped if they belong to its table)
+  @param  skip               [0|1] 1: skip the unchanged chunks of the previous release
+  @return                    the fingerprint object
+ */
+fingerprint_t *fingerprint_open(const char *db_name, const database_t *database, int skip);
+
+
+/*! @function: skip the previous chunks matched at the front of the buffer (only if aligned)
+  @param  cache              the cache object with the fingerprint
+  @return                    the bytes skipped (0: the chunk is changed, -1: more data is needed)
+ */
+int64_t fingerprint_match(cache_t *cache);
+
+
+/*! @function: hash the bytes before the end into the current chunk (e.g. the data skipped before the data body)
+  @param  cache              the cache object with the fingerprint
+  @param  end                the end of the bytes in the buffer
+  @return
+ */
+void fingerprint_feed(cache_t *cache, const char *end);
+
+
+/*! @function: decide whether a chunk ends before the data body, and look up the closed chunk
+  @param  cache              the cache object with the fingerprint
+  @param  start              the start of the data body (the front of the buffer)
+  @param  size               the size of the data body
+  @return                    1: the closed chunk is found in the previous release (aligned), 0: otherwise
+ */
+int fingerprint_boundary(cache_t *cache, const char *start, uint32_t size);
+
+
+/*! @function: add the data body into the current chunk
+  @param  cache              the cache object with the fingerprint
+  @param  body               the data body parsed
+  @return
+ */
+void fingerprint_body(cache_t *cache, const body_t *body);
+
+
+/*! @function: close the last chunk with the remaining data at the end of the stream
+  @param  cache              the cache object with the fingerprint
+  @return
+ */
+void fingerprint_finish(cache_t *cache);
+
+
+/*! @function: mark the data bodies of the chunks skipped in the batch as unchanged (flag 1 -> 2)
+  @param  fingerprint        the fingerprint object
+  @param  database           the database compared
+  @return                    the number of data bodies skipped in the batch
+ */
+uint64_t fingerprint_apply(fingerprint_t *fingerprint, const database_t *database);
+
+
+/*! @function: save the chunks of the xml file for the next release (write to a temporary file then rename)
+  @param  fingerprint        the fingerprint object
+  @param  db_name            the database file name, which the fingerprint file is next to
+  @param  database           the saved database, which the chunks belong to
+  @return
+ */
+void fingerprint_save(fingerprint_t *fingerprint, const char *db_name, const database_t *database);
+
+
+/*! @function: close the fingerprint and release the memory
+  @param  fingerprint        the fingerprint object
+  @return
+ */
+void fingerprint_close(fingerprint_t *fingerprint);
+
+
+#endif //INSDCXMLPARSER_FINGERPRINT_H
@@ -0,0 +1,415 @@
+/*************************************************************************
+    > File Name: history.c
+    > Author: xlzh
+    > Mail: xiaolongzhang2015@163.com
+    > Created Time: 2025年12月15 09时26分12秒
+ ************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "utils.h"
+#include "history.h"
+
+
+#define history_memory_resize(_history, _n) do {                                   \
+    if ((_history)->capacity < (_n)) {                                             \
+        (_history)->capacity = (_n);                                               \
+        err_realloc((_history)->ids, (_history)->capacity, uint32_t);              \
+        err_realloc((_history)->from, (_history)->capacity, uint16_t);             \
+        err_realloc((_history)->to, (_history)->capacity, uint16_t);               \
+        err_realloc((_history)->values, (_history)->capacity<<4, uint8_t);         \
+    }                                                                              \
+} while(0)
+
+
+#define history_push(_history, _id, _from, _to, _value) do {                       \
+    uint64_t _k = (_history)->size++;                                              \
+    (_history)->ids[_k] = (_id);                                                   \
+    (_history)->from[_k] = (_from);                                                \
+    (_history)->to[_k] = (_to);                                                    \
+    memcpy((_history)->values + (_k<<4), _value, 16 * sizeof(uint8_t));            \
+} while(0)
+
+
+/* append an unsigned integer to the kstring with LEB128 encoding */
+static void varint_put(kstring_t *kstr, uint64_t value)
+{
+    if (kstr->l + 10 > kstr->m) {
+        kstr->m = kstr->m ? kstr->m << 1 : 65536;
+        err_realloc(kstr->s, kstr->m, char);
+    }
+
+    while (value >= 0x80) {
+        kstr->s[kstr->l++] = (char)(value | 0x80);
+        value >>= 7;
+    }
+    kstr->s[kstr->l++] = (char)value;
+}
+
+
+/* decode one LEB128 integer, return NULL if the column is truncated */
+static const uint8_t *varint_get(const uint8_t *p, const uint8_t *end, uint64_t *value)
+{
+    uint64_t v = 0;
+
+    for (int shift=0; p < end && shift < 64; shift += 7) {
+        v |= (uint64_t)(*p & 0x7F) << shift;
+        if ((*p++ & 0x80) == 0) {
+            *value = v;
+            return p;
+        }
+    }
+    return NULL;
+}
+
+
+history_t *history_load(char *file_name)
+{
+    history_t *history;
+    err_calloc(history, 1, history_t);
+
+    FILE *file_hd = fopen(file_name, "rb");
+    if (file_hd == NULL)  /* the store is not existed yet */
+        return history;
+
+    /* read the header: magic, version, db_type, n_dates and number of versions */
+    char magic[8];
+    uint32_t version;
+
+    if (fread(magic, sizeof(char), 8, file_hd) != 8) goto _truncated_error;
+    if (memcmp(magic, HISTORY_MAGIC, 8) != 0) {
+        fprintf(stderr, "[Error:%s] the file (%s) is not a history store!\n\n", __func__, file_name);
+        exit(-1);
+    }
+
+    if (fread(&version, sizeof(uint32_t), 1, file_hd) != 1) goto _truncated_error;
+    if (version == 0 || version > HISTORY_VERSION) {
+        fprintf(stderr, "[Error:%s] unsupported history store version (%u)!\n\n", __func__, version);
+        exit(-1);
+    }
+
+    history->hash_width = DATABASE_HASH_FULL;  /* version 1 only keeps the full MD5 */
+    if (version > 1 && fread(&history->hash_width, sizeof(uint32_t), 1, file_hd) != 1) goto _truncated_error;
+    if (fread(history->db_type, sizeof(char), 8, file_hd) != 8) goto _truncated_error;
+    if (fread(&history->n_dates, sizeof(uint32_t), 1, file_hd) != 1) goto _truncated_error;
+    if (fread(&history->size, sizeof(uint64_t), 1, file_hd) != 1) goto _truncated_error;
+
+    err_malloc(history->dates, history->n_dates + 1, uint32_t);
+    if (fread(history->dates, sizeof(uint32_t), history->n_dates, file_hd) != history->n_dates)
+        goto _truncated_error;
+
+    uint64_t n_version = history->size;
+    history->size = 0;
+    history_memory_resize(history, n_version + 1);
+
+    /* read the varint columns (id delta, from, to-from) and decode them */
+    for (int col=0; col < 3; col++) {
+        uint64_t l_col, value, prev = 0;
+        uint8_t *column;
+
+        if (fread(&l_col, sizeof(uint64_t), 1, file_hd) != 1) goto _truncated_error;
+        err_malloc(column, l_col + 1, uint8_t);
+        if (fread(column, sizeof(uint8_t), l_col, file_hd) != l_col) goto _truncated_error;
+
+        const uint8_t *p = column, *end = column + l_col;
+        for (uint64_t i=0; i < n_version; i++) {
+            if ((p = varint_get(p, end, &value)) == NULL) goto _truncated_error;
+
+            if (col == 0) {
+                prev += value;
+                history->ids[i] = (uint32_t)prev;
+            }
+            else if (col == 1)
+                history->from[i] = (uint16_t)value;
+
+            else  /* 0: the version is still open */
+                history->to[i] = value ? (uint16_t)(history->from[i] + value) : HISTORY_OPEN;
+        }
+        free(column);
+    }
+
+    /* the MD5 column is stored as raw bytes */
+    if (fread(history->values, sizeof(uint8_t), n_version<<4, file_hd) != n_version<<4)
+        goto _truncated_error;
+
+    history->size = n_version;
+    fclose(file_hd);
+    return history;
+
+    _truncated_error:
+    fprintf(stderr, "[Error:%s] truncated history store (%s) detected!\n\n", __func__, file_name);
+    exit(-1);
+}
+
+
+void history_save(const history_t *history, const char *file_name)
+{
+    char tmp_name[1024];
+    if (file_tmp_name(tmp_name, sizeof(tmp_name), file_name) != 0) {
+        fprintf(stderr, "[Error:%s]: the file name (%s) is too long!\n", __func__, file_name);
+        exit(-1);
+    }
+
+    FILE *file_hd = fopen(tmp_name, "wb");
+    if (file_hd == NULL) {
+        fprintf(stderr, "[Error:%s]: failed to open (%s)!\n", __func__, tmp_name);
+        exit(-1);
+    }
+
+    /* save the header */
+    char magic[8] = HISTORY_MAGIC;
+    uint32_t version = HISTORY_VERSION;
+
+    fwrite(magic, sizeof(char), 8, file_hd);
+    fwrite(&version, sizeof(uint32_t), 1, file_hd);
+    fwrite(&history->hash_width, sizeof(uint32_t), 1, file_hd);
+    fwrite(history->db_type, sizeof(char), 8, file_hd);
+    fwrite(&history->n_dates, sizeof(uint32_t), 1, file_hd);
+    fwrite(&history->size, sizeof(uint64_t), 1, file_hd);
+    fwrite(history->dates, sizeof(uint32_t), history->n_dates, file_hd);
+
+    /* encode the id (delta to previous), from and to (distance to from) columns */
+    kstring_t column = {0, 0, NULL};
+
+    for (int col=0; col < 3; col++) {
+        uint32_t prev = 0;
+        column.l = 0;
+
+        for (uint64_t i=0; i < history->size; i++) {
+            if (col == 0) {
+                varint_put(&column, history->ids[i] - prev);
+                prev = history->ids[i];
+            }
+            else if (col == 1)
+                varint_put(&column, history->from[i]);
+
+            else
+                varint_put(&column, history->to[i] == HISTORY_OPEN ? 0 : history->to[i] - history->from[i]);
+        }
+
+        uint64_t l_col = column.l;
+        fwrite(&l_col, sizeof(uint64_t), 1, file_hd);
+        fwrite(column.s, sizeof(char), column.l, file_hd);
+    }
+    k_strfree(&column);
+
+    fwrite(history->values, sizeof(uint8_t), history->size<<4, file_hd);
+
+    if (file_cache_drop(file_hd) != 0 || fclose(file_hd) != 0 || file_publish(tmp_name, file_name) != 0) {
+        fprintf(stderr, "[Error:%s]: failed to save the history store (%s)!\n", __func__, file_name);
+        exit(-1);
+    }
+}
+
+
+void history_destroy(history_t *history)
+{
+    if (history == NULL) return;
+
+    if (history->dates != NULL) free(history->dates);
+    if (history->ids != NULL) free(history->ids);
+    if (history->from != NULL) free(history->from);
+    if (history->to != NULL) free(history->to);
+    if (history->values != NULL) free(history->values);
+
+    free(history);
+}
+
+
+/* func: merge the sorted versions with the database snapshot (k: the date index of the snapshot)
+ *
+ *    open version    snapshot     action
+ *       none          absent      -
+ *       none          present     add a new version [k, open)
+ *       md5_a         absent      close the version at k
+ *       md5_a         md5_a       -
+ *       md5_a         md5_b       close the version at k and add a new version [k, open)
+ */
+uint64_t history_append(history_t *history, const database_t *database)
+{
+    if (history->n_dates == 0) {
+        strcpy(history->db_type, database->db_type);
+        history->hash_width = database->hash_width;
+    }
+
+    if (history->hash_width != database->hash_width) {
+        fprintf(stderr, "[Error:%s] conflict hash width: %u (history: %u)!\n", __func__,
+                database->hash_width, history->hash_width);
+        exit(-1);
+    }
+
+    if (strcmp(history->db_type, database->db_type) != 0) {
+        fprintf(stderr, "[Error:%s] conflict database type: %s (history: %s)!\n", __func__,
+                database->db_type, history->db_type);
+        exit(-1);
+    }
+
+    if (history->n_dates && database->db_date <= history->dates[history->n_dates-1]) {
+        fprintf(stderr, "[Error:%s] the database date (%d) is not later than the latest snapshot (%d)!\n",
+                __func__, database->db_date, history->dates[history->n_dates-1]);
+        exit(-1);
+    }
+
+    if (history->n_dates >= HISTORY_MAX_DATES) {
+        fprintf(stderr, "[Error:%s] the history store is full (%d snapshots)!\n", __func__, history->n_dates);
+        exit(-1);
+    }
+
+    /* count the present items to bound the size of the merged store */
+    uint64_t n_present = 0;
+    for (uint32_t id=0; id < database->capacity; id++)
+        n_present += database_flag(database, id) != 0;
+
+    history_t *old = history, merged;
+    memset(&merged, 0, sizeof(history_t));
+    history_memory_resize(&merged, old->size + n_present + 1);
+
+    const uint16_t k = (uint16_t)old->n_dates;
+    uint64_t i = 0, n_created = 0;
+
+    for (uint32_t id=0; id < database->capacity || i < old->size; id++) {
+        const uint8_t *open_md5 = NULL;
+
+        /* the ids beyond the database capacity are absent in the snapshot */
+        if (i < old->size && old->ids[i] > id && id >= database->capacity)
+            id = old->ids[i];
+
+        /* copy all versions of the id, and close the open one if necessary */
+        for (; i < old->size && old->ids[i] == id; i++) {
+            history_push(&merged, id, old->from[i], old->to[i], old->values + (i<<4));
+            if (old->to[i] == HISTORY_OPEN)
+                open_md5 = old->values + (i<<4);
+        }
+
+        const uint8_t *cur_md5 = NULL;
+        uint8_t cur_buf[16] = {0};  /* the short hash is padded with 0 */
+        if (id < database->capacity && database_flag(database, id) != 0) {
+            memcpy(cur_buf, database_query(database, id), database->hash_width);
+            cur_md5 = cur_buf;
+        }
+
+        if (open_md5 != NULL && (cur_md5 == NULL || memcmp(open_md5, cur_md5, 16) != 0))
+            merged.to[merged.size-1] = k;
+
+        if (cur_md5 != NULL && (open_md5 == NULL || memcmp(open_md5, cur_md5, 16) != 0)) {
+            history_push(&merged, id, k, HISTORY_OPEN, cur_md5);
+            n_created++;
+        }
+
+        if (id == UINT32_MAX) break;
+    }
+
+    /* replace the columns with the merged ones */
+    free(old->ids); free(old->from); free(old->to); free(old->values);
+    old->ids = merged.ids; old->from = merged.from; old->to = merged.to; old->values = merged.values;
+    old->size = merged.size; old->capacity = merged.capacity;
+
+    err_realloc(old->dates, old->n_dates + 1, uint32_t);
+    old->dates[old->n_dates++] = database->db_date;
+
+    return n_created;
+}
+
+
+/* find the snapshot index valid at the given date (-1: earlier than the first snapshot) */
+static int history_date_index(const history_t *history, uint32_t date)
+{
+    int k = -1;
+
+    for (uint32_t i=0; i < history->n_dates && history->dates[i] <= date; i++)
+        k = (int)i;
+
+    return k;
+}
+
+
+uint64_t history_diff_write(const history_t *history, uint32_t from_date, uint32_t to_date, const char *diff_list)
+{
+    const int kx = history_date_index(history, from_date);
+    const int ky = history_date_index(history, to_date);
+
+    if (kx < 0 || ky < 0) {
+        fprintf(stderr, "[Error:%s] the date is earlier than the first snapshot (%d)!\n", __func__,
+                history->n_dates ? history->dates[0] : 0);
+        exit(-1);
+    }
+
+    FILE *file_hd = fopen(diff_list, "wb");
+    if (file_hd == NULL) {
+        fprintf(stderr, "[Error:%s]: failed to open (%s)!\n", __func__, diff_list);
+        exit(-1);
+    }
+
+    uint64_t n_diff = 0;
+    for (uint64_t i=0; i < history->size; ) {
+        const uint32_t id = history->ids[i];
+        const uint8_t *md5_x = NULL, *md5_y = NULL;
+
+        /* find the versions valid at both dates */
+        for (; i < history->size && history->ids[i] == id; i++) {
+            if (history->from[i] <= kx && kx < history->to[i])
+                md5_x = history->values + (i<<4);
+
+            if (history->from[i] <= ky && ky < history->to[i])
+                md5_y = history->values + (i<<4);
+        }
+
+        const char *status = NULL;
+        if (md5_x == NULL && md5_y != NULL)
+            status = "ADD";
+
+        else if (md5_x != NULL && md5_y == NULL)
+            status = "DELETE";
+
+        else if (md5_x != NULL && memcmp(md5_x, md5_y, 16) != 0)
+            status = "CHANGE";
+
+        if (status != NULL) {
+            fprintf(file_hd, "%s\t%d\n", status, id);
+            n_diff++;
+        }
+    }
+
+    fclose(file_hd);
+    return n_diff;
+}
+
+
+void history_run(const args_t *args)
+{
+    char time_buf[32];
+    history_t *history = history_load(args->history);
+
+    /* import mode: append the database snapshot into the store */
+    if (args->database != NULL) {
+        database_t *database = database_load(args->database);
+
+        fprintf(stderr, "[%s] start to append the snapshot ...\n", get_current_time(time_buf));
+        uint64_t n_created = history_append(history, database);
+        history_save(history, args->history);
+
+        fprintf(stderr, "[*] new versions of the snapshot: %lu\n", (unsigned long)n_created);
+        fprintf(stderr, "[*] history store: %s (%d snapshots, %lu versions)\n", history->db_type,
+                history->n_dates, (unsigned long)history->size);
+        fprintf(stderr, "[%s] done!\n", get_current_time(time_buf));
+    }
+
+    /* query mode: the difference between two dates */
+    if (args->output_file != NULL) {
+        if (history->n_dates == 0) {
+            fprintf(stderr, "[Error:%s] the history store (%s) is empty!\n", __func__, args->history);
+            exit(-1);
+        }
+
+        fprintf(stderr, "[%s] start to query the difference ...\n", get_current_time(time_buf));
+        uint64_t n_diff = history_diff_write(history, args->from_date, args->to_date, args->output_file);
+
+        fprintf(stderr, "[*] difference between %d and %d: %lu\n", args->from_date, args->to_date,
+                (unsigned long)n_diff);
+        fprintf(stderr, "[%s] done!\n", get_current_time(time_buf));
+    }
+
+    history_destroy(history);
+}
@@ -0,0 +1,102 @@
+/*************************************************************************
+    > File Name: history.h
+    > Author: xlzh
+    > Mail: xiaolongzhang2015@163.com
+    > Created Time: 2025年12月15 09时26分12秒
+ ************************************************************************/
+
+#ifndef INSDCXMLPARSER_HISTORY_H
+#define INSDCXMLPARSER_HISTORY_H
+
+#include <stdint.h>
+#include "params.h"
+#include "database.h"
+
+/* the magic string of the history store file */
+#define HISTORY_MAGIC "INSDCHS"
+
+/* the on-disk format version of the history store (version 2: hash width added) */
+#define HISTORY_VERSION 2
+
+/* the to-field of a version which is still valid in the latest snapshot */
+#define HISTORY_OPEN 0xFFFF
+
+/* the maximum number of snapshots kept in one store */
+#define HISTORY_MAX_DATES 0xFFFE
+
+
+/*! @typedef history_t
+  @abstract the multi-version store of MD5 values, one column per field (sorted by id, then from)
+  @field  db_type           the database type, could be SAMPLE or PROJECT
+  @field  hash_width        the hash width of the snapshots (8 or 16 bytes, the short one is padded with 0)
+  @field  n_dates           the number of snapshots appended into the store
+  @field  dates             the released date of each snapshot (ascending)
+  @field  size              the number of versions in the store
+  @field  capacity          the number of versions allowed to store (with memory allocated)
+  @field  ids               the id column of the versions
+  @field  from              the date index where the version becomes valid
+  @field  to                the date index where the version becomes invalid (HISTORY_OPEN: still valid)
+  @field  values            the MD5 column of the versions (16 uint8_t for one MD5)
+ */
+typedef struct {
+    char db_type[8];
+    uint32_t hash_width;
+    uint32_t n_dates;
+    uint32_t *dates;
+    uint64_t size;
+    uint64_t capacity;
+    uint32_t *ids;
+    uint16_t *from;
+    uint16_t *to;
+    uint8_t *values;
+} history_t;
+
+
+/*! @function: load the history store (an empty store is returned if the file is not existed)
+  @param  file_name          the history store file name
+  @return                    the history object
+ */
+history_t *history_load(char *file_name);
+
+
+/*! @function: save the history store
+  @param  history            the history object
+  @param  file_name          the history store file name
+  @return
+ */
+void history_save(const history_t *history, const char *file_name);
+
+
+/*! @function: destroy the memory allocated to history
+  @param  history            the history object
+  @return
+ */
+void history_destroy(history_t *history);
+
+
+/*! @function: append the database snapshot of its release date into the history
+  @param  history            the history object
+  @param  database           the database object (flags: 0:absent, others:present)
+  @return                    the number of versions created by this snapshot
+ */
+uint64_t history_append(history_t *history, const database_t *database);
+
+
+/*! @function: write the difference list (ADD/CHANGE/DELETE) between two dates
+  @param  history            the history object
+  @param  from_date          the earlier date
+  @param  to_date            the later date
+  @param  diff_list          the output list file
+  @return                    the number of differences
+ */
+uint64_t history_diff_write(const history_t *history, uint32_t from_date, uint32_t to_date, const char *diff_list);
+
+
+/*! @function: the history command, import a database snapshot or query the difference
+  @param  args               the command line parameters
+  @return
+ */
+void history_run(const args_t *args);
+
+
+#endif //INSDCXMLPARSER_HISTORY_H
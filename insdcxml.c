@@ -0,0 +1,302 @@
+/*************************************************************************
+    > File Name: insdcxml.c
+    > Author: xlzh
+    > Mail: xiaolongzhang2015@163.com
+    > Created Time: 2025年12月29 10时18分37秒
+ ************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <omp.h>
+
+#include "utils.h"
+#include "md5.h"
+#include "stream_reader.h"
+#include "database.h"
+#include "insdcxml.h"
+
+
+/*! @typedef insdc_reader_t
+  @abstract the reader of the xml file
+  @field  cache             the stream cache of the xml file
+  @field  n_record          the number of records in the batch
+  @field  m_record          the capacity of records
+  @field  records           the records of the batch
+  @field  status            the status after the last batch (INSDC_END or the error)
+ */
+struct insdc_reader_t {
+    cache_t *cache;
+    uint32_t n_record;
+    uint32_t m_record;
+    insdc_record_t *records;
+    int status;
+};
+
+
+/*! @typedef insdc_db_t
+  @abstract the database kept in the process
+  @field  database          the table of the database
+ */
+struct insdc_db_t {
+    database_t *database;
+};
+
+
+const char *insdc_strerror(int status)
+{
+    switch (status) {
+        case INSDC_OK: return "success";
+        case INSDC_END: return "the end of the xml file";
+        case INSDC_NOT_FOUND: return "the id is not in the database";
+        case INSDC_ERROR_ARG: return "invalid argument";
+        case INSDC_ERROR_OPEN: return "failed to open the file";
+        case INSDC_ERROR_READ: return "failed to read the xml file";
+        case INSDC_ERROR_TAG: return "the record tag is not found in the xml file";
+        case INSDC_ERROR_ID: return "the id is not exist in the record";
+        case INSDC_ERROR_FORMAT: return "the file is not a database or it is truncated";
+        case INSDC_ERROR_WRITE: return "failed to write the database";
+        case INSDC_ERROR_DATE: return "the date is not later than the database";
+        default: return "unknown status";
+    }
+}
+
+
+int insdc_reader_open(insdc_reader_t **reader, const char *file_name, const char *type)
+{
+    *reader = NULL;
+    if (file_name == NULL || type == NULL) return INSDC_ERROR_ARG;
+
+    const char *start_tag, *end_tag;
+    if (strcmp(type, "SAMPLE") == 0) {
+        start_tag = SAMPLE_START_TAG;
+        end_tag = SAMPLE_END_TAG;
+    }
+    else if (strcmp(type, "PROJECT") == 0) {
+        start_tag = PROJECT_START_TAG;
+        end_tag = PROJECT_END_TAG;
+    }
+    else return INSDC_ERROR_ARG;
+
+    cache_t *cache = stream_cache_open(file_name, start_tag, end_tag);
+    if (cache == NULL) return INSDC_ERROR_OPEN;
+
+    err_calloc(*reader, 1, insdc_reader_t);
+    (*reader)->cache = cache;
+    return INSDC_OK;
+}
+
+
+int insdc_reader_next(insdc_reader_t *reader, const insdc_record_t **records, uint32_t *n_record)
+{
+    *records = NULL;
+    *n_record = 0;
+    if (reader->status != INSDC_OK) return reader->status;  /* the end (or the error) is kept */
+
+    cache_t *cache = reader->cache;
+    const int status = stream_cache_next(cache);
+
+    if (status != STREAM_OK) {
+        reader->status = status == STREAM_END ? INSDC_END :
+                         status == STREAM_ERROR_READ ? INSDC_ERROR_READ :
+                         status == STREAM_ERROR_TAG ? INSDC_ERROR_TAG : INSDC_ERROR_ID;
+        return reader->status;
+    }
+
+    if (reader->m_record < cache->size) {
+        reader->m_record = cache->size;
+        err_realloc(reader->records, reader->m_record, insdc_record_t);
+    }
+
+    #pragma omp parallel for schedule(dynamic, 64) shared(reader, cache)
+    for (uint32_t i=0; i < cache->size; i++) {
+        const body_t *body = &cache->item_list[i];
+        insdc_record_t *record = &reader->records[i];
+
+        record->id = body->id;
+        record->size = body->size;
+        record->offset = stream_cache_offset(cache, body->start);
+        record->data = body->start;
+        md5_calculate_block((uint8_t *)body->start, body->size, record->hash);
+    }
+
+    reader->n_record = cache->size;
+    *records = reader->records;
+    *n_record = reader->n_record;
+    return INSDC_OK;
+}
+
+
+int insdc_reader_each(insdc_reader_t *reader, insdc_record_cb callback, void *user_data)
+{
+    const insdc_record_t *records;
+    uint32_t n_record;
+    int status;
+
+    while ((status = insdc_reader_next(reader, &records, &n_record)) == INSDC_OK) {
+        for (uint32_t i=0; i < n_record; i++) {
+            const int ret = callback(&records[i], user_data);
+            if (ret != 0) return ret;
+        }
+    }
+
+    return status;
+}
+
+
+void insdc_reader_close(insdc_reader_t *reader)
+{
+    if (reader == NULL) return;
+
+    stream_cache_destroy(reader->cache);
+    free(reader->records);
+    free(reader);
+}
+
+
+int insdc_db_create(insdc_db_t **db, const char *type, uint32_t date, uint32_t hash_width)
+{
+    *db = NULL;
+    if (type == NULL || (strcmp(type, "SAMPLE") != 0 && strcmp(type, "PROJECT") != 0) ||
+        (hash_width != DATABASE_HASH_SHORT && hash_width != DATABASE_HASH_FULL))
+        return INSDC_ERROR_ARG;
+
+    /* the table grows with the ids put, instead of the size of the whole archive */
+    err_calloc(*db, 1, insdc_db_t);
+    (*db)->database = database_init(1U << DATABASE_LEAF_SHIFT, hash_width, DATABASE_LAYOUT_SPLIT);
+    strcpy((*db)->database->db_type, type);
+    (*db)->database->db_date = date;
+
+    return INSDC_OK;
+}
+
+
+int insdc_db_open(insdc_db_t **db, const char *file_name)
+{
+    *db = NULL;
+    if (file_name == NULL) return INSDC_ERROR_ARG;
+
+    FILE *file_hd = fopen(file_name, "rb");
+    if (file_hd == NULL) return INSDC_ERROR_OPEN;
+
+    database_t *database = database_read(file_hd);
+    fclose(file_hd);
+    if (database == NULL) return INSDC_ERROR_FORMAT;
+
+    err_calloc(*db, 1, insdc_db_t);
+    (*db)->database = database;
+    return INSDC_OK;
+}
+
+
+int insdc_db_info(const insdc_db_t *db, insdc_db_info_t *info)
+{
+    const database_t *database = db->database;
+
+    memcpy(info->type, database->db_type, sizeof(info->type));
+    info->date = database->db_date;
+    info->capacity = database->capacity;
+    info->hash_width = database->hash_width;
+    info->root = database_tree_update(database);
+
+    return INSDC_OK;
+}
+
+
+int insdc_db_query(const insdc_db_t *db, uint32_t id, uint8_t *hash)
+{
+    const database_t *database = db->database;
+    if (id >= database->capacity || database_flag(database, id) == 0) return INSDC_NOT_FOUND;
+
+    memcpy(hash, database_query(database, id), database->hash_width);
+    return INSDC_OK;
+}
+
+
+int insdc_db_put(insdc_db_t *db, const insdc_record_t *record)
+{
+    if (record->id == UINT32_MAX) return INSDC_ERROR_ARG;  /* the table covers the ids [0, UINT32_MAX) */
+
+    database_t *database = database_resize(db->database, record->id + 1);
+    database_add(database, record->id, record->hash);
+
+    return INSDC_OK;
+}
+
+
+int insdc_db_compare(insdc_db_t *db, const insdc_record_t *record)
+{
+    if (record->id == UINT32_MAX) return INSDC_ERROR_ARG;  /* the table covers the ids [0, UINT32_MAX) */
+
+    database_t *database = database_resize(db->database, record->id + 1);
+    uint8_t *raw_md5 = database_query(database, record->id);
+
+    /* the same classification as comparing the xml file */
+    if (database_flag(database, record->id) == 0)
+        database_flag(database, record->id) = INSDC_ADD;
+    else if (!database_equal(database, raw_md5, record->hash))
+        database_flag(database, record->id) = INSDC_CHANGE;
+    else {
+        database_flag(database, record->id) = INSDC_UNCHANGED;
+        return INSDC_UNCHANGED;
+    }
+
+    database_copy(database, raw_md5, record->hash);
+    database_touch(database, record->id);
+    return database_flag(database, record->id);
+}
+
+
+int insdc_db_changes(const insdc_db_t *db, insdc_change_cb callback, void *user_data)
+{
+    const database_t *database = db->database;
+    uint64_t changed[(1U << DATABASE_LEAF_SHIFT) >> 6];
+
+    for (uint32_t start=0; start < database->capacity; start += 1U << DATABASE_LEAF_SHIFT) {
+        const uint32_t n = database->capacity - start < (1U << DATABASE_LEAF_SHIFT) ?
+                           database->capacity - start : (1U << DATABASE_LEAF_SHIFT);
+        if (database_flags_changed(database, start, n, changed) == 0) continue;
+
+        for (uint32_t w=0; w < (n + 63) >> 6; w++) {
+            for (uint64_t mask=changed[w]; mask != 0; mask &= mask - 1) {
+                const uint32_t id = start + (w << 6) + __builtin_ctzll(mask);
+
+                const int ret = callback(id, database_flag(database, id), user_data);
+                if (ret != 0) return ret;
+            }
+        }
+    }
+
+    return INSDC_OK;
+}
+
+
+int insdc_db_commit(insdc_db_t *db, uint32_t date)
+{
+    database_t *database = db->database;
+    if (date <= database->db_date) return INSDC_ERROR_DATE;
+
+    database_flags_reset(database);
+    database->db_date = date;
+    return INSDC_OK;
+}
+
+
+int insdc_db_save(insdc_db_t *db, const char *file_name)
+{
+    /* the same publishing as xml_parser, the mapped readers check the generation to reload */
+    const int status = database_publish(db->database, file_name);
+
+    if (status == -1) return INSDC_ERROR_ARG;  /* the file name is too long */
+    if (status == -2) return INSDC_ERROR_OPEN;
+    return status == 0 ? INSDC_OK : INSDC_ERROR_WRITE;
+}
+
+
+void insdc_db_close(insdc_db_t *db)
+{
+    if (db == NULL) return;
+
+    database_destroy(db->database);
+    free(db);
+}
@@ -0,0 +1,215 @@
+/*************************************************************************
+    > File Name: insdcxml.h
+    > Author: xlzh
+    > Mail: xiaolongzhang2015@163.com
+    > Created Time: 2025年12月29 10时18分37秒
+ ************************************************************************/
+
+#ifndef INSDCXMLPARSER_INSDCXML_H
+#define INSDCXMLPARSER_INSDCXML_H
+
+/* libinsdcxml: read the records of the xml file and keep the database in a long-lived process
+ *
+ *   the functions return the status instead of exiting the process (only the allocation failure exits),
+ *   the objects are independent of each other, but each object is used by one thread at a time
+ */
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* the status of the functions */
+#define INSDC_OK 0
+#define INSDC_END 1               /* no more records in the xml file */
+#define INSDC_NOT_FOUND 2         /* the id is not in the database */
+#define INSDC_ERROR_ARG -1        /* invalid argument (e.g. unknown type or hash width) */
+#define INSDC_ERROR_OPEN -2       /* failed to open the file */
+#define INSDC_ERROR_READ -3       /* failed to read the xml file */
+#define INSDC_ERROR_TAG -4        /* no record is found in the whole buffer (wrong type of the xml file) */
+#define INSDC_ERROR_ID -5         /* the id is not exist in the record */
+#define INSDC_ERROR_FORMAT -6     /* the file is not a database, or it is truncated */
+#define INSDC_ERROR_WRITE -7      /* failed to write the database */
+#define INSDC_ERROR_DATE -8       /* the date is not later than the date of the database */
+
+/* the status of the records after comparing (the same as the difference list) */
+#define INSDC_DELETE 1
+#define INSDC_UNCHANGED 2
+#define INSDC_ADD 3
+#define INSDC_CHANGE 4
+
+
+/*! @typedef insdc_record_t
+  @abstract the record (data body) of the xml file, the data is valid until the next batch is read
+  @field  id                the id of the record
+  @field  size              the size of the record
+  @field  offset            the offset of the record in the xml file
+  @field  data              the record from the start tag to the end tag (not terminated by NUL)
+  @field  hash              the md5 of the record
+ */
+typedef struct {
+    uint32_t id;
+    uint32_t size;
+    uint64_t offset;
+    const char *data;
+    uint8_t hash[16];
+} insdc_record_t;
+
+
+/*! @typedef insdc_db_info_t
+  @abstract the summary of the database
+  @field  type              the type of the database (SAMPLE or PROJECT)
+  @field  date              the date of the xml file the database is built or updated with
+  @field  capacity          the size of the table (the largest id + 1 at least)
+  @field  hash_width        the bytes of the hash kept for each id (8 or 16)
+  @field  root              the root of the hash tree, equal for the same ids and hashes
+ */
+typedef struct {
+    char type[8];
+    uint32_t date;
+    uint32_t capacity;
+    uint32_t hash_width;
+    uint64_t root;
+} insdc_db_info_t;
+
+
+typedef struct insdc_reader_t insdc_reader_t;
+typedef struct insdc_db_t insdc_db_t;
+
+/* the callback of each record (in the order of the xml file), return non-zero to stop */
+typedef int (*insdc_record_cb)(const insdc_record_t *record, void *user_data);
+
+/* the callback of each deleted, added or changed id (in the order of id), return non-zero to stop */
+typedef int (*insdc_change_cb)(uint32_t id, int status, void *user_data);
+
+
+/*! @function: the message of the status
+  @param  status             the status returned by the functions
+  @return                    the static message
+ */
+const char *insdc_strerror(int status);
+
+
+/*! @function: open the xml file to read its records
+  @param  reader             the reader opened (NULL if failed)
+  @param  file_name          the xml file ("-": the standard input, pipes are also accepted)
+  @param  type               the type of the xml file (SAMPLE or PROJECT)
+  @return                    INSDC_OK, INSDC_ERROR_ARG or INSDC_ERROR_OPEN
+ */
+int insdc_reader_open(insdc_reader_t **reader, const char *file_name, const char *type);
+
+
+/*! @function: read the next batch of records, which are hashed in parallel
+  @param  reader             the reader from insdc_reader_open
+  @param  records            the records of the batch (valid until the next call)
+  @param  n_record           the number of records in the batch (may be 0 before the end)
+  @return                    INSDC_OK, INSDC_END or INSDC_ERROR_READ|TAG|ID
+ */
+int insdc_reader_next(insdc_reader_t *reader, const insdc_record_t **records, uint32_t *n_record);
+
+
+/*! @function: call the callback for each of the remaining records
+  @param  reader             the reader from insdc_reader_open
+  @param  callback           the callback of each record
+  @param  user_data          the argument passed to the callback
+  @return                    INSDC_END, the non-zero value of the callback, or INSDC_ERROR_READ|TAG|ID
+ */
+int insdc_reader_each(insdc_reader_t *reader, insdc_record_cb callback, void *user_data);
+
+
+/*! @function: close the reader
+  @param  reader             the reader from insdc_reader_open (NULL is ignored)
+  @return
+ */
+void insdc_reader_close(insdc_reader_t *reader);
+
+
+/*! @function: create an empty database to build
+  @param  db                 the database created (NULL if failed)
+  @param  type               the type of the database (SAMPLE or PROJECT)
+  @param  date               the date of the xml file
+  @param  hash_width         the bytes of the hash kept for each id (8 or 16)
+  @return                    INSDC_OK or INSDC_ERROR_ARG
+ */
+int insdc_db_create(insdc_db_t **db, const char *type, uint32_t date, uint32_t hash_width);
+
+
+/*! @function: open the database file (all the versions written by xml_parser)
+  @param  db                 the database opened (NULL if failed)
+  @param  file_name          the database file
+  @return                    INSDC_OK, INSDC_ERROR_OPEN or INSDC_ERROR_FORMAT
+ */
+int insdc_db_open(insdc_db_t **db, const char *file_name);
+
+
+/*! @function: get the summary of the database
+  @param  db                 the database
+  @param  info               the summary
+  @return                    INSDC_OK
+ */
+int insdc_db_info(const insdc_db_t *db, insdc_db_info_t *info);
+
+
+/*! @function: query the hash of the id
+  @param  db                 the database
+  @param  id                 the id to query
+  @param  hash               the hash of the id (hash_width bytes are written)
+  @return                    INSDC_OK or INSDC_NOT_FOUND
+ */
+int insdc_db_query(const insdc_db_t *db, uint32_t id, uint8_t *hash);
+
+
+/*! @function: set the hash of the record while building the database
+  @param  db                 the database from insdc_db_create
+  @param  record             the record with its hash
+  @return                    INSDC_OK or INSDC_ERROR_ARG (the id is UINT32_MAX)
+ */
+int insdc_db_put(insdc_db_t *db, const insdc_record_t *record);
+
+
+/*! @function: compare the record with the database, and keep its hash
+  @param  db                 the database from insdc_db_open
+  @param  record             the record with its hash
+  @return                    INSDC_UNCHANGED, INSDC_ADD, INSDC_CHANGE or INSDC_ERROR_ARG (the id is UINT32_MAX)
+ */
+int insdc_db_compare(insdc_db_t *db, const insdc_record_t *record);
+
+
+/*! @function: call the callback for each id deleted, added or changed since the records are compared
+  @param  db                 the database compared
+  @param  callback           the callback of each id
+  @param  user_data          the argument passed to the callback
+  @return                    INSDC_OK or the non-zero value of the callback
+ */
+int insdc_db_changes(const insdc_db_t *db, insdc_change_cb callback, void *user_data);
+
+
+/*! @function: drop the deleted ids (not compared) and move the database to the date of the xml file
+  @param  db                 the database compared
+  @param  date               the date of the xml file compared
+  @return                    INSDC_OK or INSDC_ERROR_DATE
+ */
+int insdc_db_commit(insdc_db_t *db, uint32_t date);
+
+
+/*! @function: save the database (write to a temporary file then rename)
+  @param  db                 the database built or committed (its generation is increased)
+  @param  file_name          the database file
+  @return                    INSDC_OK, INSDC_ERROR_ARG (the name is too long), INSDC_ERROR_OPEN or INSDC_ERROR_WRITE
+ */
+int insdc_db_save(insdc_db_t *db, const char *file_name);
+
+
+/*! @function: close the database
+  @param  db                 the database (NULL is ignored)
+  @return
+ */
+void insdc_db_close(insdc_db_t *db);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //INSDCXMLPARSER_INSDCXML_H
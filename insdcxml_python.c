@@ -0,0 +1,483 @@
+/*************************************************************************
+    > File Name: insdcxml_python.c
+    > Author: xlzh
+    > Mail: xiaolongzhang2015@163.com
+    > Created Time: 2025年12月30 09时42分15秒
+ ************************************************************************/
+
+/* the python extension (make python): the table and the parsed records are exposed without copying
+ *
+ *   db = insdcxml.Database("sample.db")         # mapped, the tables are shared with the page cache
+ *   flags = numpy.asarray(db.flags)             # uint8[capacity]
+ *   values = numpy.asarray(db.values)           # uint8[capacity, hash_width]
+ *
+ *   for id, offset, data in insdcxml.Reader("biosample_set.xml", "SAMPLE"):
+ *       ...                                     # data is a memoryview into the parse buffer
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "utils.h"
+#include "stream_reader.h"
+#include "database.h"
+
+
+/*! @typedef view_object_t
+  @abstract the exporter of a memory block (the flags, the values or the stream buffer) by the buffer protocol
+  @field  owner             the object owning the memory, kept alive while the memoryviews exist (NULL: cache)
+  @field  cache             the stream cache owned by the exporter (NULL: the memory of the owner)
+  @field  data              the start of the memory
+  @field  ndim              the number of dimensions (1 or 2)
+  @field  shape             the shape of the memory (bytes)
+  @field  strides           the strides of the memory (bytes)
+ */
+typedef struct {
+    PyObject_HEAD
+    PyObject *owner;
+    cache_t *cache;
+    char *data;
+    int ndim;
+    Py_ssize_t shape[2];
+    Py_ssize_t strides[2];
+} view_object_t;
+
+
+/*! @typedef database_object_t
+  @abstract insdcxml.Database, the database mapped from the published file
+  @field  database          the table of the database
+ */
+typedef struct {
+    PyObject_HEAD
+    database_t *database;
+} database_object_t;
+
+
+/*! @typedef reader_object_t
+  @abstract insdcxml.Reader, the iterator of the records (id, offset, memoryview) in the xml file
+  @field  exporter          the exporter of the stream buffer, which owns the stream cache
+  @field  view              the memoryview of the whole stream buffer, the records are its slices
+  @field  index             the next record in the batch
+  @field  end               [0|1] 1: the end of the stream is reached
+ */
+typedef struct {
+    PyObject_HEAD
+    view_object_t *exporter;
+    PyObject *view;
+    uint32_t index;
+    int end;
+} reader_object_t;
+
+
+static PyTypeObject view_type;
+
+
+/* func: the exporter of the memory, shape[1] is only used if ndim is 2, stride is the bytes between two rows */
+static PyObject *view_new(PyObject *owner, cache_t *cache, char *data, int ndim, Py_ssize_t n, Py_ssize_t width,
+                          Py_ssize_t stride)
+{
+    view_object_t *self = PyObject_New(view_object_t, &view_type);
+    if (self == NULL) return NULL;
+
+    Py_XINCREF(owner);
+    self->owner = owner;
+    self->cache = cache;
+    self->data = data;
+    self->ndim = ndim;
+    self->shape[0] = n;
+    self->shape[1] = width;
+    self->strides[0] = stride;
+    self->strides[1] = 1;
+
+    return (PyObject *)self;
+}
+
+
+static void view_dealloc(view_object_t *self)
+{
+    Py_XDECREF(self->owner);
+    stream_cache_destroy(self->cache);
+    PyObject_Free(self);
+}
+
+
+static int view_getbuffer(view_object_t *self, Py_buffer *view, int flags)
+{
+    if (flags & PyBUF_WRITABLE) {
+        PyErr_SetString(PyExc_BufferError, "the memory is read-only");
+        return -1;
+    }
+
+    /* the flags and values of the slot layout are only exported with their strides */
+    if (self->strides[0] != (self->ndim == 2 ? self->shape[1] : 1) && (flags & PyBUF_STRIDES) != PyBUF_STRIDES) {
+        PyErr_SetString(PyExc_BufferError, "the memory is not contiguous");
+        return -1;
+    }
+
+    Py_INCREF(self);
+    view->obj = (PyObject *)self;
+    view->buf = self->data;
+    view->len = self->ndim == 2 ? self->shape[0] * self->shape[1] : self->shape[0];
+    view->readonly = 1;
+    view->itemsize = 1;
+    view->format = (flags & PyBUF_FORMAT) ? "B" : NULL;
+    view->ndim = self->ndim;
+    view->shape = (flags & PyBUF_ND) ? self->shape : NULL;
+    view->strides = (flags & PyBUF_STRIDES) == PyBUF_STRIDES ? self->strides : NULL;
+    view->suboffsets = NULL;
+    view->internal = NULL;
+
+    return 0;
+}
+
+
+static PyBufferProcs view_as_buffer = {
+    .bf_getbuffer = (getbufferproc)view_getbuffer,
+    .bf_releasebuffer = NULL,
+};
+
+
+static PyTypeObject view_type = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "insdcxml._View",
+    .tp_basicsize = sizeof(view_object_t),
+    .tp_dealloc = (destructor)view_dealloc,
+    .tp_as_buffer = &view_as_buffer,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = "the exporter of the flags, the values and the stream buffer",
+};
+
+
+static int database_object_init(database_object_t *self, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = {"file_name", NULL};
+    PyObject *path;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O&", kwlist, PyUnicode_FSConverter, &path))
+        return -1;
+
+    if (self->database != NULL) {
+        PyErr_SetString(PyExc_RuntimeError, "the database is already loaded");
+        Py_DECREF(path);
+        return -1;
+    }
+
+    if (access(PyBytes_AS_STRING(path), R_OK) != 0) {
+        PyErr_SetFromErrnoWithFilenameObject(PyExc_OSError, path);
+        Py_DECREF(path);
+        return -1;
+    }
+
+    /* the mapping keeps the generation opened, even if the next one is published by the daily update */
+    database_t *database;
+    Py_BEGIN_ALLOW_THREADS
+    database = database_map(PyBytes_AS_STRING(path));
+    Py_END_ALLOW_THREADS
+
+    if (database == NULL) {
+        PyErr_Format(PyExc_ValueError, "the file (%s) is not a database or it is truncated", PyBytes_AS_STRING(path));
+        Py_DECREF(path);
+        return -1;
+    }
+
+    Py_DECREF(path);
+    self->database = database;
+    return 0;
+}
+
+
+static void database_object_dealloc(database_object_t *self)
+{
+    database_destroy(self->database);
+    Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+
+#define database_object_check(_self) do {                                           \
+    if ((_self)->database == NULL) {                                                \
+        PyErr_SetString(PyExc_RuntimeError, "the database is not loaded");          \
+        return NULL;                                                                \
+    }                                                                               \
+} while(0)
+
+
+static PyObject *database_object_flags(database_object_t *self, void *closure)
+{
+    (void)closure;
+    database_object_check(self);
+    const database_t *database = self->database;
+
+    PyObject *exporter = view_new((PyObject *)self, NULL, (char *)database->flags, 1, database->capacity, 0,
+                                  database->flag_stride);
+    if (exporter == NULL) return NULL;
+
+    PyObject *view = PyMemoryView_FromObject(exporter);
+    Py_DECREF(exporter);
+    return view;
+}
+
+
+static PyObject *database_object_values(database_object_t *self, void *closure)
+{
+    (void)closure;
+    database_object_check(self);
+    const database_t *database = self->database;
+
+    PyObject *exporter = view_new((PyObject *)self, NULL, (char *)database->values, 2, database->capacity,
+                                  database->hash_width, database->slot_width);
+    if (exporter == NULL) return NULL;
+
+    PyObject *view = PyMemoryView_FromObject(exporter);
+    Py_DECREF(exporter);
+    return view;
+}
+
+
+static PyObject *database_object_type(database_object_t *self, void *closure)
+{
+    (void)closure;
+    database_object_check(self);
+    return PyUnicode_FromString(self->database->db_type);
+}
+
+
+static PyObject *database_object_date(database_object_t *self, void *closure)
+{
+    (void)closure;
+    database_object_check(self);
+    return PyLong_FromUnsignedLong(self->database->db_date);
+}
+
+
+static PyObject *database_object_generation(database_object_t *self, void *closure)
+{
+    (void)closure;
+    database_object_check(self);
+    return PyLong_FromUnsignedLongLong(self->database->generation);
+}
+
+
+static PyObject *database_object_capacity(database_object_t *self, void *closure)
+{
+    (void)closure;
+    database_object_check(self);
+    return PyLong_FromUnsignedLong(self->database->capacity);
+}
+
+
+static PyObject *database_object_hash_width(database_object_t *self, void *closure)
+{
+    (void)closure;
+    database_object_check(self);
+    return PyLong_FromUnsignedLong(self->database->hash_width);
+}
+
+
+static PyObject *database_object_root(database_object_t *self, void *closure)
+{
+    (void)closure;
+    database_object_check(self);
+    return PyLong_FromUnsignedLongLong(database_tree_update(self->database));
+}
+
+
+static PyObject *database_object_query(database_object_t *self, PyObject *arg)
+{
+    database_object_check(self);
+    const database_t *database = self->database;
+
+    const unsigned long id = PyLong_AsUnsignedLong(arg);
+    if (id == (unsigned long)-1 && PyErr_Occurred()) return NULL;
+
+    if (id >= database->capacity || database_flag(database, id) == 0) Py_RETURN_NONE;
+    return PyBytes_FromStringAndSize((const char *)database_query(database, id), database->hash_width);
+}
+
+
+static PyGetSetDef database_object_getset[] = {
+    {"flags", (getter)database_object_flags, NULL, "the flags (uint8[capacity], 0: empty) without copying", NULL},
+    {"values", (getter)database_object_values, NULL, "the hashes (uint8[capacity, hash_width]) without copying", NULL},
+    {"type", (getter)database_object_type, NULL, "the type of the database (SAMPLE or PROJECT)", NULL},
+    {"date", (getter)database_object_date, NULL, "the date of the database", NULL},
+    {"generation", (getter)database_object_generation, NULL, "the generation of the file (0: before version 5)",
+     NULL},
+    {"capacity", (getter)database_object_capacity, NULL, "the size of the table", NULL},
+    {"hash_width", (getter)database_object_hash_width, NULL, "the bytes of the hash kept for each id", NULL},
+    {"root", (getter)database_object_root, NULL, "the root of the hash tree", NULL},
+    {NULL}
+};
+
+
+static PyMethodDef database_object_methods[] = {
+    {"query", (PyCFunction)database_object_query, METH_O, "query(id) -> the hash of the id (bytes), None if not found"},
+    {NULL}
+};
+
+
+static PyTypeObject database_type = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "insdcxml.Database",
+    .tp_basicsize = sizeof(database_object_t),
+    .tp_dealloc = (destructor)database_object_dealloc,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = "Database(file_name): the database file mapped read-only",
+    .tp_methods = database_object_methods,
+    .tp_getset = database_object_getset,
+    .tp_init = (initproc)database_object_init,
+    .tp_new = PyType_GenericNew,
+};
+
+
+static int reader_object_init(reader_object_t *self, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = {"file_name", "type", NULL};
+    const char *type = "SAMPLE";
+    PyObject *path;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O&|s", kwlist, PyUnicode_FSConverter, &path, &type))
+        return -1;
+
+    if (self->exporter != NULL) {
+        PyErr_SetString(PyExc_RuntimeError, "the reader is already opened");
+        Py_DECREF(path);
+        return -1;
+    }
+
+    const int sample = strcmp(type, "SAMPLE") == 0;
+    if (!sample && strcmp(type, "PROJECT") != 0) {
+        PyErr_Format(PyExc_ValueError, "unknown type (%s), SAMPLE or PROJECT is expected", type);
+        Py_DECREF(path);
+        return -1;
+    }
+
+    cache_t *cache = stream_cache_open(PyBytes_AS_STRING(path), sample ? SAMPLE_START_TAG : PROJECT_START_TAG,
+                                       sample ? SAMPLE_END_TAG : PROJECT_END_TAG);
+    if (cache == NULL) {
+        PyErr_SetFromErrnoWithFilenameObject(PyExc_OSError, path);
+        Py_DECREF(path);
+        return -1;
+    }
+    Py_DECREF(path);
+
+    /* the records are the slices of the whole buffer (the ring is mapped twice, so the records are contiguous) */
+    const buffer_t *buffer = &cache->buffer;
+    const Py_ssize_t size = buffer->ring_size ? (Py_ssize_t)buffer->ring_size << 1 : (Py_ssize_t)buffer->capacity;
+
+    self->exporter = (view_object_t *)view_new(NULL, cache, buffer->base, 1, size, 0, 1);
+    if (self->exporter == NULL) {
+        stream_cache_destroy(cache);
+        return -1;
+    }
+
+    self->view = PyMemoryView_FromObject((PyObject *)self->exporter);
+    return self->view == NULL ? -1 : 0;
+}
+
+
+static void reader_object_dealloc(reader_object_t *self)
+{
+    Py_XDECREF(self->view);
+    Py_XDECREF(self->exporter);
+    Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+
+static PyObject *reader_object_next(reader_object_t *self)
+{
+    if (self->exporter == NULL) {
+        PyErr_SetString(PyExc_RuntimeError, "the reader is not opened");
+        return NULL;
+    }
+
+    /* the next batch overwrites the buffer, the memoryviews of the previous batch are only valid until then */
+    cache_t *cache = self->exporter->cache;
+    while (self->index >= cache->size) {
+        if (self->end) return NULL;
+
+        int status;
+        Py_BEGIN_ALLOW_THREADS
+        status = stream_cache_next(cache);
+        Py_END_ALLOW_THREADS
+
+        self->index = 0;
+        if (status == STREAM_END) {
+            self->end = 1;
+            cache->size = 0;
+            return NULL;
+        }
+
+        if (status == STREAM_ERROR_READ) {
+            errno = cache->error;
+            return PyErr_SetFromErrno(PyExc_OSError);
+        }
+
+        if (status != STREAM_OK) {
+            PyErr_SetString(PyExc_ValueError, status == STREAM_ERROR_TAG ?
+                            "the record tag is not found in the xml file" : "the id is not exist in the record");
+            return NULL;
+        }
+    }
+
+    /* the slice shares the buffer of the whole view, which keeps the stream cache alive */
+    const body_t *body = &cache->item_list[self->index++];
+    const Py_ssize_t start = body->start - cache->buffer.base;
+
+    PyObject *lo = PyLong_FromSsize_t(start), *hi = PyLong_FromSsize_t(start + body->size);
+    PyObject *slice = lo && hi ? PySlice_New(lo, hi, NULL) : NULL;
+    Py_XDECREF(lo);
+    Py_XDECREF(hi);
+    if (slice == NULL) return NULL;
+
+    PyObject *data = PyObject_GetItem(self->view, slice);
+    Py_DECREF(slice);
+    if (data == NULL) return NULL;
+
+    return Py_BuildValue("(kKN)", (unsigned long)body->id,
+                         (unsigned long long)stream_cache_offset(cache, body->start), data);
+}
+
+
+static PyTypeObject reader_type = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "insdcxml.Reader",
+    .tp_basicsize = sizeof(reader_object_t),
+    .tp_dealloc = (destructor)reader_object_dealloc,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = "Reader(file_name, type='SAMPLE'): iterate the records (id, offset, memoryview) of the xml file,\n"
+              "the memoryview points into the parse buffer and is valid until the next batch is read",
+    .tp_iter = PyObject_SelfIter,
+    .tp_iternext = (iternextfunc)reader_object_next,
+    .tp_init = (initproc)reader_object_init,
+    .tp_new = PyType_GenericNew,
+};
+
+
+static struct PyModuleDef insdcxml_module = {
+    PyModuleDef_HEAD_INIT,
+    .m_name = "insdcxml",
+    .m_doc = "the database and the records of the INSDC xml file without copying",
+    .m_size = -1,
+};
+
+
+PyMODINIT_FUNC PyInit_insdcxml(void)
+{
+    if (PyType_Ready(&view_type) < 0 || PyType_Ready(&database_type) < 0 || PyType_Ready(&reader_type) < 0)
+        return NULL;
+
+    PyObject *module = PyModule_Create(&insdcxml_module);
+    if (module == NULL) return NULL;
+
+    if (PyModule_AddObjectRef(module, "Database", (PyObject *)&database_type) < 0 ||
+        PyModule_AddObjectRef(module, "Reader", (PyObject *)&reader_type) < 0) {
+        Py_DECREF(module);
+        return NULL;
+    }
+
+    return module;
+}
@@ -3,6 +3,7 @@
 #include <stdio.h>
 #include <string.h>
 #include "md5.h"
+#include "cpu_dispatch.h"
 
 unsigned char PADDING[] =
 {
@@ -80,10 +81,10 @@ void MD5Update(MD5_CTX *context, unsigned char *input, unsigned int inputlen)
 	if(inputlen >= partlen)
 	{
 		memcpy(&context->buffer[index], input,partlen);
-		MD5Transform(context->state, context->buffer);
+		cpu_kernel.md5_transform(context->state, context->buffer);
 
 		for(i = partlen; i+64 <= inputlen; i+=64)
-			MD5Transform(context->state, &input[i]);
+			cpu_kernel.md5_transform(context->state, &input[i]);
 
 		index = 0;        
 	}  
@@ -143,7 +144,8 @@ void MD5Decode(unsigned int *output, unsigned char *input, unsigned int len)
 }
 
 
-void MD5Transform(unsigned int state[4], unsigned char block[64])
+/* the body of MD5Transform, inlined into the variant of each instruction set */
+static inline __attribute__((always_inline)) void md5_transform(unsigned int state[4], unsigned char block[64])
 {
 	unsigned int a = state[0];
 	unsigned int b = state[1];
@@ -230,6 +232,22 @@ void MD5Transform(unsigned int state[4], unsigned char block[64])
 }
 
 
+void MD5Transform(unsigned int state[4], unsigned char block[64])
+{
+	md5_transform(state, block);
+}
+
+
+#if defined(__x86_64__) && defined(__GNUC__)
+/* the rotations and F/G/I are compiled to rorx and andn */
+__attribute__((target("avx2,bmi,bmi2")))
+void MD5Transform_bmi2(unsigned int state[4], unsigned char block[64])
+{
+	md5_transform(state, block);
+}
+#endif
+
+
 int md5_calculate_block(unsigned char *block_data, unsigned int data_size, unsigned char *md5_value)
 {
     MD5_CTX md5_obj;
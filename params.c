@@ -13,6 +13,9 @@
 #include "params.h"
 #include "utils.h"
 #include "version.h"
+#include "cpu_dispatch.h"
+#include "database.h"
+#include "update_stamp.h"
 
 
 /* copy a string and allocate enough memory (additional 8 bytes for suffix) */
@@ -48,7 +51,39 @@ static void params_show_usage(int params_mode)
         "\n"
         "    project        parse and compare the difference between database and current xml file\n"
         "                   input: bioproject xml file (bioproject.xml) and the database index\n"
-        "                   output: the different data body updated by INSDC\n\n";
+        "                   output: the different data body updated by INSDC\n"
+        "\n"
+        "    history        keep database snapshots of multiple dates and query the difference\n"
+        "                   input: database file (.db) to append, or two dates to query\n"
+        "                   output: history store (.hdb) or the difference list between two dates\n"
+        "\n"
+        "    merge          merge the partial databases built with --range into one database\n"
+        "                   input: partial database files (.db) of the same type and date\n"
+        "                   output: database file (.db)\n"
+        "\n"
+        "    diff           parse and compare the difference between two xml files without database\n"
+        "                   input: the previous and the current xml files\n"
+        "                   output: the different data body updated by INSDC\n"
+        "\n"
+        "    serve          hold the database in memory and answer the lookups over a unix socket\n"
+        "                   input: database file (.db) and the output directory of the latest compare\n"
+        "                   output: the status and MD5 of the given IDs\n"
+        "\n"
+        "    extract        extract the data bodies of the given IDs with the record index (.rix)\n"
+        "                   input: the indexed xml file and the list of IDs\n"
+        "                   output: the data bodies of the given IDs\n"
+        "\n"
+        "    dbcmp          compare two database files with their hash trees (replicas or snapshots)\n"
+        "                   input: two database files (.db)\n"
+        "                   output: the divergent ID ranges and the different IDs (ADD/CHANGE/DELETE)\n"
+        "\n"
+        "    dbdiff         compare the tables of two database files without the xml files\n"
+        "                   input: the previous and the current database files (.db)\n"
+        "                   output: the difference list (ADD/CHANGE/DELETE)\n"
+        "\n"
+        "Options:\n"
+        "    --print-cpu-dispatch         show the cpu features and the kernel variants selected at startup\n"
+        "                                 (" CPU_DISPATCH_ENV "=generic|sse2|avx2|avx512 selects a lower level)\n\n";
 
     const char *usage_build =
         "\nUsage: xml_parser build [options]\n"
@@ -57,10 +92,29 @@ static void params_show_usage(int params_mode)
         "    -h|--help                    show help information\n"
         "\n"
         "[Required]\n"
-        "    -f|--xml_file      FILE      the xml file used to build the database\n"
+        "    -f|--xml_file      FILE      the xml file used to build the database (\"-\": the standard input)\n"
         "    -e|--xml_date      INT       the released date of the xml file (e.g. 20251208)\n"
         "    -t|--xml_type      STRING    the type of xml file [SAMPLE|PROJECT]\n"
         "    -d|--database      FILE      the output xml database file (.db)\n"
+        "\n"
+        "[Optional]\n"
+        "    -c|--checkpoint    INT       save a checkpoint every INT seconds (default: 0, disabled)\n"
+        "    -r|--resume                  continue from the latest checkpoint (<database>.ckpt)\n"
+        "    -g|--range         START:END only build the records start in the byte range [START, END)\n"
+        "                                 (END could be omitted to build until the end of file)\n"
+        "    -b|--body_store              keep the compressed data bodies next to the database (.bst/.bsi)\n"
+        "    -w|--hash_width    INT       the bytes of MD5 kept for each record [8|16] (default: 16)\n"
+        "    -l|--layout        STRING    the layout of the table in memory [split|slot] (default: split)\n"
+        "                                 (slot: the hash and the flag of each ID in one cache line)\n"
+        "    -v|--validate                check the UTF-8, balanced tags and the trailing data of the xml file\n"
+        "    -i|--index                   save the offset and size of each record next to the database (.rix)\n"
+        "    -F|--fields        LIST      save the columns of the fields of each record next to the database (.fcol)\n"
+        "                                 ([name=]@attr, [name=]tag or [name=]tag@attr separated by comma, or default)\n"
+        "    -u|--precheck                save last_update and the size of each record next to the database (.stp)\n"
+        "                                 (SAMPLE only), the next compare only hashes the records changed\n"
+        "    -N|--no_fingerprint          do not save the fingerprints of the chunks next to the database (.cdc)\n"
+        "    -T|--trace         FILE      record the spans of each batch and thread (Chrome trace JSON, Perfetto)\n"
+        "    -R|--io_rate_limit INT       read the xml file at most INT MB per second (default: 0, unlimited)\n"
         "\n\n";
 
     const char *usage_sample =
@@ -70,10 +124,25 @@ static void params_show_usage(int params_mode)
         "    -h|--help                    show help information\n"
         "\n"
         "[Required]\n"
-        "    -f|--xml_file      FILE      the sample xml file used to compare with the database\n"
+        "    -f|--xml_file      FILE      the sample xml file used to compare with the database (\"-\": stdin)\n"
         "    -e|--xml_date      INT       the released date of the xml file (e.g. 20251208)\n"
         "    -d|--database      FILE      the sample xml database file (.db)\n"
-        "    -o|--output_dir    STRING    the output directory\n\n";
+        "    -o|--output_dir    STRING    the output directory\n"
+        "\n"
+        "[Optional]\n"
+        "    -c|--checkpoint    INT       save a checkpoint every INT seconds (default: 0, disabled)\n"
+        "    -r|--resume                  continue from the latest checkpoint (<database>.ckpt)\n"
+        "    -b|--body_store              update the body store and write the previous versions (*_prev.xml)\n"
+        "    -v|--validate                check the UTF-8, balanced tags and the trailing data of the xml file\n"
+        "    -s|--output_shards INT       write the diff xml/list into INT shards by id % INT (default: 1)\n"
+        "    -i|--index                   save the offset and size of each record next to the database (.rix)\n"
+        "    -F|--fields        LIST      save the columns of the fields of each record next to the database (.fcol)\n"
+        "                                 ([name=]@attr, [name=]tag or [name=]tag@attr separated by comma, or default)\n"
+        "    -u|--precheck                only hash the records whose last_update or size is changed (.stp)\n"
+        "    -p|--paranoia      FLOAT     the rate of the unchanged records hashed with --precheck (default: 0.01)\n"
+        "    -N|--no_fingerprint          neither skip the chunks unchanged nor save their fingerprints (.cdc)\n"
+        "    -T|--trace         FILE      record the spans of each batch and thread (Chrome trace JSON, Perfetto)\n"
+        "    -R|--io_rate_limit INT       read the xml file at most INT MB per second (default: 0, unlimited)\n\n";
 
     const char *usage_project =
         "\nUsage: xml_parser project [options]\n"
@@ -82,10 +151,109 @@ static void params_show_usage(int params_mode)
         "    -h|--help                    show help information\n"
         "\n"
         "[Required]\n"
-        "    -f|--xml_file      FILE      the project xml file used to compare with the database\n"
+        "    -f|--xml_file      FILE      the project xml file used to compare with the database (\"-\": stdin)\n"
         "    -e|--xml_date      INT       the released date of the xml file (e.g. 20251208)\n"
         "    -d|--database      FILE      the project xml database file (.db)\n"
-        "    -o|--output_dir    STRING    the output directory\n\n";
+        "    -o|--output_dir    STRING    the output directory\n"
+        "\n"
+        "[Optional]\n"
+        "    -c|--checkpoint    INT       save a checkpoint every INT seconds (default: 0, disabled)\n"
+        "    -r|--resume                  continue from the latest checkpoint (<database>.ckpt)\n"
+        "    -b|--body_store              update the body store and write the previous versions (*_prev.xml)\n"
+        "    -v|--validate                check the UTF-8, balanced tags and the trailing data of the xml file\n"
+        "    -s|--output_shards INT       write the diff xml/list into INT shards by id % INT (default: 1)\n"
+        "    -i|--index                   save the offset and size of each record next to the database (.rix)\n"
+        "    -F|--fields        LIST      save the columns of the fields of each record next to the database (.fcol)\n"
+        "                                 ([name=]@attr, [name=]tag or [name=]tag@attr separated by comma, or default)\n"
+        "    -N|--no_fingerprint          neither skip the chunks unchanged nor save their fingerprints (.cdc)\n"
+        "    -T|--trace         FILE      record the spans of each batch and thread (Chrome trace JSON, Perfetto)\n"
+        "    -R|--io_rate_limit INT       read the xml file at most INT MB per second (default: 0, unlimited)\n\n";
+
+    const char *usage_history =
+        "\nUsage: xml_parser history [options]\n"
+        "\n"
+        "Options:\n"
+        "    -h|--help                    show help information\n"
+        "\n"
+        "[Required]\n"
+        "    -s|--store         FILE      the history store file (.hdb), created if not existed\n"
+        "\n"
+        "[Append]\n"
+        "    -d|--database      FILE      the database file (.db) appended as a new snapshot\n"
+        "\n"
+        "[Query]\n"
+        "    -x|--from_date     INT       the earlier date to compare (e.g. 20251130)\n"
+        "    -y|--to_date       INT       the later date to compare (e.g. 20251205)\n"
+        "    -o|--output        FILE      the output difference list\n\n";
+
+    const char *usage_merge =
+        "\nUsage: xml_parser merge [options] <partial.db> [partial.db ...]\n"
+        "\n"
+        "Options:\n"
+        "    -h|--help                    show help information\n"
+        "\n"
+        "[Required]\n"
+        "    -d|--database      FILE      the output merged database file (.db)\n\n";
+
+    const char *usage_diff =
+        "\nUsage: xml_parser diff [options]\n"
+        "\n"
+        "Options:\n"
+        "    -h|--help                    show help information\n"
+        "\n"
+        "[Required]\n"
+        "    -p|--prev_file     FILE      the previous xml file\n"
+        "    -f|--xml_file      FILE      the current xml file (\"-\": the standard input)\n"
+        "    -t|--xml_type      STRING    the type of xml file [SAMPLE|PROJECT]\n"
+        "    -o|--output_dir    STRING    the output directory\n"
+        "\n"
+        "[Optional]\n"
+        "    -v|--validate                check the UTF-8, balanced tags and the trailing data of the xml file\n"
+        "    -R|--io_rate_limit INT       read both xml files at most INT MB per second (default: 0, unlimited)\n\n";
+
+    const char *usage_serve =
+        "\nUsage: xml_parser serve [options]\n"
+        "\n"
+        "Options:\n"
+        "    -h|--help                    show help information\n"
+        "\n"
+        "[Required]\n"
+        "    -d|--database      FILE      the xml database file (.db)\n"
+        "    -s|--socket        FILE      the unix domain socket to listen\n"
+        "\n"
+        "[Optional]\n"
+        "    -o|--output_dir    STRING    the output directory of the latest compare (with *_diff.list)\n"
+        "    -i|--interval      INT       the interval (seconds) to check the database file (default: 5)\n\n";
+
+    const char *usage_extract =
+        "\nUsage: xml_parser extract [options]\n"
+        "\n"
+        "Options:\n"
+        "    -h|--help                    show help information\n"
+        "\n"
+        "[Required]\n"
+        "    -d|--database      FILE      the xml database file (.db) built or compared with --index\n"
+        "    -f|--xml_file      FILE      the xml file indexed by the database\n"
+        "    -i|--ids           FILE      the IDs to extract, the last number of each line (\"-\": stdin)\n"
+        "    -o|--output        FILE      the output xml file\n\n";
+
+    const char *usage_dbcmp =
+        "\nUsage: xml_parser dbcmp [options] <prev.db> <curr.db>\n"
+        "\n"
+        "Options:\n"
+        "    -h|--help                    show help information\n"
+        "\n"
+        "[Optional]\n"
+        "    -o|--output        FILE      the output difference list (default: the standard output)\n\n";
+
+    const char *usage_dbdiff =
+        "\nUsage: xml_parser dbdiff [options] <prev.db> <curr.db>\n"
+        "\n"
+        "Options:\n"
+        "    -h|--help                    show help information\n"
+        "\n"
+        "[Optional]\n"
+        "    -o|--output        FILE      the output difference list (default: the standard output)\n\n";
 
     fprintf(stderr, "Program: xml_parser (v%s)\n", PARSER_VERSION_STRING);
     fprintf(stderr, "CreateDate: %s\n", PARSER_CREATE_DATE);
@@ -105,6 +273,34 @@ static void params_show_usage(int params_mode)
         fprintf(stderr, "%s", usage_project);
         break;
 
+    case PARAMS_HISTORY:
+        fprintf(stderr, "%s", usage_history);
+        break;
+
+    case PARAMS_MERGE:
+        fprintf(stderr, "%s", usage_merge);
+        break;
+
+    case PARAMS_DIFF:
+        fprintf(stderr, "%s", usage_diff);
+        break;
+
+    case PARAMS_SERVE:
+        fprintf(stderr, "%s", usage_serve);
+        break;
+
+    case PARAMS_EXTRACT:
+        fprintf(stderr, "%s", usage_extract);
+        break;
+
+    case PARAMS_DBCMP:
+        fprintf(stderr, "%s", usage_dbcmp);
+        break;
+
+    case PARAMS_DBDIFF:
+        fprintf(stderr, "%s", usage_dbdiff);
+        break;
+
     default:
         fprintf(stderr, "%s", usage_main);
         break;
@@ -120,10 +316,48 @@ static const struct option build_options[] =
     {"xml_date",  required_argument,  NULL, 'e'},
     {"xml_type",  required_argument,  NULL, 't'},
     {"database",  required_argument,  NULL, 'd'},
+    {"checkpoint",  required_argument,  NULL, 'c'},
+    {"resume",  no_argument,  NULL, 'r'},
+    {"range",  required_argument,  NULL, 'g'},
+    {"body_store",  no_argument,  NULL, 'b'},
+    {"hash_width",  required_argument,  NULL, 'w'},
+    {"layout",  required_argument,  NULL, 'l'},
+    {"validate",  no_argument,  NULL, 'v'},
+    {"index",  no_argument,  NULL, 'i'},
+    {"fields",  required_argument,  NULL, 'F'},
+    {"precheck",  no_argument,  NULL, 'u'},
+    {"no_fingerprint",  no_argument,  NULL, 'N'},
+    {"trace",  required_argument,  NULL, 'T'},
+    {"io_rate_limit",  required_argument,  NULL, 'R'},
     {NULL,  0,  NULL,  0}
 };
 
 
+/* parse the byte range with format START:END (END could be omitted) */
+static void params_range_parse(args_t *args, const char *range)
+{
+    char *end_ptr;
+
+    args->range_start = strtoull(range, &end_ptr, 10);
+    args->range_end = UINT64_MAX;
+
+    if (end_ptr == range || *end_ptr != ':') goto _range_error;
+
+    if (*(++end_ptr) != '\0') {
+        const char *end_str = end_ptr;
+        args->range_end = strtoull(end_str, &end_ptr, 10);
+        if (end_ptr == end_str || *end_ptr != '\0') goto _range_error;
+    }
+
+    if (args->range_start >= args->range_end) goto _range_error;
+    return;
+
+    _range_error:
+    fprintf(stderr, "[Error:%s] the range (%s) is INVALID (e.g. 0:1073741824)!\n\n", __func__, range);
+    exit(-1);
+}
+
+
 static args_t *params_build_parse(int argc, char **argv)
 {
     int opt;
@@ -132,9 +366,11 @@ static args_t *params_build_parse(int argc, char **argv)
     /* set the default parameters */
     err_calloc(args, 1, args_t);
     args->params_mode = PARAMS_BUILD;
+    args->range_end = UINT64_MAX;
+    args->hash_width = 16;
 
     /* parse the command line parameters */
-    while ( (opt = getopt_long(argc, argv, "f:e:t:d:h", build_options, NULL)) != -1 )
+    while ( (opt = getopt_long(argc, argv, "f:e:t:d:c:rg:bw:l:viF:uNT:R:h", build_options, NULL)) != -1 )
     {
         switch (opt) {
         case 'h':
@@ -166,6 +402,74 @@ static args_t *params_build_parse(int argc, char **argv)
             args->database = params_str_dup(optarg);
             break;
 
+        case 'c':
+            args->checkpoint = (int)strtol(optarg, NULL, 10);
+            if (args->checkpoint < 0) {
+                fprintf(stderr, "[Error:%s] the checkpoint interval (%s) is INVALID!\n\n", __func__, optarg);
+                exit(-1);
+            }
+            break;
+
+        case 'r':
+            args->resume = 1;
+            break;
+
+        case 'g':
+            params_range_parse(args, optarg);
+            break;
+
+        case 'b':
+            args->body_store = 1;
+            break;
+
+        case 'v':
+            args->validate = 1;
+            break;
+
+        case 'i':
+            args->record_index = 1;
+            break;
+
+        case 'F':
+            args->fields = params_str_dup(optarg);
+            break;
+
+        case 'u':
+            args->precheck = 1;
+            break;
+
+        case 'N':
+            args->no_fingerprint = 1;
+            break;
+
+        case 'T':
+            args->trace_file = params_str_dup(optarg);
+            break;
+
+        case 'R':
+            args->io_rate_limit = (int)strtol(optarg, NULL, 10);
+            if (args->io_rate_limit < 0) {
+                fprintf(stderr, "[Error:%s] the io rate limit (%s) is INVALID!\n\n", __func__, optarg);
+                exit(-1);
+            }
+            break;
+
+        case 'w':
+            args->hash_width = (int)strtol(optarg, NULL, 10);
+            if (args->hash_width != 8 && args->hash_width != 16) {
+                fprintf(stderr, "[Error:%s] the hash width (%s) is INVALID (8 or 16)!\n\n", __func__, optarg);
+                exit(-1);
+            }
+            break;
+
+        case 'l':
+            if (strcmp(optarg, "split") != 0 && strcmp(optarg, "slot") != 0) {
+                fprintf(stderr, "[Error:%s] the layout (%s) is INVALID (split or slot)!\n\n", __func__, optarg);
+                exit(-1);
+            }
+            args->layout = strcmp(optarg, "slot") == 0 ? DATABASE_LAYOUT_SLOT : DATABASE_LAYOUT_SPLIT;
+            break;
+
         default:
             args->help = 1;
             params_show_usage(PARAMS_BUILD);
@@ -179,6 +483,12 @@ static args_t *params_build_parse(int argc, char **argv)
         params_show_usage(PARAMS_BUILD);
     }
 
+    /* only the start tag of BioSample has last_update */
+    if (args->precheck && args->xml_type && strcmp(args->xml_type, "SAMPLE") != 0) {
+        fprintf(stderr, "[Error:%s] the pre-check (--precheck) is only for the SAMPLE xml file!\n\n", __func__);
+        exit(-1);
+    }
+
     return args;
 }
 
@@ -190,6 +500,18 @@ static const struct option sample_options[] =
     {"xml_date",  required_argument,  NULL, 'e'},
     {"database",  required_argument,  NULL, 'd'},
     {"output_dir",  required_argument,  NULL, 'o'},
+    {"checkpoint",  required_argument,  NULL, 'c'},
+    {"resume",  no_argument,  NULL, 'r'},
+    {"body_store",  no_argument,  NULL, 'b'},
+    {"validate",  no_argument,  NULL, 'v'},
+    {"output_shards",  required_argument,  NULL, 's'},
+    {"index",  no_argument,  NULL, 'i'},
+    {"fields",  required_argument,  NULL, 'F'},
+    {"precheck",  no_argument,  NULL, 'u'},
+    {"paranoia",  required_argument,  NULL, 'p'},
+    {"no_fingerprint",  no_argument,  NULL, 'N'},
+    {"trace",  required_argument,  NULL, 'T'},
+    {"io_rate_limit",  required_argument,  NULL, 'R'},
     {NULL,  0,  NULL,  0}
 };
 
@@ -197,14 +519,17 @@ static const struct option sample_options[] =
 static args_t *params_sample_parse(int argc, char **argv)
 {
     int opt;
+    char *end_ptr;
     args_t *args;
 
     /* set the default parameters */
     err_calloc(args, 1, args_t);
     args->params_mode = PARAMS_SAMPLE;
+    args->output_shards = 1;
+    args->paranoia = -1.0;
 
     /* parse the command line parameters */
-    while ( (opt = getopt_long(argc, argv, "f:e:d:o:h", sample_options, NULL)) != -1 )
+    while ( (opt = getopt_long(argc, argv, "f:e:d:o:c:rbvs:iF:up:NT:R:h", sample_options, NULL)) != -1 )
     {
         switch (opt) {
             case 'h':
@@ -232,6 +557,70 @@ static args_t *params_sample_parse(int argc, char **argv)
                 args->output_dir = params_str_dup(optarg);
                 break;
 
+            case 'c':
+                args->checkpoint = (int)strtol(optarg, NULL, 10);
+                if (args->checkpoint < 0) {
+                    fprintf(stderr, "[Error:%s] the checkpoint interval (%s) is INVALID!\n\n", __func__, optarg);
+                    exit(-1);
+                }
+                break;
+
+            case 'r':
+                args->resume = 1;
+                break;
+
+            case 'b':
+                args->body_store = 1;
+                break;
+
+            case 'v':
+                args->validate = 1;
+                break;
+
+            case 'i':
+                args->record_index = 1;
+                break;
+
+            case 'F':
+                args->fields = params_str_dup(optarg);
+                break;
+
+            case 'u':
+                args->precheck = 1;
+                break;
+
+            case 'p':
+                args->paranoia = strtod(optarg, &end_ptr);
+                if (end_ptr == optarg || *end_ptr != '\0' || !(args->paranoia >= 0.0 && args->paranoia <= 1.0)) {
+                    fprintf(stderr, "[Error:%s] the paranoia rate (%s) is INVALID (0 to 1)!\n\n", __func__, optarg);
+                    exit(-1);
+                }
+                break;
+
+            case 'N':
+                args->no_fingerprint = 1;
+                break;
+
+            case 'T':
+                args->trace_file = params_str_dup(optarg);
+                break;
+
+            case 'R':
+                args->io_rate_limit = (int)strtol(optarg, NULL, 10);
+                if (args->io_rate_limit < 0) {
+                    fprintf(stderr, "[Error:%s] the io rate limit (%s) is INVALID!\n\n", __func__, optarg);
+                    exit(-1);
+                }
+                break;
+
+            case 's':
+                args->output_shards = (int)strtol(optarg, NULL, 10);
+                if (args->output_shards < 1 || args->output_shards > PARAMS_MAX_SHARD) {
+                    fprintf(stderr, "[Error:%s] the number of output shards (%s) is INVALID!\n\n", __func__, optarg);
+                    exit(-1);
+                }
+                break;
+
             default:
                 args->help = 1;
                 params_show_usage(PARAMS_SAMPLE);
@@ -245,6 +634,12 @@ static args_t *params_sample_parse(int argc, char **argv)
         params_show_usage(PARAMS_SAMPLE);
     }
 
+    if (args->paranoia >= 0.0 && !args->precheck) {
+        fprintf(stderr, "[Error:%s] the paranoia rate is only used with --precheck!\n\n", __func__);
+        exit(-1);
+    }
+    if (args->paranoia < 0.0) args->paranoia = STAMP_PARANOIA;
+
     return args;
 }
 
@@ -257,6 +652,16 @@ static const struct option project_options[] =
     {"xml_date",  required_argument,  NULL, 'e'},
     {"database",  required_argument,  NULL, 'd'},
     {"output_dir",  required_argument,  NULL, 'o'},
+    {"checkpoint",  required_argument,  NULL, 'c'},
+    {"resume",  no_argument,  NULL, 'r'},
+    {"body_store",  no_argument,  NULL, 'b'},
+    {"validate",  no_argument,  NULL, 'v'},
+    {"output_shards",  required_argument,  NULL, 's'},
+    {"index",  no_argument,  NULL, 'i'},
+    {"fields",  required_argument,  NULL, 'F'},
+    {"no_fingerprint",  no_argument,  NULL, 'N'},
+    {"trace",  required_argument,  NULL, 'T'},
+    {"io_rate_limit",  required_argument,  NULL, 'R'},
     {NULL,  0,  NULL,  0}
 };
 
@@ -269,9 +674,10 @@ static args_t *params_project_parse(int argc, char **argv)
     /* set the default parameters */
     err_calloc(args, 1, args_t);
     args->params_mode = PARAMS_PROJECT;
+    args->output_shards = 1;
 
     /* parse the command line parameters */
-    while ( (opt = getopt_long(argc, argv, "f:e:d:o:h", project_options, NULL)) != -1 )
+    while ( (opt = getopt_long(argc, argv, "f:e:d:o:c:rbvs:iF:NT:R:h", project_options, NULL)) != -1 )
     {
         switch (opt) {
             case 'h':
@@ -299,6 +705,58 @@ static args_t *params_project_parse(int argc, char **argv)
                 args->output_dir = params_str_dup(optarg);
                 break;
 
+            case 'c':
+                args->checkpoint = (int)strtol(optarg, NULL, 10);
+                if (args->checkpoint < 0) {
+                    fprintf(stderr, "[Error:%s] the checkpoint interval (%s) is INVALID!\n\n", __func__, optarg);
+                    exit(-1);
+                }
+                break;
+
+            case 'r':
+                args->resume = 1;
+                break;
+
+            case 'b':
+                args->body_store = 1;
+                break;
+
+            case 'v':
+                args->validate = 1;
+                break;
+
+            case 'i':
+                args->record_index = 1;
+                break;
+
+            case 'F':
+                args->fields = params_str_dup(optarg);
+                break;
+
+            case 'N':
+                args->no_fingerprint = 1;
+                break;
+
+            case 'T':
+                args->trace_file = params_str_dup(optarg);
+                break;
+
+            case 'R':
+                args->io_rate_limit = (int)strtol(optarg, NULL, 10);
+                if (args->io_rate_limit < 0) {
+                    fprintf(stderr, "[Error:%s] the io rate limit (%s) is INVALID!\n\n", __func__, optarg);
+                    exit(-1);
+                }
+                break;
+
+            case 's':
+                args->output_shards = (int)strtol(optarg, NULL, 10);
+                if (args->output_shards < 1 || args->output_shards > PARAMS_MAX_SHARD) {
+                    fprintf(stderr, "[Error:%s] the number of output shards (%s) is INVALID!\n\n", __func__, optarg);
+                    exit(-1);
+                }
+                break;
+
             default:
                 args->help = 1;
                 params_show_usage(PARAMS_PROJECT);
@@ -316,6 +774,446 @@ static args_t *params_project_parse(int argc, char **argv)
 }
 
 
+static const struct option history_options[] =
+{
+    {"help",  no_argument,  NULL, 'h'},
+    {"store", required_argument,  NULL, 's'},
+    {"database",  required_argument,  NULL, 'd'},
+    {"from_date",  required_argument,  NULL, 'x'},
+    {"to_date",  required_argument,  NULL, 'y'},
+    {"output",  required_argument,  NULL, 'o'},
+    {NULL,  0,  NULL,  0}
+};
+
+
+static args_t *params_history_parse(int argc, char **argv)
+{
+    int opt;
+    args_t *args;
+
+    /* set the default parameters */
+    err_calloc(args, 1, args_t);
+    args->params_mode = PARAMS_HISTORY;
+
+    /* parse the command line parameters */
+    while ( (opt = getopt_long(argc, argv, "s:d:x:y:o:h", history_options, NULL)) != -1 )
+    {
+        switch (opt) {
+            case 'h':
+                args->help = 1;
+                params_show_usage(PARAMS_HISTORY);
+                break;
+
+            case 's':
+                args->history = params_str_dup(optarg);
+                break;
+
+            case 'd':
+                args->database = params_str_dup(optarg);
+                break;
+
+            case 'x':
+                args->from_date = (int)strtol(optarg, NULL, 10);
+                if (args->from_date < 20250101 || args->from_date > 20990101) {
+                    fprintf(stderr, "[Error:%s] the from date (%s) is INVALID!\n\n", __func__, optarg);
+                    exit(-1);
+                }
+                break;
+
+            case 'y':
+                args->to_date = (int)strtol(optarg, NULL, 10);
+                if (args->to_date < 20250101 || args->to_date > 20990101) {
+                    fprintf(stderr, "[Error:%s] the to date (%s) is INVALID!\n\n", __func__, optarg);
+                    exit(-1);
+                }
+                break;
+
+            case 'o':
+                args->output_file = params_str_dup(optarg);
+                break;
+
+            default:
+                args->help = 1;
+                params_show_usage(PARAMS_HISTORY);
+                break;
+        }
+    }
+
+    /* check the required parameters */
+    if (!args->history || (!args->database && !args->output_file)) {
+        fprintf(stderr, "[Error:%s] the history store and either database or output are required!\n\n", __func__);
+        params_show_usage(PARAMS_HISTORY);
+    }
+
+    if (args->output_file && (!args->from_date || !args->to_date || args->from_date >= args->to_date)) {
+        fprintf(stderr, "[Error:%s] the from date must be earlier than the to date!\n\n", __func__);
+        params_show_usage(PARAMS_HISTORY);
+    }
+
+    return args;
+}
+
+
+static const struct option merge_options[] =
+{
+    {"help",  no_argument,  NULL, 'h'},
+    {"database",  required_argument,  NULL, 'd'},
+    {NULL,  0,  NULL,  0}
+};
+
+
+static args_t *params_merge_parse(int argc, char **argv)
+{
+    int opt;
+    args_t *args;
+
+    /* set the default parameters */
+    err_calloc(args, 1, args_t);
+    args->params_mode = PARAMS_MERGE;
+
+    /* parse the command line parameters */
+    while ( (opt = getopt_long(argc, argv, "d:h", merge_options, NULL)) != -1 )
+    {
+        switch (opt) {
+            case 'h':
+                args->help = 1;
+                params_show_usage(PARAMS_MERGE);
+                break;
+
+            case 'd':
+                args->database = params_str_dup(optarg);
+                break;
+
+            default:
+                args->help = 1;
+                params_show_usage(PARAMS_MERGE);
+                break;
+        }
+    }
+
+    /* the remaining parameters are the partial databases */
+    args->n_input = argc - optind;
+    args->inputs = argv + optind;
+
+    /* check the required parameters */
+    if (!args->database || args->n_input < 1) {
+        fprintf(stderr, "[Error:%s] the output database and at least one partial database are required!\n\n", __func__);
+        params_show_usage(PARAMS_MERGE);
+    }
+
+    return args;
+}
+
+
+static const struct option diff_options[] =
+{
+    {"help",  no_argument,  NULL, 'h'},
+    {"prev_file", required_argument,  NULL, 'p'},
+    {"xml_file", required_argument,  NULL, 'f'},
+    {"xml_type",  required_argument,  NULL, 't'},
+    {"output_dir",  required_argument,  NULL, 'o'},
+    {"validate",  no_argument,  NULL, 'v'},
+    {"io_rate_limit",  required_argument,  NULL, 'R'},
+    {NULL,  0,  NULL,  0}
+};
+
+
+static args_t *params_diff_parse(int argc, char **argv)
+{
+    int opt;
+    args_t *args;
+
+    /* set the default parameters */
+    err_calloc(args, 1, args_t);
+    args->params_mode = PARAMS_DIFF;
+
+    /* parse the command line parameters */
+    while ( (opt = getopt_long(argc, argv, "p:f:t:o:vR:h", diff_options, NULL)) != -1 )
+    {
+        switch (opt) {
+            case 'h':
+                args->help = 1;
+                params_show_usage(PARAMS_DIFF);
+                break;
+
+            case 'p':
+                args->prev_file = params_str_dup(optarg);
+                break;
+
+            case 'f':
+                args->xml_file = params_str_dup(optarg);
+                break;
+
+            case 't':
+                args->xml_type = params_str_dup(optarg);
+                if (strcmp(args->xml_type, "SAMPLE") != 0 && strcmp(args->xml_type, "PROJECT") != 0) {
+                    fprintf(stderr, "[Error:%s] the xml_type (%s) is INVALID!\n\n", __func__, optarg);
+                    exit(-1);
+                }
+                break;
+
+            case 'o':
+                args->output_dir = params_str_dup(optarg);
+                break;
+
+            case 'v':
+                args->validate = 1;
+                break;
+
+            case 'R':
+                args->io_rate_limit = (int)strtol(optarg, NULL, 10);
+                if (args->io_rate_limit < 0) {
+                    fprintf(stderr, "[Error:%s] the io rate limit (%s) is INVALID!\n\n", __func__, optarg);
+                    exit(-1);
+                }
+                break;
+
+            default:
+                args->help = 1;
+                params_show_usage(PARAMS_DIFF);
+                break;
+        }
+    }
+
+    /* check the required parameters */
+    if (!args->prev_file || !args->xml_file || !args->xml_type || !args->output_dir) {
+        fprintf(stderr, "[Error:%s] the two xml files, xml type and output directory are required!\n\n", __func__);
+        params_show_usage(PARAMS_DIFF);
+    }
+
+    return args;
+}
+
+
+static const struct option serve_options[] =
+{
+    {"help",  no_argument,  NULL, 'h'},
+    {"database",  required_argument,  NULL, 'd'},
+    {"socket",  required_argument,  NULL, 's'},
+    {"output_dir",  required_argument,  NULL, 'o'},
+    {"interval",  required_argument,  NULL, 'i'},
+    {NULL,  0,  NULL,  0}
+};
+
+
+static args_t *params_serve_parse(int argc, char **argv)
+{
+    int opt;
+    args_t *args;
+
+    /* set the default parameters */
+    err_calloc(args, 1, args_t);
+    args->params_mode = PARAMS_SERVE;
+    args->interval = 5;
+
+    /* parse the command line parameters */
+    while ( (opt = getopt_long(argc, argv, "d:s:o:i:h", serve_options, NULL)) != -1 )
+    {
+        switch (opt) {
+            case 'h':
+                args->help = 1;
+                params_show_usage(PARAMS_SERVE);
+                break;
+
+            case 'd':
+                args->database = params_str_dup(optarg);
+                break;
+
+            case 's':
+                args->socket = params_str_dup(optarg);
+                break;
+
+            case 'o':
+                args->output_dir = params_str_dup(optarg);
+                break;
+
+            case 'i':
+                args->interval = (int)strtol(optarg, NULL, 10);
+                if (args->interval <= 0) {
+                    fprintf(stderr, "[Error:%s] the interval (%s) is INVALID!\n\n", __func__, optarg);
+                    exit(-1);
+                }
+                break;
+
+            default:
+                args->help = 1;
+                params_show_usage(PARAMS_SERVE);
+                break;
+        }
+    }
+
+    /* check the required parameters */
+    if (!args->database || !args->socket) {
+        fprintf(stderr, "[Error:%s] the database and socket are required!\n\n", __func__);
+        params_show_usage(PARAMS_SERVE);
+    }
+
+    return args;
+}
+
+
+static const struct option extract_options[] =
+{
+    {"help",  no_argument,  NULL, 'h'},
+    {"database",  required_argument,  NULL, 'd'},
+    {"xml_file", required_argument,  NULL, 'f'},
+    {"ids",  required_argument,  NULL, 'i'},
+    {"output",  required_argument,  NULL, 'o'},
+    {NULL,  0,  NULL,  0}
+};
+
+
+static args_t *params_extract_parse(int argc, char **argv)
+{
+    int opt;
+    args_t *args;
+
+    /* set the default parameters */
+    err_calloc(args, 1, args_t);
+    args->params_mode = PARAMS_EXTRACT;
+
+    /* parse the command line parameters */
+    while ( (opt = getopt_long(argc, argv, "d:f:i:o:h", extract_options, NULL)) != -1 )
+    {
+        switch (opt) {
+            case 'h':
+                args->help = 1;
+                params_show_usage(PARAMS_EXTRACT);
+                break;
+
+            case 'd':
+                args->database = params_str_dup(optarg);
+                break;
+
+            case 'f':
+                args->xml_file = params_str_dup(optarg);
+                break;
+
+            case 'i':
+                args->ids_file = params_str_dup(optarg);
+                break;
+
+            case 'o':
+                args->output_file = params_str_dup(optarg);
+                break;
+
+            default:
+                args->help = 1;
+                params_show_usage(PARAMS_EXTRACT);
+                break;
+        }
+    }
+
+    /* check the required parameters */
+    if (!args->database || !args->xml_file || !args->ids_file || !args->output_file) {
+        fprintf(stderr, "[Error:%s] the database, xml file, id list and output file are required!\n\n", __func__);
+        params_show_usage(PARAMS_EXTRACT);
+    }
+
+    return args;
+}
+
+
+static const struct option dbcmp_options[] =
+{
+    {"help",  no_argument,  NULL, 'h'},
+    {"output",  required_argument,  NULL, 'o'},
+    {NULL,  0,  NULL,  0}
+};
+
+
+static args_t *params_dbcmp_parse(int argc, char **argv)
+{
+    int opt;
+    args_t *args;
+
+    /* set the default parameters */
+    err_calloc(args, 1, args_t);
+    args->params_mode = PARAMS_DBCMP;
+
+    /* parse the command line parameters */
+    while ( (opt = getopt_long(argc, argv, "o:h", dbcmp_options, NULL)) != -1 )
+    {
+        switch (opt) {
+            case 'h':
+                args->help = 1;
+                params_show_usage(PARAMS_DBCMP);
+                break;
+
+            case 'o':
+                args->output_file = params_str_dup(optarg);
+                break;
+
+            default:
+                args->help = 1;
+                params_show_usage(PARAMS_DBCMP);
+                break;
+        }
+    }
+
+    /* the remaining parameters are the two databases */
+    args->n_input = argc - optind;
+    args->inputs = argv + optind;
+
+    if (args->n_input != 2) {
+        fprintf(stderr, "[Error:%s] two database files are required!\n\n", __func__);
+        params_show_usage(PARAMS_DBCMP);
+    }
+
+    return args;
+}
+
+
+static const struct option dbdiff_options[] =
+{
+    {"help",  no_argument,  NULL, 'h'},
+    {"output",  required_argument,  NULL, 'o'},
+    {NULL,  0,  NULL,  0}
+};
+
+
+static args_t *params_dbdiff_parse(int argc, char **argv)
+{
+    int opt;
+    args_t *args;
+
+    /* set the default parameters */
+    err_calloc(args, 1, args_t);
+    args->params_mode = PARAMS_DBDIFF;
+
+    /* parse the command line parameters */
+    while ( (opt = getopt_long(argc, argv, "o:h", dbdiff_options, NULL)) != -1 )
+    {
+        switch (opt) {
+            case 'h':
+                args->help = 1;
+                params_show_usage(PARAMS_DBDIFF);
+                break;
+
+            case 'o':
+                args->output_file = params_str_dup(optarg);
+                break;
+
+            default:
+                args->help = 1;
+                params_show_usage(PARAMS_DBDIFF);
+                break;
+        }
+    }
+
+    /* the remaining parameters are the previous and current databases */
+    args->n_input = argc - optind;
+    args->inputs = argv + optind;
+
+    if (args->n_input != 2) {
+        fprintf(stderr, "[Error:%s] two database files are required!\n\n", __func__);
+        params_show_usage(PARAMS_DBDIFF);
+    }
+
+    return args;
+}
+
+
 args_t *params_parse(int argc, char **argv)
 {
     args_t *args = NULL;
@@ -325,6 +1223,11 @@ args_t *params_parse(int argc, char **argv)
         return args;
     }
 
+    if (strcmp(argv[1], "--print-cpu-dispatch") == 0) {
+        cpu_dispatch_print(stdout);
+        exit(0);
+    }
+
     /* check the first parameter to decide which function to call */
     if (strcmp(argv[1], "build") == 0)
         args = params_build_parse(argc-1, argv+1);
@@ -335,6 +1238,27 @@ args_t *params_parse(int argc, char **argv)
     else if (strcmp(argv[1], "project") == 0)
         args = params_project_parse(argc-1, argv+1);
 
+    else if (strcmp(argv[1], "history") == 0)
+        args = params_history_parse(argc-1, argv+1);
+
+    else if (strcmp(argv[1], "merge") == 0)
+        args = params_merge_parse(argc-1, argv+1);
+
+    else if (strcmp(argv[1], "diff") == 0)
+        args = params_diff_parse(argc-1, argv+1);
+
+    else if (strcmp(argv[1], "serve") == 0)
+        args = params_serve_parse(argc-1, argv+1);
+
+    else if (strcmp(argv[1], "extract") == 0)
+        args = params_extract_parse(argc-1, argv+1);
+
+    else if (strcmp(argv[1], "dbcmp") == 0)
+        args = params_dbcmp_parse(argc-1, argv+1);
+
+    else if (strcmp(argv[1], "dbdiff") == 0)
+        args = params_dbdiff_parse(argc-1, argv+1);
+
     else {
         fprintf(stderr, "[Error:%s] unrecognized command '%s' is detected!\n\n", __func__, argv[1]);
         params_show_usage(PARAMS_INVALID);
@@ -8,16 +8,29 @@
 #ifndef INSDCXMLPARSER_PARAMS_H
 #define INSDCXMLPARSER_PARAMS_H
 
+#include <stdint.h>
+
 
 /* chose the mode to decide operation */
 enum ParamsMode {
     PARAMS_INVALID=0,
     PARAMS_BUILD=1,
     PARAMS_SAMPLE = 2,
-    PARAMS_PROJECT = 3
+    PARAMS_PROJECT = 3,
+    PARAMS_HISTORY = 4,
+    PARAMS_MERGE = 5,
+    PARAMS_DIFF = 6,
+    PARAMS_SERVE = 7,
+    PARAMS_EXTRACT = 8,
+    PARAMS_DBCMP = 9,
+    PARAMS_DBDIFF = 10
 };
 
 
+/* the maximum number of the output shards (each shard keeps a file open) */
+#define PARAMS_MAX_SHARD 256
+
+
 /*! @typedef args_t
   @abstract structure for the command line args
   @field help                [0|1] 1: print the help information
@@ -27,6 +40,32 @@ enum ParamsMode {
   @field xml_type            the type of the xml file, only could be SAMPLE or PROJECT
   @field database            the database name generated by xml_file (e.g. biosample.db)
   @field output_dir          the output directory, which only used in comparing operation
+  @field history             the history store with multiple database snapshots (e.g. biosample.hdb)
+  @field from_date           the earlier date to query from the history store
+  @field to_date             the later date to query from the history store
+  @field output_file         the output file, which only used in history query
+  @field checkpoint          the interval (seconds) to save the checkpoint (0: disabled)
+  @field resume              [0|1] 1: continue from the latest checkpoint
+  @field range_start         the start offset of the xml file to build (records start from it)
+  @field range_end           the end offset of the xml file to build (records start before it)
+  @field n_input             the number of input files, which only used in merging and database comparing operation
+  @field inputs              the input files, which only used in merging and database comparing operation
+  @field prev_file           the previous xml file, which only used in diff operation
+  @field socket              the unix domain socket to listen, which only used in serve operation
+  @field interval            the interval (seconds) to check the database file, which only used in serve operation
+  @field body_store          [0|1] 1: keep the compressed data bodies next to the database
+  @field hash_width          [8|16] the bytes of MD5 kept for each record, which only used in building operation
+  @field layout              [0|1] 1: keep the hash and the flag of each ID in one slot, which only used in building
+  @field validate            [0|1] 1: validate the xml file while scanning
+  @field output_shards       the number of diff xml/list files partitioned by id % output_shards (1: no shard)
+  @field record_index        [0|1] 1: save the offset and size of each data body next to the database (.rix)
+  @field fields              the fields extracted into the columns next to the database (NULL: disabled)
+  @field precheck            [0|1] 1: only hash the records whose last_update or size is changed (SAMPLE)
+  @field paranoia            the rate of the records hashed although last_update and size are unchanged
+  @field ids_file            the list of ids to extract, which only used in extracting operation
+  @field no_fingerprint      [0|1] 1: neither skip the unchanged chunks nor save the chunk fingerprints (.cdc)
+  @field trace_file          the output trace of the spans of each batch and thread (NULL: disabled)
+  @field io_rate_limit       the MB read per second from the xml files (0: unlimited)
 */
 typedef struct args_t {
     int help;
@@ -36,6 +75,32 @@ typedef struct args_t {
     char *xml_type;
     char *database;
     char *output_dir;
+    char *history;
+    int from_date;
+    int to_date;
+    char *output_file;
+    int checkpoint;
+    int resume;
+    uint64_t range_start;
+    uint64_t range_end;
+    int n_input;
+    char **inputs;
+    char *prev_file;
+    char *socket;
+    int interval;
+    int body_store;
+    int hash_width;
+    int layout;
+    int validate;
+    int output_shards;
+    int record_index;
+    char *fields;
+    int precheck;
+    double paranoia;
+    char *ids_file;
+    int no_fingerprint;
+    char *trace_file;
+    int io_rate_limit;
 } args_t;
 
 
@@ -0,0 +1,231 @@
+/*************************************************************************
+    > File Name: record_index.c
+    > Author: xlzh
+    > Mail: xiaolongzhang2015@163.com
+    > Created Time: 2025年12月24 15时26分08秒
+ ************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "utils.h"
+#include "record_index.h"
+#include "checkpoint.h"
+
+
+/* the size of the header: magic[8], version, xml_date, xml_size, capacity, n_record */
+#define RECORD_HEADER_SIZE 32
+
+
+#define record_memory_resize(_index, _n) do {                                      \
+    if ((_index)->capacity < (_n)) {                                               \
+        uint32_t _old = (_index)->capacity;                                        \
+        (_index)->capacity = (_n); kroundup32((_index)->capacity);                 \
+        err_realloc((_index)->offsets, (_index)->capacity, uint64_t);              \
+        err_realloc((_index)->sizes, (_index)->capacity, uint32_t);                \
+        memset((_index)->offsets + _old, 0, ((_index)->capacity - _old) * sizeof(uint64_t)); \
+        memset((_index)->sizes + _old, 0, ((_index)->capacity - _old) * sizeof(uint32_t));   \
+    }                                                                              \
+} while(0)
+
+
+static void record_index_name(const char *db_name, int checkpoint, char *name, size_t size)
+{
+    snprintf(name, size, "%s%s%s", db_name, RECORD_INDEX_SUFFIX, checkpoint ? CHECKPOINT_SUFFIX : "");
+}
+
+
+/* func: map the index file, the offsets and sizes point into the mapping */
+static record_index_t *record_index_map(const char *index_name)
+{
+    int fd = open(index_name, O_RDONLY);
+    if (fd < 0) return NULL;
+
+    struct stat st;
+    char header[RECORD_HEADER_SIZE];
+    if (fstat(fd, &st) != 0 || pread(fd, header, RECORD_HEADER_SIZE, 0) != RECORD_HEADER_SIZE ||
+        memcmp(header, RECORD_INDEX_MAGIC, 8) != 0) {
+        fprintf(stderr, "[Error:%s] the file (%s) is not a record index!\n", __func__, index_name);
+        exit(-1);
+    }
+
+    record_index_t *index;
+    uint32_t version;
+    err_calloc(index, 1, record_index_t);
+
+    memcpy(&version, header + 8, sizeof(uint32_t));
+    memcpy(&index->xml_date, header + 12, sizeof(uint32_t));
+    memcpy(&index->xml_size, header + 16, sizeof(uint64_t));
+    memcpy(&index->capacity, header + 24, sizeof(uint32_t));
+    memcpy(&index->n_record, header + 28, sizeof(uint32_t));
+
+    if (version > RECORD_INDEX_VERSION) {
+        fprintf(stderr, "[Error:%s] unsupported record index version (%u)!\n", __func__, version);
+        exit(-1);
+    }
+
+    index->map_size = RECORD_HEADER_SIZE + (size_t)index->capacity * (sizeof(uint64_t) + sizeof(uint32_t));
+    if ((size_t)st.st_size != index->map_size) {
+        fprintf(stderr, "[Error:%s] truncated record index (%s) detected!\n", __func__, index_name);
+        exit(-1);
+    }
+
+    index->map = mmap(NULL, index->map_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (index->map == MAP_FAILED) {
+        fprintf(stderr, "[Error:%s] failed to map the record index (%s)!\n", __func__, index_name);
+        exit(-1);
+    }
+
+    index->offsets = (uint64_t *)((char *)index->map + RECORD_HEADER_SIZE);
+    index->sizes = (uint32_t *)(index->offsets + index->capacity);
+    return index;
+}
+
+
+record_index_t *record_index_open(const char *db_name, const char *xml_file, uint32_t xml_date, int resume)
+{
+    char index_name[1024];
+    record_index_t *index;
+    err_calloc(index, 1, record_index_t);
+    err_malloc(index->db_name, strlen(db_name) + 1, char);
+    strcpy(index->db_name, db_name);
+
+    struct stat st;
+    index->xml_date = xml_date;
+    index->xml_size = strcmp(xml_file, "-") != 0 && stat(xml_file, &st) == 0 ? (uint64_t)st.st_size : 0;
+
+    /* the index of the checkpoint covers the records before the offset of the checkpoint */
+    record_index_name(db_name, 1, index_name, sizeof(index_name));
+    record_index_t *saved = resume ? record_index_map(index_name) : NULL;
+
+    if (saved != NULL) {
+        record_memory_resize(index, saved->capacity);
+        memcpy(index->offsets, saved->offsets, saved->capacity * sizeof(uint64_t));
+        memcpy(index->sizes, saved->sizes, saved->capacity * sizeof(uint32_t));
+        index->n_record = saved->n_record;
+        record_index_close(saved);
+    }
+
+    return index;
+}
+
+
+void record_index_batch(record_index_t *index, const cache_t *cache)
+{
+    uint32_t max_id = 0, n_record = 0;
+    for (uint32_t i=0; i < cache->size; i++)
+        max_id = cache->item_list[i].id > max_id ? cache->item_list[i].id : max_id;
+    record_memory_resize(index, max_id + 1);
+
+    for (uint32_t i=0; i < cache->size; i++) {
+        const body_t *body = &cache->item_list[i];
+
+        n_record += index->sizes[body->id] == 0;
+        index->offsets[body->id] = stream_cache_offset(cache, body->start);
+        index->sizes[body->id] = body->size;
+    }
+
+    index->n_record += n_record;
+}
+
+
+void record_index_save(record_index_t *index, int checkpoint)
+{
+    char index_name[1024], tmp_name[sizeof(index_name) + 4];
+    record_index_name(index->db_name, checkpoint, index_name, sizeof(index_name));
+    file_tmp_name(tmp_name, sizeof(tmp_name), index_name);
+
+    FILE *file_hd = fopen(tmp_name, "wb");
+    if (file_hd == NULL) {
+        fprintf(stderr, "[Error:%s] failed to open (%s)!\n", __func__, tmp_name);
+        exit(-1);
+    }
+
+    /* the ids after the largest indexed id are not saved */
+    uint32_t capacity = index->capacity;
+    while (capacity > 0 && index->sizes[capacity-1] == 0) capacity--;
+
+    char magic[8] = RECORD_INDEX_MAGIC;
+    const uint32_t version = RECORD_INDEX_VERSION;
+    size_t n_item = 0;
+
+    n_item += fwrite(magic, sizeof(char), 8, file_hd);
+    n_item += fwrite(&version, sizeof(uint32_t), 1, file_hd);
+    n_item += fwrite(&index->xml_date, sizeof(uint32_t), 1, file_hd);
+    n_item += fwrite(&index->xml_size, sizeof(uint64_t), 1, file_hd);
+    n_item += fwrite(&capacity, sizeof(uint32_t), 1, file_hd);
+    n_item += fwrite(&index->n_record, sizeof(uint32_t), 1, file_hd);
+    n_item += fwrite(index->offsets, sizeof(uint64_t), capacity, file_hd);
+    n_item += fwrite(index->sizes, sizeof(uint32_t), capacity, file_hd);
+
+    if (file_cache_drop(file_hd) != 0 || fclose(file_hd) != 0 || n_item != 13 + (size_t)capacity * 2 ||
+        file_publish(tmp_name, index_name) != 0) {
+        fprintf(stderr, "[Error:%s] failed to save the record index (%s)!\n", __func__, index_name);
+        exit(-1);
+    }
+
+    /* the index of the checkpoint is useless after saving */
+    if (!checkpoint) {
+        record_index_name(index->db_name, 1, index_name, sizeof(index_name));
+        unlink(index_name);
+    }
+}
+
+
+record_index_t *record_index_load(const char *db_name)
+{
+    char index_name[1024];
+    record_index_name(db_name, 0, index_name, sizeof(index_name));
+
+    record_index_t *index = record_index_map(index_name);
+    if (index == NULL) return NULL;
+
+    err_malloc(index->db_name, strlen(db_name) + 1, char);
+    strcpy(index->db_name, db_name);
+    return index;
+}
+
+
+uint64_t record_index_merge(record_index_t *index, const record_index_t *partial)
+{
+    uint64_t n_dup = 0, n_record = 0;
+    record_memory_resize(index, partial->capacity);
+
+    #pragma omp parallel for reduction(+:n_dup, n_record)
+    for (uint32_t id=0; id < partial->capacity; id++) {
+        if (partial->sizes[id] == 0) continue;
+
+        if (index->sizes[id] != 0) {
+            n_dup++;
+            continue;
+        }
+        index->offsets[id] = partial->offsets[id];
+        index->sizes[id] = partial->sizes[id];
+        n_record++;
+    }
+
+    index->n_record += (uint32_t)n_record;
+    return n_dup;
+}
+
+
+void record_index_close(record_index_t *index)
+{
+    if (index == NULL) return;
+
+    if (index->map != NULL)
+        munmap(index->map, index->map_size);
+    else {
+        free(index->offsets);
+        free(index->sizes);
+    }
+
+    free(index->db_name);
+    free(index);
+}
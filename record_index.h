@@ -0,0 +1,95 @@
+/*************************************************************************
+    > File Name: record_index.h
+    > Author: xlzh
+    > Mail: xiaolongzhang2015@163.com
+    > Created Time: 2025年12月24 15时26分08秒
+ ************************************************************************/
+
+#ifndef INSDCXMLPARSER_RECORD_INDEX_H
+#define INSDCXMLPARSER_RECORD_INDEX_H
+
+#include <stdint.h>
+#include "stream_reader.h"
+
+/* the magic string and the format version of the index file */
+#define RECORD_INDEX_MAGIC "INSDCRI"
+#define RECORD_INDEX_VERSION 1
+
+/* the suffix of the index file (e.g. biosample.db.rix) */
+#define RECORD_INDEX_SUFFIX ".rix"
+
+
+/*! @typedef record_index_t
+  @abstract the position of the data body of each id in the xml file
+  @field  xml_date          the released date of the xml file
+  @field  n_record          the number of data bodies indexed
+  @field  capacity          the maximum number of items to index
+  @field  xml_size          the size of the xml file (0: unknown, e.g. the standard input)
+  @field  offsets           the offset of the data body in the xml file
+  @field  sizes             the size of the data body (0: not existed)
+  @field  map               the mapping of the index file (NULL: the index is allocated in memory)
+  @field  map_size          the size of the mapping
+  @field  db_name           the database file name, which the index is next to
+ */
+typedef struct {
+    uint32_t xml_date;
+    uint32_t n_record;
+    uint32_t capacity;
+    uint64_t xml_size;
+    uint64_t *offsets;
+    uint32_t *sizes;
+    void *map;
+    size_t map_size;
+    char *db_name;
+} record_index_t;
+
+
+/*! @function: create the index next to the database for the xml file (grown with the largest id)
+  @param  db_name            the database file name
+  @param  xml_file           the xml file to index ("-": the standard input)
+  @param  xml_date           the released date of the xml file
+  @param  resume             [0|1] 1: load the index saved by the latest checkpoint
+  @return                    the index object
+ */
+record_index_t *record_index_open(const char *db_name, const char *xml_file, uint32_t xml_date, int resume);
+
+
+/*! @function: add the data bodies of the batch into the index
+  @param  index              the index object
+  @param  cache              the cache with parsed data bodies
+  @return
+ */
+void record_index_batch(record_index_t *index, const cache_t *cache);
+
+
+/*! @function: save the index (write to a temporary file then rename)
+  @param  index              the index object
+  @param  checkpoint         [0|1] 1: save the index for the checkpoint (<index>.ckpt)
+  @return
+ */
+void record_index_save(record_index_t *index, int checkpoint);
+
+
+/*! @function: map the index file read-only (only the pages of the queried ids are read from the disk)
+  @param  db_name            the database file name, which the index is next to
+  @return                    the index object (NULL: the index is not existed)
+ */
+record_index_t *record_index_load(const char *db_name);
+
+
+/*! @function: merge the partial index (built with --range) into the index
+  @param  index              the index object
+  @param  partial            the partial index of the same xml file
+  @return                    the number of ids existed in both indexes
+ */
+uint64_t record_index_merge(record_index_t *index, const record_index_t *partial);
+
+
+/*! @function: close the index and release the memory
+  @param  index              the index object
+  @return
+ */
+void record_index_close(record_index_t *index);
+
+
+#endif //INSDCXMLPARSER_RECORD_INDEX_H
@@ -0,0 +1,387 @@
+/*************************************************************************
+    > File Name: serve.c
+    > Author: xlzh
+    > Mail: xiaolongzhang2015@163.com
+    > Created Time: 2025年12月18 16时30分05秒
+ ************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "utils.h"
+#include "database.h"
+#include "serve.h"
+
+
+/*! @typedef snapshot_t
+  @abstract the immutable state answering the lookups, replaced as a whole when the files change
+  @field  database          the database object
+  @field  diff              the latest diff status for each id (0:none, 1:delete, 3:add, 4:modify)
+  @field  generation        the generation of the snapshot (increased by every reload)
+  @field  refs              the number of requests using the snapshot
+  @field  db_mtime          the modified time of the database file when loaded
+  @field  db_size           the size of the database file when loaded
+  @field  list_mtime        the modified time of the diff list when loaded
+ */
+typedef struct {
+    database_t *database;
+    uint8_t *diff;
+    uint32_t generation;
+    int refs;
+    struct timespec db_mtime;
+    off_t db_size;
+    struct timespec list_mtime;
+} snapshot_t;
+
+
+#define mtime_equal(_a, _b) ((_a).tv_sec == (_b).tv_sec && (_a).tv_nsec == (_b).tv_nsec)
+
+
+/* the current snapshot, the lock is only held to swap or count the references */
+static snapshot_t *serve_current = NULL;
+static pthread_mutex_t serve_lock = PTHREAD_MUTEX_INITIALIZER;
+static volatile sig_atomic_t serve_reload = 0;
+static volatile sig_atomic_t serve_stop = 0;
+
+
+static void serve_signal(int sig)
+{
+    if (sig == SIGHUP) serve_reload = 1;
+    else serve_stop = 1;
+}
+
+
+static snapshot_t *snapshot_acquire(void)
+{
+    pthread_mutex_lock(&serve_lock);
+    snapshot_t *snapshot = serve_current;
+    snapshot->refs++;
+    pthread_mutex_unlock(&serve_lock);
+
+    return snapshot;
+}
+
+
+static void snapshot_destroy(snapshot_t *snapshot)
+{
+    database_destroy(snapshot->database);
+    if (snapshot->diff != NULL) free(snapshot->diff);
+    free(snapshot);
+}
+
+
+static void snapshot_release(snapshot_t *snapshot)
+{
+    pthread_mutex_lock(&serve_lock);
+    int unused = --snapshot->refs == 0 && snapshot != serve_current;
+    pthread_mutex_unlock(&serve_lock);
+
+    if (unused) snapshot_destroy(snapshot);
+}
+
+
+/* publish the new snapshot, the old one is destroyed by its last reader */
+static void snapshot_publish(snapshot_t *snapshot)
+{
+    pthread_mutex_lock(&serve_lock);
+    snapshot_t *old = serve_current;
+    snapshot->generation = old ? old->generation + 1 : 1;
+    serve_current = snapshot;
+    int unused = old != NULL && old->refs == 0;
+    pthread_mutex_unlock(&serve_lock);
+
+    if (unused) snapshot_destroy(old);
+}
+
+
+/* the diff list of the latest compare (NULL: no output directory) */
+static void serve_list_name(const args_t *args, const char *db_type, char *list_name, size_t size)
+{
+    list_name[0] = '\0';
+    if (args->output_dir != NULL)
+        snprintf(list_name, size, "%s/%s_diff.list", args->output_dir,
+                 strcmp(db_type, "SAMPLE") ? "project" : "sample");
+}
+
+
+/* map the published database and load the diff list, NULL if the files are being rewritten */
+static snapshot_t *snapshot_load(const args_t *args)
+{
+    struct stat st, st_end;
+    FILE *file_hd;
+    if (stat(args->database, &st) != 0) return NULL;
+
+    /* the tables are shared with the page cache, the mapping is kept even if a new generation is renamed over it */
+    database_t *database = database_map(args->database);
+
+    /* the database is truncated or modified while mapping (saved in place by an old version) */
+    if (database == NULL || stat(args->database, &st_end) != 0 ||
+        !mtime_equal(st_end.st_mtim, st.st_mtim) || st_end.st_size != st.st_size) {
+        database_destroy(database);
+        return NULL;
+    }
+
+    snapshot_t *snapshot;
+    err_calloc(snapshot, 1, snapshot_t);
+    err_calloc(snapshot->diff, database->capacity, uint8_t);
+    snapshot->database = database;
+    snapshot->db_mtime = st.st_mtim;
+    snapshot->db_size = st.st_size;
+
+    char list_name[1024], status[16];
+    uint32_t id;
+    serve_list_name(args, database->db_type, list_name, sizeof(list_name));
+
+    if (list_name[0] && stat(list_name, &st) == 0 && (file_hd = fopen(list_name, "r")) != NULL) {
+        snapshot->list_mtime = st.st_mtim;
+
+        while (fscanf(file_hd, "%15s %u", status, &id) == 2) {
+            if (id >= database->capacity) continue;
+
+            if (strcmp(status, "DELETE") == 0) snapshot->diff[id] = 1;
+            else if (strcmp(status, "ADD") == 0) snapshot->diff[id] = 3;
+            else if (strcmp(status, "CHANGE") == 0) snapshot->diff[id] = 4;
+        }
+        fclose(file_hd);
+    }
+
+    return snapshot;
+}
+
+
+/* check whether the database or the diff list is changed since the snapshot was loaded */
+static int snapshot_outdated(const args_t *args, const snapshot_t *snapshot)
+{
+    struct stat st;
+    char list_name[1024];
+
+    if (stat(args->database, &st) == 0 && (!mtime_equal(st.st_mtim, snapshot->db_mtime) || st.st_size != snapshot->db_size))
+        return 1;
+
+    /* a new generation is published within the resolution of mtime */
+    if (database_generation(args->database) > snapshot->database->generation)
+        return 1;
+
+    serve_list_name(args, snapshot->database->db_type, list_name, sizeof(list_name));
+    if (list_name[0] && stat(list_name, &st) == 0 && !mtime_equal(st.st_mtim, snapshot->list_mtime))
+        return 1;
+
+    return 0;
+}
+
+
+static void *serve_reloader(void *data)
+{
+    const args_t *args = (const args_t *)data;
+    char time_buf[32];
+
+    for (int tick=0; !serve_stop; tick++) {
+        sleep(1);
+        if (!serve_reload && tick % args->interval != 0) continue;
+        serve_reload = 0;
+
+        snapshot_t *current = snapshot_acquire();
+        int outdated = snapshot_outdated(args, current);
+        snapshot_release(current);
+        if (!outdated) continue;
+
+        /* the snapshot is loaded aside, the readers keep using the current one */
+        snapshot_t *snapshot = snapshot_load(args);
+        if (snapshot == NULL) continue;  /* try again in the next round */
+
+        snapshot_publish(snapshot);
+        fprintf(stderr, "[%s] reload the database: %s (%d), generation: %lu\n", get_current_time(time_buf),
+                snapshot->database->db_type, snapshot->database->db_date,
+                (unsigned long)snapshot->database->generation);
+    }
+    return NULL;
+}
+
+
+static int serve_read_full(int fd, void *data, size_t size)
+{
+    for (size_t n=0; n < size; ) {
+        ssize_t n_bytes = read(fd, (char *)data + n, size - n);
+        if (n_bytes < 0 && errno == EINTR) continue;
+        if (n_bytes <= 0) return -1;
+        n += (size_t)n_bytes;
+    }
+    return 0;
+}
+
+
+static int serve_write_full(int fd, const void *data, size_t size)
+{
+    for (size_t n=0; n < size; ) {
+        ssize_t n_bytes = write(fd, (const char *)data + n, size - n);
+        if (n_bytes < 0 && errno == EINTR) continue;
+        if (n_bytes <= 0) return -1;
+        n += (size_t)n_bytes;
+    }
+    return 0;
+}
+
+
+/* answer the requests of one client until it closes the connection */
+static void *serve_client(void *data)
+{
+    int fd = (int)(intptr_t)data;
+    uint32_t *ids = NULL;
+    uint8_t *items = NULL;
+    uint32_t m_batch = 0;
+    serve_header_t request, response;
+
+    while (serve_read_full(fd, &request, sizeof(serve_header_t)) == 0) {
+        response.magic = SERVE_MAGIC;
+        response.code = SERVE_OK;
+        response.n = 0;
+
+        if (request.magic != SERVE_MAGIC) break;  /* the stream is out of sync */
+
+        if (request.code == SERVE_OP_LOOKUP && request.n > SERVE_MAX_BATCH) {
+            response.code = SERVE_TOO_LARGE;
+            response.generation = 0;
+            serve_write_full(fd, &response, sizeof(serve_header_t));
+            break;
+        }
+
+        if (request.code == SERVE_OP_LOOKUP) {
+            if (m_batch < request.n) {
+                m_batch = request.n;
+                err_realloc(ids, m_batch, uint32_t);
+                err_realloc(items, (size_t)m_batch * SERVE_ITEM_SIZE, uint8_t);
+            }
+            if (serve_read_full(fd, ids, request.n * sizeof(uint32_t)) != 0) break;
+
+            /* the whole batch is answered by one snapshot */
+            snapshot_t *snapshot = snapshot_acquire();
+            const database_t *database = snapshot->database;
+
+            for (uint32_t i=0; i < request.n; i++) {
+                uint8_t *item = items + (size_t)i * SERVE_ITEM_SIZE;
+                const uint32_t id = ids[i];
+
+                if (id >= database->capacity) {
+                    memset(item, 0, SERVE_ITEM_SIZE);
+                    continue;
+                }
+                item[0] = database_flag(database, id) != 0;
+                item[1] = snapshot->diff[id];
+                memset(item + 2, 0, 16);  /* the short hash is padded with 0 */
+                memcpy(item + 2, database_query(database, id), database->hash_width);
+            }
+
+            response.n = request.n;
+            response.generation = snapshot->generation;
+            snapshot_release(snapshot);
+
+            if (serve_write_full(fd, &response, sizeof(serve_header_t)) != 0 ||
+                serve_write_full(fd, items, (size_t)request.n * SERVE_ITEM_SIZE) != 0)
+                break;
+        }
+        else if (request.code == SERVE_OP_INFO) {
+            char info[16];
+            snapshot_t *snapshot = snapshot_acquire();
+
+            memcpy(info, snapshot->database->db_type, 8);
+            memcpy(info + 8, &snapshot->database->db_date, sizeof(uint32_t));
+            memcpy(info + 12, &snapshot->database->capacity, sizeof(uint32_t));
+            response.generation = snapshot->generation;
+            snapshot_release(snapshot);
+
+            if (serve_write_full(fd, &response, sizeof(serve_header_t)) != 0 ||
+                serve_write_full(fd, info, sizeof(info)) != 0)
+                break;
+        }
+        else if (request.code == SERVE_OP_RELOAD) {
+            serve_reload = 1;
+            response.generation = 0;
+            if (serve_write_full(fd, &response, sizeof(serve_header_t)) != 0) break;
+        }
+        else {
+            response.code = SERVE_BAD_REQUEST;
+            response.generation = 0;
+            serve_write_full(fd, &response, sizeof(serve_header_t));
+            break;
+        }
+    }
+
+    if (ids != NULL) free(ids);
+    if (items != NULL) free(items);
+    close(fd);
+    return NULL;
+}
+
+
+void serve_run(const args_t *args)
+{
+    char time_buf[32];
+    fprintf(stderr, "[%s] start to load the database ...\n", get_current_time(time_buf));
+
+    snapshot_t *snapshot = snapshot_load(args);
+    if (snapshot == NULL) {
+        fprintf(stderr, "[Error:%s] failed to load the database (%s)!\n\n", __func__, args->database);
+        exit(-1);
+    }
+    snapshot_publish(snapshot);
+    fprintf(stderr, "[*] database version: %s (%d)\n", snapshot->database->db_type, snapshot->database->db_date);
+
+    /* listen on the unix domain socket */
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+
+    if (strlen(args->socket) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "[Error:%s] the socket path (%s) is too long!\n\n", __func__, args->socket);
+        exit(-1);
+    }
+    strcpy(addr.sun_path, args->socket);
+
+    int server_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(args->socket);
+
+    if (server_fd < 0 || bind(server_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(server_fd, 64) != 0) {
+        fprintf(stderr, "[Error:%s] failed to listen on the socket (%s)!\n\n", __func__, args->socket);
+        exit(-1);
+    }
+
+    /* SIGHUP: reload now; SIGINT/SIGTERM: stop the service */
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = serve_signal;
+    sigaction(SIGHUP, &action, NULL);
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    pthread_t reloader;
+    pthread_create(&reloader, NULL, serve_reloader, (void *)args);
+    fprintf(stderr, "[%s] listening on %s ...\n", get_current_time(time_buf), args->socket);
+
+    while (!serve_stop) {
+        int client_fd = accept(server_fd, NULL, NULL);
+        if (client_fd < 0) continue;  /* interrupted by the signal */
+
+        pthread_t client;
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+        if (pthread_create(&client, &attr, serve_client, (void *)(intptr_t)client_fd) != 0)
+            close(client_fd);
+        pthread_attr_destroy(&attr);
+    }
+
+    close(server_fd);
+    unlink(args->socket);
+    pthread_join(reloader, NULL);
+    fprintf(stderr, "[%s] done!\n", get_current_time(time_buf));
+}
@@ -0,0 +1,62 @@
+/*************************************************************************
+    > File Name: serve.h
+    > Author: xlzh
+    > Mail: xiaolongzhang2015@163.com
+    > Created Time: 2025年12月18 16时30分05秒
+ ************************************************************************/
+
+#ifndef INSDCXMLPARSER_SERVE_H
+#define INSDCXMLPARSER_SERVE_H
+
+#include <stdint.h>
+#include "params.h"
+
+/* the magic of every request and response header ("IXQ1" in little-endian) */
+#define SERVE_MAGIC 0x31515849
+
+/* the maximum number of ids in one lookup request */
+#define SERVE_MAX_BATCH 1048576
+
+/* the size of one item in the lookup response: present(1) + diff(1) + md5(16) */
+#define SERVE_ITEM_SIZE 18
+
+
+/* the operations of the request */
+enum ServeOp {
+    SERVE_OP_LOOKUP = 1,  /* payload: n * uint32 id; response: n * SERVE_ITEM_SIZE */
+    SERVE_OP_INFO = 2,    /* payload: none; response: db_type[8], db_date, capacity */
+    SERVE_OP_RELOAD = 3   /* payload: none; response: none (check the database file now) */
+};
+
+
+/* the status of the response */
+enum ServeStatus {
+    SERVE_OK = 0,
+    SERVE_BAD_REQUEST = 1,
+    SERVE_TOO_LARGE = 2
+};
+
+
+/*! @typedef serve_header_t
+  @abstract the header of the request and the response (native byte order)
+  @field  magic             always SERVE_MAGIC
+  @field  code              the request: ServeOp; the response: ServeStatus
+  @field  n                 the number of items following the header
+  @field  generation        the generation of the snapshot used (only for the response)
+ */
+typedef struct {
+    uint32_t magic;
+    uint32_t code;
+    uint32_t n;
+    uint32_t generation;
+} serve_header_t;
+
+
+/*! @function: hold the database and the latest diff list in memory and answer the lookups
+  @param  args               the command line parameters (database, socket, output_dir, interval)
+  @return
+ */
+void serve_run(const args_t *args);
+
+
+#endif //INSDCXMLPARSER_SERVE_H
@@ -8,10 +8,53 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <errno.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "utils.h"
 #include "stream_reader.h"
+#include "xml_validate.h"
+#include "fingerprint.h"
+#include "cpu_dispatch.h"
+#include "trace.h"
+
+
+/*! @typedef reader_t
+  @abstract the thread filling the ring buffer from a pipe, so that the transfer overlaps the parsing
+  @field  thread            the reader thread
+  @field  lock              the lock of the fields below and the position of the buffer (data)
+  @field  cond              signaled when the data is filled or the space is released
+  @field  filled            the number of bytes filled after buffer.data
+  @field  eof               [0|1] 1: the end of the stream (or an error) is reached
+  @field  error             the errno of the failed read (0: no error)
+  @field  stop              [0|1] 1: the reader is asked to stop
+ */
+typedef struct reader_t {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint32_t filled;
+    int eof;
+    int error;
+    int stop;
+} reader_t;
+
+
+/*! @typedef throttle_t
+  @abstract the token bucket limiting the read rate, only used by the thread reading the stream
+  @field  rate              the bytes read per second
+  @field  tokens            the bytes allowed to read now (<0: the debt of the previous read)
+  @field  last              the monotonic time (ns) of the latest refill
+ */
+typedef struct throttle_t {
+    uint64_t rate;
+    double tokens;
+    uint64_t last;
+} throttle_t;
 
 
 #define cache_memory_resize(_cache) do {                                           \
@@ -22,137 +65,521 @@
 } while(0)
 
 
+/* drop the parsed data before the front: the ring buffer only moves its head, otherwise the tail is moved */
 #define cache_buffer_reset(_buffer) do {                                           \
-    memmove((_buffer)->data, (_buffer)->front, (_buffer)->size * sizeof(char));    \
-    (_buffer)->data[(_buffer)->size] = '\0';                                       \
+    (_buffer)->offset += (_buffer)->front - (_buffer)->data;                       \
+    if ((_buffer)->ring_size) {                                                    \
+        (_buffer)->head = ((_buffer)->head + (uint32_t)((_buffer)->front - (_buffer)->data)) % (_buffer)->ring_size; \
+        (_buffer)->data = (_buffer)->base + (_buffer)->head;                       \
+    }                                                                              \
+    else memmove((_buffer)->data, (_buffer)->front, (_buffer)->size * sizeof(char)); \
     (_buffer)->front = (_buffer)->data;                                            \
 } while(0)
 
 
+/* func: map the memory file twice in a row, so that the data wrapped around the end of the ring is contiguous */
+static char *stream_ring_alloc(uint32_t size)
+{
+    int fd = memfd_create("stream_cache", MFD_CLOEXEC);
+    if (fd < 0) return NULL;
+
+    char *base = MAP_FAILED;
+    if (ftruncate(fd, size) == 0)
+        base = mmap(NULL, (size_t)size << 1, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+
+    if (base != MAP_FAILED &&
+        (mmap(base, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED ||
+         mmap(base + size, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED)) {
+        munmap(base, (size_t)size << 1);
+        base = MAP_FAILED;
+    }
+
+    close(fd);
+    return base == MAP_FAILED ? NULL : base;
+}
+
+
+static uint64_t stream_clock_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+
+/* func: wait until the debt of the previous reads is paid, return the bytes allowed to read (at most n) */
+static size_t stream_throttle_wait(throttle_t *throttle, size_t n)
+{
+    if (throttle == NULL) return n;
+
+    uint64_t now = stream_clock_ns();
+    throttle->tokens += (double)(now - throttle->last) * throttle->rate / 1e9;
+    throttle->last = now;
+
+    if (throttle->tokens < 0) {
+        const uint64_t t_wait = trace_begin();
+        const double delay = -throttle->tokens / throttle->rate;
+        struct timespec ts = {(time_t)delay, (long)((delay - (time_t)delay) * 1e9)};
+        while (nanosleep(&ts, &ts) != 0 && errno == EINTR);
+        trace_end(t_wait, "throttle", 0);
+
+        now = stream_clock_ns();
+        throttle->tokens += (double)(now - throttle->last) * throttle->rate / 1e9;
+        throttle->last = now;
+    }
+
+    /* the burst is at most one second, and each read is small enough to be paced */
+    if (throttle->tokens > throttle->rate) throttle->tokens = (double)throttle->rate;
+    return n < STREAM_READ_SIZE ? n : STREAM_READ_SIZE;
+}
+
+
+/* func: the bytes read are taken from the bucket */
+#define stream_throttle_take(_throttle, _n_bytes) do {                              \
+    if ((_throttle) != NULL && (_n_bytes) > 0) (_throttle)->tokens -= (double)(_n_bytes); \
+} while(0)
+
+
+/* func: drop the consumed data before the offset from the page cache (the clean pages of the input file) */
+static void stream_cache_drop(cache_t *cache, uint64_t offset)
+{
+    if (!cache->drop_cache || offset < cache->dropped + STREAM_DROP_SIZE) return;
+
+    posix_fadvise(cache->file_hd, (off_t)cache->dropped, (off_t)(offset - cache->dropped), POSIX_FADV_DONTNEED);
+    cache->dropped = offset;
+}
+
+
+/* func: the reader thread, fill the free space of the ring buffer until the end of the stream */
+static void *stream_reader_run(void *arg)
+{
+    cache_t *cache = (cache_t *)arg;
+    buffer_t *buffer = &cache->buffer;
+    reader_t *reader = buffer->reader;
+
+    /* only the blocking read could be canceled (the lock is never held there) */
+    pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+    trace_thread_name("reader");
+    pthread_mutex_lock(&reader->lock);
+
+    while (1) {
+        while (!reader->stop && reader->filled == buffer->capacity)
+            pthread_cond_wait(&reader->cond, &reader->lock);
+        if (reader->stop) break;
+
+        /* the free space after the filled data, which is contiguous in the mirrored mapping */
+        char *dest = buffer->base + (buffer->head + reader->filled) % buffer->ring_size;
+        uint32_t n_free = buffer->capacity - reader->filled;
+        if (n_free > STREAM_READ_SIZE) n_free = STREAM_READ_SIZE;
+        pthread_mutex_unlock(&reader->lock);
+
+        pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
+        n_free = (uint32_t)stream_throttle_wait(cache->throttle, n_free);
+        const uint64_t t_read = trace_begin();
+        const ssize_t n_bytes = read(cache->file_hd, dest, n_free);
+        pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+        trace_end(t_read, "read", n_bytes > 0 ? (uint64_t)n_bytes : 0);
+        stream_throttle_take(cache->throttle, n_bytes);
+
+        pthread_mutex_lock(&reader->lock);
+        if (n_bytes < 0 && errno == EINTR) continue;
+
+        if (n_bytes <= 0) {
+            reader->error = n_bytes < 0 ? errno : 0;
+            reader->eof = 1;
+            pthread_cond_broadcast(&reader->cond);
+            break;
+        }
+
+        reader->filled += (uint32_t)n_bytes;
+        pthread_cond_broadcast(&reader->cond);
+    }
+
+    pthread_mutex_unlock(&reader->lock);
+    return NULL;
+}
+
+
 cache_t *stream_cache_init(const char *filename, const char *start_tag, const char *end_tag)
 {
-    cache_t *cache;
-    err_calloc(cache, 1, cache_t);
+    cache_t *cache = stream_cache_open(filename, start_tag, end_tag);
+    if (cache != NULL) return cache;
 
-    /* open the input file */
-    cache->file_hd = open(filename, O_RDONLY);
-    if (cache->file_hd < 0) {
+    if (errno == EINVAL)
+        fprintf(stderr, "[Error:stream_cache_init] the length of start tag or end tag exceed 64!\n");
+    else
         fprintf(stderr, "[Error:stream_cache_init] failed to open the file (%s)!\n", filename);
-        exit(-1);
+    exit(-1);
+}
+
+
+cache_t *stream_cache_open(const char *filename, const char *start_tag, const char *end_tag)
+{
+    if (strlen(start_tag) >= 64 || strlen(end_tag) >= 64) {
+        errno = EINVAL;
+        return NULL;
     }
 
+    /* open the input file ("-": the standard input) */
+    const int file_hd = strcmp(filename, "-") == 0 ? STDIN_FILENO : open(filename, O_RDONLY);
+    if (file_hd < 0) return NULL;
+
+    cache_t *cache;
+    err_calloc(cache, 1, cache_t);
+    cache->file_hd = file_hd;
+
     buffer_t *buffer = &cache->buffer;
     k_strcpy(&buffer->start_tag, start_tag);
     k_strcpy(&buffer->end_tag, end_tag);
 
-    if (buffer->start_tag.l >= 64 || buffer->end_tag.l >= 64) {
-        fprintf(stderr, "[Error:stream_cache_init] the length of start tag or end tag exceed 64!\n");
-        exit(-1);
-    }
+    /* prepare the data filed of the buffer, the plain buffer is used if the ring could not be mapped */
+    if ((buffer->base = stream_ring_alloc(BUFFER_SIZE)) != NULL)
+        buffer->ring_size = BUFFER_SIZE;
+    else
+        err_malloc(buffer->base, BUFFER_SIZE + 8, char);
 
-    /* prepare the data filed of the buffer */
-    err_malloc(buffer->data, BUFFER_SIZE + 8, char);
     buffer->capacity = BUFFER_SIZE;
+    buffer->data = buffer->base;
     buffer->front = buffer->data;
 
+    /* the regular file is read once from the start to the end, the consumed data is not kept in the page cache
+     * (the other workloads of the node are not evicted by the 100GB stream) */
+    struct stat st;
+    const int n_stat = fstat(cache->file_hd, &st);
+    if (n_stat == 0 && S_ISREG(st.st_mode)) {
+        posix_fadvise(cache->file_hd, 0, 0, POSIX_FADV_SEQUENTIAL);
+        cache->drop_cache = 1;
+    }
+
+    /* the pipe is read by the thread, the regular file is read when the data is needed (and could be seeked) */
+    if (buffer->ring_size && n_stat == 0 && !S_ISREG(st.st_mode)) {
+        err_calloc(buffer->reader, 1, reader_t);
+        pthread_mutex_init(&buffer->reader->lock, NULL);
+        pthread_cond_init(&buffer->reader->cond, NULL);
+
+        const int status = pthread_create(&buffer->reader->thread, NULL, stream_reader_run, cache);
+        if (status != 0) {
+            pthread_mutex_destroy(&buffer->reader->lock);
+            pthread_cond_destroy(&buffer->reader->cond);
+            free(buffer->reader);
+            buffer->reader = NULL;
+            stream_cache_destroy(cache);
+            errno = status;
+            return NULL;
+        }
+    }
+
     return cache;
 }
 
 
-void stream_cache_destroy(cache_t *cache)
+void stream_cache_validate(cache_t *cache)
 {
-    if (cache == NULL) return;
+    cache->validate = validate_init();
+}
+
+
+void stream_cache_fingerprint(cache_t *cache, struct fingerprint_t *fingerprint)
+{
+    cache->fingerprint = fingerprint;
+}
+
+
+void stream_cache_throttle(cache_t *cache, uint64_t rate)
+{
+    if (rate == 0) return;
+
+    if (cache->throttle == NULL) err_calloc(cache->throttle, 1, throttle_t);
+    cache->throttle->rate = rate;
+    cache->throttle->last = stream_clock_ns();
+}
+
+
+uint64_t stream_cache_destroy(cache_t *cache)
+{
+    if (cache == NULL) return 0;
+
+    /* the errors found are reported even if the stream is not read to the end (e.g. the range is built) */
+    uint64_t n_error = 0;
+    if (cache->validate != NULL && (cache->validate->finished || cache->validate->n_error > 0))
+        n_error = validate_report(cache->validate);
+    validate_destroy(cache->validate);
 
     /* destroy the memory of item_list */
     if (cache->item_list != NULL) free(cache->item_list);
 
     /* destroy the buffer */
     buffer_t *buffer = &cache->buffer;
-    if (buffer == NULL) return;
+    reader_t *reader = buffer->reader;
+
+    if (reader != NULL) {  /* the reader may be blocked by the pipe */
+        pthread_mutex_lock(&reader->lock);
+        reader->stop = 1;
+        pthread_cond_broadcast(&reader->cond);
+        pthread_mutex_unlock(&reader->lock);
+
+        pthread_cancel(reader->thread);
+        pthread_join(reader->thread, NULL);
+        pthread_mutex_destroy(&reader->lock);
+        pthread_cond_destroy(&reader->cond);
+        free(reader);
+    }
 
     k_strfree(&buffer->start_tag);
     k_strfree(&buffer->end_tag);
-    if (buffer->data != NULL) free(buffer->data);
+    if (buffer->ring_size)
+        munmap(buffer->base, (size_t)buffer->ring_size << 1);
+    else if (buffer->base != NULL)
+        free(buffer->base);
 
+    /* the data read after the latest drop */
+    if (cache->drop_cache)
+        posix_fadvise(cache->file_hd, (off_t)cache->dropped, 0, POSIX_FADV_DONTNEED);
+
+    if (cache->file_hd > STDIN_FILENO) close(cache->file_hd);
+    free(cache->throttle);
     free(cache);
+
+    return n_error;
 }
 
 
-static uint32_t stream_id_parse(const char *data, const uint32_t data_size)
+/* func: find the tag in the data (bounded, the data is not terminated by NUL since the reader may be filling after it)
+ *
+ *   the variant of the cpu is selected at startup (see cpu_dispatch.h)
+ */
+static inline char *stream_tag_find(const char *data, size_t size, const kstring_t *tag)
 {
-    const char *id_start = strstr(data, "id=\"");
-    uint32_t n_shift = id_start - data;
+    return (char *)cpu_kernel.tag_find(data, size, tag->s, tag->l);
+}
 
-    if (id_start == NULL || n_shift > data_size) {
+
+uint32_t stream_id_parse(const char *data, const uint32_t data_size)
+{
+    uint32_t id;
+
+    if (stream_id_find(data, data_size, &id) != 0) {
         fprintf(stderr, "[Error:stream_id_parse] the id is not exist in the data body!\n");
         exit(-1);
     }
 
+    return id;
+}
+
+
+int stream_id_find(const char *data, const uint32_t data_size, uint32_t *id)
+{
+    const char *id_start = cpu_kernel.tag_find(data, data_size, "id=\"", 4);
+    if (id_start == NULL) return -1;
+
     /* skip the id tag before parsing*/
     id_start += 4;
-    uint32_t id = 0;
+    *id = 0;
 
     while (*id_start >= '0' && *id_start <= '9') {
-        id = id * 10 + (*id_start - '0');
+        *id = *id * 10 + (*id_start - '0');
         id_start++;
     }
 
-    return id;
+    return 0;
 }
 
 
-static int stream_cache_parse(cache_t *cache)
+int stream_cache_parse(cache_t *cache)
 {
     buffer_t *buffer = &cache->buffer;
     kstring_t *st = &buffer->start_tag, *et = &buffer->end_tag;
 
     /* parse the data body with start and end tag */
     while (1) {
+        /* skip the chunk unchanged since the previous release without parsing its data bodies */
+        if (cache->fingerprint != NULL && cache->fingerprint->aligned) {
+            const int64_t n_skip = fingerprint_match(cache);
+            if (n_skip < 0) break;  /* the chunk is not in the buffer yet */
+            if (n_skip > 0) continue;
+        }
+
         /* find the start tag */
-        char *start = strstr(buffer->front, st->s);
+        char *start = stream_tag_find(buffer->front, buffer->size, st);
         if (start == NULL) break;  /* there is no start tag in the buffer yet */
 
+        if (cache->validate != NULL)  /* the data skipped before the data body */
+            validate_gap(cache, buffer->front, start);
+        if (cache->fingerprint != NULL)
+            fingerprint_feed(cache, start);
+
         buffer->size -= start - buffer->front;
         buffer->front = start;
 
         /* find the end tag */
-        char *end = strstr(buffer->front + st->l, et->s);
+        char *end = stream_tag_find(buffer->front + st->l, buffer->size - st->l, et);
         if (end == NULL) break;  /* there is no end tag in the buffer yet */
 
+        /* a chunk of the previous release may start from the data body */
+        const uint32_t size = end - start + et->l;
+        if (cache->fingerprint != NULL && fingerprint_boundary(cache, start, size))
+            continue;
+
         /* store the tag-pair when both start_tag and end_tag were found */
+        uint32_t id;
+        if (stream_id_find(start, size, &id) != 0) return STREAM_ERROR_ID;
+
         cache_memory_resize(cache);
         body_t *body = &cache->item_list[cache->size++];
         body->start = start;
-        body->size = end - start + et->l;
-        body->id = stream_id_parse(body->start, body->size);
+        body->size = size;
+        body->id = id;
+        if (cache->fingerprint != NULL) fingerprint_body(cache, body);
 
         /* shift the front to next tag-pair */
         buffer->front += body->size;
         buffer->size -= body->size;
     }
 
-    return 0;
+    return STREAM_OK;
+}
+
+
+/* func: wait for the reader thread to fill more data, return the number of new bytes (0: end of the stream, <0: -errno) */
+static int64_t stream_reader_wait(buffer_t *buffer)
+{
+    reader_t *reader = buffer->reader;
+    const uint64_t t_wait = trace_begin();
+    pthread_mutex_lock(&reader->lock);
+
+    /* release the parsed data to the reader */
+    reader->filled -= (uint32_t)(buffer->front - buffer->data);
+    cache_buffer_reset(buffer);
+    pthread_cond_broadcast(&reader->cond);
+
+    /* wait for a batch large enough to keep the workers busy, or the end of the stream */
+    uint32_t target = buffer->size + STREAM_BATCH_SIZE;
+    if (target > buffer->capacity) target = buffer->capacity;
+
+    while (!reader->eof && reader->filled < target)
+        pthread_cond_wait(&reader->cond, &reader->lock);
+
+    const uint32_t n_bytes = reader->filled - buffer->size;
+    const int error = reader->error;
+    pthread_mutex_unlock(&reader->lock);
+    trace_end(t_wait, "wait", n_bytes);
+
+    return error != 0 ? -(int64_t)error : n_bytes;
+}
+
+
+/* func: read until the buffer is full or the end of the stream, return the number of new bytes (<0: -errno) */
+static int64_t stream_read_fill(cache_t *cache)
+{
+    buffer_t *buffer = &cache->buffer;
+    uint32_t n_total = 0;
+    const uint64_t t_read = trace_begin();
+
+    cache_buffer_reset(buffer);
+    stream_cache_drop(cache, buffer->offset);
+
+    while (buffer->size + n_total < buffer->capacity) {
+        const size_t n_free = stream_throttle_wait(cache->throttle, buffer->capacity - buffer->size - n_total);
+        const ssize_t n_bytes = read(cache->file_hd, buffer->data + buffer->size + n_total, n_free);
+        stream_throttle_take(cache->throttle, n_bytes);
+        if (n_bytes < 0 && errno == EINTR) continue;
+
+        if (n_bytes < 0) {
+            trace_end(t_read, "read", n_total);
+            return -(int64_t)errno;
+        }
+
+        if (n_bytes == 0) break;  /* stream end of the input file */
+        n_total += (uint32_t)n_bytes;
+    }
+
+    trace_end(t_read, "read", n_total);
+    return n_total;
 }
 
 
 int stream_cache_data(cache_t *cache)
+{
+    const int status = stream_cache_next(cache);
+
+    if (status == STREAM_ERROR_READ)
+        fprintf(stderr, "[Error:stream_cache_data] failed to read the stream (%s)!\n", strerror(cache->error));
+    else if (status == STREAM_ERROR_TAG)
+        fprintf(stderr, "[Error:stream_cache_data] the tag (%s) may NOT EXIST in your file!\n",
+                cache->buffer.start_tag.s);
+    else if (status == STREAM_ERROR_ID)
+        fprintf(stderr, "[Error:stream_id_parse] the id is not exist in the data body!\n");
+    else
+        return status;
+
+    exit(-1);
+}
+
+
+int stream_cache_next(cache_t *cache)
 {
     buffer_t *buffer = &cache->buffer;
 
     /* the start_tag is not existed in the total buffer (invalid tag) */
-    if (buffer->size == buffer->capacity) {
-        fprintf(stderr, "[Error:stream_cache_data] the tag (%s) may NOT EXIST in your file!\n", buffer->start_tag.s);
-        exit(-1);
-    }
+    if (buffer->size == buffer->capacity) return STREAM_ERROR_TAG;
 
-    cache_buffer_reset(buffer);
-    const size_t n_bytes = read(cache->file_hd, buffer->data + buffer->size, buffer->capacity - buffer->size);
-    if (n_bytes <= 0) return -1;  /* stream end of the input file */
+    const int64_t n_read = buffer->reader ? stream_reader_wait(buffer) : stream_read_fill(cache);
+    if (n_read < 0) {
+        cache->error = (int)-n_read;
+        return STREAM_ERROR_READ;
+    }
+    const uint32_t n_bytes = (uint32_t)n_read;
+
+    /* the data left for the next chunk of the previous release is parsed once more at the end of the stream */
+    const int pending = cache->fingerprint != NULL && cache->fingerprint->aligned && buffer->size > 0;
+    if (n_bytes == 0 && (cache->eof || !pending)) {  /* stream end of the input file */
+        if (cache->validate != NULL) validate_finish(cache);
+        if (cache->fingerprint != NULL) fingerprint_finish(cache);
+        return STREAM_END;
+    }
 
+    cache->eof = n_bytes == 0;
     buffer->size += n_bytes;
-    buffer->data[buffer->size] = '\0';
 
     /* parse the stream cache to find all potential body data */
     cache->size = 0;
-    return stream_cache_parse(cache);
+    uint64_t t_span = trace_begin();
+    const int status = stream_cache_parse(cache);
+    trace_end(t_span, "scan", cache->size);
+    if (status != STREAM_OK) return status;
+
+    if (cache->validate != NULL) {
+        t_span = trace_begin();
+        validate_batch(cache);
+        trace_end(t_span, "validate", cache->size);
+    }
+
+    return STREAM_OK;
+}
+
+
+int stream_cache_seek(cache_t *cache, uint64_t offset)
+{
+    buffer_t *buffer = &cache->buffer;
+
+    if (lseek(cache->file_hd, (off_t)offset, SEEK_SET) < 0)
+        return -1;
+
+    /* the data before the new position is not read again (e.g. the chunks skipped by the fingerprint) */
+    if (cache->drop_cache) {
+        if (offset > cache->dropped)
+            posix_fadvise(cache->file_hd, (off_t)cache->dropped, (off_t)(offset - cache->dropped), POSIX_FADV_DONTNEED);
+        cache->dropped = offset;
+    }
+
+    /* drop all the cached data and items */
+    buffer->size = 0;
+    buffer->offset = offset;
+    buffer->front = buffer->data;
+    cache->size = 0;
+
+    if (cache->validate != NULL)
+        cache->validate->resync = offset > 0;
+
+    return 0;
 }
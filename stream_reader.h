@@ -16,6 +16,20 @@
 /* the buffer_size of the cache (128MB) */
 #define BUFFER_SIZE 134217728
 
+/* the minimum new data of a batch read from a pipe (16MB), and the size of each read (4MB) */
+#define STREAM_BATCH_SIZE 16777216
+#define STREAM_READ_SIZE 4194304
+
+/* the consumed data of the regular file is dropped from the page cache every 64MB */
+#define STREAM_DROP_SIZE 67108864
+
+/* the status of stream_cache_next (the errors exit the process in stream_cache_data) */
+#define STREAM_OK 0
+#define STREAM_END -1
+#define STREAM_ERROR_READ -2    /* failed to read the stream (cache->error is the errno) */
+#define STREAM_ERROR_TAG -3     /* the start tag is not found in the whole buffer */
+#define STREAM_ERROR_ID -4      /* the id is not exist in the data body */
+
 
 /*! @typedef buffer_t
   @abstract the buffer for xml stream
@@ -25,14 +39,24 @@
   @field  end_tag        the end tag of the data body (e.g. </BioSample)
   @field  front          the pointer to the next round searching in the buffer
   @field  data           the pointer to the data from file
+  @field  offset         the offset of the data in the file (data[0])
+  @field  base           the memory of the buffer
+  @field  ring_size      the size of the ring mapped twice at base (0: the plain buffer, the data is moved to base)
+  @field  head           the position of data in the ring (data = base + head)
+  @field  reader         the thread reading the pipe into the ring (NULL: read when the data is needed)
  */
 typedef struct {
     uint32_t size;
     uint32_t capacity;
+    uint64_t offset;
     kstring_t start_tag;
     kstring_t end_tag;
     char *front;
     char *data;
+    char *base;
+    uint32_t ring_size;
+    uint32_t head;
+    struct reader_t *reader;
 } buffer_t;
 
 
@@ -56,6 +80,13 @@ typedef struct {
   @field  item_list         the item list with data body
   @field  buffer            the buffer used to cache stream data from file
   @field  file_hd           the file handle by POSIX open function
+  @field  validate          the validation state of the stream (NULL: validation disabled)
+  @field  fingerprint       the chunk fingerprints of the stream (NULL: fingerprint disabled)
+  @field  eof               [0|1] 1: the end of the stream is reached (the remaining data is being parsed)
+  @field  error             the errno of the failed read (STREAM_ERROR_READ)
+  @field  throttle          the token bucket limiting the read rate (NULL: unlimited)
+  @field  drop_cache        [0|1] 1: the consumed data is dropped from the page cache (the regular file)
+  @field  dropped           the offset of the file before which the data is dropped from the page cache
  */
 typedef struct {
     uint32_t size;
@@ -63,11 +94,18 @@ typedef struct {
     body_t *item_list;
     buffer_t buffer;
     int file_hd;
+    struct validate_t *validate;
+    struct fingerprint_t *fingerprint;
+    int eof;
+    int error;
+    struct throttle_t *throttle;
+    int drop_cache;
+    uint64_t dropped;
 } cache_t;
 
 
 /*! @function: initiation of stream cache
-  @param  filename           the filename of the XML file
+  @param  filename           the filename of the XML file ("-": the standard input, pipes are also accepted)
   @param  start_tag          the start tag in the XML to catch
   @param  end_tag            the end tag in the XML to catch
   @return                    cache object
@@ -75,11 +113,43 @@ typedef struct {
 cache_t *stream_cache_init(const char *filename, const char *start_tag, const char *end_tag);
 
 
-/*! @function: destroy the memory allocated to cache
+/*! @function: the same as stream_cache_init, but the error is returned instead of exiting
+  @param  filename           the filename of the XML file ("-": the standard input, pipes are also accepted)
+  @param  start_tag          the start tag in the XML to catch
+  @param  end_tag            the end tag in the XML to catch
+  @return                    cache object (NULL: failed, errno is EINVAL if the tag is too long)
+ */
+cache_t *stream_cache_open(const char *filename, const char *start_tag, const char *end_tag);
+
+
+/*! @function: enable the validation (UTF-8, balanced tags and the trailing data) of the stream
+  @param  cache              the cache object from stream_cache_init
+  @return
+ */
+void stream_cache_validate(cache_t *cache);
+
+
+/*! @function: fingerprint the chunks of the stream, and skip the chunks of the previous release
   @param  cache              the cache object from stream_cache_init
+  @param  fingerprint        the fingerprint object from fingerprint_open (owned by the caller)
   @return
  */
-void stream_cache_destroy(cache_t * cache);
+void stream_cache_fingerprint(cache_t *cache, struct fingerprint_t *fingerprint);
+
+
+/*! @function: limit the read rate of the stream by a token bucket (the burst is at most one second)
+  @param  cache              the cache object from stream_cache_init
+  @param  rate               the bytes read per second (0: unlimited)
+  @return
+ */
+void stream_cache_throttle(cache_t *cache, uint64_t rate);
+
+
+/*! @function: destroy the memory allocated to cache, and report the errors found by the validation
+  @param  cache              the cache object from stream_cache_init
+  @return                    the number of errors found in the xml file (0: valid or not validated)
+ */
+uint64_t stream_cache_destroy(cache_t * cache);
 
 
 /*! @function: caching and parsing XML file
@@ -89,4 +159,51 @@ void stream_cache_destroy(cache_t * cache);
 int stream_cache_data(cache_t *cache);
 
 
+/*! @function: the same as stream_cache_data, but the error is returned instead of exiting
+  @param  cache              the cache object from stream_cache_init
+  @return                    STREAM_OK, STREAM_END or STREAM_ERROR_*
+ */
+int stream_cache_next(cache_t *cache);
+
+
+/*! @function: parse the data bodies from the buffered data (buffer.front with buffer.size bytes)
+  @param  cache              the cache object from stream_cache_init
+  @return                    status of parsing (STREAM_OK or STREAM_ERROR_ID)
+ */
+int stream_cache_parse(cache_t *cache);
+
+
+/*! @function: parse the id (id="...") of the data body
+  @param  data               the start of the data body
+  @param  data_size          the size of the data body
+  @return                    the id of the data body
+ */
+uint32_t stream_id_parse(const char *data, const uint32_t data_size);
+
+
+/*! @function: the same as stream_id_parse, but the missing id is returned instead of exiting
+  @param  data               the start of the data body
+  @param  data_size          the size of the data body
+  @param  id                 the id of the data body
+  @return                    0: the id is found, -1: the id is not exist
+ */
+int stream_id_find(const char *data, const uint32_t data_size, uint32_t *id);
+
+
+/*! @function: reposition the stream to the given offset and drop the cached data
+  @param  cache              the cache object from stream_cache_init
+  @param  offset             the offset of the file to read from
+  @return                    status of seeking (-1: failed)
+ */
+int stream_cache_seek(cache_t *cache, uint64_t offset);
+
+
+/*! @function: get the file offset of the given pointer in the buffer
+  @param  _cache             the cache object from stream_cache_init
+  @param  _ptr               the pointer in the buffer (e.g. body->start or buffer.front)
+  @return                    the offset in the file
+ */
+#define stream_cache_offset(_cache, _ptr) ((_cache)->buffer.offset + (uint64_t)((_ptr) - (_cache)->buffer.data))
+
+
 #endif //INSDCXMLPARSER_STREAM_READER_H
\ No newline at end of file
@@ -0,0 +1,235 @@
+#!/bin/bash
+#************************************************************************
+#    > File Name: run_check.sh
+#    > Author: xlzh
+#    > Mail: xiaolongzhang2015@163.com
+#    > Created Time: 2026年10月19 10时30分12秒
+#************************************************************************
+#
+# the end-to-end checks of build, compare and the files next to the database, e.g.
+#   make check
+#   test/run_check.sh ./xml_parser
+#
+# the difference of test/sample_set.xml (20251130) and test/current_set.xml (20251205) is the reference,
+# every variant below (fingerprints, pre-check, body store, ranges, checkpoint) must give the same bytes
+
+PARSER=$(readlink -f "${1:-./xml_parser}")
+TEST_DIR=$(dirname "$(readlink -f "$0")")
+OLD_XML=$TEST_DIR/sample_set.xml
+NEW_XML=$TEST_DIR/current_set.xml
+
+WORK_DIR=$(mktemp -d "${TMPDIR:-/tmp}/insdc_check.XXXXXX") || exit 1
+trap 'rm -rf "$WORK_DIR"' EXIT
+cd "$WORK_DIR" || exit 1
+
+n_check=0
+n_fail=0
+
+
+# func: run the parser, keep the log and print it when failed
+run()
+{
+    "$PARSER" "$@" > run.log 2>&1 && return 0
+    cat run.log >&2
+    return 1
+}
+
+
+# func: record the result of the check
+check()
+{
+    local name=$1
+    shift
+    n_check=$((n_check + 1))
+
+    if "$@"; then
+        echo "[*] $name: ok"
+    else
+        echo "[Error:run_check] $name: failed!" >&2
+        n_fail=$((n_fail + 1))
+    fi
+}
+
+
+# func: the two diff outputs (list and xml) are byte-identical
+same_diff()
+{
+    cmp -s "$1/sample_diff.list" "$2/sample_diff.list" && cmp -s "$1/sample_diff.xml" "$2/sample_diff.xml"
+}
+
+
+# func: the two databases have the same ids and hashes
+same_db()
+{
+    "$PARSER" dbcmp "$1" "$2" > /dev/null 2>&1
+}
+
+
+# func: the records of the xml file without the root tags, one line for each record in order
+records()
+{
+    sed '1d;$d' "$1" | awk '{ record = record $0 "\001" } /^<\/BioSample>$/ { print record; record = "" }' | sort
+}
+
+
+# func: build the database of the old xml file and compare it with the new xml file
+# usage: build_compare <name> <build options> -- <compare options>
+build_compare()
+{
+    local name=$1 build_opt=() sample_opt=()
+    shift
+    while [ $# -gt 0 ] && [ "$1" != "--" ]; do build_opt+=("$1"); shift; done
+    [ $# -gt 0 ] && shift
+    sample_opt=("$@")
+
+    mkdir -p "$name"
+    run build -f "$OLD_XML" -e 20251130 -t SAMPLE -d "$name.db" "${build_opt[@]}" &&
+    run sample -f "$NEW_XML" -e 20251205 -d "$name.db" -o "$name" "${sample_opt[@]}"
+}
+
+
+# func: copy the records of the xml file N times with the ids shifted by 1000 (larger than a batch)
+enlarge()
+{
+    awk -v n_copy="$2" '
+    NR <= 2 { head[NR] = $0; next }
+    { line[++n_line] = $0 }
+    /^<\/BioSample>$/ { n_body = n_line }
+    END {
+        print head[1]; print head[2]
+        for (k = 0; k < n_copy; k++) {
+            for (i = 1; i <= n_body; i++) {
+                s = line[i]
+                if (k > 0 && substr(s, 1, 11) == "<BioSample " && match(s, / id="[0-9]+"/)) {
+                    id = substr(s, RSTART + 5, RLENGTH - 6) + k * 1000
+                    s = substr(s, 1, RSTART - 1) " id=\"" id "\"" substr(s, RSTART + RLENGTH)
+                }
+                print s
+            }
+        }
+        print "</BioSampleSet>"
+    }' "$1"
+}
+
+
+# func: run the parser with the xml file from stdin until the first checkpoint is saved, then kill it
+# usage: interrupt <xml file> <database> <parser arguments>
+interrupt()
+{
+    local xml_file=$1 db_name=$2
+    shift 2
+
+    rm -f "$db_name.ckpt"
+    "$PARSER" "$@" < "$xml_file" > run.log 2>&1 &
+    local pid=$!
+
+    while [ ! -e "$db_name.ckpt" ] && kill -0 "$pid" 2> /dev/null; do sleep 0.1; done
+    kill -9 "$pid" 2> /dev/null
+    wait "$pid" 2> /dev/null
+
+    # the run must be stopped in the middle, otherwise the checkpoint is removed
+    [ -e "$db_name.ckpt" ]
+}
+
+
+if [ ! -x "$PARSER" ]; then
+    echo "[Error:run_check] the parser ($PARSER) is not found, run make first!" >&2
+    exit 1
+fi
+export OMP_NUM_THREADS=${OMP_NUM_THREADS:-4}
+
+
+# the reference: no sidecar is read or written
+check "compare without fingerprints" build_compare ref -N -- -N
+check "build of the old xml file" run build -f "$OLD_XML" -e 20251130 -t SAMPLE -d old.db -N
+check "diff without database" eval 'mkdir -p diff && run diff -p "$OLD_XML" -f "$NEW_XML" -t SAMPLE -o diff'
+check "diff equal to compare" same_diff ref diff
+
+# the ids of test/current_set.xml are not ascending (66666 before 4), the pipe could not be read again
+check "diff of a pipe" eval \
+    'mkdir -p diff_pipe && cat "$NEW_XML" | run diff -p "$OLD_XML" -f - -t SAMPLE -o diff_pipe'
+check "diff of a pipe equal to compare" same_diff ref diff_pipe
+check "dbdiff equal to compare" eval '"$PARSER" dbdiff old.db ref.db 2> /dev/null | cmp -s - ref/sample_diff.list'
+check "dbcmp finds the difference" eval '! same_db old.db ref.db'
+
+# the test files end with a broken record, which is refused by --validate
+check "validate refuses broken xml" eval '! "$PARSER" build -f "$OLD_XML" -e 20251130 -t SAMPLE -d bad.db -v \
+    > /dev/null 2>&1 && [ ! -e bad.db ]'
+
+# the fingerprints of the chunks (.cdc) skip the chunks unchanged
+check "compare with fingerprints" build_compare cdc --
+check "fingerprint output" same_diff ref cdc
+check "fingerprint database" same_db ref.db cdc.db
+check "fingerprints saved" test -s cdc.db.cdc
+
+# the pre-check of last_update and size (.stp) only hashes the records changed
+check "compare with pre-check" build_compare stp -u -- -u
+check "pre-check output" same_diff ref stp
+check "compare with pre-check (all sampled)" build_compare stp_all -u -- -u -p 1
+check "pre-check (all sampled) output" same_diff ref stp_all
+check "pre-check databases" eval 'same_db ref.db stp.db && same_db ref.db stp_all.db'
+
+# the sidecars after a compare are the same as built from the new xml file directly
+check "compare with all sidecars" build_compare full -b -i -F default -u -- -b -i -F default -u
+check "sidecar compare output" same_diff ref full
+check "build of the new xml file" run build -f "$NEW_XML" -e 20251205 -t SAMPLE -d new.db -b -i -F default -u
+check "database (v5) round trip" same_db full.db new.db
+check ".rix round trip" cmp -s full.db.rix new.db.rix
+check ".fcol round trip" cmp -s full.db.fcol new.db.fcol
+check ".stp round trip" cmp -s full.db.stp new.db.stp
+check ".cdc round trip" cmp -s full.db.cdc new.db.cdc
+
+# the record index (.rix) extracts the same records as the diff xml
+check "extract with record index" eval \
+    'grep -v DELETE ref/sample_diff.list | "$PARSER" extract -d full.db -f "$NEW_XML" -i - -o extract.xml \
+     > /dev/null 2>&1 && cmp -s <(records extract.xml) <(records ref/sample_diff.xml)'
+
+# the body store (.bst/.bsi) gives back the records of the new xml file when compared with the old one again
+check "compare back with body store" eval 'mkdir -p back && run sample -f "$OLD_XML" -e 20251207 -d full.db -o back -b'
+check "body store round trip" eval \
+    'grep -v ADD back/sample_diff.list | sort -k2,2n | "$PARSER" extract -d new.db -f "$NEW_XML" -i - -o prev.xml \
+     > /dev/null 2>&1 && cmp -s <(records prev.xml) <(records back/sample_prev.xml)'
+
+# the partial databases of two byte ranges are merged into the same database
+split=$(grep -b '^<BioSample ' "$OLD_XML" | sed -n '200p' | cut -d: -f1)
+check "build of the byte ranges" eval \
+    'run build -f "$OLD_XML" -e 20251130 -t SAMPLE -d part1.db -N -g 0:$split &&
+     run build -f "$OLD_XML" -e 20251130 -t SAMPLE -d part2.db -N -g $split: &&
+     run merge -d merged.db part1.db part2.db'
+check "merged database" same_db old.db merged.db
+
+# the history store gives the same difference between the two dates
+check "history store" eval \
+    'run history -s sample.hdb -d old.db && run history -s sample.hdb -d ref.db &&
+     run history -s sample.hdb -x 20251130 -y 20251205 -o history.list && cmp -s history.list ref/sample_diff.list'
+
+# the checkpoint (.ckpt) of the build and compare, the xml files are larger than a batch to save one in the middle
+enlarge "$OLD_XML" 40 > big_old.xml
+enlarge "$NEW_XML" 40 > big_new.xml
+check "build of the large xml file" eval \
+    'run build -f - -e 20251130 -t SAMPLE -d big.db -b -i -F default -u < big_old.xml && cp big.db big_ref.db &&
+     mkdir -p big_ref && run sample -f big_new.xml -e 20251205 -d big_ref.db -o big_ref'
+
+check "build interrupted" interrupt big_old.xml ckpt.db \
+    build -f - -e 20251130 -t SAMPLE -d ckpt.db -c 1 -R 10 -b -i -F default -u
+check "build resumed" eval \
+    'run build -f - -e 20251130 -t SAMPLE -d ckpt.db -c 1 -r -b -i -F default -u < big_old.xml &&
+     grep -q "load the checkpoint" run.log'
+check "resumed database" same_db big.db ckpt.db
+for suffix in .rix .fcol .stp; do
+    check "resumed $suffix" cmp -s "big.db$suffix" "ckpt.db$suffix"
+done
+check "checkpoint removed" test ! -e ckpt.db.ckpt
+
+mkdir -p big_ckpt
+check "compare interrupted" interrupt big_new.xml big.db \
+    sample -f - -e 20251205 -d big.db -o big_ckpt -c 1 -R 10
+check "compare resumed" eval \
+    'run sample -f - -e 20251205 -d big.db -o big_ckpt -c 1 -r < big_new.xml &&
+     grep -q "load the checkpoint" run.log'
+check "resumed compare output" same_diff big_ref big_ckpt
+check "resumed compare database" same_db big_ref.db big.db
+
+
+echo "[*] $((n_check - n_fail)) of $n_check checks passed"
+[ "$n_fail" -eq 0 ]
@@ -0,0 +1,186 @@
+/*************************************************************************
+    > File Name: trace.c
+    > Author: xlzh
+    > Mail: xiaolongzhang2015@163.com
+    > Created Time: 2025年12月27 09时36分52秒
+ ************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <pthread.h>
+#include <omp.h>
+
+#include "utils.h"
+#include "trace.h"
+
+
+/*! @typedef span_t
+  @abstract one complete span ("ph": "X") of a thread
+ */
+typedef struct {
+    const char *name;
+    uint64_t start;
+    uint64_t end;
+    uint64_t value;
+} span_t;
+
+
+/*! @typedef thread_trace_t
+  @abstract the spans recorded by one thread (only appended by the thread itself)
+  @field  name              the thread name
+  @field  n_span            the number of spans
+  @field  m_span            the capacity of spans
+  @field  spans             the recorded spans
+ */
+typedef struct {
+    char name[32];
+    uint32_t n_span;
+    uint32_t m_span;
+    span_t *spans;
+} thread_trace_t;
+
+
+int trace_enabled = 0;
+
+static char *trace_file = NULL;
+static uint64_t trace_origin = 0;
+static pthread_mutex_t trace_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint32_t trace_n_thread = 0;
+static thread_trace_t *trace_threads[TRACE_MAX_THREAD];
+
+/* the number of trace_close, the records of the earlier traces are freed */
+static uint32_t trace_generation = 0;
+
+/* the trace of the current thread (NULL: not registered yet), only valid in the same generation */
+static __thread thread_trace_t *trace_self = NULL;
+static __thread uint32_t trace_self_generation = 0;
+
+
+uint64_t trace_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec + 1;
+}
+
+
+/* func: register the current thread, the threads beyond TRACE_MAX_THREAD are not recorded */
+static thread_trace_t *trace_thread_get(void)
+{
+    if (trace_self != NULL && trace_self_generation == trace_generation) return trace_self;
+
+    thread_trace_t *thread;
+    err_calloc(thread, 1, thread_trace_t);
+
+    if (omp_in_parallel())
+        snprintf(thread->name, sizeof(thread->name), "omp %d", omp_get_thread_num());
+    else
+        snprintf(thread->name, sizeof(thread->name), "main");
+
+    pthread_mutex_lock(&trace_lock);
+    if (trace_n_thread < TRACE_MAX_THREAD)
+        trace_threads[trace_n_thread++] = thread;
+    else {
+        free(thread);
+        thread = NULL;
+    }
+    trace_self_generation = trace_generation;
+    pthread_mutex_unlock(&trace_lock);
+
+    return trace_self = thread;
+}
+
+
+void trace_record(uint64_t start, const char *name, uint64_t value)
+{
+    const uint64_t end = trace_now();
+    thread_trace_t *thread = trace_thread_get();
+    if (thread == NULL) return;
+
+    if (thread->n_span == thread->m_span) {
+        thread->m_span = thread->m_span ? thread->m_span << 1 : 1024;
+        err_realloc(thread->spans, thread->m_span, span_t);
+    }
+
+    span_t *span = &thread->spans[thread->n_span++];
+    span->name = name;
+    span->start = start;
+    span->end = end;
+    span->value = value;
+}
+
+
+void trace_open(const char *file_name)
+{
+    err_malloc(trace_file, strlen(file_name) + 1, char);
+    strcpy(trace_file, file_name);
+
+    trace_origin = trace_now();
+    trace_enabled = 1;
+}
+
+
+void trace_thread_name(const char *name)
+{
+    if (!trace_enabled) return;
+
+    thread_trace_t *thread = trace_thread_get();
+    if (thread != NULL) snprintf(thread->name, sizeof(thread->name), "%s", name);
+}
+
+
+void trace_close(void)
+{
+    if (!trace_enabled) return;
+    trace_enabled = 0;
+
+    FILE *file_hd = fopen(trace_file, "w");
+    if (file_hd == NULL) {
+        fprintf(stderr, "[Error:%s] failed to open the trace file (%s)!\n", __func__, trace_file);
+        exit(-1);
+    }
+
+    /* the timestamps are in microseconds since trace_open, the tid is the order of registration */
+    uint64_t n_span = 0;
+    fprintf(file_hd, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(file_hd, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"xml_parser\"}}");
+
+    pthread_mutex_lock(&trace_lock);
+    for (uint32_t t=0; t < trace_n_thread; t++) {
+        thread_trace_t *thread = trace_threads[t];
+        fprintf(file_hd, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                t + 1, thread->name);
+        fprintf(file_hd, ",\n{\"name\":\"thread_sort_index\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,"
+                "\"args\":{\"sort_index\":%u}}", t + 1, t + 1);
+
+        for (uint32_t i=0; i < thread->n_span; i++) {
+            const span_t *span = &thread->spans[i];
+            const uint64_t start = span->start > trace_origin ? span->start - trace_origin : 0;
+
+            fprintf(file_hd, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,"
+                    "\"args\":{\"value\":%lu}}", span->name, t + 1, (double)start / 1e3,
+                    (double)(span->end - span->start) / 1e3, (unsigned long)span->value);
+        }
+        n_span += thread->n_span;
+
+        free(thread->spans);
+        free(thread);
+        trace_threads[t] = NULL;
+    }
+    trace_n_thread = 0;
+    trace_generation++;  /* the other threads register again on the next span */
+    trace_self = NULL;
+    pthread_mutex_unlock(&trace_lock);
+
+    fprintf(file_hd, "\n]}\n");
+    if (fclose(file_hd) != 0) {
+        fprintf(stderr, "[Error:%s] failed to write the trace file (%s)!\n", __func__, trace_file);
+        exit(-1);
+    }
+
+    fprintf(stderr, "[*] trace: %lu spans of %s\n", (unsigned long)n_span, trace_file);
+    free(trace_file);
+    trace_file = NULL;
+}
@@ -0,0 +1,69 @@
+/*************************************************************************
+    > File Name: trace.h
+    > Author: xlzh
+    > Mail: xiaolongzhang2015@163.com
+    > Created Time: 2025年12月27 09时36分52秒
+ ************************************************************************/
+
+#ifndef INSDCXMLPARSER_TRACE_H
+#define INSDCXMLPARSER_TRACE_H
+
+#include <stdint.h>
+
+/* the maximum number of threads recorded (the main, reader and openmp threads) */
+#define TRACE_MAX_THREAD 1024
+
+/* the spans are not recorded unless trace_open is called (only one branch for each span) */
+extern int trace_enabled;
+
+
+/*! @function: the monotonic time of the span start in nanoseconds (never 0)
+  @return
+ */
+uint64_t trace_now(void);
+
+
+/*! @function: record the span [start, now) of the current thread
+  @param  start              the time returned by trace_begin
+  @param  name               the name of the span (read, scan, hash, classify, write, load, save ...)
+  @param  value              the argument of the span (the batch number, the bytes or the items)
+  @return
+ */
+void trace_record(uint64_t start, const char *name, uint64_t value);
+
+
+/* the start of a span (0: the trace is disabled) */
+static inline uint64_t trace_begin(void)
+{
+    return trace_enabled ? trace_now() : 0;
+}
+
+
+/* the end of a span started by trace_begin */
+static inline void trace_end(uint64_t start, const char *name, uint64_t value)
+{
+    if (start != 0) trace_record(start, name, value);
+}
+
+
+/*! @function: start to record the spans of all threads
+  @param  file_name          the output trace file (Chrome trace-event JSON, viewable in Perfetto)
+  @return
+ */
+void trace_open(const char *file_name);
+
+
+/*! @function: name the current thread in the trace (the default: main or omp <n>)
+  @param  name               the thread name (a static string)
+  @return
+ */
+void trace_thread_name(const char *name);
+
+
+/*! @function: write the recorded spans into the trace file and stop recording
+  @return
+ */
+void trace_close(void);
+
+
+#endif //INSDCXMLPARSER_TRACE_H
@@ -0,0 +1,345 @@
+/*************************************************************************
+    > File Name: update_stamp.c
+    > Author: xlzh
+    > Mail: xiaolongzhang2015@163.com
+    > Created Time: 2026年01月05 14时22分37秒
+ ************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <omp.h>
+
+#include "utils.h"
+#include "update_stamp.h"
+#include "checkpoint.h"
+
+
+/* the size of the header: magic[8], version, db_date, capacity, reserved, root */
+#define STAMP_HEADER_SIZE 32
+
+/* the attribute of the start tag parsed into the stamp */
+#define STAMP_ATTR " last_update=\""
+
+
+/* the suffix of the stamps saved with the previous checkpoint */
+#define STAMP_PREV_SUFFIX ".prev"
+
+
+/* func: the name of the stamp file (checkpoint, 0: the final one, 1: the latest checkpoint, 2: the previous one) */
+static void stamp_file_name(const char *db_name, int checkpoint, char *name, size_t size)
+{
+    snprintf(name, size, "%s%s%s%s", db_name, STAMP_SUFFIX, checkpoint ? CHECKPOINT_SUFFIX : "",
+             checkpoint == 2 ? STAMP_PREV_SUFFIX : "");
+}
+
+
+static void stamp_table_resize(stamp_table_t *table, uint32_t n)
+{
+    if (table->capacity >= n) return;
+
+    const uint32_t old = table->capacity;
+    table->capacity = n;
+    kroundup32(table->capacity);
+    err_realloc(table->stamps, table->capacity, uint64_t);
+    memset(table->stamps + old, 0, (size_t)(table->capacity - old) * sizeof(uint64_t));
+}
+
+
+stamp_table_t *stamp_table_open(const char *db_name, uint32_t xml_date, double paranoia)
+{
+    stamp_table_t *table;
+    err_calloc(table, 1, stamp_table_t);
+    err_malloc(table->db_name, strlen(db_name) + 1, char);
+    strcpy(table->db_name, db_name);
+
+    table->xml_date = xml_date;
+    table->threshold = paranoia >= 1.0 ? UINT64_MAX : (uint64_t)(paranoia * 18446744073709551616.0);
+    return table;
+}
+
+
+/* func: read the stamps of the file if they are saved with the database (the same date and root)
+ *
+ *   return the number of the stamps read (-1: missing or stale)
+ */
+static int64_t stamp_file_read(stamp_table_t *table, const char *file_name, const database_t *database)
+{
+    FILE *file_hd = fopen(file_name, "rb");
+    if (file_hd == NULL) return -1;
+
+    char header[STAMP_HEADER_SIZE];
+    uint32_t version, db_date, capacity;
+    uint64_t root;
+
+    if (fread(header, 1, STAMP_HEADER_SIZE, file_hd) != STAMP_HEADER_SIZE || memcmp(header, STAMP_MAGIC, 8) != 0) {
+        fprintf(stderr, "[Error:%s] the file (%s) is not a stamp file!\n", __func__, file_name);
+        exit(-1);
+    }
+
+    memcpy(&version, header + 8, sizeof(uint32_t));
+    memcpy(&db_date, header + 12, sizeof(uint32_t));
+    memcpy(&capacity, header + 16, sizeof(uint32_t));
+    memcpy(&root, header + 24, sizeof(uint64_t));
+
+    /* the database is updated without the stamps (e.g. compared without --precheck) */
+    if (version != STAMP_VERSION || db_date != database->db_date || root != database_tree_update(database)) {
+        fclose(file_hd);
+        return -1;
+    }
+
+    stamp_table_resize(table, capacity);
+    uint64_t *stamps;
+    err_malloc(stamps, capacity ? capacity : 1, uint64_t);
+
+    if (fread(stamps, sizeof(uint64_t), capacity, file_hd) != capacity) {
+        fprintf(stderr, "[Error:%s] truncated stamp file (%s) detected!\n", __func__, file_name);
+        exit(-1);
+    }
+    fclose(file_hd);
+
+    /* the stamps of the partial databases are merged into the same table */
+    int64_t n_stamp = 0;
+
+    #pragma omp parallel for schedule(static) reduction(+:n_stamp)
+    for (uint32_t id=0; id < capacity; id++) {
+        if (stamps[id] == 0) continue;
+
+        table->stamps[id] = stamps[id];
+        n_stamp++;
+    }
+
+    free(stamps);
+    return n_stamp;
+}
+
+
+int stamp_table_load(stamp_table_t *table, const database_t *database, int checkpoint)
+{
+    char file_name[1024];
+    stamp_file_name(table->db_name, checkpoint, file_name, sizeof(file_name));
+
+    /* the stamps are saved before the checkpoint, which is the previous one if the latest is not finished */
+    int64_t n_stamp = stamp_file_read(table, file_name, database);
+    if (n_stamp < 0 && checkpoint) {
+        stamp_file_name(table->db_name, 2, file_name, sizeof(file_name));
+        n_stamp = stamp_file_read(table, file_name, database);
+    }
+
+    if (n_stamp < 0) {
+        fprintf(stderr, "[Warning:%s] no stamps saved with the database (%s), all records are hashed!\n", __func__,
+                file_name);
+        return -1;
+    }
+    fprintf(stderr, "[*] stamps of the database: %lu ids\n", (unsigned long)n_stamp);
+
+    /* e.g. the chunks skipped by the fingerprints when the stamps were missing */
+    uint64_t n_missing = 0;
+
+    #pragma omp parallel for schedule(static) reduction(+:n_missing)
+    for (uint32_t id=0; id < database->capacity; id++)
+        n_missing += database_flag(database, id) != 0 && (id >= table->capacity || table->stamps[id] == 0);
+
+    if (n_missing > 0) {
+        fprintf(stderr, "[Warning:%s] %lu ids of the database are not stamped!\n", __func__,
+                (unsigned long)n_missing);
+        return -1;
+    }
+    return 0;
+}
+
+
+void stamp_table_reserve(stamp_table_t *table, uint32_t n)
+{
+    if (table->m_batch >= n) return;
+
+    table->m_batch = n;
+    err_realloc(table->batch, n, uint64_t);
+    err_realloc(table->checks, n, uint8_t);
+}
+
+
+/* func: the days from 1970-01-01 of the civil date (the proleptic Gregorian calendar) */
+static int64_t stamp_days(int64_t y, int64_t m, int64_t d)
+{
+    y -= m <= 2;
+    const int64_t era = (y >= 0 ? y : y - 399) / 400;
+    const int64_t yoe = y - era * 400;
+    const int64_t doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    const int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+
+/* func: parse the n digits (-1 if any of them is not a digit) */
+static inline int64_t stamp_digits(const char *p, int n)
+{
+    int64_t v = 0;
+
+    for (int i=0; i < n; i++) {
+        if (p[i] < '0' || p[i] > '9') return -1;
+        v = v * 10 + (p[i] - '0');
+    }
+    return v;
+}
+
+
+uint64_t stamp_parse(const body_t *body)
+{
+    const char *end = memchr(body->start, '>', body->size);
+    if (end == NULL || body->size >= (1U << STAMP_SIZE_BITS)) return 0;
+
+    /* last_update="YYYY-MM-DDTHH:MM:SS[.fff]" */
+    const char *p = memmem(body->start, end - body->start, STAMP_ATTR, sizeof(STAMP_ATTR) - 1);
+    if (p == NULL || end - p < (ptrdiff_t)sizeof(STAMP_ATTR) + 19) return 0;
+    p += sizeof(STAMP_ATTR) - 1;
+
+    if (p[4] != '-' || p[7] != '-' || p[10] != 'T' || p[13] != ':' || p[16] != ':') return 0;
+    const int64_t year = stamp_digits(p, 4), month = stamp_digits(p + 5, 2), day = stamp_digits(p + 8, 2);
+    const int64_t hour = stamp_digits(p + 11, 2), minute = stamp_digits(p + 14, 2), second = stamp_digits(p + 17, 2);
+
+    if (year < 2000 || month < 1 || month > 12 || day < 1 || day > 31 || hour < 0 || hour > 23 ||
+        minute < 0 || minute > 59 || second < 0 || second > 60)
+        return 0;
+
+    /* the milliseconds (the digits after them are ignored) */
+    int64_t ms = 0;
+    if (p[19] == '.') {
+        int n = 0;
+        for (p += 20; n < 3 && p < end && *p >= '0' && *p <= '9'; p++, n++)
+            ms = ms * 10 + (*p - '0');
+        for (; n < 3; n++) ms *= 10;
+    }
+
+    const int64_t days = stamp_days(year, month, day) - stamp_days(2000, 1, 1);
+    const uint64_t stamp_ms = (uint64_t)(((days * 24 + hour) * 60 + minute) * 60 + second) * 1000 + (uint64_t)ms;
+    if (stamp_ms >> (64 - STAMP_SIZE_BITS)) return 0;
+
+    return (stamp_ms << STAMP_SIZE_BITS) | body->size;
+}
+
+
+/* func: whether the id is sampled to hash on the date (splitmix64 of the date and id) */
+static inline int stamp_sampled(const stamp_table_t *table, uint32_t id)
+{
+    uint64_t z = (((uint64_t)table->xml_date << 32) | id) + 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    z ^= z >> 31;
+
+    return table->threshold == UINT64_MAX || z < table->threshold;
+}
+
+
+int stamp_check(stamp_table_t *table, uint32_t i, const body_t *body, const database_t *database)
+{
+    const uint64_t stamp = stamp_parse(body);
+    const uint32_t id = body->id;
+    int check = STAMP_HASH;
+
+    /* only the ids present in the database are skipped (their hashes are kept) */
+    if (stamp != 0 && database != NULL && id < table->capacity && id < database->capacity &&
+        database_flag(database, id) != 0 && table->stamps[id] == stamp)
+        check = stamp_sampled(table, id) ? STAMP_SAMPLE : STAMP_SKIP;
+
+    table->batch[i] = stamp;
+    table->checks[i] = (uint8_t)check;
+    return check;
+}
+
+
+void stamp_table_batch(stamp_table_t *table, const cache_t *cache)
+{
+    uint32_t max_id = 0;
+    for (uint32_t i=0; i < cache->size; i++)
+        max_id = cache->item_list[i].id > max_id ? cache->item_list[i].id : max_id;
+    stamp_table_resize(table, max_id + 1);
+
+    for (uint32_t i=0; i < cache->size; i++) {
+        table->stamps[cache->item_list[i].id] = table->batch[i] ? table->batch[i] : STAMP_NONE;
+        table->n_skip += table->checks[i] == STAMP_SKIP;
+        table->n_sample += table->checks[i] == STAMP_SAMPLE;
+    }
+}
+
+
+int stamp_table_merge(stamp_table_t *table, const char *db_name, const database_t *partial)
+{
+    char file_name[1024];
+    stamp_file_name(db_name, 0, file_name, sizeof(file_name));
+
+    return stamp_file_read(table, file_name, partial) < 0 ? -1 : 0;
+}
+
+
+void stamp_table_save(stamp_table_t *table, const database_t *database, int checkpoint)
+{
+    char file_name[1024], tmp_name[sizeof(file_name) + 4];
+    stamp_file_name(table->db_name, checkpoint, file_name, sizeof(file_name));
+    file_tmp_name(tmp_name, sizeof(tmp_name), file_name);
+
+    /* the stamps of the deleted (or never added) ids are cleared */
+    uint32_t capacity = table->capacity < database->capacity ? table->capacity : database->capacity;
+
+    #pragma omp parallel for schedule(static)
+    for (uint32_t id=0; id < capacity; id++) {
+        if (database_flag(database, id) == 0) table->stamps[id] = 0;
+    }
+    while (capacity > 0 && table->stamps[capacity-1] == 0) capacity--;
+
+    FILE *file_hd = fopen(tmp_name, "wb");
+    if (file_hd == NULL) {
+        fprintf(stderr, "[Error:%s] failed to open (%s)!\n", __func__, tmp_name);
+        exit(-1);
+    }
+
+    /* the stamps are only used with the table saved at the same time */
+    char magic[8] = STAMP_MAGIC;
+    const uint32_t version = STAMP_VERSION, reserved = 0;
+    const uint64_t root = database_tree_update(database);
+    size_t n_item = 0;
+
+    n_item += fwrite(magic, sizeof(char), 8, file_hd);
+    n_item += fwrite(&version, sizeof(uint32_t), 1, file_hd);
+    n_item += fwrite(&database->db_date, sizeof(uint32_t), 1, file_hd);
+    n_item += fwrite(&capacity, sizeof(uint32_t), 1, file_hd);
+    n_item += fwrite(&reserved, sizeof(uint32_t), 1, file_hd);
+    n_item += fwrite(&root, sizeof(uint64_t), 1, file_hd);
+    n_item += fwrite(table->stamps, sizeof(uint64_t), capacity, file_hd);
+
+    if (file_cache_drop(file_hd) != 0 || fclose(file_hd) != 0 || n_item != 13 + (size_t)capacity) {
+        fprintf(stderr, "[Error:%s] failed to save the stamps (%s)!\n", __func__, file_name);
+        exit(-1);
+    }
+
+    /* the stamps of the checkpoint being replaced are kept until the next one */
+    char prev_name[1024];
+    stamp_file_name(table->db_name, 2, prev_name, sizeof(prev_name));
+    if (checkpoint) rename(file_name, prev_name);
+
+    if (file_publish(tmp_name, file_name) != 0) {
+        fprintf(stderr, "[Error:%s] failed to save the stamps (%s)!\n", __func__, file_name);
+        exit(-1);
+    }
+
+    /* the stamps of the checkpoints are useless after saving */
+    if (!checkpoint) {
+        stamp_file_name(table->db_name, 1, file_name, sizeof(file_name));
+        unlink(file_name);
+        unlink(prev_name);
+    }
+}
+
+
+void stamp_table_close(stamp_table_t *table)
+{
+    if (table == NULL) return;
+
+    free(table->stamps);
+    free(table->batch);
+    free(table->checks);
+    free(table->db_name);
+    free(table);
+}
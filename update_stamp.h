@@ -0,0 +1,144 @@
+/*************************************************************************
+    > File Name: update_stamp.h
+    > Author: xlzh
+    > Mail: xiaolongzhang2015@163.com
+    > Created Time: 2026年01月05 14时22分37秒
+ ************************************************************************/
+
+#ifndef INSDCXMLPARSER_UPDATE_STAMP_H
+#define INSDCXMLPARSER_UPDATE_STAMP_H
+
+#include <stdint.h>
+#include "stream_reader.h"
+#include "database.h"
+
+/* the magic string and the format version of the stamp file */
+#define STAMP_MAGIC "INSDCUS"
+#define STAMP_VERSION 1
+
+/* the suffix of the stamp file (e.g. biosample.db.stp) */
+#define STAMP_SUFFIX ".stp"
+
+/* the stamp: the milliseconds of last_update since 2000-01-01 (42 bits) and the size of the record (22 bits),
+ * 0 if last_update is missing or the record is larger than 4MB (the record is always hashed) */
+#define STAMP_SIZE_BITS 22
+
+/* the stamp kept for the record without last_update (never equal to the stamp parsed, 0: not stamped yet) */
+#define STAMP_NONE 1
+
+/* the default rate of the records hashed although their stamps are unchanged */
+#define STAMP_PARANOIA 0.01
+
+/* the result of the pre-check of each record */
+#define STAMP_HASH 0      /* the stamp is changed (or unknown), the record is hashed */
+#define STAMP_SKIP 1      /* the stamp is unchanged, the record is not hashed */
+#define STAMP_SAMPLE 2    /* the stamp is unchanged, but the record is sampled to hash */
+
+
+/*! @typedef stamp_table_t
+  @abstract the stamp (last_update and size) of each id, which is saved with the database
+  @field  capacity          the size of the stamps (the largest id + 1 at least)
+  @field  stamps            the stamp of each id (0: not stamped, STAMP_NONE: without last_update)
+  @field  threshold         the record is sampled if the hash of its id and the xml date is below it
+  @field  xml_date          the released date of the xml file (the records sampled are different every day)
+  @field  batch             the stamp of each record in the current batch
+  @field  checks            the result of the pre-check of each record in the current batch
+  @field  m_batch           the capacity of the batch and checks
+  @field  n_skip            the number of the records not hashed
+  @field  n_sample          the number of the records sampled
+  @field  n_miss            the number of the sampled records changed (without changing the stamp)
+  @field  db_name           the database file name, which the stamp file is next to
+ */
+typedef struct {
+    uint32_t capacity;
+    uint64_t *stamps;
+    uint64_t threshold;
+    uint32_t xml_date;
+    uint64_t *batch;
+    uint8_t *checks;
+    uint32_t m_batch;
+    uint64_t n_skip;
+    uint64_t n_sample;
+    uint64_t n_miss;
+    char *db_name;
+} stamp_table_t;
+
+
+/*! @function: create an empty stamp table next to the database
+  @param  db_name            the database file name
+  @param  xml_date           the released date of the xml file
+  @param  paranoia           the rate of the records hashed although their stamps are unchanged [0, 1]
+  @return                    the stamp table
+ */
+stamp_table_t *stamp_table_open(const char *db_name, uint32_t xml_date, double paranoia);
+
+
+/*! @function: load the stamps saved with the database (the table is kept empty if they are missing or stale)
+  @param  table              the stamp table
+  @param  database           the database loaded, the stamps must be saved with the same date and root
+  @param  checkpoint         [0|1] 1: load the stamps saved with the checkpoint (<stamps>.ckpt or <stamps>.ckpt.prev)
+  @return                    0: loaded, -1: missing, stale or some present ids are not stamped
+ */
+int stamp_table_load(stamp_table_t *table, const database_t *database, int checkpoint);
+
+
+/*! @function: make sure the stamps and checks of the batch are allocated (called before stamp_check)
+  @param  table              the stamp table
+  @param  n                  the number of data bodies in the batch
+  @return
+ */
+void stamp_table_reserve(stamp_table_t *table, uint32_t n);
+
+
+/*! @function: the stamp of the data body from last_update of its start tag and its size
+  @param  body               the data body
+  @return                    the stamp (0: unknown)
+ */
+uint64_t stamp_parse(const body_t *body);
+
+
+/*! @function: pre-check the data body with the stamp saved (thread safe for different i)
+  @param  table              the stamp table
+  @param  i                  the index of the data body in the batch
+  @param  body               the data body
+  @param  database           the database compared (NULL: building, always hashed)
+  @return                    STAMP_HASH, STAMP_SKIP or STAMP_SAMPLE
+ */
+int stamp_check(stamp_table_t *table, uint32_t i, const body_t *body, const database_t *database);
+
+
+/*! @function: keep the stamps of the batch
+  @param  table              the stamp table
+  @param  cache              the cache with the data bodies checked
+  @return
+ */
+void stamp_table_batch(stamp_table_t *table, const cache_t *cache);
+
+
+/*! @function: merge the stamps of the partial database (built with --range)
+  @param  table              the stamp table
+  @param  db_name            the partial database file name
+  @param  partial            the partial database loaded, before it is merged
+  @return                    0: merged, -1: the stamps of the partial database are missing or stale
+ */
+int stamp_table_merge(stamp_table_t *table, const char *db_name, const database_t *partial);
+
+
+/*! @function: save the stamps of the present ids with the date and root of the database (tmp file then rename)
+  @param  table              the stamp table
+  @param  database           the database saved
+  @param  checkpoint         [0|1] 1: save the stamps before the checkpoint (<stamps>.ckpt, the previous one is
+                             kept as <stamps>.ckpt.prev until the next checkpoint)
+  @return
+ */
+void stamp_table_save(stamp_table_t *table, const database_t *database, int checkpoint);
+
+
+/*! @function: close the stamp table and release the memory
+  @param  table              the stamp table
+  @return
+ */
+void stamp_table_close(stamp_table_t *table);
+
+
+#endif //INSDCXMLPARSER_UPDATE_STAMP_H
@@ -8,6 +8,9 @@
 
 #include <time.h>
 #include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
 #include "utils.h"
 
 
@@ -86,3 +89,43 @@ int32_t is_file_exists(char *file_fn)
 
     return 0;
 }
+
+
+int file_tmp_name(char *tmp_name, size_t size, const char *file_name)
+{
+    const int n = snprintf(tmp_name, size, "%s.tmp", file_name);
+    return n >= 0 && (size_t)n < size ? 0 : -1;
+}
+
+
+int file_cache_drop(FILE *file_hd)
+{
+    /* only the clean pages could be dropped */
+    if (fflush(file_hd) != 0 || fdatasync(fileno(file_hd)) != 0) return -1;
+
+    posix_fadvise(fileno(file_hd), 0, 0, POSIX_FADV_DONTNEED);
+    return 0;
+}
+
+
+int file_publish(const char *tmp_name, const char *file_name)
+{
+    if (rename(tmp_name, file_name) != 0) return -1;
+
+    /* the new directory entry must be on the disk as well, or a crash could bring back the previous file */
+    char dir_name[1024];
+    const char *slash = strrchr(file_name, '/');
+    const size_t l_dir = slash == NULL ? 0 : (slash == file_name ? 1 : (size_t)(slash - file_name));
+
+    if (l_dir >= sizeof(dir_name)) return -1;
+    memcpy(dir_name, l_dir ? file_name : ".", l_dir ? l_dir : 1);
+    dir_name[l_dir ? l_dir : 1] = '\0';
+
+    const int fd = open(dir_name, O_RDONLY | O_DIRECTORY);
+    if (fd < 0) return -1;
+
+    /* some file systems could not sync a directory, the rename is all they offer */
+    const int status = fsync(fd) != 0 && errno != EINVAL ? -1 : 0;
+    close(fd);
+    return status;
+}
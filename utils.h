@@ -89,4 +89,16 @@ char *get_current_time(char *time_buf);
 int32_t is_file_exists(char *file_fn);
 
 
+/* the temporary name of the file written aside before it is renamed (<file_name>.tmp), -1: the name is too long */
+int file_tmp_name(char *tmp_name, size_t size, const char *file_name);
+
+
+/* write the output to the disk and drop it from the page cache (the output is not read again), -1: failed */
+int file_cache_drop(FILE *file_hd);
+
+
+/* rename the file written aside over the published one, then sync the directory entry, -1: failed */
+int file_publish(const char *tmp_name, const char *file_name);
+
+
 #endif //INSDCXMLPARSER_UTILS_H
\ No newline at end of file
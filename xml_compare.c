@@ -7,99 +7,485 @@
 
 
 #include <omp.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
 #include "md5.h"
 #include "database.h"
 #include "stream_reader.h"
+#include "checkpoint.h"
+#include "record_index.h"
+#include "field_extract.h"
+#include "trace.h"
+#include "xml_compare.h"
 
 
-void xml_compare_core(database_t *database, char *xml_name, char *diff_name, char *start_tag, char *end_tag)
+/* store the added and changed data bodies, and write the previous version of the changed ones */
+static void compare_store_batch(body_store_t *store, const cache_t *cache, const database_t *database,
+                                const uint32_t *changed, uint32_t n_changed, kstring_t *blobs, FILE *prev_hd)
 {
-    FILE *file_hd = fopen(diff_name, "wb");
-    cache_t *cache = stream_cache_init(xml_name, start_tag, end_tag);
-    database_t *cache_db = database_init(16);
+    body_store_train(store, cache);
+
+    #pragma omp parallel shared(store, cache, database, changed, blobs)
+    {
+        void *stream = body_stream_init();
+
+        /* blobs[2k]: the new compressed data body, blobs[2k+1]: the previous data body */
+        #pragma omp for schedule(dynamic, 16)
+        for (uint32_t k=0; k < n_changed; k++) {
+            const body_t *body = &cache->item_list[changed[k]];
+
+            body_store_compress(store, stream, body, &blobs[k<<1]);
+            if (database_flag(database, body->id) != 4 || body_store_get(store, body->id, &blobs[(k<<1)+1]) != 0)
+                blobs[(k<<1)+1].l = 0;
+        }
+        body_stream_destroy(stream);
+    }
+
+    for (uint32_t k=0; k < n_changed; k++) {
+        const body_t *body = &cache->item_list[changed[k]];
+
+        if (blobs[(k<<1)+1].l > 0) {
+            fwrite(blobs[(k<<1)+1].s, sizeof(char), blobs[(k<<1)+1].l, prev_hd);
+            fwrite("\n", sizeof(char), 1, prev_hd);
+        }
+        body_store_put(store, body->id, &blobs[k<<1], body->size);
+    }
+}
+
+
+/* write the previous version of the deleted data bodies (flag 1 after comparing) */
+static void compare_store_delete(body_store_t *store, const database_t *database, FILE *prev_hd)
+{
+    kstring_t body = {0, 0, NULL};
+
+    uint64_t changed[(1U << DATABASE_LEAF_SHIFT) >> 6];
+
+    for (uint32_t start=0; start < database->capacity; start += 1U << DATABASE_LEAF_SHIFT) {
+        const uint32_t n = database->capacity - start < (1U << DATABASE_LEAF_SHIFT) ?
+                           database->capacity - start : (1U << DATABASE_LEAF_SHIFT);
+        if (database_flags_changed(database, start, n, changed) == 0) continue;
+
+        for (uint32_t w=0; w < (n + 63) >> 6; w++) {
+            for (uint64_t mask=changed[w]; mask != 0; mask &= mask - 1) {
+                const uint32_t id = start + (w << 6) + __builtin_ctzll(mask);
+                if (database_flag(database, id) != 1) continue;
+
+                if (body_store_get(store, id, &body) == 0) {
+                    fwrite(body.s, sizeof(char), body.l, prev_hd);
+                    fwrite("\n", sizeof(char), 1, prev_hd);
+                }
+                body_store_remove(store, id);
+            }
+        }
+    }
+    k_strfree(&body);
+}
+
+
+/* open the output xml, or drop the data written after the checkpoint and continue */
+static FILE *compare_output_open(const char *file_name, const checkpoint_t *ckpt, uint64_t size, const char *root)
+{
+    FILE *file_hd = fopen(file_name, ckpt->offset ? "r+b" : "wb");
+
+    if (file_hd == NULL) {
+        fprintf(stderr, "[Error:compare_output_open]: failed to open (%s)!\n", file_name);
+        exit(-1);
+    }
+
+    if (ckpt->offset == 0)
+        fprintf(file_hd, "<%s>\n", root);  /* add root start tag */
+
+    else if (ftruncate(fileno(file_hd), (off_t)size) != 0 || fseek(file_hd, 0, SEEK_END) != 0) {
+        fprintf(stderr, "[Error:compare_output_open] failed to resume from the checkpoint!\n");
+        exit(-1);
+    }
+
+    return file_hd;
+}
+
+
+/* func: the file name of the shard, the index is inserted before the suffix (e.g. sample_diff.3.xml) */
+static void shard_name(char *buf, size_t size, const char *name, uint32_t k)
+{
+    const char *suffix = strrchr(name, '.');
+    if (suffix == NULL || strchr(suffix, '/') != NULL) suffix = name + strlen(name);
+
+    snprintf(buf, size, "%.*s.%u%s", (int)(suffix - name), name, k, suffix);
+}
+
+
+/* func: write the added and changed data bodies, each shard (id % n_shard) is written by its own thread
+ *
+ * the changed items are partitioned by the shard once (counting sort, the order in each shard is kept),
+ * so each thread only walks its own items.
+ */
+static void compare_diff_write(const cache_t *cache, const uint32_t *changed, uint32_t n_changed, FILE **diff_hd,
+                               uint32_t n_shard)
+{
+    uint32_t *order = NULL, *start;
+    err_calloc(start, n_shard + 1, uint32_t);
+
+    if (n_shard > 1) {
+        err_malloc(order, n_changed + 1, uint32_t);
+
+        for (uint32_t j=0; j < n_changed; j++)
+            start[cache->item_list[changed[j]].id % n_shard + 1]++;
+        for (uint32_t k=0; k < n_shard; k++)
+            start[k+1] += start[k];
+
+        for (uint32_t j=0; j < n_changed; j++)
+            order[start[cache->item_list[changed[j]].id % n_shard]++] = changed[j];
+        for (uint32_t k=n_shard; k > 0; k--)  /* start[k] is the end of the shard k after the scatter */
+            start[k] = start[k-1];
+        start[0] = 0;
+    }
+    else start[1] = n_changed;
+
+    const uint32_t *items = order ? order : changed;
+
+    #pragma omp parallel for schedule(dynamic, 1) if(n_shard > 1)
+    for (uint32_t k=0; k < n_shard; k++) {
+        for (uint32_t j=start[k]; j < start[k+1]; j++) {
+            const body_t *body = &cache->item_list[items[j]];
+
+            fwrite(body->start, sizeof(char), body->size, diff_hd[k]);
+            fwrite("\n", sizeof(char), 1, diff_hd[k]);
+        }
+    }
+
+    free(order);
+    free(start);
+}
+
+
+uint64_t xml_compare_core(database_t *database, const args_t *args, checkpoint_t *ckpt, body_store_t *store,
+                          fingerprint_t *fingerprint, stamp_table_t *stamps, char *diff_name, char *prev_name,
+                          char *start_tag, char *end_tag)
+{
+    /* the single diff xml, or one file for each shard */
+    const uint32_t n_shard = ckpt->n_shard ? ckpt->n_shard : 1;
+    FILE **diff_hd;
+    err_malloc(diff_hd, n_shard, FILE *);
+
+    if (ckpt->n_shard == 0)
+        diff_hd[0] = compare_output_open(diff_name, ckpt, ckpt->diff_size, "DiffXmlSet");
+
+    for (uint32_t k=0; k < ckpt->n_shard; k++) {
+        char name_buf[1024];
+        shard_name(name_buf, sizeof(name_buf), diff_name, k);
+        diff_hd[k] = compare_output_open(name_buf, ckpt, ckpt->shard_size[k], "DiffXmlSet");
+    }
+
+    FILE *prev_hd = store ? compare_output_open(prev_name, ckpt, ckpt->prev_size, "PrevXmlSet") : NULL;
+    cache_t *cache = stream_cache_init(args->xml_file, start_tag, end_tag);
+    if (args->validate) stream_cache_validate(cache);
+    if (fingerprint != NULL) stream_cache_fingerprint(cache, fingerprint);
+    stream_cache_throttle(cache, (uint64_t)args->io_rate_limit << 20);
+    database_t *cache_db = database_init(16, database->hash_width, DATABASE_LAYOUT_SPLIT);
+    record_index_t *index = NULL;
+    if (args->record_index)
+        index = record_index_open(args->database, args->xml_file, args->xml_date, args->resume);
+    field_table_t *fields = NULL;
+    if (args->fields)
+        fields = field_table_open(args->database, args->fields, args->xml_date, ckpt->n_item);
 
     char time_buf[32];
-    uint32_t n_total_item = 0;
+    uint64_t n_total_item = ckpt->n_item;
     fprintf(stderr, "[%s] start to compare the difference ...\n", get_current_time(time_buf));
-    fputs("<DiffXmlSet>\n", file_hd);  /* add root start tag */
+
+    if (ckpt->offset && stream_cache_seek(cache, ckpt->offset) != 0) {
+        fprintf(stderr, "[Error:%s] failed to resume from the checkpoint!\n", __func__);
+        exit(-1);
+    }
+
+    /* the index of the added and changed items in the batch, and their data bodies (with body store) */
+    uint32_t *changed = NULL, n_changed, m_changed = 0;
+    kstring_t *blobs = NULL;
+    uint64_t n_batch = 0, t_batch = trace_begin(), t_span;
 
     while (stream_cache_data(cache) >= 0) {
         database_resize(cache_db, cache->size);
+        n_changed = 0;
 
-        /* calculate the md5 value in parallel with openmp */
-        #pragma omp parallel for shared(cache, cache_db, database)
-        for (int i=0; i < cache->size; i++) {
-            uint8_t md5_str[16];
-            body_t *body = &cache->item_list[i];
+        if (m_changed < cache->size) {
+            err_realloc(changed, cache->size, uint32_t);
+            if (store != NULL) {
+                err_realloc(blobs, (size_t)cache->size << 1, kstring_t);
+                memset(blobs + ((size_t)m_changed << 1), 0, ((size_t)(cache->size - m_changed) << 1) * sizeof(kstring_t));
+            }
+            m_changed = cache->size;
+        }
+        if (fields != NULL) field_table_reserve(fields, cache->size);
+        if (stamps != NULL) stamp_table_reserve(stamps, cache->size);
+
+        /* calculate the md5 value in parallel with openmp (the span of each thread ends before the barrier) */
+        #pragma omp parallel shared(cache, cache_db, database, fields, stamps)
+        {
+            const uint64_t t_hash = trace_begin();
+            uint64_t n_hash = 0;
+
+            #pragma omp for nowait
+            for (uint32_t i=0; i < cache->size; i++) {
+                uint8_t md5_str[16];
+                body_t *body = &cache->item_list[i];
+
+                if (fields != NULL) field_extract(fields, i, body);
 
-            md5_calculate_block((uint8_t *)body->start, body->size, md5_str);
-            database_add(cache_db, i, md5_str);  /* Note: the flag value is ignored */
+                /* the record with the same last_update and size as the database is not hashed */
+                if (stamps != NULL && stamp_check(stamps, i, body, database) == STAMP_SKIP) continue;
+
+                md5_calculate_block((uint8_t *)body->start, body->size, md5_str);
+                database_add(cache_db, i, md5_str);  /* Note: the flag value is ignored */
+                n_hash++;
+            }
+            trace_end(t_hash, "hash", n_hash);
         }
+        t_span = trace_begin();
+
+        /* make sure the table covers the IDs of the batch */
+        uint32_t max_id = 0;
+        for (uint32_t i=0; i < cache->size; i++)
+            max_id = cache->item_list[i].id > max_id ? cache->item_list[i].id : max_id;
+        database_resize(database, max_id + 1);
 
         /* get the different data body by comparing sample database */
-        for (int i=0; i < cache->size; i++) {
+        for (uint32_t i=0; i < cache->size; i++) {
             body_t *body = &cache->item_list[i];
             uint8_t *raw_md5 = database_query(database, body->id);
             uint8_t *cur_md5 = database_query(cache_db, i);
 
-            if (database->flags[body->id] == 0) {  /* the item is new added */
-                fwrite(body->start, sizeof(char), body->size, file_hd);
-                fwrite("\n", sizeof(char), 1, file_hd);
-                database->flags[body->id] = 3;
-                memcpy(raw_md5, cur_md5, 16 * sizeof(uint8_t));
+            if (stamps != NULL && stamps->checks[i] == STAMP_SKIP) {  /* unchanged by the pre-check */
+                database_flag(database, body->id) = 2;
+                continue;
+            }
+
+            if (database_flag(database, body->id) == 0) {  /* the item is new added */
+                database_flag(database, body->id) = 3;
+                database_copy(database, raw_md5, cur_md5);
+                database_touch(database, body->id);
+                changed[n_changed++] = i;
                 continue;
             }
 
-            if (strncmp((char *)raw_md5, (char *)cur_md5, 16) != 0) {  /* the item is changed */
-                fwrite(body->start, sizeof(char), body->size, file_hd);
-                fwrite("\n", sizeof(char), 1, file_hd);
-                database->flags[body->id] = 4;
-                memcpy(raw_md5, cur_md5, 16 * sizeof(uint8_t));
+            if (!database_equal(database, raw_md5, cur_md5)) {  /* the item is changed */
+                if (stamps != NULL) stamps->n_miss += stamps->checks[i] == STAMP_SAMPLE;
+                database_flag(database, body->id) = 4;
+                database_copy(database, raw_md5, cur_md5);
+                database_touch(database, body->id);
+                changed[n_changed++] = i;
                 continue;
             }
 
-            database->flags[body->id] = 2;  /* the item is unchanged */
+            database_flag(database, body->id) = 2;  /* the item is unchanged */
         }
+        trace_end(t_span, "classify", cache->size);
+
+        t_span = trace_begin();
+        compare_diff_write(cache, changed, n_changed, diff_hd, n_shard);
+        if (store != NULL)
+            compare_store_batch(store, cache, database, changed, n_changed, blobs, prev_hd);
+        trace_end(t_span, "write", n_changed);
+
+        if (index != NULL) record_index_batch(index, cache);
+        if (fields != NULL) field_table_batch(fields, cache);
+        if (stamps != NULL) stamp_table_batch(stamps, cache);
+
+        /* the data bodies of the skipped chunks are unchanged */
+        if (fingerprint != NULL) n_total_item += fingerprint_apply(fingerprint, database);
 
         n_total_item += cache->size;
-        fprintf(stderr, "\r[*] compare number of items: %d", n_total_item);
+        fprintf(stderr, "\r[*] compare number of items: %lu", (unsigned long)n_total_item);
+
+        /* the diff xml must be on the disk before the table referring to it (and it is not kept in the page cache) */
+        if (checkpoint_due(ckpt, args)) {
+            t_span = trace_begin();
+            int status = 0;
+            for (uint32_t k=0; k < n_shard; k++)
+                if (file_cache_drop(diff_hd[k]) != 0) status = -1;
+            if (store != NULL && file_cache_drop(prev_hd) != 0) status = -1;
+
+            if (status != 0) {
+                /* the sizes would point past the data not on the disk, try again in the next interval */
+                fprintf(stderr, "\n[Warning:%s] failed to sync the outputs, the checkpoint is skipped!\n", __func__);
+                ckpt->last_time = time(NULL);
+            }
+            else {
+                for (uint32_t k=0; ckpt->n_shard && k < n_shard; k++)
+                    ckpt->shard_size[k] = (uint64_t)ftello(diff_hd[k]);
+
+                ckpt->offset = stream_cache_offset(cache, cache->buffer.front);
+                ckpt->diff_size = (uint64_t)ftello(diff_hd[0]);
+                ckpt->n_item = n_total_item;
+
+                if (store != NULL) {
+                    ckpt->prev_size = (uint64_t)ftello(prev_hd);
+                    body_store_save(store, 1);
+                }
+                if (index != NULL) record_index_save(index, 1);
+                if (fields != NULL) field_table_save(fields, 1);
+                if (stamps != NULL) stamp_table_save(stamps, database, 1);
+                checkpoint_save(ckpt, args, database);
+            }
+            trace_end(t_span, "save", ckpt->n_item);
+        }
+
+        trace_end(t_batch, "batch", n_batch++);
+        t_batch = trace_begin();
     }
 
-    fputs("</DiffXmlSet>\n", file_hd);  /* add root close tag */
-    fclose(file_hd);
-    fprintf(stderr, "\n[%s] done!\n", get_current_time(time_buf));
+    /* the sidecars of the invalid xml file are not saved */
+    const uint64_t n_invalid = stream_cache_destroy(cache);
+
+    for (uint32_t k=0; k < n_shard; k++) {
+        fputs("</DiffXmlSet>\n", diff_hd[k]);  /* add root close tag */
+        if (file_cache_drop(diff_hd[k]) != 0 || fclose(diff_hd[k]) != 0) {
+            fprintf(stderr, "\n[Error:%s] failed to write the diff xml (shard %u)!\n", __func__, k);
+            exit(-1);
+        }
+    }
+    free(diff_hd);
+    free(changed);
+
+    if (store != NULL) {
+        compare_store_delete(store, database, prev_hd);
+        fputs("</PrevXmlSet>\n", prev_hd);
+        if (file_cache_drop(prev_hd) != 0 || fclose(prev_hd) != 0) {
+            fprintf(stderr, "\n[Error:%s] failed to write the previous versions (%s)!\n", __func__, prev_name);
+            exit(-1);
+        }
+
+        for (uint32_t k=0; k < (m_changed << 1); k++) k_strfree(&blobs[k]);
+        free(blobs);
+    }
+
+    if (index != NULL) {
+        if (n_invalid == 0) record_index_save(index, 0);
+        record_index_close(index);
+    }
+
+    if (fields != NULL) {
+        if (n_invalid == 0) field_table_save(fields, 0);
+        fprintf(stderr, "\n[*] extract the fields: %u rows, %u columns", fields->n_row, fields->n_field);
+        field_table_close(fields);
+    }
+
+    if (fingerprint != NULL && fingerprint->n_prev > 0)
+        fprintf(stderr, "\n[*] skipped chunks: %lu of %u (%.1f MB, %lu items)", (unsigned long)fingerprint->n_skip_total,
+                fingerprint->n_prev, (double)fingerprint->n_skip_byte / (1 << 20), (unsigned long)fingerprint->n_skip_id);
+
+    if (stamps != NULL) {
+        fprintf(stderr, "\n[*] pre-check: %lu items not hashed, %lu sampled", (unsigned long)stamps->n_skip,
+                (unsigned long)stamps->n_sample);
+        if (stamps->n_miss > 0)
+            fprintf(stderr, "\n[Warning:%s] %lu sampled items are changed without changing last_update!", __func__,
+                    (unsigned long)stamps->n_miss);
+    }
+
+    database_destroy(cache_db);
+    if (n_invalid == 0) fprintf(stderr, "\n[%s] done!\n", get_current_time(time_buf));
+    return n_invalid;
 }
 
 
-void diff_list_write(const database_t *database, const char *diff_list)
+void diff_list_write(const database_t *database, const char *diff_list, uint32_t n_shard, uint64_t *n_entry)
 {
-    FILE *file_hd = fopen(diff_list, "wb");
-
-    /* output the status (change, add, delete) to stander output */
-    uint8_t *flags = database->flags;
     static const char *table[] = {NULL, "DELETE", NULL, "ADD", "CHANGE"};
+    if (n_shard == 0) n_shard = 1;
+    const uint64_t t_list = trace_begin();
+
+    /* each shard (id % n_shard) is written by its own thread */
+    #pragma omp parallel for schedule(dynamic, 1) if(n_shard > 1)
+    for (uint32_t k=0; k < n_shard; k++) {
+        char name_buf[1024];
+        if (n_shard > 1) shard_name(name_buf, sizeof(name_buf), diff_list, k);
+        else snprintf(name_buf, sizeof(name_buf), "%s", diff_list);
+
+        FILE *file_hd = fopen(name_buf, "wb");
+        if (file_hd == NULL) {
+            fprintf(stderr, "[Error:diff_list_write]: failed to open the output (%s)!\n", name_buf);
+            exit(-1);
+        }
+
+        /* output the status (change, add, delete) to stander output */
+        uint64_t n_write = 0;
+
+        /* the unused (0) and unchanged (2) items are skipped by the vector kernel */
+        uint64_t changed[(1U << DATABASE_LEAF_SHIFT) >> 6];
+
+        for (uint32_t start=0; start < database->capacity; start += 1U << DATABASE_LEAF_SHIFT) {
+            const uint32_t n = database->capacity - start < (1U << DATABASE_LEAF_SHIFT) ?
+                               database->capacity - start : (1U << DATABASE_LEAF_SHIFT);
+            if (database_flags_changed(database, start, n, changed) == 0) continue;
+
+            for (uint32_t w=0; w < (n + 63) >> 6; w++) {
+                for (uint64_t mask=changed[w]; mask != 0; mask &= mask - 1) {
+                    const uint32_t id = start + (w << 6) + __builtin_ctzll(mask);
+                    if (id % n_shard != k) continue;
+
+                    fprintf(file_hd, "%s\t%d\n", table[database_flag(database, id)], id);
+                    n_write++;
+                }
+            }
+        }
+        fclose(file_hd);
+
+        if (n_entry != NULL) n_entry[k] = n_write;
+    }
+    trace_end(t_list, "write", database->capacity);
+}
+
+
+void diff_manifest_write(const args_t *args, const char *diff_xml, const char *diff_list, const uint64_t *n_entry,
+                         const char *manifest)
+{
+    FILE *file_hd = fopen(manifest, "wb");
+    if (file_hd == NULL) {
+        fprintf(stderr, "[Error:%s]: failed to open the output (%s)!\n", __func__, manifest);
+        exit(-1);
+    }
+
+    fprintf(file_hd, "#date\t%d\n#shards\t%d\n#partition\tid %% %d\n", args->xml_date, args->output_shards,
+            args->output_shards);
+    fprintf(file_hd, "#shard\txml_file\txml_size\tlist_file\tn_entry\n");
+
+    for (uint32_t k=0; k < (uint32_t)args->output_shards; k++) {
+        char xml_buf[1024], list_buf[1024];
+        struct stat st;
 
-    for (uint32_t id=0; id < database->capacity; id++) {
-        if (table[flags[id]] == NULL)  /* 0:unused and 2:unchanged */
-            continue;
+        shard_name(xml_buf, sizeof(xml_buf), diff_xml, k);
+        shard_name(list_buf, sizeof(list_buf), diff_list, k);
+        if (stat(xml_buf, &st) != 0) st.st_size = 0;
 
-        fprintf(file_hd, "%s\t%d\n", table[flags[id]], id);
+        /* the file names are relative to the manifest */
+        const char *xml_base = strrchr(xml_buf, '/'), *list_base = strrchr(list_buf, '/');
+        fprintf(file_hd, "%u\t%s\t%lu\t%s\t%lu\n", k, xml_base ? xml_base + 1 : xml_buf, (unsigned long)st.st_size,
+                list_base ? list_base + 1 : list_buf, (unsigned long)n_entry[k]);
     }
+
     fclose(file_hd);
 }
 
 
-void sample_xml_compare(const args_t *args)
+int sample_xml_compare(const args_t *args)
 {
-    database_t *database = database_load(args->database);
+    checkpoint_t ckpt;
+    database_t *database = NULL;
+
+    /* the checkpoint holds the partial compared table */
+    checkpoint_init(&ckpt, args);
+    if (args->resume)
+        database = checkpoint_load(&ckpt, args);
+
+    if (database == NULL)
+        database = database_load(args->database);
 
     if (strcmp(database->db_type, "SAMPLE") != 0) {
         fprintf(stderr, "[Error:%s] conflict database type: %s!\n", __func__, database->db_type);
         exit(-1);
     }
 
-    if (args->xml_date <= database->db_date) {
+    if ((uint32_t)args->xml_date <= database->db_date) {
         fprintf(stderr, "[Error:%s] conflict date detected between the database and given xml file!\n", __func__);
         fprintf(stderr, "  (-) database date: %d\n", database->db_date);
         fprintf(stderr, "  (-) the xml date: %d\n", args->xml_date);
@@ -107,30 +493,96 @@ void sample_xml_compare(const args_t *args)
     }
 
     /* parse the difference of the xml file */
-    char path_buf[512];
+    char path_buf[512], prev_buf[512];
 
     snprintf(path_buf, sizeof(path_buf), "%s/sample_diff.xml", args->output_dir);
-    xml_compare_core(database, args->xml_file, path_buf, SAMPLE_START_TAG, SAMPLE_END_TAG);
+    snprintf(prev_buf, sizeof(prev_buf), "%s/sample_prev.xml", args->output_dir);
+    body_store_t *store = NULL;
+    if (args->body_store)
+        store = body_store_open(args->database, database->capacity, args->resume, 0);
+
+    /* the records with the same last_update and size as the database are not hashed,
+     * the stamps missing are rebuilt from all chunks, so none of them is skipped */
+    stamp_table_t *stamps = NULL;
+    int stamp_ready = 1;
+    if (args->precheck) {
+        stamps = stamp_table_open(args->database, args->xml_date, args->paranoia);
+        stamp_ready = stamp_table_load(stamps, database, ckpt.offset != 0) == 0;
+    }
+
+    /* the unchanged chunks are skipped, unless each data body is indexed, validated or extracted */
+    fingerprint_t *fingerprint = NULL;
+    if (!args->no_fingerprint && !args->checkpoint && !args->resume)
+        fingerprint = fingerprint_open(args->database, database,
+                                       !args->record_index && !args->validate && !args->fields && stamp_ready);
+
+    /* the database and the sidecars are not updated with the invalid xml file */
+    if (xml_compare_core(database, args, &ckpt, store, fingerprint, stamps, path_buf, prev_buf, SAMPLE_START_TAG,
+                         SAMPLE_END_TAG) > 0) {
+        body_store_close(store);
+        fingerprint_close(fingerprint);
+        stamp_table_close(stamps);
+        database_destroy(database);
+        return -1;
+    }
+
+    /* the difference list (and the manifest of the shards) */
+    char list_buf[512];
+    uint64_t *n_entry;
+    err_calloc(n_entry, ckpt.n_shard + 1, uint64_t);
+
+    snprintf(list_buf, sizeof(list_buf), "%s/sample_diff.list", args->output_dir);
+    diff_list_write(database, list_buf, ckpt.n_shard, n_entry);
 
-    snprintf(path_buf, sizeof(path_buf), "%s/sample_diff.list", args->output_dir);
-    diff_list_write(database, path_buf);
+    if (ckpt.n_shard) {
+        snprintf(prev_buf, sizeof(prev_buf), "%s/sample_diff.manifest", args->output_dir);
+        diff_manifest_write(args, path_buf, list_buf, n_entry, prev_buf);
+    }
+    free(n_entry);
+    free(ckpt.shard_size);
 
     /* update the database to current date */
     database->db_date = args->xml_date;
     database_update(database, args->database);
+    checkpoint_remove(args);
+
+    if (store != NULL) {
+        body_store_save(store, 0);
+        body_store_close(store);
+    }
+
+    if (fingerprint != NULL) {
+        fingerprint_save(fingerprint, args->database, database);
+        fingerprint_close(fingerprint);
+    }
+
+    if (stamps != NULL) {
+        stamp_table_save(stamps, database, 0);
+        stamp_table_close(stamps);
+    }
+    return 0;
 }
 
 
-void project_xml_compare(const args_t *args)
+int project_xml_compare(const args_t *args)
 {
-    database_t *database = database_load(args->database);
+    checkpoint_t ckpt;
+    database_t *database = NULL;
+
+    /* the checkpoint holds the partial compared table */
+    checkpoint_init(&ckpt, args);
+    if (args->resume)
+        database = checkpoint_load(&ckpt, args);
+
+    if (database == NULL)
+        database = database_load(args->database);
 
     if (strcmp(database->db_type, "PROJECT") != 0) {
         fprintf(stderr, "[Error:%s] conflict database type: %s!\n", __func__, database->db_type);
         exit(-1);
     }
 
-    if (args->xml_date <= database->db_date) {
+    if ((uint32_t)args->xml_date <= database->db_date) {
         fprintf(stderr, "[Error:%s] conflict date detected between the database and given xml file!\n", __func__);
         fprintf(stderr, "  (-) database date: %d\n", database->db_date);
         fprintf(stderr, "  (-) the xml date: %d\n", args->xml_date);
@@ -138,15 +590,56 @@ void project_xml_compare(const args_t *args)
     }
 
     /* parse the difference of the xml file */
-    char path_buf[512];
+    char path_buf[512], prev_buf[512];
 
     snprintf(path_buf, sizeof(path_buf), "%s/project_diff.xml", args->output_dir);
-    xml_compare_core(database, args->xml_file, path_buf, PROJECT_START_TAG, PROJECT_END_TAG);
+    snprintf(prev_buf, sizeof(prev_buf), "%s/project_prev.xml", args->output_dir);
+    body_store_t *store = NULL;
+    if (args->body_store)
+        store = body_store_open(args->database, database->capacity, args->resume, 0);
+
+    /* the unchanged chunks are skipped, unless each data body is indexed, validated or extracted */
+    fingerprint_t *fingerprint = NULL;
+    if (!args->no_fingerprint && !args->checkpoint && !args->resume)
+        fingerprint = fingerprint_open(args->database, database, !args->record_index && !args->validate && !args->fields);
+
+    /* the database and the sidecars are not updated with the invalid xml file */
+    if (xml_compare_core(database, args, &ckpt, store, fingerprint, NULL, path_buf, prev_buf, PROJECT_START_TAG,
+                         PROJECT_END_TAG) > 0) {
+        body_store_close(store);
+        fingerprint_close(fingerprint);
+        database_destroy(database);
+        return -1;
+    }
+
+    /* the difference list (and the manifest of the shards) */
+    char list_buf[512];
+    uint64_t *n_entry;
+    err_calloc(n_entry, ckpt.n_shard + 1, uint64_t);
 
-    snprintf(path_buf, sizeof(path_buf), "%s/project_diff.list", args->output_dir);
-    diff_list_write(database, path_buf);
+    snprintf(list_buf, sizeof(list_buf), "%s/project_diff.list", args->output_dir);
+    diff_list_write(database, list_buf, ckpt.n_shard, n_entry);
+
+    if (ckpt.n_shard) {
+        snprintf(prev_buf, sizeof(prev_buf), "%s/project_diff.manifest", args->output_dir);
+        diff_manifest_write(args, path_buf, list_buf, n_entry, prev_buf);
+    }
+    free(n_entry);
+    free(ckpt.shard_size);
 
     /* update the database to current date */
     database->db_date = args->xml_date;
     database_update(database, args->database);
+    checkpoint_remove(args);
+
+    if (store != NULL) {
+        body_store_save(store, 0);
+        body_store_close(store);
+    }
+
+    if (fingerprint != NULL) {
+        fingerprint_save(fingerprint, args->database, database);
+        fingerprint_close(fingerprint);
+    }
+    return 0;
 }
@@ -9,20 +9,65 @@
 #define INSDCXMLPARSER_XML_COMPARE_H
 
 #include "params.h"
+#include "database.h"
+#include "checkpoint.h"
+#include "body_store.h"
+#include "fingerprint.h"
+#include "update_stamp.h"
+
+
+/*! @function: compare the xml file with the database, write the different data body and set the flags
+  @param  database           the database object (the flags are set to 2:constant, 3:add, 4:modify)
+  @param  args               the command line parameters (xml_file, checkpoint)
+  @param  ckpt               the checkpoint object (resume from ckpt->offset if it is not 0)
+  @param  store              the body store updated with the added and changed items (NULL: disabled)
+  @param  fingerprint        the chunk fingerprints, the unchanged chunks are skipped (NULL: disabled)
+  @param  stamps             the stamps of the records, the records with the same stamps are not hashed (NULL: disabled)
+  @param  diff_name          the output diff xml file (with shards: sample_diff.xml -> sample_diff.<k>.xml)
+  @param  prev_name          the output xml file of the previous versions (only used with body store)
+  @param  start_tag          the start tag of the data body
+  @param  end_tag            the end tag of the data body
+  @return                    the number of errors found in the xml file (0: valid or not validated)
+ */
+uint64_t xml_compare_core(database_t *database, const args_t *args, checkpoint_t *ckpt, body_store_t *store,
+                      fingerprint_t *fingerprint, stamp_table_t *stamps, char *diff_name, char *prev_name,
+                      char *start_tag, char *end_tag);
+
+
+/*! @function: write the difference list (ADD/CHANGE/DELETE) with the flags after comparing
+  @param  database           the database object
+  @param  diff_list          the output list file (with shards: sample_diff.list -> sample_diff.<k>.list)
+  @param  n_shard            the number of shards, the ids are partitioned by id % n_shard (0 or 1: no shard)
+  @param  n_entry            the number of entries written into each shard (NULL: ignored)
+  @return
+ */
+void diff_list_write(const database_t *database, const char *diff_list, uint32_t n_shard, uint64_t *n_entry);
+
+
+/*! @function: write the manifest of the shards (index, xml file, xml size, list file, number of entries)
+  @param  args               the command line parameters (xml_date, output_shards)
+  @param  diff_xml           the diff xml file name before sharding
+  @param  diff_list          the list file name before sharding
+  @param  n_entry            the number of entries of each shard
+  @param  manifest           the output manifest file
+  @return
+ */
+void diff_manifest_write(const args_t *args, const char *diff_xml, const char *diff_list, const uint64_t *n_entry,
+                         const char *manifest);
 
 
 /*! @function: compare the difference between database and the current biosample
   @param  args               the command line parameters
-  @return
+  @return                    status (-1: the xml file is invalid, the database is not updated)
  */
-void sample_xml_compare(args_t *args);
+int sample_xml_compare(const args_t *args);
 
 
 /*! @function: compare the difference between database and the current bioproject
   @param  args               the command line parameters
-  @return
+  @return                    status (-1: the xml file is invalid, the database is not updated)
  */
-void project_xml_compare(args_t *args);
+int project_xml_compare(const args_t *args);
 
 
 #endif //INSDCXMLPARSER_XML_COMPARE_H
\ No newline at end of file
@@ -0,0 +1,344 @@
+/*************************************************************************
+    > File Name: xml_diff.c
+    > Author: xlzh
+    > Mail: xiaolongzhang2015@163.com
+    > Created Time: 2025年12月17 10时12分48秒
+ ************************************************************************/
+
+#include <omp.h>
+#include <sys/stat.h>
+
+#include "md5.h"
+#include "database.h"
+#include "stream_reader.h"
+#include "checkpoint.h"
+#include "xml_compare.h"
+#include "xml_diff.h"
+
+
+/*! @typedef entry_t
+  @abstract the id and MD5 of a data body from the previous xml file
+ */
+typedef struct {
+    uint32_t id;
+    uint8_t md5[16];
+} entry_t;
+
+
+/*! @typedef queue_t
+  @abstract the previous items waiting to join with the current items (ascending id)
+  @field  head              the index of the first item not joined yet
+  @field  size              the number of items in the list
+  @field  capacity          the max number of items allowed to store
+  @field  eof               [0|1] 1: the previous xml file is consumed
+  @field  entries           the item list
+  @field  cache             the cache of the previous xml file
+ */
+typedef struct {
+    uint64_t head;
+    uint64_t size;
+    uint64_t capacity;
+    int eof;
+    entry_t *entries;
+    cache_t *cache;
+} queue_t;
+
+
+#define queue_memory_resize(_queue, _n) do {                                       \
+    if ((_queue)->capacity < (_n)) {                                               \
+        (_queue)->capacity = (_n) + ((_n) >> 1);                                   \
+        err_realloc((_queue)->entries, (_queue)->capacity, entry_t);               \
+    }                                                                              \
+} while(0)
+
+
+#define queue_last_id(_queue) ((_queue)->entries[(_queue)->size-1].id)
+
+
+/* read the next batch of the previous xml file (0: the file is consumed) */
+static uint32_t queue_read(queue_t *queue)
+{
+    if (queue->eof || stream_cache_data(queue->cache) < 0) {
+        queue->eof = 1;
+        return 0;
+    }
+    return queue->cache->size;
+}
+
+
+/* append the hashed batch into the queue (-1: the ids are not ascending) */
+static int queue_append(queue_t *queue, const entry_t *batch, uint32_t n_item)
+{
+    for (uint32_t i=0; i < n_item; i++) {
+        if (queue->size > 0 && batch[i].id <= queue_last_id(queue))
+            return -1;
+        queue->entries[queue->size++] = batch[i];
+    }
+    return 0;
+}
+
+
+/* read and hash the previous batches until the queue covers the given id */
+static int queue_cover(queue_t *queue, entry_t **batch, uint64_t *m_batch, uint32_t id)
+{
+    while (!queue->eof && (queue->head == queue->size || queue_last_id(queue) < id)) {
+        uint32_t n_item = queue_read(queue);
+
+        if (*m_batch < n_item) {
+            *m_batch = n_item;
+            err_realloc(*batch, *m_batch, entry_t);
+        }
+
+        #pragma omp parallel for schedule(dynamic, 64)
+        for (uint32_t i=0; i < n_item; i++) {
+            body_t *body = &queue->cache->item_list[i];
+            (*batch)[i].id = body->id;
+            md5_calculate_block((uint8_t *)body->start, body->size, (*batch)[i].md5);
+        }
+
+        queue_memory_resize(queue, queue->size + n_item);
+        if (queue_append(queue, *batch, n_item) != 0)
+            return -1;
+    }
+    return 0;
+}
+
+
+/* func: merge join of two xml files with ascending ids, the memory is bounded by the batch size
+ *
+ *    previous     current      status
+ *      id_a        none        DELETE
+ *      none        id_a        ADD
+ *      md5_a       md5_a       -
+ *      md5_a       md5_b       CHANGE
+ *
+ * return -1 if the ids of either file are not ascending, -2 if either file is invalid, the outputs are incomplete then.
+ */
+static int xml_diff_merge_join(const args_t *args, const char *diff_name, const char *list_name,
+                               const char *start_tag, const char *end_tag, uint64_t *n_diff)
+{
+    FILE *diff_hd = fopen(diff_name, "wb");
+    FILE *list_hd = fopen(list_name, "wb");
+
+    if (diff_hd == NULL || list_hd == NULL) {
+        fprintf(stderr, "[Error:%s]: failed to open the output (%s)!\n", __func__, diff_name);
+        exit(-1);
+    }
+
+    queue_t queue;
+    memset(&queue, 0, sizeof(queue_t));
+    queue.cache = stream_cache_init(args->prev_file, start_tag, end_tag);
+    cache_t *cache = stream_cache_init(args->xml_file, start_tag, end_tag);
+
+    if (args->validate) {
+        stream_cache_validate(queue.cache);
+        stream_cache_validate(cache);
+    }
+
+    /* both files are read at the same time, the limit is shared */
+    stream_cache_throttle(queue.cache, (uint64_t)args->io_rate_limit << 19);
+    stream_cache_throttle(cache, (uint64_t)args->io_rate_limit << 19);
+
+    entry_t *batch = NULL, *prev_batch = NULL;
+    uint64_t m_batch = 0, m_prev_batch = 0, n_total_item = 0;
+    uint32_t last_id = 0;
+    int status = 0, first = 1;
+
+    fputs("<DiffXmlSet>\n", diff_hd);  /* add root start tag */
+    *n_diff = 0;
+
+    while (1) {
+        int cur_status = 0;
+        uint32_t n_prev = 0;
+
+        /* read the next batch of both files concurrently, the previous one only if the queue is behind */
+        int prev_need = !queue.eof && (queue.head == queue.size || queue_last_id(&queue) <= last_id);
+
+        #pragma omp parallel sections
+        {
+            #pragma omp section
+            cur_status = stream_cache_data(cache);
+
+            #pragma omp section
+            n_prev = prev_need ? queue_read(&queue) : 0;
+        }
+
+        uint32_t n_cur = cur_status < 0 ? 0 : cache->size;
+        if (m_batch < n_cur) {
+            m_batch = n_cur;
+            err_realloc(batch, m_batch, entry_t);
+        }
+        if (m_prev_batch < n_prev) {
+            m_prev_batch = n_prev;
+            err_realloc(prev_batch, m_prev_batch, entry_t);
+        }
+
+        /* hash the items of both files in parallel */
+        #pragma omp parallel for schedule(dynamic, 64)
+        for (uint32_t i=0; i < n_cur + n_prev; i++) {
+            const body_t *body = i < n_cur ? &cache->item_list[i] : &queue.cache->item_list[i-n_cur];
+            entry_t *entry = i < n_cur ? &batch[i] : &prev_batch[i-n_cur];
+
+            entry->id = body->id;
+            md5_calculate_block((uint8_t *)body->start, body->size, entry->md5);
+        }
+
+        queue_memory_resize(&queue, queue.size + n_prev);
+        if (queue_append(&queue, prev_batch, n_prev) != 0) { status = -1; break; }
+        if (cur_status < 0) break;
+
+        /* the queue must cover the last id of the current batch before joining */
+        if (n_cur > 0 && queue_cover(&queue, &prev_batch, &m_prev_batch, batch[n_cur-1].id) != 0) {
+            status = -1; break;
+        }
+
+        for (uint32_t i=0; i < n_cur; i++) {
+            const uint32_t id = batch[i].id;
+
+            if (!first && id <= last_id) { status = -1; break; }
+            last_id = id; first = 0;
+
+            /* the previous items before the id are deleted */
+            for (; queue.head < queue.size && queue.entries[queue.head].id < id; queue.head++) {
+                fprintf(list_hd, "DELETE\t%d\n", queue.entries[queue.head].id);
+                (*n_diff)++;
+            }
+
+            const char *diff = "ADD";
+            if (queue.head < queue.size && queue.entries[queue.head].id == id) {
+                diff = memcmp(queue.entries[queue.head].md5, batch[i].md5, 16) ? "CHANGE" : NULL;
+                queue.head++;
+            }
+
+            if (diff != NULL) {
+                body_t *body = &cache->item_list[i];
+                fwrite(body->start, sizeof(char), body->size, diff_hd);
+                fwrite("\n", sizeof(char), 1, diff_hd);
+                fprintf(list_hd, "%s\t%d\n", diff, id);
+                (*n_diff)++;
+            }
+        }
+        if (status != 0) break;
+
+        /* drop the joined items of the queue */
+        if (queue.head > (queue.size >> 1)) {
+            memmove(queue.entries, queue.entries + queue.head, (queue.size - queue.head) * sizeof(entry_t));
+            queue.size -= queue.head;
+            queue.head = 0;
+        }
+
+        n_total_item += n_cur;
+        fprintf(stderr, "\r[*] compare number of items: %lu", (unsigned long)n_total_item);
+    }
+
+    /* the remaining items of the previous file are deleted */
+    if (status == 0 && queue_cover(&queue, &prev_batch, &m_prev_batch, UINT32_MAX) != 0)
+        status = -1;
+
+    for (; status == 0 && queue.head < queue.size; queue.head++) {
+        fprintf(list_hd, "DELETE\t%d\n", queue.entries[queue.head].id);
+        (*n_diff)++;
+    }
+
+    fputs("</DiffXmlSet>\n", diff_hd);  /* add root close tag */
+    if (file_cache_drop(diff_hd) != 0 || fclose(diff_hd) != 0 || fclose(list_hd) != 0) {
+        fprintf(stderr, "\n[Error:%s]: failed to write the output (%s)!\n", __func__, diff_name);
+        exit(-1);
+    }
+
+    const uint64_t n_invalid = stream_cache_destroy(cache) + stream_cache_destroy(queue.cache);
+    if (queue.entries != NULL) free(queue.entries);
+    if (batch != NULL) free(batch);
+    if (prev_batch != NULL) free(prev_batch);
+
+    return n_invalid > 0 ? -2 : status;
+}
+
+
+/* hash join of two xml files: build the table of the previous file, then compare the current one (-2: invalid) */
+static int xml_diff_hash_join(const args_t *args, char *diff_name, const char *list_name,
+                               char *start_tag, char *end_tag, uint64_t *n_diff)
+{
+    uint32_t table_size = strcmp(args->xml_type, "SAMPLE") ? PROJECT_TABLE_SIZE : SAMPLE_TABLE_SIZE;
+    database_t *database = database_init(table_size, DATABASE_HASH_FULL, DATABASE_LAYOUT_SPLIT);
+    cache_t *cache = stream_cache_init(args->prev_file, start_tag, end_tag);
+    if (args->validate) stream_cache_validate(cache);
+    stream_cache_throttle(cache, (uint64_t)args->io_rate_limit << 20);
+
+    while (stream_cache_data(cache) >= 0) {
+        uint32_t max_id = 0;
+        for (uint32_t i=0; i < cache->size; i++)
+            max_id = cache->item_list[i].id > max_id ? cache->item_list[i].id : max_id;
+        database_resize(database, max_id + 1);
+
+        #pragma omp parallel for shared(cache, database)
+        for (int i=0; i < cache->size; i++) {
+            uint8_t md5_str[16];
+            body_t *body = &cache->item_list[i];
+
+            md5_calculate_block((uint8_t *)body->start, body->size, md5_str);
+            database_add(database, body->id, md5_str);
+        }
+    }
+
+    if (stream_cache_destroy(cache) > 0) {
+        database_destroy(database);
+        return -2;
+    }
+
+    /* the same as comparing with a database, but nothing is saved */
+    checkpoint_t ckpt;
+    checkpoint_init(&ckpt, args);
+    if (xml_compare_core(database, args, &ckpt, NULL, NULL, NULL, diff_name, NULL, start_tag, end_tag) > 0) {
+        database_destroy(database);
+        return -2;
+    }
+    diff_list_write(database, list_name, 0, NULL);
+
+    *n_diff = 0;
+    for (uint32_t id=0; id < database->capacity; id++)
+        *n_diff += database_flag(database, id) == 1 || database_flag(database, id) >= 3;
+
+    database_destroy(database);
+    return 0;
+}
+
+
+/* the file could be read again from the start (not the standard input or a pipe) */
+static int xml_diff_rereadable(const char *xml_file)
+{
+    struct stat st;
+    return strcmp(xml_file, "-") != 0 && stat(xml_file, &st) == 0 && S_ISREG(st.st_mode);
+}
+
+
+int xml_diff_run(const args_t *args)
+{
+    char time_buf[32], diff_name[512], list_name[512];
+    const int is_sample = strcmp(args->xml_type, "SAMPLE") == 0;
+    char *start_tag = is_sample ? SAMPLE_START_TAG : PROJECT_START_TAG;
+    char *end_tag = is_sample ? SAMPLE_END_TAG : PROJECT_END_TAG;
+    uint64_t n_diff = 0;
+
+    snprintf(diff_name, sizeof(diff_name), "%s/%s_diff.xml", args->output_dir, is_sample ? "sample" : "project");
+    snprintf(list_name, sizeof(list_name), "%s/%s_diff.list", args->output_dir, is_sample ? "sample" : "project");
+
+    fprintf(stderr, "[%s] start to compare the difference ...\n", get_current_time(time_buf));
+    /* the hash join reads both files from the start, so the pipes (consumed once) skip the merge join */
+    int status = -1;
+    if (xml_diff_rereadable(args->prev_file) && xml_diff_rereadable(args->xml_file)) {
+        status = xml_diff_merge_join(args, diff_name, list_name, start_tag, end_tag, &n_diff);
+        if (status == -1) fprintf(stderr, "\n[*] the IDs are not ascending, switch to hash join\n");
+    }
+    else {
+        fprintf(stderr, "[*] the xml file is read from a pipe, use hash join\n");
+    }
+
+    if (status == -1)
+        status = xml_diff_hash_join(args, diff_name, list_name, start_tag, end_tag, &n_diff);
+    if (status != 0) return -1;  /* the xml file is invalid */
+
+    fprintf(stderr, "\n[*] number of differences: %lu\n", (unsigned long)n_diff);
+    fprintf(stderr, "[%s] done!\n", get_current_time(time_buf));
+    return 0;
+}
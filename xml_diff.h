@@ -0,0 +1,21 @@
+/*************************************************************************
+    > File Name: xml_diff.h
+    > Author: xlzh
+    > Mail: xiaolongzhang2015@163.com
+    > Created Time: 2025年12月17 10时12分48秒
+ ************************************************************************/
+
+#ifndef INSDCXMLPARSER_XML_DIFF_H
+#define INSDCXMLPARSER_XML_DIFF_H
+
+#include "params.h"
+
+
+/*! @function: compare two xml files directly without building the database
+  @param  args               the command line parameters (prev_file, xml_file, xml_type, output_dir)
+  @return                    status (-1: either xml file is invalid, the outputs are incomplete)
+ */
+int xml_diff_run(const args_t *args);
+
+
+#endif //INSDCXMLPARSER_XML_DIFF_H
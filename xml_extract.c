@@ -0,0 +1,194 @@
+/*************************************************************************
+    > File Name: xml_extract.c
+    > Author: xlzh
+    > Mail: xiaolongzhang2015@163.com
+    > Created Time: 2025年12月24 15时26分08秒
+ ************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <omp.h>
+
+#include "utils.h"
+#include "record_index.h"
+#include "xml_extract.h"
+
+
+/*! @typedef extract_t
+  @abstract the data body to extract (the position in the xml file and in the batch buffer)
+ */
+typedef struct {
+    uint64_t offset;
+    uint32_t size;
+    uint32_t id;
+    uint64_t pos;
+} extract_t;
+
+
+static int extract_compare(const void *a, const void *b)
+{
+    const extract_t *x = (const extract_t *)a, *y = (const extract_t *)b;
+
+    return x->offset < y->offset ? -1 : x->offset > y->offset;
+}
+
+
+/* func: read the ids (the last number of each line, e.g. the sample_diff.list is accepted directly) */
+static uint32_t *extract_ids_read(const char *ids_file, uint32_t *n_id)
+{
+    FILE *file_hd = strcmp(ids_file, "-") == 0 ? stdin : fopen(ids_file, "r");
+    if (file_hd == NULL) {
+        fprintf(stderr, "[Error:%s] failed to open the id list (%s)!\n", __func__, ids_file);
+        exit(-1);
+    }
+
+    char line[1024];
+    uint32_t *ids = NULL, m_id = 0;
+    *n_id = 0;
+
+    while (fgets(line, sizeof(line), file_hd) != NULL) {
+        if (line[0] == '#') continue;
+
+        /* the last run of digits in the line */
+        char *end = line + strlen(line), *start;
+        while (end > line && !isdigit((unsigned char)end[-1])) end--;
+        for (start = end; start > line && isdigit((unsigned char)start[-1]); start--) ;
+        if (start == end) continue;
+
+        if (*n_id == m_id) {
+            m_id = m_id ? m_id << 1 : 1024;
+            err_realloc(ids, m_id, uint32_t);
+        }
+        ids[(*n_id)++] = (uint32_t)strtoul(start, NULL, 10);
+    }
+
+    if (file_hd != stdin) fclose(file_hd);
+    return ids;
+}
+
+
+/* func: read the whole data body, the short reads are continued */
+static int extract_pread(int fd, char *buf, uint32_t size, uint64_t offset)
+{
+    while (size > 0) {
+        ssize_t n_bytes = pread(fd, buf, size, (off_t)offset);
+        if (n_bytes <= 0) return -1;
+
+        buf += n_bytes; size -= (uint32_t)n_bytes; offset += (uint64_t)n_bytes;
+    }
+
+    return 0;
+}
+
+
+void xml_extract_run(const args_t *args)
+{
+    char time_buf[32];
+    fprintf(stderr, "[%s] start to extract the data bodies ...\n", get_current_time(time_buf));
+
+    record_index_t *index = record_index_load(args->database);
+    if (index == NULL) {
+        fprintf(stderr, "[Error:%s] the record index (%s%s) is not existed, build with --index!\n", __func__,
+                args->database, RECORD_INDEX_SUFFIX);
+        exit(-1);
+    }
+
+    /* the offsets are only valid for the indexed xml file */
+    struct stat st;
+    int fd = open(args->xml_file, O_RDONLY);
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        fprintf(stderr, "[Error:%s] failed to open the xml file (%s)!\n", __func__, args->xml_file);
+        exit(-1);
+    }
+
+    if (index->xml_size != 0 && index->xml_size != (uint64_t)st.st_size) {
+        fprintf(stderr, "[Error:%s] the xml file (%lu bytes) does not match the record index (%d, %lu bytes)!\n",
+                __func__, (unsigned long)st.st_size, index->xml_date, (unsigned long)index->xml_size);
+        exit(-1);
+    }
+
+    /* look up the ids, then read the data bodies in the order of offset */
+    uint32_t n_id, n_record = 0;
+    uint64_t n_missing = 0;
+    uint32_t *ids = extract_ids_read(args->ids_file, &n_id);
+
+    extract_t *records;
+    err_malloc(records, n_id + 1, extract_t);
+
+    for (uint32_t k=0; k < n_id; k++) {
+        if (ids[k] >= index->capacity || index->sizes[ids[k]] == 0) {
+            n_missing++;
+            continue;
+        }
+        records[n_record].offset = index->offsets[ids[k]];
+        records[n_record].size = index->sizes[ids[k]];
+        records[n_record++].id = ids[k];
+    }
+    free(ids);
+
+    qsort(records, n_record, sizeof(extract_t), extract_compare);
+
+    uint32_t n_unique = 0;
+    for (uint32_t k=0; k < n_record; k++) {
+        if (n_unique > 0 && records[n_unique-1].id == records[k].id) continue;
+        records[n_unique++] = records[k];
+    }
+
+    FILE *file_hd = fopen(args->output_file, "wb");
+    if (file_hd == NULL) {
+        fprintf(stderr, "[Error:%s]: failed to open the output (%s)!\n", __func__, args->output_file);
+        exit(-1);
+    }
+    fputs("<ExtractXmlSet>\n", file_hd);
+
+    /* each batch is read in parallel with pread, then written in the order of offset */
+    char *buffer = NULL;
+    uint64_t m_buffer = 0;
+
+    for (uint32_t start=0, end; start < n_unique; start = end) {
+        uint64_t n_byte = 0;
+        for (end=start; end < n_unique && (end == start || n_byte < EXTRACT_BATCH_SIZE); end++) {
+            records[end].pos = n_byte;
+            n_byte += records[end].size + 1;  /* with the line break */
+        }
+
+        if (m_buffer < n_byte) {
+            m_buffer = n_byte;
+            err_realloc(buffer, m_buffer, char);
+        }
+
+        uint32_t n_broken = 0;
+        #pragma omp parallel for schedule(dynamic, 16) reduction(+:n_broken)
+        for (uint32_t k=start; k < end; k++) {
+            char *data = buffer + records[k].pos;
+
+            if (extract_pread(fd, data, records[k].size, records[k].offset) != 0 || data[0] != '<')
+                n_broken++;
+            data[records[k].size] = '\n';
+        }
+
+        if (n_broken > 0) {
+            fprintf(stderr, "[Error:%s] %u data bodies are not found at the indexed offsets, the xml file or the "
+                    "record index is changed!\n", __func__, n_broken);
+            exit(-1);
+        }
+
+        fwrite(buffer, sizeof(char), n_byte, file_hd);
+    }
+
+    fputs("</ExtractXmlSet>\n", file_hd);
+    fclose(file_hd);
+    close(fd);
+
+    fprintf(stderr, "[*] extract number of items: %u, not found: %lu\n", n_unique, (unsigned long)n_missing);
+    fprintf(stderr, "[%s] done!\n", get_current_time(time_buf));
+
+    free(buffer);
+    free(records);
+    record_index_close(index);
+}
@@ -0,0 +1,24 @@
+/*************************************************************************
+    > File Name: xml_extract.h
+    > Author: xlzh
+    > Mail: xiaolongzhang2015@163.com
+    > Created Time: 2025年12月24 15时26分08秒
+ ************************************************************************/
+
+#ifndef INSDCXMLPARSER_XML_EXTRACT_H
+#define INSDCXMLPARSER_XML_EXTRACT_H
+
+#include "params.h"
+
+/* the bytes of the data bodies read in one batch */
+#define EXTRACT_BATCH_SIZE (64UL << 20)
+
+
+/*! @function: extract the data bodies of the given ids with the record index (<database>.rix)
+  @param  args               the command line parameters (database, xml_file, ids_file, output_file)
+  @return
+ */
+void xml_extract_run(const args_t *args);
+
+
+#endif //INSDCXMLPARSER_XML_EXTRACT_H
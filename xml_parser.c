@@ -10,29 +10,68 @@
 #include "params.h"
 #include "database.h"
 #include "xml_compare.h"
+#include "history.h"
+#include "xml_diff.h"
+#include "serve.h"
+#include "xml_extract.h"
+#include "db_compare.h"
+#include "trace.h"
 
 
 int main(int argc, char **argv)
 {
     args_t *args;
+    int status = 0;
     args = params_parse(argc, argv);
 
+    if (args->trace_file != NULL)
+        trace_open(args->trace_file);
+
     switch (args->params_mode) {
         case PARAMS_BUILD:
-            database_build(args);
+            status = database_build(args);
             break;
 
         case PARAMS_SAMPLE:
-            sample_xml_compare(args);
+            status = sample_xml_compare(args);
             break;
 
         case PARAMS_PROJECT:
-            project_xml_compare(args);
+            status = project_xml_compare(args);
+            break;
+
+        case PARAMS_HISTORY:
+            history_run(args);
+            break;
+
+        case PARAMS_MERGE:
+            database_merge(args);
+            break;
+
+        case PARAMS_DIFF:
+            status = xml_diff_run(args);
+            break;
+
+        case PARAMS_SERVE:
+            serve_run(args);
+            break;
+
+        case PARAMS_EXTRACT:
+            xml_extract_run(args);
+            break;
+
+        case PARAMS_DBCMP:
+            status = db_compare_run(args);
+            break;
+
+        case PARAMS_DBDIFF:
+            db_diff_run(args);
             break;
 
         default:
             fprintf(stderr, "[Error:%s] Trust me, you will never be here!\n\n", __func__);
     }
 
-    return 0;
+    trace_close();
+    return status;
 }
@@ -0,0 +1,342 @@
+/*************************************************************************
+    > File Name: xml_validate.c
+    > Author: xlzh
+    > Mail: xiaolongzhang2015@163.com
+    > Created Time: 2025年12月23 10时12分05秒
+ ************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <omp.h>
+
+#include "utils.h"
+#include "xml_validate.h"
+#include "cpu_dispatch.h"
+
+
+#define is_blank(_c) ((_c) == ' ' || (_c) == '\n' || (_c) == '\t' || (_c) == '\r')
+
+
+validate_t *validate_init(void)
+{
+    validate_t *validate;
+    err_calloc(validate, 1, validate_t);
+
+    return validate;
+}
+
+
+void validate_destroy(validate_t *validate)
+{
+    if (validate != NULL) free(validate);
+}
+
+
+/* func: keep the error if it is one of the first VALIDATE_MAX_ERROR errors (by offset) */
+static void validate_error(validate_t *validate, uint64_t offset, const char *message)
+{
+    validate->n_error++;
+
+    int k = validate->n_kept;
+    if (k == VALIDATE_MAX_ERROR) {
+        if (offset >= validate->errors[k-1].offset) return;
+        k--;
+    }
+    else validate->n_kept++;
+
+    /* insert the error in the order of offset */
+    for (; k > 0 && validate->errors[k-1].offset > offset; k--)
+        validate->errors[k] = validate->errors[k-1];
+
+    validate->errors[k].offset = offset;
+    validate->errors[k].message = message;
+}
+
+
+/* func: check the UTF-8 encoding (no overlong, surrogate or out of range code points) and the control characters
+ *
+ *   the printable ASCII, tab, LF and CR are skipped with the vector kernel of the cpu (see cpu_dispatch.h),
+ *   the other bytes fall back to the byte-wise check
+ */
+static const char *utf8_check(const char *data, const char *end, const char **message)
+{
+    const uint8_t *s = (const uint8_t *)data, *e = (const uint8_t *)end;
+
+    while (s < e) {
+        s += cpu_kernel.text_span(s, e - s);
+        if (s >= e) break;
+
+        const uint8_t c = *s;  /* a control character or a non-ASCII byte */
+
+        if (c < 0x20) {
+            *message = "invalid control character";
+            return (const char *)s;
+        }
+
+        /* the number of continuation bytes, and the range of the first continuation byte */
+        int n;
+        uint8_t lo = 0x80, hi = 0xBF;
+
+        if (c >= 0xC2 && c <= 0xDF)
+            n = 1;
+        else if (c >= 0xE0 && c <= 0xEF) {
+            n = 2;
+            if (c == 0xE0) lo = 0xA0;  /* overlong */
+            if (c == 0xED) hi = 0x9F;  /* surrogate */
+        }
+        else if (c >= 0xF0 && c <= 0xF4) {
+            n = 3;
+            if (c == 0xF0) lo = 0x90;  /* overlong */
+            if (c == 0xF4) hi = 0x8F;  /* beyond U+10FFFF */
+        }
+        else {
+            *message = "invalid UTF-8 lead byte";
+            return (const char *)s;
+        }
+
+        if (e - s <= n) {
+            *message = "truncated UTF-8 sequence";
+            return (const char *)s;
+        }
+
+        int valid = s[1] >= lo && s[1] <= hi;
+        for (int k=2; k <= n; k++)
+            valid &= (s[k] & 0xC0) == 0x80;
+
+        if (!valid) {
+            *message = "invalid UTF-8 sequence";
+            return (const char *)s;
+        }
+        s += n + 1;
+    }
+
+    return NULL;
+}
+
+
+/* func: check the tags of the data body are balanced (comments, CDATA and processing instructions are skipped) */
+static const char *tags_check(const char *data, const char *end, const char **message)
+{
+    const char *names[VALIDATE_MAX_DEPTH];
+    uint32_t lens[VALIDATE_MAX_DEPTH];
+    int depth = 0;
+
+    const char *p = data;
+    while (p < end && (p = memchr(p, '<', end - p)) != NULL) {
+        const char *close = NULL;
+        int is_markup = 1;
+
+        if (end - p >= 4 && memcmp(p, "<!--", 4) == 0)
+            close = memmem(p + 4, end - p - 4, "-->", 3);
+
+        else if (end - p >= 9 && memcmp(p, "<![CDATA[", 9) == 0)
+            close = memmem(p + 9, end - p - 9, "]]>", 3);
+
+        else if (end - p >= 2 && p[1] == '?')
+            close = memmem(p + 2, end - p - 2, "?>", 2);
+
+        else if (end - p >= 2 && p[1] == '!')
+            close = memchr(p, '>', end - p);
+
+        else
+            is_markup = 0;
+
+        if (is_markup) {  /* comment, CDATA, declaration or processing instruction */
+            if (close == NULL) {
+                *message = "unterminated markup";
+                return p;
+            }
+            p = (const char *)memchr(close, '>', end - close) + 1;
+            continue;
+        }
+
+        /* the element name of the open or close tag */
+        const int is_close = p + 1 < end && p[1] == '/';
+        const char *name = p + 1 + is_close, *q = name;
+
+        while (q < end && !is_blank(*q) && *q != '>' && *q != '/' && *q != '<')
+            q++;
+
+        const uint32_t len = (uint32_t)(q - name);
+        if (len == 0) {
+            *message = "invalid tag name";
+            return p;
+        }
+
+        /* find the end of the tag, the '>' in the quoted attribute values is skipped */
+        char quote = 0;
+        for (; q < end; q++) {
+            if (quote) {
+                if (*q == quote) quote = 0;
+            }
+            else if (*q == '"' || *q == '\'')
+                quote = *q;
+
+            else if (*q == '>' || *q == '<')
+                break;
+        }
+
+        if (q == end || *q == '<') {
+            *message = "unterminated tag";
+            return p;
+        }
+
+        if (is_close) {
+            if (depth == 0 || lens[depth-1] != len || memcmp(names[depth-1], name, len) != 0) {
+                *message = "mismatched close tag";
+                return p;
+            }
+            depth--;
+        }
+        else if (q[-1] != '/') {  /* not the empty element (<tag/>) */
+            if (depth == VALIDATE_MAX_DEPTH) {
+                *message = "too deep nested elements";
+                return p;
+            }
+            names[depth] = name;
+            lens[depth++] = len;
+        }
+        p = q + 1;
+    }
+
+    if (depth > 0) {
+        *message = "unclosed element";
+        return names[depth-1] - 1;
+    }
+
+    return NULL;
+}
+
+
+const char *validate_body(const char *data, uint32_t size, const char **message)
+{
+    const char *pos = utf8_check(data, data + size, message);
+    if (pos != NULL) return pos;
+
+    return tags_check(data, data + size, message);
+}
+
+
+/* func: check the data outside the data bodies, only blanks and markups are allowed
+ *
+ *   n_open:  the number of open tags allowed (the set tag before the first data body)
+ *   n_close: the number of close tags found (the set tag after the last data body)
+ */
+static void validate_outside(cache_t *cache, const char *start, const char *end, int *n_open, int *n_close)
+{
+    validate_t *validate = cache->validate;
+    const char *message = NULL, *pos = utf8_check(start, end, &message);
+
+    validate->n_byte += end - start;
+    if (pos != NULL) {
+        validate_error(validate, stream_cache_offset(cache, pos), message);
+        end = pos;
+    }
+
+    for (const char *p=start; p < end; ) {
+        if (is_blank(*p)) {
+            p++;
+            continue;
+        }
+
+        const char *close = *p == '<' ? memchr(p, '>', end - p) : NULL;
+        const int is_markup = close != NULL && (p[1] == '?' || p[1] == '!');
+
+        if (close != NULL && !is_markup && p[1] == '/' && n_close != NULL)
+            (*n_close)++;
+
+        else if (close != NULL && !is_markup && p[1] != '/' && n_open != NULL && *n_open > 0)
+            (*n_open)--;
+
+        else if (!is_markup) {
+            validate_error(validate, stream_cache_offset(cache, p), n_close ? "unexpected data after the last "
+                           "data body" : "unexpected data between the data bodies");
+            return;
+        }
+        p = close + 1;
+    }
+}
+
+
+void validate_gap(cache_t *cache, const char *start, const char *end)
+{
+    validate_t *validate = cache->validate;
+
+    if (validate->resync) {  /* the data before the first data body is a part of the previous data body */
+        validate->n_byte += end - start;
+        validate->resync = 0;
+    }
+    else {
+        int n_open = !validate->started && !validate->set_open;
+        validate_outside(cache, start, end, &n_open, NULL);
+        validate->set_open |= !validate->started && n_open == 0;
+    }
+
+    validate->started = 1;
+}
+
+
+void validate_batch(cache_t *cache)
+{
+    validate_t *validate = cache->validate;
+    uint64_t n_byte = 0;
+
+    #pragma omp parallel for schedule(dynamic, 64) reduction(+:n_byte)
+    for (int i=0; i < cache->size; i++) {
+        const body_t *body = &cache->item_list[i];
+        const char *message = NULL, *pos = validate_body(body->start, body->size, &message);
+
+        n_byte += body->size;
+        if (pos != NULL) {
+            #pragma omp critical(validate_error)
+            validate_error(validate, stream_cache_offset(cache, pos), message);
+        }
+    }
+
+    validate->n_byte += n_byte;
+}
+
+
+uint64_t validate_finish(cache_t *cache)
+{
+    validate_t *validate = cache->validate;
+    buffer_t *buffer = &cache->buffer;
+
+    /* the start tag without the end tag: the last data body is cut off */
+    const char *end = buffer->front + buffer->size;
+    const char *body = memmem(buffer->front, buffer->size, buffer->start_tag.s, buffer->start_tag.l);
+
+    int n_close = 0;
+    validate_outside(cache, buffer->front, body ? body : end, NULL, &n_close);
+
+    if (body != NULL) {  /* e.g. the NUL bytes stop searching the end tag */
+        const char *message = NULL, *pos = utf8_check(body, end, &message);
+        if (pos != NULL) validate_error(validate, stream_cache_offset(cache, pos), message);
+
+        validate->n_byte += end - body;
+        validate_error(validate, stream_cache_offset(cache, body), "unterminated data body");
+    }
+
+    else if (n_close == 0)
+        validate_error(validate, stream_cache_offset(cache, end), "missing the close tag of the set");
+
+    validate->finished = 1;
+    return validate->n_error;
+}
+
+
+uint64_t validate_report(const validate_t *validate)
+{
+    fprintf(stderr, "\n[*] validate: %lu bytes, %lu errors\n", (unsigned long)validate->n_byte,
+            (unsigned long)validate->n_error);
+
+    for (int k=0; k < validate->n_kept; k++)
+        fprintf(stderr, "  (-) offset %lu: %s\n", (unsigned long)validate->errors[k].offset,
+                validate->errors[k].message);
+
+    if (validate->n_error > 0)
+        fprintf(stderr, "[Error:%s] the xml file is INVALID!\n", __func__);
+
+    return validate->n_error;
+}
@@ -0,0 +1,107 @@
+/*************************************************************************
+    > File Name: xml_validate.h
+    > Author: xlzh
+    > Mail: xiaolongzhang2015@163.com
+    > Created Time: 2025年12月23 10时12分05秒
+ ************************************************************************/
+
+#ifndef INSDCXMLPARSER_XML_VALIDATE_H
+#define INSDCXMLPARSER_XML_VALIDATE_H
+
+#include <stdint.h>
+#include "stream_reader.h"
+
+/* the number of errors kept (with the smallest offsets) to report */
+#define VALIDATE_MAX_ERROR 10
+
+/* the maximum depth of the nested elements in one data body */
+#define VALIDATE_MAX_DEPTH 256
+
+
+/*! @typedef valid_error_t
+  @abstract the validation error (the offset and the description)
+  @field  offset            the offset of the error in the file
+  @field  message           the description of the error
+ */
+typedef struct {
+    uint64_t offset;
+    const char *message;
+} valid_error_t;
+
+
+/*! @typedef validate_t
+  @abstract the state of the validation along the stream
+  @field  n_byte            the number of bytes validated
+  @field  n_error           the number of errors found
+  @field  started           [0|1] 1: the first data body has been found
+  @field  resync            [0|1] 1: the stream is repositioned, the data before the next data body is skipped
+  @field  set_open          [0|1] 1: the open tag of the set (e.g. <BioSampleSet>) has been found
+  @field  finished          [0|1] 1: the stream is read to the end, the data after the last data body is checked
+  @field  n_kept            the number of errors kept
+  @field  errors            the errors with the smallest offsets
+ */
+typedef struct validate_t {
+    uint64_t n_byte;
+    uint64_t n_error;
+    int started;
+    int resync;
+    int set_open;
+    int finished;
+    int n_kept;
+    valid_error_t errors[VALIDATE_MAX_ERROR];
+} validate_t;
+
+
+/*! @function: initiation of the validation state
+  @return                    validate object
+ */
+validate_t *validate_init(void);
+
+
+/*! @function: destroy the validation state
+  @param  validate           the validate object
+  @return
+ */
+void validate_destroy(validate_t *validate);
+
+
+/*! @function: check the data between two data bodies (only blanks and markups are allowed)
+  @param  cache              the cache object with validation enabled
+  @param  start              the start of the data (in the buffer)
+  @param  end                the end of the data (exclusive)
+  @return
+ */
+void validate_gap(cache_t *cache, const char *start, const char *end);
+
+
+/*! @function: check the UTF-8 encoding and the balanced tags of all data bodies in the cache (in parallel)
+  @param  cache              the cache object with validation enabled
+  @return
+ */
+void validate_batch(cache_t *cache);
+
+
+/*! @function: check the data after the last data body (only the close tag of the set is allowed)
+  @param  cache              the cache object at the end of the stream
+  @return                    the number of errors found in the xml file
+ */
+uint64_t validate_finish(cache_t *cache);
+
+
+/*! @function: report the number of bytes checked and the first errors
+  @param  validate           the validate object
+  @return                    the number of errors found in the xml file
+ */
+uint64_t validate_report(const validate_t *validate);
+
+
+/*! @function: check one data body
+  @param  data               the start of the data body
+  @param  size               the size of the data body
+  @param  message            the description of the error
+  @return                    the position of the first error (NULL: no error)
+ */
+const char *validate_body(const char *data, uint32_t size, const char **message);
+
+
+#endif //INSDCXMLPARSER_XML_VALIDATE_H